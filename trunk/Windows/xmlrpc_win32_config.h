@@ -67,6 +67,9 @@
 #ifndef HAVE_STRICMP
 #define HAVE_STRICMP 0
 #endif
+#ifndef HAVE_ZLIB
+#define HAVE_ZLIB 0
+#endif
 #ifndef HAVE__STRICMP
 #define HAVE__STRICMP 0
 #endif
@@ -172,6 +175,41 @@
   #define HAVE_REGEX 1
 #endif
 
+/* HAVE_ATOMIC_REFCOUNT says we can maintain xmlrpc_value reference counts
+   with the compiler's atomic builtins (GCC 4.7 and later, Clang) instead of
+   a mutex per value.
+*/
+#if defined(__GNUC__) && defined(__ATOMIC_ACQ_REL)
+  #define HAVE_ATOMIC_REFCOUNT 1
+#else
+  #define HAVE_ATOMIC_REFCOUNT 0
+#endif
+
+/* XMLRPC_THREAD_LOCAL is the storage class specifier for a variable of which
+   each thread has its own copy, if HAVE_THREAD_LOCAL says the compiler has
+   one.
+*/
+#if defined(__GNUC__)
+  #define HAVE_THREAD_LOCAL 1
+  #define XMLRPC_THREAD_LOCAL __thread
+#else
+  #define HAVE_THREAD_LOCAL 0
+  #define XMLRPC_THREAD_LOCAL
+#endif
+
+/* HAVE_X86_SIMD says we can use SSE2 intrinsics, and AVX2 ones in a
+   function declared __attribute__((target("avx2"))) when
+   __builtin_cpu_supports("avx2") says the CPU has them (x86-64, GCC 4.9 and
+   later, or Clang, which reports itself as GCC 4.2).
+*/
+#if defined(__GNUC__) && defined(__x86_64__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || \
+     defined(__clang__))
+  #define HAVE_X86_SIMD 1
+#else
+  #define HAVE_X86_SIMD 0
+#endif
+
 #if MSVCRT
   #define XMLRPC_SOCKETPAIR xmlrpc_win32_socketpair
   #define XMLRPC_CLOSESOCKET closesocket
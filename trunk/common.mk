@@ -292,7 +292,8 @@ endif
 # libxmlrpc_util itself, but we have found (2012.12) that in a Mingw build
 # it does not.
 
-LIBXMLRPC_UTIL_LIBDEP = -L$(LIBXMLRPC_UTIL_DIR) -lxmlrpc_util $(THREAD_LIBS)
+LIBXMLRPC_UTIL_LIBDEP = \
+  -L$(LIBXMLRPC_UTIL_DIR) -lxmlrpc_util $(ZLIB_LIBS) $(THREAD_LIBS)
 
 ##############################################################################
 #            RULES TO BUILD OBJECT FILES TO LINK INTO LIBRARIES              #
@@ -436,6 +437,8 @@ $(BLDDIR)/lib/curl_transport/curltransaction.o \
 $(BLDDIR)/lib/curl_transport/curltransaction.osh \
 $(BLDDIR)/lib/curl_transport/curlmulti.o \
 $(BLDDIR)/lib/curl_transport/curlmulti.osh \
+$(BLDDIR)/lib/curl_transport/curlpool.o \
+$(BLDDIR)/lib/curl_transport/curlpool.osh \
 $(BLDDIR)/lib/curl_transport/lock_pthread.o \
 $(BLDDIR)/lib/curl_transport/lock_pthread.osh \
 : FORCE
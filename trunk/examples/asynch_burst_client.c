@@ -0,0 +1,254 @@
+/* An asynchronous XML-RPC client program written in C, for benchmarking
+   many RPCs in flight at once.
+
+   The program starts some number of asynchronous RPCs at once, then waits
+   for them all to finish, and does that for some number of rounds.  If
+   there are no more than 10 rounds, it reports how long each took and how
+   much CPU time the client used.
+   With thousands of RPCs in flight, that mostly measures how the client
+   library's cost grows with the number of RPCs it is juggling.
+
+   The RPC is "bench.sleep", which the example program 'bench_server'
+   executes.
+
+   The program takes four or more arguments, optionally preceded by
+   the option -nopool:
+
+     1) the number of RPCs to have in flight at once
+
+     2) the number of rounds
+
+     3) the number of milliseconds the server is to take to execute each
+        RPC
+
+     4...) server URLs.  The program sends the RPCs to these in turn.
+
+   Example:
+
+   $ ./bench_server 8080 5000 1 &
+   $ ./bench_server 8081 5000 1 &
+   $ ./asynch_burst_client 10000 3 0 \
+       http://localhost:8080/RPC2 http://localhost:8081/RPC2
+
+   -nopool makes the Curl transport give every RPC a new Curl session
+   instead of reusing one from its session pool.  At the end, the program
+   reports the total rate and the pool's hits and misses, so running it
+   with and without -nopool compares the two.  E.g. 100,000 RPCs, 8 at a
+   time:
+
+   $ ./asynch_burst_client 8 12500 0 http://localhost:8080/RPC2
+   $ ./asynch_burst_client -nopool 8 12500 0 http://localhost:8080/RPC2
+
+   Each RPC in flight needs a connection, and so a file descriptor, at both
+   ends.  An Abyss server uses 3 file descriptors per connection.  Both
+   programs raise their own limit on open files as far as the system allows;
+   use several servers if that isn't far enough for one.
+
+   Each server must be able to serve its share of the connections at once
+   (bench_server's MAX_CONN argument).  Otherwise the excess connections
+   wait until idle ones reach the server's keep-alive timeout.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/client.h>
+#include <xmlrpc-c/transport.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define NAME "Xmlrpc-c Asynchronous Burst Benchmark Client"
+#define VERSION "1.0"
+
+static unsigned int failedCt;
+    /* Number of RPCs that have failed so far */
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static void
+handleResponse(const char *   const serverUrl,
+               const char *   const methodName,
+               xmlrpc_value * const paramArrayP,
+               void *         const user_data,
+               xmlrpc_env *   const faultP,
+               xmlrpc_value * const resultP) {
+
+    if (faultP->fault_occurred) {
+        if (failedCt == 0)
+            fprintf(stderr, "RPC failed.  %s (%d)\n",
+                    faultP->fault_string, faultP->fault_code);
+        ++failedCt;
+    }
+}
+
+
+
+static void
+raiseOpenFileLimit(void) {
+
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+
+
+static double
+seconds(struct timeval const tv) {
+
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    xmlrpc_env env;
+    unsigned int argi;
+    int noPool;
+    const char ** serverUrl;
+    unsigned int serverCt;
+    unsigned int rpcCt;
+    unsigned int roundCt;
+    xmlrpc_int32 sleepMs;
+    struct xmlrpc_curl_xportparms curlParms;
+    struct xmlrpc_client_transport * transportP;
+    struct xmlrpc_clientparms clientParms;
+    xmlrpc_client * clientP;
+    struct xmlrpc_curl_poolstats poolStats;
+    struct timeval benchStart;
+    unsigned int round;
+
+    argi = 1;
+    if (argc > 1 && strcmp(argv[1], "-nopool") == 0) {
+        noPool = 1;
+        ++argi;
+    } else
+        noPool = 0;
+
+    if (argc - argi < 4) {
+        fprintf(stderr, "Usage: asynch_burst_client [-nopool] "
+                "RPCS_IN_FLIGHT ROUNDS SLEEP_MS URL [URL ...]\n");
+        exit(1);
+    }
+    rpcCt     = atoi(argv[argi + 0]);
+    roundCt   = atoi(argv[argi + 1]);
+    sleepMs   = atoi(argv[argi + 2]);
+    serverUrl = &argv[argi + 3];
+    serverCt  = argc - (argi + 3);
+
+    raiseOpenFileLimit();
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    dieIfFaultOccurred(&env);
+
+    memset(&curlParms, 0, sizeof(curlParms));
+    curlParms.no_session_pool   = noPool;
+    curlParms.session_pool_size = rpcCt;
+        /* Keep every round's Curl sessions for the next round */
+
+    /* We create the transport ourselves, rather than have the client do
+       it, so we can ask it for its session pool statistics.
+    */
+    xmlrpc_curl_transport_ops.create(&env, XMLRPC_CLIENT_NO_FLAGS,
+                                     NAME, VERSION,
+                                     &curlParms,
+                                     XMLRPC_CXPSIZE(session_pool_size),
+                                     &transportP);
+    dieIfFaultOccurred(&env);
+
+    memset(&clientParms, 0, sizeof(clientParms));
+    clientParms.transportOpsP     = &xmlrpc_curl_transport_ops;
+    clientParms.transportP        = transportP;
+    clientParms.dialect           = xmlrpc_dialect_i8;
+    clientParms.transportOps_size = sizeof(xmlrpc_curl_transport_ops);
+
+    xmlrpc_client_create(&env, XMLRPC_CLIENT_NO_FLAGS, NAME, VERSION,
+                         &clientParms, XMLRPC_CPSIZE(transportOps_size),
+                         &clientP);
+    dieIfFaultOccurred(&env);
+
+    gettimeofday(&benchStart, NULL);
+    failedCt = 0;
+
+    for (round = 0; round < roundCt; ++round) {
+        struct timeval start, started, end;
+        struct rusage usageStart, usageEnd;
+        unsigned int const failedCtBefore = failedCt;
+
+        unsigned int i;
+
+        gettimeofday(&start, NULL);
+        getrusage(RUSAGE_SELF, &usageStart);
+
+        for (i = 0; i < rpcCt; ++i) {
+            xmlrpc_client_start_rpcf(&env, clientP, serverUrl[i % serverCt],
+                                     "bench.sleep", &handleResponse, NULL,
+                                     "(i)", sleepMs);
+            dieIfFaultOccurred(&env);
+        }
+        gettimeofday(&started, NULL);
+
+        xmlrpc_client_event_loop_finish(clientP);
+
+        gettimeofday(&end, NULL);
+        getrusage(RUSAGE_SELF, &usageEnd);
+
+        if (roundCt <= 10)
+            printf("Round %u: %u RPCs: start %.3f s, all done %.3f s; "
+                   "CPU user %.3f s, system %.3f s; %u failed\n",
+                   round, rpcCt,
+                   seconds(started) - seconds(start),
+                   seconds(end) - seconds(start),
+                   seconds(usageEnd.ru_utime) - seconds(usageStart.ru_utime),
+                   seconds(usageEnd.ru_stime) - seconds(usageStart.ru_stime),
+                   failedCt - failedCtBefore);
+    }
+    {
+        struct timeval benchEnd;
+        double elapsed;
+
+        gettimeofday(&benchEnd, NULL);
+        elapsed = seconds(benchEnd) - seconds(benchStart);
+
+        xmlrpc_curl_transport_get_pool_stats(transportP, &poolStats);
+
+        printf("Session pool %s: %u RPCs in %.3f s = %.0f RPCs/s; "
+               "%u failed; pool hits %lu, misses %lu, discards %lu\n",
+               noPool ? "off" : "on", rpcCt * roundCt, elapsed,
+               rpcCt * roundCt / elapsed, failedCt,
+               poolStats.hits, poolStats.misses, poolStats.discards);
+    }
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_curl_transport_ops.destroy(transportP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+
+    return failedCt > 0 ? 1 : 0;
+}
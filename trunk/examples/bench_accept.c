@@ -0,0 +1,251 @@
+/* A benchmark of how fast an Xmlrpc-c Abyss server takes on new
+   connections when it is at its connection limit.
+
+   The program runs some number of client threads at once.  Each opens a
+   connection to the server, sends one "bench.sleep" RPC on it, reads the
+   response and closes the connection, and does that some number of times.
+   The program reports the 50th, 90th and 99th percentile of the time from
+   starting to connect to receiving the first byte of the response.
+
+   Run it against the example program 'bench_server', with fewer
+   connections allowed (bench_server's MAX_CONN argument) than client
+   threads.  Then most connections have to wait for the server to finish
+   one and accept the next, so the percentiles show how promptly the
+   server notices that a connection has finished.
+
+   The program takes four arguments:
+
+     1) the TCP port number of the server on the loopback interface
+
+     2) the number of client threads
+
+     3) the number of connections each thread makes, one after another
+
+     4) the number of milliseconds the server is to take to execute each
+        RPC
+
+   Example:
+
+   $ ./bench_server 8080 4 &
+   $ ./bench_accept 8080 32 5 10
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define MAX_THREADS 1024
+
+static unsigned short portNumber;
+static unsigned int connPerThreadCt;
+static char request[1024];
+
+static double * latency;
+    /* latency[i * connPerThreadCt + j] is the seconds to first byte of
+       the jth connection thread i made.
+    */
+static unsigned int failedCt;
+static pthread_mutex_t failedLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+static void
+buildRequest(int const sleepMs) {
+
+    char body[512];
+
+    sprintf(body,
+            "<?xml version=\"1.0\"?>\r\n"
+            "<methodCall><methodName>bench.sleep</methodName>"
+            "<params><param><value><i4>%d</i4></value></param></params>"
+            "</methodCall>\r\n",
+            sleepMs);
+
+    sprintf(request,
+            "POST /RPC2 HTTP/1.0\r\n"
+            "Content-Type: text/xml\r\n"
+            "Content-Length: %u\r\n"
+            "\r\n"
+            "%s",
+            (unsigned)strlen(body), body);
+}
+
+
+
+static int
+oneConnection(double * const secondsP) {
+/*----------------------------------------------------------------------------
+   Execute the RPC on a new connection.  Return the time from starting to
+   connect to the first byte of the response as *secondsP.
+
+   Return 0 for success, -1 for failure.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in sockAddr;
+    struct timeval start;
+    char buffer[4096];
+    ssize_t rc;
+    int fd;
+    int retval;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family      = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockAddr.sin_port        = htons(portNumber);
+
+    gettimeofday(&start, NULL);
+
+    if (connect(fd, (struct sockaddr *)&sockAddr, sizeof(sockAddr)) != 0)
+        retval = -1;
+    else if (write(fd, request, strlen(request)) != (ssize_t)strlen(request))
+        retval = -1;
+    else {
+        rc = read(fd, buffer, sizeof(buffer));
+        if (rc <= 0)
+            retval = -1;
+        else {
+            *secondsP = secondsSince(start);
+
+            /* Read the rest; the server closes the connection after it */
+            while (read(fd, buffer, sizeof(buffer)) > 0);
+
+            retval = 0;
+        }
+    }
+    close(fd);
+
+    return retval;
+}
+
+
+
+static void *
+clientThread(void * const arg) {
+
+    unsigned int const threadNum = (unsigned int)(unsigned long)arg;
+
+    unsigned int i;
+
+    for (i = 0; i < connPerThreadCt; ++i) {
+        double * const latencyP = &latency[threadNum * connPerThreadCt + i];
+
+        if (oneConnection(latencyP) != 0) {
+            *latencyP = -1;
+
+            pthread_mutex_lock(&failedLock);
+            ++failedCt;
+            pthread_mutex_unlock(&failedLock);
+        }
+    }
+    return NULL;
+}
+
+
+
+static int
+compareDouble(const void * const aP,
+              const void * const bP) {
+
+    double const a = *(const double *)aP;
+    double const b = *(const double *)bP;
+
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    pthread_t threads[MAX_THREADS];
+    unsigned int threadCt;
+    unsigned int connCt;
+    unsigned int okCt;
+    struct timeval start;
+    double elapsed;
+    unsigned int i;
+
+    if (argc-1 != 4) {
+        fprintf(stderr, "Usage: bench_accept PORT THREADS CONNECTIONS "
+                "SLEEP_MS\n");
+        exit(1);
+    }
+    portNumber      = atoi(argv[1]);
+    threadCt        = atoi(argv[2]);
+    connPerThreadCt = atoi(argv[3]);
+
+    if (threadCt < 1 || threadCt > MAX_THREADS) {
+        fprintf(stderr, "Number of threads must be 1 to %u\n", MAX_THREADS);
+        exit(1);
+    }
+    buildRequest(atoi(argv[4]));
+
+    connCt = threadCt * connPerThreadCt;
+
+    latency = malloc(connCt * sizeof(latency[0]));
+    if (latency == NULL) {
+        fprintf(stderr, "Can't allocate memory for %u connections\n", connCt);
+        exit(1);
+    }
+    failedCt = 0;
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < threadCt; ++i) {
+        if (pthread_create(&threads[i], NULL, &clientThread,
+                           (void *)(unsigned long)i) != 0) {
+            fprintf(stderr, "Can't create thread %u\n", i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < threadCt; ++i)
+        pthread_join(threads[i], NULL);
+
+    elapsed = secondsSince(start);
+
+    /* Failed connections have latency -1, so they sort first */
+    qsort(latency, connCt, sizeof(latency[0]), &compareDouble);
+
+    okCt = connCt - failedCt;
+
+    printf("%u connections in %.3f s; %u failed\n",
+           connCt, elapsed, failedCt);
+
+    if (okCt > 0) {
+        double * const ok = &latency[failedCt];
+
+        printf("Connect to first byte: p50 %.1f ms, p90 %.1f ms, "
+               "p99 %.1f ms, max %.1f ms\n",
+               ok[okCt * 50 / 100]  * 1e3,
+               ok[okCt * 90 / 100]  * 1e3,
+               ok[okCt * 99 / 100]  * 1e3,
+               ok[okCt - 1]         * 1e3);
+    }
+    free(latency);
+
+    return failedCt > 0 ? 1 : 0;
+}
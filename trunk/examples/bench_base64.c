@@ -0,0 +1,153 @@
+/* A benchmark of base64 encoding and decoding.
+
+   For sizes from 1 KB up to some maximum, growing by a factor of 4 each
+   time, the program encodes that many bytes of binary data with
+   xmlrpc_base64_encode() (which breaks lines every 76 characters, as in a
+   <base64> XML-RPC value) and decodes the result with
+   xmlrpc_base64_decode().  It reports the rate of each in megabytes of
+   binary data per second.
+
+   For small sizes, it does each many times, so that every size processes
+   at least 256 MB in all.
+
+   The program takes one optional argument: the maximum size in kilobytes
+   (default 1048576, i.e. 1 GB).  At 1 GB, it needs about 3.5 GB of memory.
+
+   Example:
+
+   $ ./bench_base64
+   $ ./bench_base64 65536
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/util.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define MIN_BYTES_PER_SIZE (256.0 * 1024 * 1024)
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+static void
+benchSize(const unsigned char * const data,
+          size_t                const size) {
+
+    unsigned int const repeatCt =
+        size >= MIN_BYTES_PER_SIZE ? 1 :
+        (unsigned int)(MIN_BYTES_PER_SIZE / size);
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * encodedP;
+    xmlrpc_mem_block * decodedP;
+    struct timeval start;
+    double encodeSecs, decodeSecs;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0, encodedP = NULL; i < repeatCt; ++i) {
+        if (encodedP)
+            XMLRPC_MEMBLOCK_FREE(char, encodedP);
+
+        encodedP = xmlrpc_base64_encode(&env, data, size);
+        dieIfFaultOccurred(&env);
+    }
+    encodeSecs = secondsSince(start);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0, decodedP = NULL; i < repeatCt; ++i) {
+        if (decodedP)
+            XMLRPC_MEMBLOCK_FREE(unsigned char, decodedP);
+
+        decodedP = xmlrpc_base64_decode(
+            &env,
+            XMLRPC_MEMBLOCK_CONTENTS(char, encodedP),
+            XMLRPC_MEMBLOCK_SIZE(char, encodedP));
+        dieIfFaultOccurred(&env);
+    }
+    decodeSecs = secondsSince(start);
+
+    if (XMLRPC_MEMBLOCK_SIZE(unsigned char, decodedP) != size ||
+        memcmp(XMLRPC_MEMBLOCK_CONTENTS(unsigned char, decodedP),
+               data, size) != 0) {
+        fprintf(stderr, "Decoding %lu bytes didn't give back the original\n",
+                (unsigned long)size);
+        exit(1);
+    }
+    printf("%10lu KB   %14.1f   %14.1f\n",
+           (unsigned long)(size / 1024),
+           (double)size * repeatCt / encodeSecs / 1e6,
+           (double)size * repeatCt / decodeSecs / 1e6);
+
+    XMLRPC_MEMBLOCK_FREE(char, encodedP);
+    XMLRPC_MEMBLOCK_FREE(unsigned char, decodedP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    size_t maxSize;
+    unsigned char * data;
+    size_t size;
+    size_t i;
+
+    if (argc-1 > 1) {
+        fprintf(stderr, "Usage: bench_base64 [MAX_KILOBYTES]\n");
+        exit(1);
+    }
+    maxSize = (argc-1 >= 1 ? strtoul(argv[1], NULL, 10) : 1048576) * 1024;
+
+    data = malloc(maxSize);
+    if (data == NULL) {
+        fprintf(stderr, "Can't allocate %lu bytes\n", (unsigned long)maxSize);
+        exit(1);
+    }
+    /* Bytes that look random enough that nothing could take a shortcut */
+    for (i = 0; i < maxSize; ++i)
+        data[i] = (unsigned char)((i * 2654435761u) >> 13);
+
+    printf("      size   encode (MB/s)   decode (MB/s)\n");
+
+    for (size = 1024; size <= maxSize; size *= 4)
+        benchSize(data, size);
+
+    free(data);
+
+    return 0;
+}
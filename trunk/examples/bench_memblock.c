@@ -0,0 +1,203 @@
+/* A benchmark of building large XML-RPC responses in memory blocks.
+
+   For each of several sizes, the program does two things:
+
+     1) It grows an xmlrpc_mem_block to that size by appending 4 KB at a
+        time, the way the serializer and the Abyss server build a body.
+        Whenever the block's contents move, the library had to copy
+        everything in it, so the program counts those moves and the bytes
+        in the block when each happened.
+
+     2) It serializes a response whose result is a base64 value of that
+        many bytes, with xmlrpc_serialize_response(), and times that.
+
+   Where memory blocks grow by a fixed amount, the bytes copied grow with
+   the square of the size.  Where they grow geometrically, or in place,
+   they grow in proportion to it.
+
+   The count of bytes copied is an upper bound: a move of a very large
+   block may be done by remapping pages rather than copying bytes.
+
+   The program takes one optional argument: the largest size, in
+   megabytes (default 200).  It does 1 MB and that, and 20 MB in between
+   if it fits.
+
+   Example:
+
+   $ ./bench_memblock
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define PIECE_SIZE 4096
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+static void
+growBlock(size_t         const size,
+          unsigned int * const moveCtP,
+          double *       const bytesCopiedP,
+          double *       const secondsP) {
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * blockP;
+    char piece[PIECE_SIZE];
+    const char * contents;
+    unsigned int moveCt;
+    double bytesCopied;
+    struct timeval start;
+    size_t len;
+
+    xmlrpc_env_init(&env);
+
+    memset(piece, 'x', sizeof(piece));
+
+    gettimeofday(&start, NULL);
+
+    blockP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    dieIfFaultOccurred(&env);
+
+    contents = XMLRPC_MEMBLOCK_CONTENTS(char, blockP);
+
+    for (len = 0, moveCt = 0, bytesCopied = 0; len < size;
+         len += PIECE_SIZE) {
+
+        XMLRPC_MEMBLOCK_APPEND(char, &env, blockP, piece, PIECE_SIZE);
+        dieIfFaultOccurred(&env);
+
+        if (XMLRPC_MEMBLOCK_CONTENTS(char, blockP) != contents) {
+            if (len > 0) {
+                ++moveCt;
+                bytesCopied += len;
+            }
+            contents = XMLRPC_MEMBLOCK_CONTENTS(char, blockP);
+        }
+    }
+    *secondsP = secondsSince(start);
+
+    XMLRPC_MEMBLOCK_FREE(char, blockP);
+
+    *moveCtP      = moveCt;
+    *bytesCopiedP = bytesCopied;
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static double
+secondsToSerialize(size_t const size) {
+
+    xmlrpc_env env;
+    unsigned char * data;
+    xmlrpc_value * base64P;
+    xmlrpc_mem_block * responseP;
+    struct timeval start;
+    double secs;
+
+    xmlrpc_env_init(&env);
+
+    data = malloc(size);
+    if (data == NULL) {
+        fprintf(stderr, "Can't allocate %lu bytes\n", (unsigned long)size);
+        exit(1);
+    }
+    memset(data, 0x5a, size);
+
+    base64P = xmlrpc_base64_new(&env, size, data);
+    dieIfFaultOccurred(&env);
+
+    free(data);
+
+    gettimeofday(&start, NULL);
+
+    responseP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    dieIfFaultOccurred(&env);
+
+    xmlrpc_serialize_response(&env, responseP, base64P);
+    dieIfFaultOccurred(&env);
+
+    secs = secondsSince(start);
+
+    XMLRPC_MEMBLOCK_FREE(char, responseP);
+    xmlrpc_DECREF(base64P);
+
+    xmlrpc_env_clean(&env);
+
+    return secs;
+}
+
+
+
+static void
+benchSize(unsigned int const megabytes) {
+
+    size_t const size = (size_t)megabytes * 1024 * 1024;
+
+    unsigned int moveCt;
+    double bytesCopied;
+    double growSecs;
+
+    growBlock(size, &moveCt, &bytesCopied, &growSecs);
+
+    printf("%6u MB   %6u   %13.1f   %10.3f   %14.3f\n",
+           megabytes, moveCt, bytesCopied / 1024 / 1024, growSecs,
+           secondsToSerialize(size));
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned int maxMegabytes;
+
+    if (argc-1 > 1) {
+        fprintf(stderr, "Usage: bench_memblock [MAX_MEGABYTES]\n");
+        exit(1);
+    }
+    maxMegabytes = argc-1 >= 1 ? atoi(argv[1]) : 200;
+
+    printf("   size    moves   copied (MB)   append (s)   serialize (s)\n");
+
+    benchSize(1);
+
+    if (maxMegabytes > 20)
+        benchSize(20);
+
+    if (maxMegabytes > 1)
+        benchSize(maxMegabytes);
+
+    return 0;
+}
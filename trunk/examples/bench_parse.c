@@ -0,0 +1,213 @@
+/* A benchmark of parsing large XML-RPC responses.
+
+   The program generates the XML of a response whose result is an array of
+   some number of elements, and then parses it with
+   xmlrpc_parse_response2() several times.  It reports the parse rate and
+   how much the parsing grew the program's peak memory use (resident set
+   size), which shows how many copies of the document the parser holds at
+   once.
+
+   The program takes up to three arguments:
+
+     1) the kind of array element:
+
+          struct    a struct with a string member and an integer member
+                    (default)
+
+          datetime  a dateTime.iso8601 value
+
+     2) the number of elements (default 500,000)
+
+     3) the number of times to parse the response (default 5)
+
+   Example:
+
+   $ ./bench_parse
+   $ ./bench_parse struct 100000 20
+   $ ./bench_parse datetime 100000
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <xmlrpc-c/base.h>
+
+#include "config.h"  /* information about this build environment */
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static void
+structElementXml(unsigned int const i,
+                 char *       const buffer) {
+
+    sprintf(buffer,
+            "<value><struct>"
+            "<member><name>name</name>"
+            "<value><string>item%u</string></value></member>"
+            "<member><name>value</name>"
+            "<value><i4>%u</i4></value></member>"
+            "</struct></value>\r\n",
+            i, i);
+}
+
+
+
+static void
+datetimeElementXml(unsigned int const i,
+                   char *       const buffer) {
+
+    sprintf(buffer,
+            "<value><dateTime.iso8601>2026%02u%02uT%02u:%02u:%02u"
+            "</dateTime.iso8601></value>\r\n",
+            1 + i / 28 % 12, 1 + i % 28, i / 3600 % 24, i / 60 % 60, i % 60);
+}
+
+
+
+static xmlrpc_mem_block *
+responseXml(const char * const kind,
+            unsigned int const elementCt) {
+/*----------------------------------------------------------------------------
+   Generate the XML of the response as text, rather than build the values
+   and serialize them, so that the values don't count in the program's peak
+   memory use before the parse.
+-----------------------------------------------------------------------------*/
+    const char * const head =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+        "<methodResponse>\r\n"
+        "<params>\r\n"
+        "<param><value><array><data>\r\n";
+    const char * const tail =
+        "</data></array></value></param>\r\n"
+        "</params>\r\n"
+        "</methodResponse>\r\n";
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * responseP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    responseP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    dieIfFaultOccurred(&env);
+
+    XMLRPC_MEMBLOCK_APPEND(char, &env, responseP, head, strlen(head));
+    dieIfFaultOccurred(&env);
+
+    for (i = 0; i < elementCt; ++i) {
+        char element[512];
+
+        if (strcmp(kind, "struct") == 0)
+            structElementXml(i, element);
+        else if (strcmp(kind, "datetime") == 0)
+            datetimeElementXml(i, element);
+        else {
+            fprintf(stderr, "Unrecognized element kind '%s'\n", kind);
+            exit(1);
+        }
+        XMLRPC_MEMBLOCK_APPEND(char, &env, responseP,
+                               element, strlen(element));
+        dieIfFaultOccurred(&env);
+    }
+    XMLRPC_MEMBLOCK_APPEND(char, &env, responseP, tail, strlen(tail));
+    dieIfFaultOccurred(&env);
+
+    xmlrpc_env_clean(&env);
+
+    return responseP;
+}
+
+
+
+static long
+maxRssKb(void) {
+
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    const char * kind;
+    unsigned int elementCt;
+    unsigned int repeatCt;
+    xmlrpc_mem_block * responseP;
+    size_t xmlSize;
+    long rssBeforeKb;
+    struct timeval start, end;
+    double secs;
+    unsigned int i;
+
+    if (argc-1 > 3) {
+        fprintf(stderr, "Usage: bench_parse [KIND [ELEMENTS [REPEATS]]]\n");
+        exit(1);
+    }
+    kind      = argc-1 >= 1 ? argv[1] : "struct";
+    elementCt = argc-1 >= 2 ? atoi(argv[2]) : 500000;
+    repeatCt  = argc-1 >= 3 ? atoi(argv[3]) : 5;
+
+    responseP = responseXml(kind, elementCt);
+    xmlSize = XMLRPC_MEMBLOCK_SIZE(char, responseP);
+
+    xmlrpc_limit_set(XMLRPC_XML_SIZE_LIMIT_ID, xmlSize);
+
+    rssBeforeKb = maxRssKb();
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < repeatCt; ++i) {
+        xmlrpc_env env;
+        xmlrpc_value * resultP;
+        int faultCode;
+        const char * faultString;
+
+        xmlrpc_env_init(&env);
+
+        xmlrpc_parse_response2(&env,
+                               XMLRPC_MEMBLOCK_CONTENTS(char, responseP),
+                               xmlSize, &resultP, &faultCode, &faultString);
+        dieIfFaultOccurred(&env);
+
+        if (faultString) {
+            fprintf(stderr, "Response is a fault: %s\n", faultString);
+            exit(1);
+        }
+        xmlrpc_DECREF(resultP);
+
+        xmlrpc_env_clean(&env);
+    }
+    gettimeofday(&end, NULL);
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+
+    printf("%u %s elements, %.1f MB of XML\n",
+           elementCt, kind, xmlSize / 1e6);
+    printf("parse: %.3f s each, %.1f MB/s; peak memory grew %.0f MB\n",
+           secs / repeatCt, xmlSize * repeatCt / secs / 1e6,
+           (maxRssKb() - rssBeforeKb) / 1024.0);
+
+    XMLRPC_MEMBLOCK_FREE(char, responseP);
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* A benchmark of xmlrpc_INCREF() and xmlrpc_DECREF() under threads.
+
+   For 1, 2, 4, 8, 16 and 32 threads, each thread does some number of
+   INCREF/DECREF pairs, first on a value of its own, then on one value all
+   the threads share.  The program reports how many reference count
+   operations per second all the threads did together in each case.
+
+   Where Xmlrpc-c is built with atomic reference counts
+   (HAVE_ATOMIC_REFCOUNT in xmlrpc_config.h), an operation is an atomic
+   add.  Otherwise, it is a mutex lock and unlock, so running this against
+   both builds compares the two.
+
+   The program takes one optional argument: the number of INCREF/DECREF
+   pairs each thread does in each case (default 1,000,000).
+
+   Example:
+
+   $ ./bench_refcount
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define MAX_THREADS 32
+
+static unsigned long pairCt;
+static xmlrpc_value * sharedValueP;
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static void *
+incrementOwn(void * const arg) {
+
+    xmlrpc_env env;
+    xmlrpc_value * valueP;
+    unsigned long i;
+
+    xmlrpc_env_init(&env);
+
+    valueP = xmlrpc_int_new(&env, 1);
+    dieIfFaultOccurred(&env);
+
+    for (i = 0; i < pairCt; ++i) {
+        xmlrpc_INCREF(valueP);
+        xmlrpc_DECREF(valueP);
+    }
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_env_clean(&env);
+
+    return NULL;
+}
+
+
+
+static void *
+incrementShared(void * const arg) {
+
+    unsigned long i;
+
+    for (i = 0; i < pairCt; ++i) {
+        xmlrpc_INCREF(sharedValueP);
+        xmlrpc_DECREF(sharedValueP);
+    }
+    return NULL;
+}
+
+
+
+static double
+runThreads(unsigned int const threadCt,
+           void *    (*const threadFn)(void *)) {
+/*----------------------------------------------------------------------------
+   Run 'threadFn' in 'threadCt' threads at once and return how many
+   seconds it took them all.
+-----------------------------------------------------------------------------*/
+    pthread_t threads[MAX_THREADS];
+    struct timeval start, end;
+    unsigned int i;
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < threadCt; ++i) {
+        if (pthread_create(&threads[i], NULL, threadFn, NULL) != 0) {
+            fprintf(stderr, "Can't create thread %u\n", i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < threadCt; ++i)
+        pthread_join(threads[i], NULL);
+
+    gettimeofday(&end, NULL);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    xmlrpc_env env;
+    unsigned int threadCt;
+
+    if (argc-1 > 1) {
+        fprintf(stderr, "Usage: bench_refcount [PAIRS_PER_THREAD]\n");
+        exit(1);
+    }
+    pairCt = argc-1 >= 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+
+    xmlrpc_env_init(&env);
+
+    sharedValueP = xmlrpc_int_new(&env, 1);
+    dieIfFaultOccurred(&env);
+
+    printf("threads   own value (Mop/s)   shared value (Mop/s)\n");
+
+    for (threadCt = 1; threadCt <= MAX_THREADS; threadCt *= 2) {
+        double const opCt = 2.0 * pairCt * threadCt;
+
+        double const ownSecs    = runThreads(threadCt, &incrementOwn);
+        double const sharedSecs = runThreads(threadCt, &incrementShared);
+
+        printf("%7u   %17.1f   %20.1f\n", threadCt,
+               opCt / ownSecs / 1e6, opCt / sharedSecs / 1e6);
+    }
+
+    xmlrpc_DECREF(sharedValueP);
+
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/* A benchmark of XML-RPC method dispatch.
+
+   The program registers some number of methods, each of which does
+   nothing, and then executes calls to them, spread over all of them, with
+   xmlrpc_registry_process_call2(): parse the call, find the method,
+   execute it and serialize the response.  It does that twice, once before
+   and once after xmlrpc_registry_freeze(), and reports the time per call.
+
+   With a linear search of the methods, the time per call would grow with
+   the number of methods.  With the hash index, it stays about the same,
+   and with the perfect hash a freeze makes, lookup is the same two table
+   reads whatever the number.
+
+   The program takes up to two arguments:
+
+     1) the number of methods (default 900)
+
+     2) the number of calls to execute each time (default 200,000)
+
+   Example:
+
+   $ ./bench_registry
+   $ ./bench_registry 10
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/server.h>
+
+#include "config.h"  /* information about this build environment */
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static xmlrpc_value *
+doNothing(xmlrpc_env *   const envP,
+          xmlrpc_value * const paramArrayP,
+          void *         const serverInfo,
+          void *         const callInfo) {
+
+    return xmlrpc_nil_new(envP);
+}
+
+
+
+static void
+methodName(unsigned int const methodNum,
+           char *       const buffer) {
+
+    sprintf(buffer, "service.namespace.method%u", methodNum);
+}
+
+
+
+static double
+secondsToExecute(xmlrpc_registry *   const registryP,
+                 xmlrpc_mem_block ** const calls,
+                 unsigned int        const methodCt,
+                 unsigned long       const callCt) {
+
+    xmlrpc_env env;
+    struct timeval start, end;
+    unsigned long i;
+
+    xmlrpc_env_init(&env);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < callCt; ++i) {
+        /* Go through the methods in an order with no pattern to it, as
+           a real mix of calls would.
+        */
+        xmlrpc_mem_block * const callP = calls[(i * 7919) % methodCt];
+
+        xmlrpc_mem_block * responseP;
+
+        xmlrpc_registry_process_call2(&env, registryP,
+                                      XMLRPC_MEMBLOCK_CONTENTS(char, callP),
+                                      XMLRPC_MEMBLOCK_SIZE(char, callP),
+                                      NULL, &responseP);
+        dieIfFaultOccurred(&env);
+
+        XMLRPC_MEMBLOCK_FREE(char, responseP);
+    }
+    gettimeofday(&end, NULL);
+
+    xmlrpc_env_clean(&env);
+
+    return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    xmlrpc_env env;
+    unsigned int methodCt;
+    unsigned long callCt;
+    xmlrpc_registry * registryP;
+    xmlrpc_mem_block ** calls;
+    xmlrpc_value * paramArrayP;
+    double secs;
+    unsigned int i;
+
+    if (argc-1 > 2) {
+        fprintf(stderr, "Usage: bench_registry [METHODS [CALLS]]\n");
+        exit(1);
+    }
+    methodCt = argc-1 >= 1 ? atoi(argv[1]) : 900;
+    callCt   = argc-1 >= 2 ? strtoul(argv[2], NULL, 10) : 200000;
+
+    if (methodCt < 1) {
+        fprintf(stderr, "There must be at least one method\n");
+        exit(1);
+    }
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    dieIfFaultOccurred(&env);
+
+    calls = malloc(methodCt * sizeof(calls[0]));
+    if (calls == NULL) {
+        fprintf(stderr, "Can't allocate memory for %u calls\n", methodCt);
+        exit(1);
+    }
+    paramArrayP = xmlrpc_array_new(&env);
+    dieIfFaultOccurred(&env);
+
+    for (i = 0; i < methodCt; ++i) {
+        char name[64];
+
+        methodName(i, name);
+
+        xmlrpc_registry_add_method2(&env, registryP, name, &doNothing,
+                                    NULL, NULL, NULL);
+        dieIfFaultOccurred(&env);
+
+        calls[i] = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_serialize_call(&env, calls[i], name, paramArrayP);
+        dieIfFaultOccurred(&env);
+    }
+
+    printf("%u methods, %lu calls\n", methodCt, callCt);
+
+    secs = secondsToExecute(registryP, calls, methodCt, callCt);
+    printf("not frozen: %.2f us per call\n", secs * 1e6 / callCt);
+
+    xmlrpc_registry_freeze(&env, registryP);
+    dieIfFaultOccurred(&env);
+
+    secs = secondsToExecute(registryP, calls, methodCt, callCt);
+    printf("frozen:     %.2f us per call\n", secs * 1e6 / callCt);
+
+    for (i = 0; i < methodCt; ++i)
+        XMLRPC_MEMBLOCK_FREE(char, calls[i]);
+    free(calls);
+
+    xmlrpc_DECREF(paramArrayP);
+
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    return 0;
+}
@@ -0,0 +1,331 @@
+/* A benchmark of how fast an Abyss server sends a large static file.
+
+   The program writes a file of some size to a new temporary directory and
+   runs an Abyss server in a child process with that directory as its
+   document root.  Then it downloads the file from the server over the
+   loopback interface some number of times, one after another, with plain
+   HTTP GETs, and checks that it got the whole file each time.
+
+   It reports the download rate and how much CPU time the server process
+   used in all.  The CPU time shows whether the server copies the file
+   through its own memory or has the kernel send it straight from the page
+   cache, as with sendfile().
+
+   The program takes up to two arguments:
+
+     1) the size of the file in megabytes (default 4096)
+
+     2) the number of times to download it (default 2)
+
+   The file must fit in the page cache as well as on the disk holding the
+   temporary directory (the TMPDIR environment variable, or /tmp), or the
+   benchmark measures the disk.
+
+   Example:
+
+   $ ./bench_sendfile
+   $ ./bench_sendfile 1024 5
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <xmlrpc-c/abyss.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define CHUNK_SIZE (1024 * 1024)
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+static void
+dieWithErrno(const char * const what) {
+
+    fprintf(stderr, "%s failed.  errno=%d (%s)\n",
+            what, errno, strerror(errno));
+    exit(1);
+}
+
+
+
+static void
+writeFile(const char * const fileName,
+          unsigned int const sizeMb) {
+
+    FILE * fileP;
+    char * chunk;
+    unsigned int i;
+
+    fileP = fopen(fileName, "wb");
+    if (!fileP)
+        dieWithErrno("fopen() of the file to serve");
+
+    chunk = malloc(CHUNK_SIZE);
+    if (!chunk) {
+        fprintf(stderr, "Can't allocate %u bytes\n", CHUNK_SIZE);
+        exit(1);
+    }
+    for (i = 0; i < CHUNK_SIZE; ++i)
+        chunk[i] = (char)((i * 2654435761u) >> 13);
+
+    for (i = 0; i < sizeMb; ++i) {
+        /* Make each megabyte different */
+        memcpy(chunk, &i, sizeof(i));
+
+        if (fwrite(chunk, CHUNK_SIZE, 1, fileP) != 1)
+            dieWithErrno("fwrite() of the file to serve");
+    }
+    if (fclose(fileP) != 0)
+        dieWithErrno("fclose() of the file to serve");
+
+    free(chunk);
+}
+
+
+
+static int
+listeningSocket(unsigned short * const portNumberP) {
+/*----------------------------------------------------------------------------
+   Make a socket listening on some free port of the loopback interface.
+
+   We listen before we start the server, so that we can connect to it as
+   soon as we like.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in addr;
+    socklen_t addrLen;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        dieWithErrno("socket()");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        dieWithErrno("bind()");
+
+    if (listen(fd, 16) != 0)
+        dieWithErrno("listen()");
+
+    addrLen = sizeof(addr);
+    if (getsockname(fd, (struct sockaddr *)&addr, &addrLen) != 0)
+        dieWithErrno("getsockname()");
+
+    *portNumberP = ntohs(addr.sin_port);
+
+    return fd;
+}
+
+
+
+static void
+runServer(int          const listenFd,
+          const char * const dirName) {
+/*----------------------------------------------------------------------------
+   Serve files from directory 'dirName' on 'listenFd' until someone kills
+   us.
+-----------------------------------------------------------------------------*/
+    const char * error;
+    TServer server;
+    abyss_bool success;
+
+    AbyssInit(&error);
+    if (error) {
+        fprintf(stderr, "Failed to initialize Abyss.  %s\n", error);
+        exit(1);
+    }
+    success = ServerCreateSocket(&server, "bench_sendfile", listenFd,
+                                 dirName, NULL);
+    if (!success) {
+        fprintf(stderr, "Failed to create Abyss server\n");
+        exit(1);
+    }
+    ServerInit(&server);
+
+    ServerRun(&server);
+
+    exit(0);
+}
+
+
+
+static unsigned long long
+download(unsigned short const portNumber,
+         char *         const buffer) {
+/*----------------------------------------------------------------------------
+   Download the file from the server and return the number of bytes of the
+   body of the response.
+
+   'buffer' is CHUNK_SIZE + 1 bytes, which must be enough for the whole
+   header and a terminating NUL.
+-----------------------------------------------------------------------------*/
+    const char * const request = "GET /data HTTP/1.0\r\n\r\n";
+
+    struct sockaddr_in addr;
+    int fd;
+    bool gotHeader;
+    unsigned long long bodySize;
+    size_t headerLen;
+    ssize_t rc;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        dieWithErrno("socket()");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(portNumber);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        dieWithErrno("connect()");
+
+    if (write(fd, request, strlen(request)) != (ssize_t)strlen(request))
+        dieWithErrno("write() of request");
+
+    /* Read the header into the front of the buffer, then the body through
+       the rest of it.
+    */
+    for (gotHeader = false, headerLen = 0, bodySize = 0, rc = 1; rc > 0; ) {
+        rc = read(fd, buffer + headerLen, CHUNK_SIZE - headerLen);
+
+        if (rc < 0)
+            dieWithErrno("read() of response");
+        else if (gotHeader)
+            bodySize += rc;
+        else {
+            const char * headerEnd;
+
+            headerLen += rc;
+            buffer[headerLen] = '\0';
+
+            headerEnd = strstr(buffer, "\r\n\r\n");
+            if (headerEnd) {
+                if (strncmp(buffer, "HTTP/1.1 200 ", 13) != 0) {
+                    fprintf(stderr, "Server did not send the file.  "
+                            "Response: %.*s\n",
+                            (int)(headerEnd - buffer), buffer);
+                    exit(1);
+                }
+                bodySize = buffer + headerLen - (headerEnd + 4);
+                gotHeader = true;
+            } else if (headerLen >= CHUNK_SIZE / 2) {
+                fprintf(stderr, "Response header is too long\n");
+                exit(1);
+            }
+        }
+    }
+    close(fd);
+
+    return bodySize;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned int sizeMb;
+    unsigned int downloadCt;
+    const char * tmpDir;
+    char dirName[1024];
+    char fileName[1100];
+    char * buffer;
+    unsigned short portNumber;
+    int listenFd;
+    pid_t serverPid;
+    struct rusage serverUsage;
+    struct timeval start;
+    double secs;
+    unsigned int i;
+
+    if (argc-1 > 2) {
+        fprintf(stderr, "Usage: bench_sendfile [MEGABYTES [DOWNLOADS]]\n");
+        exit(1);
+    }
+    sizeMb     = argc-1 >= 1 ? atoi(argv[1]) : 4096;
+    downloadCt = argc-1 >= 2 ? atoi(argv[2]) : 2;
+
+    tmpDir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+
+    snprintf(dirName, sizeof(dirName), "%s/bench_sendfileXXXXXX", tmpDir);
+    if (!mkdtemp(dirName))
+        dieWithErrno("mkdtemp()");
+
+    snprintf(fileName, sizeof(fileName), "%s/data", dirName);
+
+    writeFile(fileName, sizeMb);
+
+    listenFd = listeningSocket(&portNumber);
+
+    serverPid = fork();
+    if (serverPid < 0)
+        dieWithErrno("fork()");
+    else if (serverPid == 0)
+        runServer(listenFd, dirName);
+
+    close(listenFd);
+
+    /* Room for the header plus a terminating NUL */
+    buffer = malloc(CHUNK_SIZE + 1);
+    if (!buffer) {
+        fprintf(stderr, "Can't allocate %u bytes\n", CHUNK_SIZE + 1);
+        exit(1);
+    }
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < downloadCt; ++i) {
+        unsigned long long const bodySize = download(portNumber, buffer);
+
+        if (bodySize != (unsigned long long)sizeMb * CHUNK_SIZE) {
+            fprintf(stderr, "Download %u got %llu bytes instead of %llu\n",
+                    i, bodySize, (unsigned long long)sizeMb * CHUNK_SIZE);
+            exit(1);
+        }
+    }
+    secs = secondsSince(start);
+
+    kill(serverPid, SIGTERM);
+
+    if (wait4(serverPid, NULL, 0, &serverUsage) < 0)
+        dieWithErrno("wait4()");
+
+    printf("%u MB file, %u downloads\n", sizeMb, downloadCt);
+    printf("download: %.1f MB/s; server CPU %.2f s user, %.2f s system\n",
+           (double)sizeMb * CHUNK_SIZE * downloadCt / secs / 1e6,
+           serverUsage.ru_utime.tv_sec + serverUsage.ru_utime.tv_usec / 1e6,
+           serverUsage.ru_stime.tv_sec + serverUsage.ru_stime.tv_usec / 1e6);
+
+    free(buffer);
+    unlink(fileName);
+    rmdir(dirName);
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* A benchmark of serializing string-heavy XML-RPC responses.
+
+   The program builds a response whose result is an array of strings and
+   serializes it with xmlrpc_serialize_response() several times.  It does
+   that for two kinds of strings:
+
+     ascii    plain text, with nothing in it that XML needs escaped
+
+     escape   markup-like text, where about every fourth character is a
+              '<', '>', '&' or carriage return that XML needs escaped
+
+   and reports the serialization rate in megabytes of strings per second.
+
+   The program takes up to three arguments:
+
+     1) the number of strings (default 20,000)
+
+     2) the length of each string (default 1000)
+
+     3) the number of times to serialize the response (default 50)
+
+   Example:
+
+   $ ./bench_serialize
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+
+#include "config.h"  /* information about this build environment */
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static xmlrpc_value *
+stringArray(const char * const pattern,
+            unsigned int const stringCt,
+            size_t       const stringLen) {
+/*----------------------------------------------------------------------------
+   An array of 'stringCt' strings of length 'stringLen', each made of
+   'pattern' over and over, starting at a different place in it.  They are
+   separate strings, so the serializer reads as much memory as it would for
+   real data.
+-----------------------------------------------------------------------------*/
+    size_t const patternLen = strlen(pattern);
+
+    xmlrpc_env env;
+    xmlrpc_value * arrayP;
+    char * text;
+    unsigned int j;
+
+    xmlrpc_env_init(&env);
+
+    text = malloc(stringLen + 1);
+    if (text == NULL) {
+        fprintf(stderr, "Can't allocate memory for a string\n");
+        exit(1);
+    }
+    arrayP = xmlrpc_array_new(&env);
+    dieIfFaultOccurred(&env);
+
+    for (j = 0; j < stringCt; ++j) {
+        xmlrpc_value * stringP;
+        size_t i;
+
+        for (i = 0; i < stringLen; ++i)
+            text[i] = pattern[(i + j) % patternLen];
+        text[stringLen] = '\0';
+
+        stringP = xmlrpc_string_new(&env, text);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_array_append_item(&env, arrayP, stringP);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_DECREF(stringP);
+    }
+    free(text);
+
+    xmlrpc_env_clean(&env);
+
+    return arrayP;
+}
+
+
+
+static void
+benchCorpus(const char * const name,
+            const char * const pattern,
+            unsigned int const stringCt,
+            size_t       const stringLen,
+            unsigned int const repeatCt) {
+
+    double const stringBytes = (double)stringCt * stringLen;
+
+    xmlrpc_value * arrayP;
+    struct timeval start, end;
+    double secs;
+    size_t xmlSize;
+    unsigned int i;
+
+    arrayP = stringArray(pattern, stringCt, stringLen);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < repeatCt; ++i) {
+        xmlrpc_env env;
+        xmlrpc_mem_block * responseP;
+
+        xmlrpc_env_init(&env);
+
+        responseP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_serialize_response(&env, responseP, arrayP);
+        dieIfFaultOccurred(&env);
+
+        xmlSize = XMLRPC_MEMBLOCK_SIZE(char, responseP);
+
+        XMLRPC_MEMBLOCK_FREE(char, responseP);
+
+        xmlrpc_env_clean(&env);
+    }
+    gettimeofday(&end, NULL);
+
+    secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+
+    printf("%-6s   %8.1f MB   %8.1f MB   %12.3f   %10.1f\n",
+           name, stringBytes / 1e6, xmlSize / 1e6, secs / repeatCt,
+           stringBytes * repeatCt / secs / 1e6);
+
+    xmlrpc_DECREF(arrayP);
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned int stringCt;
+    size_t stringLen;
+    unsigned int repeatCt;
+
+    if (argc-1 > 3) {
+        fprintf(stderr, "Usage: bench_serialize [STRINGS [LENGTH [REPEATS]]]"
+                "\n");
+        exit(1);
+    }
+    stringCt  = argc-1 >= 1 ? atoi(argv[1]) : 20000;
+    stringLen = argc-1 >= 2 ? atoi(argv[2]) : 1000;
+    repeatCt  = argc-1 >= 3 ? atoi(argv[3]) : 50;
+
+    printf("corpus    strings         XML   serialize (s)   MB/s\n");
+
+    benchCorpus("ascii",
+                "The quick brown fox jumps over the lazy dog. ",
+                stringCt, stringLen, repeatCt);
+
+    benchCorpus("escape",
+                "<a href=\"x?p=1&q=2\">1 < 2 & 3 > 2</a>\r\n",
+                stringCt, stringLen, repeatCt);
+
+    return 0;
+}
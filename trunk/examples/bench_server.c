@@ -0,0 +1,156 @@
+/* A standalone XML-RPC server program for benchmarking clients.
+
+   This server knows one RPC class (besides the system classes):
+   "bench.sleep".  It takes one integer parameter, a number of milliseconds,
+   waits that long, and returns the number.  With 0, it is about the
+   cheapest RPC an Xmlrpc-c server can execute, so a benchmark against it
+   measures mostly the client and the network.
+
+   The program takes one to three arguments:
+
+     1) the HTTP port number on which the server is to accept connections,
+        in decimal
+
+     2) the most connections the server serves at once (default 64)
+
+     3) 1 to use Abyss' event-driven engine, which does not need a thread
+        per connection, 0 (default) for a thread per connection
+
+   The program raises its limit on open files as far as the system allows,
+   because each connection takes 3 file descriptors.
+
+   You can use the example programs 'threaded_synch_client' and
+   'asynch_burst_client' to send RPCs to this server.
+
+   Example:
+
+   $ ./bench_server 8080 64 &
+   $ ./threaded_synch_client http://localhost:8080/RPC2 8 10000 1
+*/
+
+#define _XOPEN_SOURCE 600  /* Make sure usleep() is in <unistd.h> */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/server.h>
+#include <xmlrpc-c/server_abyss.h>
+
+#include "config.h"  /* information about this build environment */
+
+
+
+static xmlrpc_value *
+bench_sleep(xmlrpc_env *   const envP,
+            xmlrpc_value * const paramArrayP,
+            void *         const serverInfo,
+            void *         const channelInfo) {
+
+    xmlrpc_int32 ms;
+
+    xmlrpc_decompose_value(envP, paramArrayP, "(i)", &ms);
+    if (envP->fault_occurred)
+        return NULL;
+
+    if (ms > 0)
+        usleep(ms * 1000);
+
+    return xmlrpc_build_value(envP, "i", ms);
+}
+
+
+
+static void
+raiseOpenFileLimit(void) {
+
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    struct xmlrpc_method_info3 const methodInfo = {
+        /* .methodName     = */ "bench.sleep",
+        /* .methodFunction = */ &bench_sleep,
+    };
+    xmlrpc_server_abyss_parms serverparm;
+    xmlrpc_registry * registryP;
+    xmlrpc_env env;
+
+    if (argc-1 < 1 || argc-1 > 3) {
+        fprintf(stderr, "Usage: bench_server PORT [MAX_CONN [EVENT_DRIVEN]]"
+                "\n");
+        exit(1);
+    }
+
+    raiseOpenFileLimit();
+
+    xmlrpc_env_init(&env);
+
+    registryP = xmlrpc_registry_new(&env);
+    if (env.fault_occurred) {
+        printf("xmlrpc_registry_new() failed.  %s\n", env.fault_string);
+        exit(1);
+    }
+
+    xmlrpc_registry_add_method3(&env, registryP, &methodInfo);
+    if (env.fault_occurred) {
+        printf("xmlrpc_registry_add_method3() failed.  %s\n",
+               env.fault_string);
+        exit(1);
+    }
+
+    serverparm.config_file_name   = NULL;
+    serverparm.registryP          = registryP;
+    serverparm.port_number        = atoi(argv[1]);
+    serverparm.log_file_name      = NULL;
+    serverparm.keepalive_timeout  = 0;
+    serverparm.keepalive_max_conn = 1000000;
+        /* A benchmark client makes many RPCs on each connection; don't
+           make it reconnect every few.
+        */
+    serverparm.timeout            = 0;
+    serverparm.dont_advertise     = 0;
+    serverparm.socket_bound       = 0;
+    serverparm.uri_path           = NULL;
+    serverparm.chunk_response     = 0;
+    serverparm.enable_shutdown    = 0;
+    serverparm.allow_origin       = NULL;
+    serverparm.access_ctl_expires = 0;
+    serverparm.access_ctl_max_age = 0;
+    serverparm.sockaddr_p         = NULL;
+    serverparm.sockaddrlen        = 0;
+    serverparm.max_conn           = argc-1 >= 2 ? atoi(argv[2]) : 64;
+    serverparm.max_conn_backlog   =
+        serverparm.max_conn > 1024 ? serverparm.max_conn : 1024;
+        /* A client that opens many connections at once must not overflow
+           the listen backlog, or those connections wait for the client's
+           TCP to retry, which takes a second or more.  That includes
+           connections beyond MAX_CONN, which wait in the backlog for the
+           server to finish others.
+        */
+    serverparm.max_rpc_mem        = 0;
+    serverparm.event_driven       = argc-1 >= 3 ? atoi(argv[3]) : 0;
+
+    printf("Running benchmark XML-RPC server...\n");
+
+    xmlrpc_server_abyss(&env, &serverparm, XMLRPC_APSIZE(event_driven));
+    if (env.fault_occurred) {
+        printf("xmlrpc_server_abyss() failed.  %s\n", env.fault_string);
+        exit(1);
+    }
+    /* xmlrpc_server_abyss() never returns unless it fails */
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* A benchmark of building and searching large XML-RPC structs.
+
+   For structs of 8 members up to some maximum, growing by a factor of 8
+   each time, the program builds the struct with xmlrpc_struct_set_value(),
+   then looks up every member with xmlrpc_struct_find_value().  It reports
+   the time per member for each.
+
+   If lookup were a linear search, building an n-member struct would take
+   time proportional to n squared, so the time per member would grow with
+   n.  With a hash index, it stays about flat.
+
+   The program takes one optional argument: the maximum number of members
+   (default 1048576).  It always does that size, even if it isn't 8 times
+   one it did.
+
+   Example:
+
+   $ ./bench_struct
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+
+#include "config.h"  /* information about this build environment */
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+static void
+benchStruct(unsigned long const memberCt) {
+
+    xmlrpc_env env;
+    xmlrpc_value * structP;
+    xmlrpc_value * memberValueP;
+    struct timeval start;
+    double buildSecs, findSecs;
+    unsigned long i;
+
+    xmlrpc_env_init(&env);
+
+    memberValueP = xmlrpc_int_new(&env, 1);
+    dieIfFaultOccurred(&env);
+
+    gettimeofday(&start, NULL);
+
+    structP = xmlrpc_struct_new(&env);
+    dieIfFaultOccurred(&env);
+
+    for (i = 0; i < memberCt; ++i) {
+        char key[32];
+
+        sprintf(key, "member%lu", i);
+        xmlrpc_struct_set_value(&env, structP, key, memberValueP);
+        dieIfFaultOccurred(&env);
+    }
+    buildSecs = secondsSince(start);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < memberCt; ++i) {
+        char key[32];
+        xmlrpc_value * valueP;
+
+        sprintf(key, "member%lu", i);
+        xmlrpc_struct_find_value(&env, structP, key, &valueP);
+        dieIfFaultOccurred(&env);
+
+        if (valueP == NULL) {
+            fprintf(stderr, "Member '%s' is missing\n", key);
+            exit(1);
+        }
+        xmlrpc_DECREF(valueP);
+    }
+    findSecs = secondsSince(start);
+
+    printf("%9lu   %15.0f   %16.0f\n", memberCt,
+           buildSecs * 1e9 / memberCt, findSecs * 1e9 / memberCt);
+
+    xmlrpc_DECREF(structP);
+    xmlrpc_DECREF(memberValueP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    unsigned long maxMemberCt;
+    unsigned long memberCt;
+
+    if (argc-1 > 1) {
+        fprintf(stderr, "Usage: bench_struct [MAX_MEMBERS]\n");
+        exit(1);
+    }
+    maxMemberCt = argc-1 >= 1 ? strtoul(argv[1], NULL, 10) : 1048576;
+
+    printf("  members   set (ns/member)   find (ns/member)\n");
+
+    for (memberCt = 8; memberCt < maxMemberCt; memberCt *= 8)
+        benchStruct(memberCt);
+
+    benchStruct(maxMemberCt);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/* A multithreaded synchronous XML-RPC client program written in C, for
+   benchmarking.
+
+   Some number of threads share one client (xmlrpc_client object), and each
+   makes some number of synchronous RPCs, one after another.  The program
+   reports how many RPCs per second they made in all.  Because the Curl
+   transport runs synchronous RPCs from different threads at the same time,
+   that should grow with the number of threads, until the server or the
+   network can't keep up.
+
+   The RPC is "bench.sleep", which the example program 'bench_server'
+   executes.
+
+   The program takes three or four arguments:
+
+     1) the server URL
+
+     2) the number of threads
+
+     3) the number of RPCs each thread makes
+
+     4) the number of milliseconds the server is to take to execute each
+        RPC (default 0)
+
+   Example:
+
+   $ ./bench_server 8080 64 &
+   $ ./threaded_synch_client http://localhost:8080/RPC2 8 1000 1
+
+   The server must be able to serve as many connections at once as there
+   are threads, or threads will wait for one another.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <xmlrpc-c/base.h>
+#include <xmlrpc-c/client.h>
+
+#include "config.h"  /* information about this build environment */
+
+#define NAME "Xmlrpc-c Threaded Synchronous Benchmark Client"
+#define VERSION "1.0"
+
+static xmlrpc_client * clientP;
+static const char * serverUrl;
+static unsigned int callsPerThread;
+static xmlrpc_int32 sleepMs;
+
+
+
+static void
+dieIfFaultOccurred(xmlrpc_env * const envP) {
+    if (envP->fault_occurred) {
+        fprintf(stderr, "ERROR: %s (%d)\n",
+                envP->fault_string, envP->fault_code);
+        exit(1);
+    }
+}
+
+
+
+static void *
+makeCalls(void * const arg) {
+
+    xmlrpc_env env;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    for (i = 0; i < callsPerThread; ++i) {
+        xmlrpc_value * resultP;
+
+        xmlrpc_client_call2f(&env, clientP, serverUrl, "bench.sleep",
+                             &resultP, "(i)", sleepMs);
+        dieIfFaultOccurred(&env);
+
+        xmlrpc_DECREF(resultP);
+    }
+    xmlrpc_env_clean(&env);
+
+    return NULL;
+}
+
+
+
+static double
+secondsSince(struct timeval const start) {
+
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+
+int
+main(int           const argc,
+     const char ** const argv) {
+
+    xmlrpc_env env;
+    unsigned int threadCt;
+    pthread_t * threads;
+    struct timeval start;
+    double elapsed;
+    unsigned int i;
+
+    if (argc-1 < 3 || argc-1 > 4) {
+        fprintf(stderr, "Usage: threaded_synch_client URL THREADS "
+                "CALLS_PER_THREAD [SLEEP_MS]\n");
+        exit(1);
+    }
+    serverUrl      = argv[1];
+    threadCt       = atoi(argv[2]);
+    callsPerThread = atoi(argv[3]);
+    sleepMs        = argc-1 >= 4 ? atoi(argv[4]) : 0;
+
+    threads = malloc(threadCt * sizeof(threads[0]));
+    if (threads == NULL) {
+        fprintf(stderr, "Can't allocate memory for %u threads\n", threadCt);
+        exit(1);
+    }
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    dieIfFaultOccurred(&env);
+
+    xmlrpc_client_create(&env, XMLRPC_CLIENT_NO_FLAGS, NAME, VERSION,
+                         NULL, 0, &clientP);
+    dieIfFaultOccurred(&env);
+
+    gettimeofday(&start, NULL);
+
+    for (i = 0; i < threadCt; ++i) {
+        if (pthread_create(&threads[i], NULL, &makeCalls, NULL) != 0) {
+            fprintf(stderr, "Can't create thread %u\n", i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < threadCt; ++i)
+        pthread_join(threads[i], NULL);
+
+    elapsed = secondsSince(start);
+
+    printf("%u threads: %u RPCs in %.3f s = %.0f RPCs/s\n",
+           threadCt, threadCt * callsPerThread, elapsed,
+           threadCt * callsPerThread / elapsed);
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+
+    free(threads);
+
+    return 0;
+}
@@ -258,6 +258,46 @@ void
 ServerSetMaxSessionMem(TServer * const serverP,
                        size_t    const size);
 
+#define HAVE_SERVER_SET_CONN_BUFFER_SIZE 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetConnBufferSize(TServer *       const serverP,
+                        xmlrpc_uint32_t const size);
+
+#define HAVE_SERVER_SET_EVENT_DRIVEN 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven);
+
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetEventThreads(TServer *    const serverP,
+                      unsigned int const ioThreadCt,
+                      unsigned int const workerCt);
+
+#define HAVE_SERVER_SET_THREAD_POOL 1
+XMLRPC_ABYSS_EXPORTED
+void
+ServerSetThreadPool(TServer *    const serverP,
+                    unsigned int const minThreadCt,
+                    unsigned int const maxThreadCt,
+                    unsigned int const idleTimeout);
+
+typedef struct {
+    unsigned int  threadCt;        /* threads in the pool */
+    unsigned int  busyThreadCt;    /* threads serving a connection */
+    unsigned int  queueDepth;      /* connections waiting for a thread */
+    unsigned int  peakThreadCt;
+    unsigned int  peakQueueDepth;
+    unsigned long connectionCt;    /* connections the pool has served */
+} TServerThreadPoolStats;
+
+XMLRPC_ABYSS_EXPORTED
+void
+ServerGetThreadPoolStats(TServer *                const serverP,
+                         TServerThreadPoolStats * const statsP);
+
 XMLRPC_ABYSS_EXPORTED
 void
 ServerInit2(TServer *     const serverP,
@@ -446,6 +486,14 @@ SessionGetBody(TSession *    const sessionP,
                size_t *      const outLenP,
                const char ** const errorP);
 
+#define HAVE_SESSION_READ_BODY 1
+XMLRPC_ABYSS_EXPORTED
+void
+SessionReadBody(TSession *    const sessionP,
+                void *        const buffer,
+                size_t        const len,
+                const char ** const errorP);
+
 XMLRPC_ABYSS_EXPORTED
 abyss_bool
 SessionRefillBuffer(TSession * const sessionP);
@@ -510,6 +558,11 @@ XMLRPC_ABYSS_EXPORTED
 abyss_bool
 ResponseWriteEnd(TSession * const sessionP);
 
+#define HAVE_RESPONSE_ABORT 1
+XMLRPC_ABYSS_EXPORTED
+void
+ResponseAbort(TSession * const sessionP);
+
 XMLRPC_ABYSS_EXPORTED
 abyss_bool
 ResponseChunked(TSession * const sessionP);
@@ -43,6 +43,36 @@ struct abyss_openSsl_chaninfo {
         */
 };
 
+struct abyss_openSsl_sessionparms {
+/*----------------------------------------------------------------------------
+   How an OpenSSL channel switch lets clients resume earlier TLS sessions
+   instead of doing a full handshake on every connection.
+-----------------------------------------------------------------------------*/
+    unsigned int cacheSize;
+        /* Maximum number of sessions in the server-side session cache.
+           0 means no cache.
+        */
+    unsigned int timeout;
+        /* Seconds after its full handshake for which a client may resume a
+           session, whether from the cache or from a ticket.  0 means
+           OpenSSL's default (300 seconds).
+        */
+    unsigned int ticketKeyLifetime;
+        /* Seconds for which we issue session tickets under one key before
+           we rotate to a new one.  We still accept tickets issued under the
+           two keys before the current one.  0 means issue no tickets.
+        */
+};
+
+struct abyss_openSsl_handshakestats {
+    unsigned long fullCt;
+        /* Handshakes that established a new session */
+    unsigned long resumedCt;
+        /* Handshakes that resumed a session from the cache or a ticket */
+    unsigned long failedCt;
+        /* Handshakes that failed, or that the client never finished */
+};
+
 void
 ChanSwitchOpenSslCreate(int                     const protocolFamily,
                         const struct sockaddr * const sockAddrP,
@@ -69,6 +99,17 @@ ChanSwitchOpenSslCreateFd(int            const fd,
                           TChanSwitch ** const chanSwitchPP,
                           const char **  const errorP);
 
+void
+ChanSwitchOpenSslSetSessionParms(
+    TChanSwitch *                             const chanSwitchP,
+    const struct abyss_openSsl_sessionparms * const parmsP,
+    const char **                             const errorP);
+
+void
+ChanSwitchOpenSslGetHandshakeStats(
+    TChanSwitch *                         const chanSwitchP,
+    struct abyss_openSsl_handshakestats * const statsP);
+
 void
 ChannelOpenSslCreateSsl(SSL *                            const sslP,
                         TChannel **                      const channelPP,
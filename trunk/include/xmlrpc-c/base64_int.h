@@ -1,7 +1,9 @@
 #ifndef BASE64_INT_H_INCLUDED
 #define BASE64_INT_H_INCLUDED
 
+#include "bool.h"
 #include "xmlrpc-c/c_util.h"  /* For XMLRPC_DLLEXPORT */
+#include "xmlrpc-c/util.h"
 
 /*
   XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
@@ -21,4 +23,12 @@ void
 xmlrpc_base64Encode(const char * const chars,
                     char *       const base64);
 
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_base64EncodeAppend(xmlrpc_env *          const envP,
+                          xmlrpc_mem_block *    const outputP,
+                          const unsigned char * const binData,
+                          size_t                const binLen,
+                          bool                  const wantNewlines);
+
 #endif
@@ -41,7 +41,13 @@ extern "C" {
 
 struct _xmlrpc_value {
     xmlrpc_type _type;
+#if !HAVE_ATOMIC_REFCOUNT
     struct lock * lockP;
+        /* Protects 'refcount'.  Where the compiler provides atomic
+           operations, we don't need this; we update 'refcount' atomically
+           instead.
+        */
+#endif
     unsigned int refcount;
 
     /* Certain data types store their data directly in the xmlrpc_value. */
@@ -57,6 +63,16 @@ struct _xmlrpc_value {
             xmlrpc_cptr_dtor_fn dtor;   // NULL if none
             void *              dtorContext;
         } cptr;
+        struct {
+            uint32_t *   index;
+                /* Open-addressing hash index of the members in 'blockP':
+                   each slot is the member's position in 'blockP' plus one,
+                   or zero for an empty slot.  NULL if we haven't built it;
+                   we build it only for large structs.
+                */
+            unsigned int indexLog2Size;
+                /* log2 of the number of slots in 'index' */
+        } strct;
     } _value;
     
     /* Other data types use a memory block.
@@ -101,6 +117,10 @@ struct _xmlrpc_value {
            This is essentially a cached value of the result of a
            xmlrpc_read_datetime_str_old().  NULL means nothing cached.
         */
+    xmlrpc_mem_pool * arenaP;
+        /* The pool in whose arena this xmlrpc_value lives, or NULL if it is
+           on the heap.  The value holds a reference to the pool.
+        */
 };
 
 #define XMLRPC_ASSERT_VALUE_OK(val) \
@@ -126,6 +146,20 @@ void
 xmlrpc_createXmlrpcValue(xmlrpc_env *    const envP,
                          xmlrpc_value ** const valPP);
 
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_freeXmlrpcValue(xmlrpc_value * const valP);
+
+XMLRPC_LIBINT_EXPORTED
+xmlrpc_mem_block *
+xmlrpc_valueBlockNew(xmlrpc_env * const envP,
+                     size_t       const size);
+
+XMLRPC_LIBINT_EXPORTED
+xmlrpc_value *
+xmlrpc_base64_new_block(xmlrpc_env *       const envP,
+                        xmlrpc_mem_block * const blockP);
+
 XMLRPC_LIBINT_EXPORTED
 const char *
 xmlrpc_typeName(xmlrpc_type const type);
@@ -152,6 +186,20 @@ XMLRPC_LIBINT_EXPORTED
 void
 xmlrpc_destroyArrayContents(xmlrpc_value * const arrayP);
 
+typedef void xmlrpc_serializeFlushFn(xmlrpc_env *       const envP,
+                                     void *             const arg,
+                                     xmlrpc_mem_block * const outputP);
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_serializeResponseStream(xmlrpc_env *              const envP,
+                               xmlrpc_mem_block *        const outputP,
+                               xmlrpc_value *            const valueP,
+                               xmlrpc_dialect            const dialect,
+                               size_t                    const flushSize,
+                               xmlrpc_serializeFlushFn         flush,
+                               void *                    const flushArg);
+
 /*----------------------------------------------------------------------------
    The following are for use by the legacy xmlrpc_parse_value().  They don't
    do proper memory management, so they aren't appropriate for general use,
@@ -127,6 +127,22 @@ struct xmlrpc_curl_xportparms {
     xmlrpc_bool  tcp_keepalive;
     unsigned int tcp_keepidle_sec;
     unsigned int tcp_keepintvl_sec;
+    unsigned int compression_level;
+        /* zlib level (1-9) at which to gzip calls; 0 means don't.  The
+           server must be able to decode that.
+        */
+    size_t       compression_threshold;
+        /* Don't compress a call smaller than this; 0 means 1024 */
+    xmlrpc_bool  accept_compressed;
+        /* Ask the server to compress its responses */
+    xmlrpc_bool  no_session_pool;
+        /* Give every asynchronous RPC a new Curl session instead of
+           reusing one an earlier RPC to the same server left idle.
+        */
+    unsigned int session_pool_size;
+        /* The most idle Curl sessions to keep for one server URL;
+           0 means 8
+        */
 };
 
 
@@ -135,6 +151,23 @@ struct xmlrpc_curl_xportparms {
 
 /* XMLRPC_CXPSIZE(xyz) is analogous to XMLRPC_CPSIZE, below */
 
+struct xmlrpc_curl_poolstats {
+    unsigned long hits;
+        /* Asynchronous RPCs that reused an idle Curl session */
+    unsigned long misses;
+        /* Asynchronous RPCs for which there was no idle Curl session */
+    unsigned long discards;
+        /* Curl sessions destroyed after an RPC because there was no room
+           in the pool for them
+        */
+};
+
+XMLRPC_CLIENT_EXPORTED
+void
+xmlrpc_curl_transport_get_pool_stats(
+    struct xmlrpc_client_transport * const transportP,
+    struct xmlrpc_curl_poolstats *   const statsP);
+
 struct xmlrpc_wininet_xportparms {
     int allowInvalidSSLCerts;
 };
@@ -157,6 +190,18 @@ struct xmlrpc_progress_data {
 typedef void xmlrpc_progress_fn(void * const,
                                 struct xmlrpc_progress_data const);
 
+/* What to wait for on a file descriptor xmlrpc_client_get_pollfds()
+   returns; the 'events' member of struct xmlrpc_pollfd is a bitmask
+   of these.
+*/
+#define XMLRPC_POLL_IN  0x1
+#define XMLRPC_POLL_OUT 0x2
+
+struct xmlrpc_pollfd {
+    int fd;
+    unsigned int events;
+};
+
 struct xmlrpc_clientparms {
     /* (transport, transportparmsP, transportparm_size) and
        (transportOpsP, transportP) are mutually exclusive.
@@ -170,6 +215,10 @@ struct xmlrpc_clientparms {
     xmlrpc_client_transport *  transportP;
     xmlrpc_dialect             dialect;
     xmlrpc_progress_fn *       progressFn;
+    size_t                     transportOps_size;
+        /* Size of *transportOpsP, e.g. XMLRPC_XOPSIZE(perform_asynch).
+           If you don't supply this, it is XMLRPC_XOPSIZE(set_interrupt).
+        */
 };
 
 #define XMLRPC_CPSIZE(mbrname) \
@@ -376,6 +425,30 @@ void
 xmlrpc_client_event_loop_finish_timeout(xmlrpc_client * const clientP,
                                         unsigned long   const milliseconds);
 
+/* xmlrpc_client_get_pollfds() and xmlrpc_client_event_loop_perform() are
+   for driving asynchronous RPCs from your own event loop instead of
+   waiting in xmlrpc_client_event_loop_finish():  Wait (e.g. with poll())
+   until one of the file descriptors the former returns is ready or its
+   timeout passes, then call the latter, which finishes whatever RPCs it
+   can without waiting.  Query the file descriptors again before each wait,
+   and in particular after you start an RPC.  Not every transport can do
+   this; with one that can't, both calls fail.
+*/
+
+XMLRPC_CLIENT_EXPORTED
+void
+xmlrpc_client_get_pollfds(xmlrpc_env *           const envP,
+                          xmlrpc_client *        const clientP,
+                          struct xmlrpc_pollfd * const pollfds,
+                          unsigned int           const maxCt,
+                          unsigned int *         const pollfdCtP,
+                          int *                  const timeoutMsP);
+
+XMLRPC_CLIENT_EXPORTED
+void
+xmlrpc_client_event_loop_perform(xmlrpc_env *    const envP,
+                                 xmlrpc_client * const clientP);
+
 XMLRPC_CLIENT_EXPORTED
 void
 xmlrpc_client_start_rpc(xmlrpc_env *               const envP,
@@ -90,6 +90,13 @@ public:
     void
     finishAsync(xmlrpc_c::timeout const timeout);
 
+    virtual void
+    getPollfds(std::vector<struct xmlrpc_pollfd> * const pollfdsP,
+               xmlrpc_c::timeout *                 const timeoutP);
+
+    virtual void
+    performAsync();
+
     virtual void
     setInterrupt(int *);
 };
@@ -157,6 +164,24 @@ public:
     xmlrpc_c::carriageParm * carriageParmP;
 };
 
+struct XMLRPC_CLIENTPP_EXPORTED multicallStats {
+/*----------------------------------------------------------------------------
+   What a client_xml has done coalescing RPCs into system.multicall
+   requests.  See client_xml::setMulticall().
+-----------------------------------------------------------------------------*/
+    multicallStats() :
+        batchCt(0), batchedRpcCt(0), singleRpcCt(0), maxBatchSize(0) {}
+
+    unsigned long batchCt;
+        // system.multicall requests sent
+    unsigned long batchedRpcCt;
+        // RPCs those requests carried
+    unsigned long singleRpcCt;
+        // RPCs sent by themselves because no other RPC joined them
+    unsigned int maxBatchSize;
+        // The most RPCs any one system.multicall request carried
+};
+
 class XMLRPC_CLIENTPP_EXPORTED client_xml : public xmlrpc_c::client {
 /*----------------------------------------------------------------------------
    A client that uses XML-RPC XML in the RPC.  This class does not define
@@ -190,9 +215,23 @@ public:
     void
     finishAsync(xmlrpc_c::timeout const timeout);
 
+    void
+    getPollfds(std::vector<struct xmlrpc_pollfd> * const pollfdsP,
+               xmlrpc_c::timeout *                 const timeoutP);
+
+    void
+    performAsync();
+
     virtual void
     setInterrupt(int * interruptP);
 
+    void
+    setMulticall(unsigned int const maxBatchSize,
+                 unsigned int const windowMs);
+
+    xmlrpc_c::multicallStats
+    getMulticallStats() const;
+
 private:
     struct client_xml_impl * implP;
 };
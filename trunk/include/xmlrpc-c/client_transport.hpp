@@ -117,6 +117,13 @@ public:
     virtual void
     finishAsync(xmlrpc_c::timeout const timeout);
 
+    virtual void
+    getPollfds(std::vector<struct xmlrpc_pollfd> * const pollfdsP,
+               xmlrpc_c::timeout *                 const timeoutP);
+
+    virtual void
+    performAsync();
+
     static void
     asyncComplete(
         struct xmlrpc_call_info * const callInfoP,
@@ -233,6 +240,13 @@ public:
     virtual void
     finishAsync(xmlrpc_c::timeout const timeout);
 
+    virtual void
+    getPollfds(std::vector<struct xmlrpc_pollfd> * const pollfdsP,
+               xmlrpc_c::timeout *                 const timeoutP);
+
+    virtual void
+    performAsync();
+
     virtual void
     setInterrupt(int * const interruptP);
 
@@ -314,6 +328,11 @@ public:
         constrOpt & tcp_keepalive     (bool         const& arg);
         constrOpt & tcp_keepidle_sec  (unsigned int const& arg);
         constrOpt & tcp_keepintvl_sec (unsigned int const& arg);
+        constrOpt & compression_level (unsigned int const& arg);
+        constrOpt & compression_threshold (size_t   const& arg);
+        constrOpt & accept_compressed (bool         const& arg);
+        constrOpt & no_session_pool   (bool         const& arg);
+        constrOpt & session_pool_size (unsigned int const& arg);
 
     private:
         struct constrOpt_impl * implP;
@@ -329,6 +348,9 @@ public:
 
     ~clientXmlTransport_curl();
 
+    xmlrpc_curl_poolstats
+    poolStats() const;
+
 private:
     void
     initialize(constrOpt const& opt);
@@ -0,0 +1,105 @@
+#ifndef COMPRESS_INT_H_INCLUDED
+#define COMPRESS_INT_H_INCLUDED
+
+/*============================================================================
+  HTTP content codings (RFC 7231 Section 3.1.2) for XML-RPC bodies.
+
+  An xmlrpc_zstream compresses or decompresses a body a piece at a time, so
+  whoever moves the body can do it as the pieces arrive and never has to
+  hold both whole forms at once.
+
+  This is all zlib.  Where Xmlrpc-c is built without zlib, only the identity
+  coding exists; xmlrpc_compressionAvailable() says which is the case.
+============================================================================*/
+
+#include <stddef.h>
+
+#include "bool.h"
+#include "xmlrpc-c/c_util.h"  /* For XMLRPC_DLLEXPORT */
+#include "xmlrpc-c/util.h"
+
+/*
+  XMLRPC_UTIL_EXPORTED marks a symbol in this file that is exported from
+  libxmlrpc_util.
+
+  XMLRPC_BUILDING_UTIL says this compilation is part of libxmlrpc_util, as
+  opposed to something that _uses_ libxmlrpc_util.
+*/
+#ifdef XMLRPC_BUILDING_UTIL
+#define XMLRPC_UTIL_EXPORTED XMLRPC_DLLEXPORT
+#else
+#define XMLRPC_UTIL_EXPORTED
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    XMLRPC_CODING_IDENTITY,
+    XMLRPC_CODING_GZIP,
+    XMLRPC_CODING_DEFLATE
+} xmlrpc_contentCoding;
+
+XMLRPC_UTIL_EXPORTED
+bool
+xmlrpc_compressionAvailable(void);
+
+XMLRPC_UTIL_EXPORTED
+const char *
+xmlrpc_contentCodingName(xmlrpc_contentCoding const coding);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_contentCodingFromName(const char *           const name,
+                             bool *                 const recognizedP,
+                             xmlrpc_contentCoding * const codingP);
+
+typedef struct xmlrpc_zstream xmlrpc_zstream;
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_zstreamCreateDeflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding,
+                            int                    const level,
+                            xmlrpc_zstream **      const zsPP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_zstreamCreateInflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding,
+                            size_t                 const maxSize,
+                            xmlrpc_zstream **      const zsPP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_zstreamDestroy(xmlrpc_zstream * const zsP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_zstreamFeed(xmlrpc_env *       const envP,
+                   xmlrpc_zstream *   const zsP,
+                   const void *       const data,
+                   size_t             const len,
+                   xmlrpc_mem_block * const outputP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_zstreamFinish(xmlrpc_env *       const envP,
+                     xmlrpc_zstream *   const zsP,
+                     xmlrpc_mem_block * const outputP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_compress(xmlrpc_env *          const envP,
+                xmlrpc_contentCoding  const coding,
+                int                   const level,
+                const void *          const data,
+                size_t                const len,
+                xmlrpc_mem_block **   const outputPP);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -191,6 +191,9 @@ public:
     void
     disableIntrospection();
 
+    void
+    freeze();
+
     class XMLRPC_SERVERPP_EXPORTED shutdown {
     public:
         virtual ~shutdown() = 0;
@@ -122,6 +122,11 @@ xmlrpc_registry_add_method3(
     xmlrpc_registry *                  const registryP,
     const struct xmlrpc_method_info3 * const infoP);
 
+XMLRPC_SERVER_EXPORTED
+void
+xmlrpc_registry_freeze(xmlrpc_env *      const envP,
+                       xmlrpc_registry * const registryP);
+
 XMLRPC_SERVER_EXPORTED
 void
 xmlrpc_registry_set_default_method(xmlrpc_env *          const envP,
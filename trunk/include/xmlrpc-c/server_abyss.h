@@ -101,6 +101,22 @@ typedef struct {
     unsigned int      max_conn;
     unsigned int      max_conn_backlog;
     size_t            max_rpc_mem;
+    xmlrpc_bool       event_driven;
+    unsigned int      event_io_threads;
+    unsigned int      event_workers;
+    unsigned int      thread_pool_min;
+    unsigned int      thread_pool_max;
+    unsigned int      thread_pool_idle_timeout;
+    unsigned int      compression_level;
+        /* zlib level (1-9) at which to compress responses for clients that
+           accept it; 0 means never compress
+        */
+    size_t            compression_threshold;
+        /* Don't compress a response smaller than this; 0 means 1024 */
+    unsigned int      conn_buffer_size;
+        /* Bytes of a request each connection buffers; 0 means 4096.  A
+           line of the HTTP header must fit.
+        */
 } xmlrpc_server_abyss_parms;
 
 
@@ -199,6 +215,12 @@ typedef struct {
         /* NULL means don't answer HTTP access control query */
     xmlrpc_bool             access_ctl_expires;
     unsigned int            access_ctl_max_age;
+    unsigned int            compression_level;
+        /* zlib level (1-9) at which to compress responses for clients that
+           accept it; 0 means never compress
+        */
+    size_t                  compression_threshold;
+        /* Don't compress a response smaller than this; 0 means 1024 */
 } xmlrpc_server_abyss_handler_parms;
 
 #define XMLRPC_AHPSIZE(MBRNAME) \
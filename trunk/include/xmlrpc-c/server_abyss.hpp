@@ -74,6 +74,15 @@ public:
         constrOpt & logFileName       (std::string    const& arg);
         constrOpt & serverOwnsSignals (bool           const& arg);
         constrOpt & expectSigchld     (bool           const& arg);
+        constrOpt & eventDriven       (bool           const& arg);
+        constrOpt & eventIoThreads    (unsigned int   const& arg);
+        constrOpt & eventWorkers      (unsigned int   const& arg);
+        constrOpt & threadPoolMin     (unsigned int   const& arg);
+        constrOpt & threadPoolMax     (unsigned int   const& arg);
+        constrOpt & threadPoolIdleTimeout(unsigned int const& arg);
+        constrOpt & compressionLevel  (unsigned int   const& arg);
+        constrOpt & compressionThreshold(size_t       const& arg);
+        constrOpt & connBufferSize    (unsigned int   const& arg);
 
     private:
         struct constrOpt_impl * implP;
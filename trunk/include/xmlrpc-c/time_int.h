@@ -21,6 +21,10 @@
 #define XMLRPC_UTIL_EXPORTED
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #if HAVE_TIMESPEC
   # include <sys/time.h> /* for struct timespec */
   typedef struct timespec xmlrpc_timespec;
@@ -51,4 +55,8 @@ void
 xmlrpc_gmtime(time_t      const datetime,
               struct tm * const resultP);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -72,18 +72,45 @@ typedef void (*xmlrpc_transport_set_interrupt)(
     struct xmlrpc_client_transport * const clientTransportP,
     int *                            const interruptP);
 
+typedef void (*xmlrpc_transport_get_pollfds)(
+    xmlrpc_env *                     const envP,
+    struct xmlrpc_client_transport * const clientTransportP,
+    struct xmlrpc_pollfd *           const pollfds,
+    unsigned int                     const maxCt,
+    unsigned int *                   const pollfdCtP,
+    int *                            const timeoutMsP);
+
+typedef void (*xmlrpc_transport_perform_asynch)(
+    xmlrpc_env *                     const envP,
+    struct xmlrpc_client_transport * const clientTransportP);
+
 struct xmlrpc_client_transport_ops {
 
-    xmlrpc_transport_setup         setup_global_const;
-    xmlrpc_transport_teardown      teardown_global_const;
-    xmlrpc_transport_create        create;
-    xmlrpc_transport_destroy       destroy;
-    xmlrpc_transport_send_request  send_request;
-    xmlrpc_transport_call          call;
-    xmlrpc_transport_finish_asynch finish_asynch;
-    xmlrpc_transport_set_interrupt set_interrupt;
+    xmlrpc_transport_setup          setup_global_const;
+    xmlrpc_transport_teardown       teardown_global_const;
+    xmlrpc_transport_create         create;
+    xmlrpc_transport_destroy        destroy;
+    xmlrpc_transport_send_request   send_request;
+    xmlrpc_transport_call           call;
+    xmlrpc_transport_finish_asynch  finish_asynch;
+    xmlrpc_transport_set_interrupt  set_interrupt;
+    xmlrpc_transport_get_pollfds    get_pollfds;
+        /* NULL if the transport can't be driven by an external event loop */
+    xmlrpc_transport_perform_asynch perform_asynch;
+        /* NULL if 'get_pollfds' is */
 };
 
+#define XMLRPC_XOPSIZE(mbrname) \
+  XMLRPC_STRUCTSIZE(struct xmlrpc_client_transport_ops, mbrname)
+
+/* XMLRPC_XOPSIZE(xyz) is the minimum size a struct
+   xmlrpc_client_transport_ops must be to include the 'xyz' member.  A user
+   transport passes the size of its ops structure as the 'transportOps_size'
+   client parameter, so the library knows which members it has.  One
+   compiled before 'get_pollfds' existed is XMLRPC_XOPSIZE(set_interrupt)
+   in size, and we treat the members it lacks as NULL.
+*/
+
 extern int xmlrpc_trace_transport;
     // This is nonzero to indicate that client XML transport logic should
     // be traced.
@@ -63,6 +63,12 @@ extern "C" {
   Since the xmlrpc_mem_block type is part of the API, we may want to make
   xmlrpc_mem_pool external some day.  For now, any xmlrpc_mem_block created
   outside of Xmlrpc-c code goes in the default pool.
+
+  A pool is also an arena: xmlrpc_mem_pool_get() hands out memory that all
+  goes back to the system in one piece when the last reference to the pool
+  is gone.  Code that builds a lot of short-lived little objects at once
+  (e.g. the XML-RPC parser) makes a pool the thread's current arena while
+  it works, and the xmlrpc_value constructors allocate from there.
 ============================================================================*/
 
 typedef struct _xmlrpc_mem_pool xmlrpc_mem_pool;
@@ -87,12 +93,41 @@ void
 xmlrpc_mem_pool_release(xmlrpc_mem_pool * const poolP,
                         size_t            const size);
 
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_mem_pool_ref(xmlrpc_mem_pool * const poolP);
+
+XMLRPC_UTIL_EXPORTED
+void
+xmlrpc_mem_pool_charge_arena(xmlrpc_mem_pool * const poolP,
+                             xmlrpc_mem_pool * const chargePoolP);
+
+XMLRPC_UTIL_EXPORTED
+void *
+xmlrpc_mem_pool_get(xmlrpc_env *      const envP,
+                    xmlrpc_mem_pool * const poolP,
+                    size_t            const size);
+
+XMLRPC_UTIL_EXPORTED
+xmlrpc_mem_pool *
+xmlrpc_mem_pool_set_current(xmlrpc_mem_pool * const poolP);
+
+XMLRPC_UTIL_EXPORTED
+xmlrpc_mem_pool *
+xmlrpc_mem_pool_current(void);
+
 XMLRPC_UTIL_EXPORTED
 xmlrpc_mem_block *
 xmlrpc_mem_block_new_pool(xmlrpc_env *      const envP,
                           size_t            const size,
                           xmlrpc_mem_pool * const poolP);
 
+XMLRPC_UTIL_EXPORTED
+xmlrpc_mem_block *
+xmlrpc_mem_block_new_arena(xmlrpc_env *      const envP,
+                           size_t            const size,
+                           xmlrpc_mem_pool * const poolP);
+
 #ifdef __cplusplus
 }
 #endif
@@ -148,6 +148,40 @@ ChannelWrite(TChannel *            const channelP,
 
 
 
+void
+ChannelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              TChanWriteExpect      const expectation,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+  Same as ChannelWrite(), but write all the pieces iov[], in order, as if
+  they were one buffer.
+
+  Where the channel can do this, it is one system call instead of one per
+  piece.
+-----------------------------------------------------------------------------*/
+    if (ChannelTraceIsActive)
+        fprintf(stderr, "Writing %u pieces to channel %p\n",
+                iovCt, channelP);
+
+    if (channelP->vtbl.writev)
+        (*channelP->vtbl.writev)(channelP, iov, iovCt, expectation, failedP);
+    else {
+        unsigned int i;
+
+        for (i = 0, *failedP = false; i < iovCt && !*failedP; ++i) {
+            TChanWriteExpect const pieceExpect =
+                i + 1 < iovCt ? CHAN_EXPECT_MORE : expectation;
+
+            (*channelP->vtbl.write)(channelP, iov[i].buffer, iov[i].len,
+                                    pieceExpect, failedP);
+        }
+    }
+}
+
+
+
 void
 ChannelRead(TChannel *      const channelP,
             unsigned char * const buffer,
@@ -206,3 +240,73 @@ ChannelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+int
+ChannelPollFd(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   Return a file descriptor that becomes readable (in the poll()/epoll sense)
+   when data arrives on *channelP, or -1 if the channel has no such file
+   descriptor.
+
+   The descriptor being readable doesn't guarantee a ChannelRead() would not
+   block -- the channel may need more than what has arrived to produce a
+   byte (e.g. a whole TLS record), so use ChannelWait() with a zero timeout
+   to find out.  And data the channel has already received and buffered
+   doesn't make it readable; see ChannelReadPending().
+-----------------------------------------------------------------------------*/
+    return channelP->vtbl.pollFd ? (*channelP->vtbl.pollFd)(channelP) : -1;
+}
+
+
+
+bool
+ChannelReadPending(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   *channelP has data buffered that ChannelRead() would return right away
+   but its poll file descriptor doesn't show.
+-----------------------------------------------------------------------------*/
+    return channelP->vtbl.readPending ?
+        (*channelP->vtbl.readPending)(channelP) : false;
+}
+
+
+
+bool
+ChannelCanSendFile(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   ChannelSendFile() works on *channelP.
+-----------------------------------------------------------------------------*/
+    return !!channelP->vtbl.sendFile;
+}
+
+
+
+void
+ChannelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                uint32_t * const bytesSentP,
+                bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   Send 'len' bytes of the open file 'fileFd', starting at 'offset', without
+   bringing them into our address space (e.g. with sendfile()).  The file
+   position of 'fileFd' doesn't change.
+
+   Return as *bytesSentP how many bytes we sent.  That is less than 'len'
+   if the file ends first, or if we fail.
+
+   Valid only if ChannelCanSendFile() says so.
+-----------------------------------------------------------------------------*/
+    assert(channelP->vtbl.sendFile);
+
+    if (ChannelTraceIsActive)
+        fprintf(stderr, "Sending %u bytes of file %d from offset %llu "
+                "to channel %p\n",
+                len, fileFd, (unsigned long long)offset, channelP);
+
+    (*channelP->vtbl.sendFile)(channelP, fileFd, offset, len,
+                               bytesSentP, failedP);
+}
+
+
+
@@ -32,6 +32,20 @@ typedef void ChannelWriteImpl(TChannel *            const channelP,
                               TChanWriteExpect      const expectation,
                               bool *                const failedP);
 
+typedef struct {
+/*----------------------------------------------------------------------------
+   One piece of a scatter-gather write
+-----------------------------------------------------------------------------*/
+    const unsigned char * buffer;
+    uint32_t              len;
+} TChannelIoVec;
+
+typedef void ChannelWritevImpl(TChannel *            const channelP,
+                               const TChannelIoVec * const iov,
+                               unsigned int          const iovCt,
+                               TChanWriteExpect      const expectation,
+                               bool *                const failedP);
+
 typedef void ChannelReadImpl(TChannel *      const channelP,
                              unsigned char * const buffer,
                              uint32_t        const len,
@@ -53,6 +67,17 @@ typedef void ChannelInterruptImpl(TChannel * const channelP);
 typedef void ChannelFormatPeerInfoImpl(TChannel *    const channelP,
                                        const char ** const peerStringP);
 
+typedef int ChannelPollFdImpl(TChannel * const channelP);
+
+typedef bool ChannelReadPendingImpl(TChannel * const channelP);
+
+typedef void ChannelSendFileImpl(TChannel * const channelP,
+                                 int        const fileFd,
+                                 uint64_t   const offset,
+                                 uint32_t   const len,
+                                 uint32_t * const bytesSentP,
+                                 bool *     const failedP);
+
 struct TChannelVtbl {
     ChannelDestroyImpl            * destroy;
     ChannelWriteImpl              * write;
@@ -60,6 +85,22 @@ struct TChannelVtbl {
     ChannelWaitImpl               * wait;
     ChannelInterruptImpl          * interrupt;
     ChannelFormatPeerInfoImpl     * formatPeerInfo;
+    ChannelPollFdImpl             * pollFd;
+        /* NULL means the channel has no file descriptor that tells when
+           it is readable (e.g. it buffers data internally).
+        */
+    ChannelWritevImpl             * writev;
+        /* NULL means the channel has no scatter-gather write; we use
+           'write' on each piece.
+        */
+    ChannelReadPendingImpl        * readPending;
+        /* NULL means the channel never holds received data that its
+           poll file descriptor doesn't show.
+        */
+    ChannelSendFileImpl           * sendFile;
+        /* NULL means the channel can't send straight from a file; the
+           caller must read the file and use 'write'.
+        */
 };
 
 struct _TChannel {
@@ -90,6 +131,13 @@ ChannelWrite(TChannel *            const channelP,
              TChanWriteExpect      const expectation,
              bool *                const failedP);
 
+void
+ChannelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              TChanWriteExpect      const expectation,
+              bool *                const failedP);
+
 void
 ChannelRead(TChannel *      const channelP,
             unsigned char * const buffer,
@@ -113,4 +161,21 @@ void
 ChannelFormatPeerInfo(TChannel *    const channelP,
                       const char ** const peerStringP);
 
+int
+ChannelPollFd(TChannel * const channelP);
+
+bool
+ChannelReadPending(TChannel * const channelP);
+
+bool
+ChannelCanSendFile(TChannel * const channelP);
+
+void
+ChannelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                uint32_t * const bytesSentP,
+                bool *     const failedP);
+
 #endif
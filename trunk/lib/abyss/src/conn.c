@@ -12,6 +12,7 @@
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/sleep_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/abyss.h"
 #include "channel.h"
 #include "server.h"
@@ -32,7 +33,8 @@ connJob(void * const userHandle) {
    This is the root function for a thread that processes a connection
    (performs HTTP transactions).
 
-   We never return.  We ultimately exit the thread.
+   We ultimately exit the thread.  But if the thread belongs to a thread
+   pool, we return to the pool instead.
 -----------------------------------------------------------------------------*/
     TConn * const connectionP = userHandle;
 
@@ -48,20 +50,14 @@ connJob(void * const userHandle) {
 
 
     /* Note that ThreadExit() runs a cleanup function, which in our
-       case is connDone().
+       case is threadDone().  For a pool thread, the pool runs it after we
+       return.
     */
     ThreadExit(connectionP->threadP, 0);
 }
 
 
 
-/* This is the maximum amount of stack that 'connJob' itself uses --
-   does not count what user's connection job function uses.
-*/
-#define CONNJOB_STACK 1024
-
-
-
 static void
 connDone(TConn * const connectionP) {
 
@@ -84,6 +80,9 @@ threadDone(void * const userHandle) {
     TConn * const connectionP = userHandle;
 
     connDone(connectionP);
+
+    /* Wake up the server if it's waiting for a connection to finish */
+    ThreadNotifyDone();
 }
 
 
@@ -91,6 +90,7 @@ threadDone(void * const userHandle) {
 static void
 makeThread(TConn *             const connectionP,
            enum abyss_foreback const foregroundBackground,
+           TThreadPool *       const threadPoolP,
            bool                const useSigchld,
            size_t              const jobStackSize,
            const char **       const errorP) {
@@ -103,10 +103,16 @@ makeThread(TConn *             const connectionP,
     case ABYSS_BACKGROUND: {
         const char * error;
         connectionP->hasOwnThread = true;
-        ThreadCreate(&connectionP->threadP, connectionP,
-                     &connJob, &threadDone, useSigchld,
-                     CONNJOB_STACK + jobStackSize,
-                     &error);
+        if (threadPoolP)
+            ThreadCreatePooled(&connectionP->threadP, threadPoolP,
+                               connectionP, &connJob, &threadDone,
+                               CONNJOB_STACK + jobStackSize,
+                               &error);
+        else
+            ThreadCreate(&connectionP->threadP, connectionP,
+                         &connJob, &threadDone, useSigchld,
+                         CONNJOB_STACK + jobStackSize,
+                         &error);
         if (error) {
             xmlrpc_asprintf(errorP, "Unable to create thread to "
                             "process connection.  %s", error);
@@ -128,6 +134,7 @@ ConnCreate(TConn **            const connectionPP,
            size_t              const jobStackSize,
            TThreadDoneFn *     const done,
            enum abyss_foreback const foregroundBackground,
+           TThreadPool *       const threadPoolP,
            bool                const useSigchld,
            const char **       const errorP) {
 /*----------------------------------------------------------------------------
@@ -147,6 +154,9 @@ ConnCreate(TConn **            const connectionPP,
    connection asynchronously to the creator, in the background, via a
    TThread thread.  'foregroundBackground' determines which.
 
+   A background connection's thread comes from thread pool *threadPoolP,
+   or is a new one of its own if 'threadPoolP' is NULL.
+
    'job' calls methods of the connection to get requests and send
    responses.
 
@@ -155,14 +165,22 @@ ConnCreate(TConn **            const connectionPP,
 
    'channelInfoP' == NULL means no channel info supplied.
 -----------------------------------------------------------------------------*/
+    uint32_t const bufferAllocSize = serverP->srvP->connBufferSize;
+
     TConn * connectionP;
 
     MALLOCVAR(connectionP);
 
-    if (connectionP == NULL)
+    if (connectionP)
+        MALLOCARRAY(connectionP->buffer.b, bufferAllocSize);
+
+    if (connectionP == NULL || connectionP->buffer.b == NULL) {
         xmlrpc_asprintf(errorP, "Unable to allocate memory for a connection "
                         "descriptor.");
-    else {
+        if (connectionP)
+            free(connectionP);
+    } else {
+        connectionP->bufferAllocSize = bufferAllocSize;
         connectionP->server       = serverP;
         connectionP->channelP     = channelP;
         connectionP->channelInfoP = channelInfoP;
@@ -176,8 +194,13 @@ ConnCreate(TConn **            const connectionPP,
         connectionP->outbytes     = 0;
         connectionP->trace        = getenv("ABYSS_TRACE_CONN");
 
-        makeThread(connectionP, foregroundBackground, useSigchld,
-                   jobStackSize, errorP);
+        makeThread(connectionP, foregroundBackground, threadPoolP,
+                   useSigchld, jobStackSize, errorP);
+
+        if (*errorP) {
+            free(connectionP->buffer.b);
+            free(connectionP);
+        }
     }
     *connectionPP = connectionP;
 }
@@ -192,9 +215,9 @@ ConnBufferSpace(TConn * const connectionP) {
    Note that the space before the read pointer (connectionP->bufferpos)
    is also unused, but we don't consider that.
 -----------------------------------------------------------------------------*/
-    assert(connectionP->buffersize + 1 <= BUFFER_SIZE);
+    assert(connectionP->buffersize + 1 <= connectionP->bufferAllocSize);
 
-    return BUFFER_SIZE - connectionP->buffersize - 1;
+    return connectionP->bufferAllocSize - connectionP->buffersize - 1;
         /* - 1 is because we reserve the last byte of the buffer for a NUL. */
 }
 
@@ -238,6 +261,7 @@ ConnWaitAndRelease(TConn * const connectionP) {
         assert(connectionP->threadP);
         ThreadWaitAndRelease(connectionP->threadP);
     }
+    free(connectionP->buffer.b);
     free(connectionP);
 }
 
@@ -399,14 +423,14 @@ readFromChannel(TConn *       const connectionP,
     uint32_t bytesRead;
     bool readError;
 
-    assert(connectionP->buffersize <= BUFFER_SIZE);
+    assert(connectionP->buffersize <= connectionP->bufferAllocSize);
 
-    if (BUFFER_SIZE - connectionP->buffersize < 2)
+    if (connectionP->bufferAllocSize - connectionP->buffersize < 2)
         xmlrpc_asprintf(errorP, "Connection buffer full.");
     else {
         ChannelRead(connectionP->channelP,
                     connectionP->buffer.b + connectionP->buffersize,
-                    BUFFER_SIZE - connectionP->buffersize - 1,
+                    connectionP->bufferAllocSize - connectionP->buffersize - 1,
                     &bytesRead, &readError);
 
         if (readError)
@@ -530,6 +554,79 @@ ConnRead(TConn *       const connectionP,
 
 
 
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               void *        const buffer,
+               size_t        const len,
+               size_t *      const bytesReadP,
+               const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Read some stuff on connection *connectionP from the channel, like
+   ConnRead(), but straight into Caller's 'len'-byte 'buffer' instead of the
+   connection buffer.  Return as *bytesReadP how much we read: at least one
+   byte.
+
+   This is for reading something big whose length Caller knows, such as an
+   HTTP request body with a Content-length, after Caller has taken whatever
+   of it was already in the connection buffer.  It saves copying the data
+   and lets one system call bring in as much as the channel has.
+
+   Don't wait more than 'timeout' seconds for data to arrive.  Fail if it
+   doesn't, or the client closes the connection.
+-----------------------------------------------------------------------------*/
+    uint32_t const timeoutMs = timeout * 1000;
+
+    assert(connectionP->bufferpos == connectionP->buffersize);
+        /* Otherwise, we'd be reading ahead of what's in the buffer */
+
+    if (timeoutMs < timeout)
+        /* Arithmetic overflow */
+        xmlrpc_asprintf(errorP, "Timeout value is too large");
+    else {
+        bool const waitForRead  = true;
+        bool const waitForWrite = false;
+
+        bool readyForRead;
+        bool failed;
+
+        ChannelWait(connectionP->channelP, waitForRead, waitForWrite,
+                    timeoutMs, &readyForRead, NULL, &failed);
+
+        if (failed)
+            xmlrpc_asprintf(errorP,
+                            "Wait for stuff to arrive from client failed.");
+        else if (!readyForRead) {
+            traceReadTimeout(connectionP, timeout);
+            xmlrpc_asprintf(errorP, "Client did not send anything "
+                            "for %u seconds", timeout);
+        } else {
+            uint32_t const maxRead = (uint32_t)MIN(len, 0x7fffffff);
+
+            uint32_t bytesRead;
+            bool readError;
+
+            ChannelRead(connectionP->channelP, buffer, maxRead,
+                        &bytesRead, &readError);
+
+            if (readError)
+                xmlrpc_asprintf(errorP, "Error reading from channel");
+            else if (bytesRead == 0)
+                xmlrpc_asprintf(errorP, "Client closed the connection");
+            else {
+                if (connectionP->trace)
+                    traceBuffer("READ FROM CHANNEL", buffer, bytesRead);
+
+                connectionP->inbytes += bytesRead;
+                *bytesReadP = bytesRead;
+                *errorP = NULL;
+            }
+        }
+    }
+}
+
+
+
 bool
 ConnWrite(TConn *          const connectionP,
           const void *     const buffer,
@@ -561,6 +658,229 @@ ConnWrite(TConn *          const connectionP,
 
 
 
+bool
+ConnWritev(TConn *               const connectionP,
+           const TChannelIoVec * const iov,
+           unsigned int          const iovCt,
+           TConnWriteExpect      const expectation) {
+/*----------------------------------------------------------------------------
+  Same as ConnWrite(), but write all the pieces iov[], in order, in one go.
+  Where the channel can, that is one system call.
+-----------------------------------------------------------------------------*/
+    TChanWriteExpect const chanExpect =
+        expectation == CONN_EXPECT_MORE ?
+            CHAN_EXPECT_MORE : CHAN_EXPECT_NOTHING;
+
+    bool failed;
+    unsigned int i;
+
+    ChannelWritev(connectionP->channelP, iov, iovCt, chanExpect, &failed);
+
+    for (i = 0; i < iovCt; ++i) {
+        traceChannelWrite(connectionP, (const char *)iov[i].buffer,
+                          iov[i].len, failed);
+
+        if (!failed)
+            connectionP->outbytes += iov[i].len;
+    }
+    return !failed;
+}
+
+
+
+struct tokenBucket {
+/*----------------------------------------------------------------------------
+   A token bucket rate limiter.  A token is permission to send one byte.
+   Tokens accrue at 'rate' per second, up to 'capacity', so a sender that has
+   been idle may burst that much and otherwise averages 'rate'.
+-----------------------------------------------------------------------------*/
+    uint32_t        rate;
+    uint32_t        capacity;
+    uint64_t        tokens;
+    xmlrpc_timespec lastFill;
+};
+
+
+
+static void
+tokenBucketInit(struct tokenBucket * const bucketP,
+                uint32_t             const rate,
+                uint32_t             const capacity) {
+
+    bucketP->rate     = rate;
+    bucketP->capacity = capacity;
+    bucketP->tokens   = capacity;
+
+    xmlrpc_gettimeofday(&bucketP->lastFill);
+}
+
+
+
+static void
+tokenBucketFill(struct tokenBucket * const bucketP) {
+
+    xmlrpc_timespec now;
+    int64_t elapsedUs;
+
+    xmlrpc_gettimeofday(&now);
+
+    elapsedUs = ((int64_t)now.tv_sec - bucketP->lastFill.tv_sec) * 1000000 +
+        ((int64_t)now.tv_nsec - bucketP->lastFill.tv_nsec) / 1000;
+
+    if (elapsedUs < 0)
+        /* Clock went backward.  Start over from now. */
+        bucketP->lastFill = now;
+    else {
+        uint64_t const newTokens =
+            (uint64_t)elapsedUs * bucketP->rate / 1000000;
+
+        if (newTokens > 0) {
+            bucketP->tokens   = MIN(bucketP->capacity,
+                                    bucketP->tokens + newTokens);
+            bucketP->lastFill = now;
+        }
+    }
+}
+
+
+
+static void
+tokenBucketTake(struct tokenBucket * const bucketP,
+                uint32_t             const amount) {
+/*----------------------------------------------------------------------------
+   Wait until the bucket holds 'amount' tokens, then take them.
+
+   'amount' must not exceed the bucket's capacity.
+-----------------------------------------------------------------------------*/
+    assert(amount <= bucketP->capacity);
+
+    tokenBucketFill(bucketP);
+
+    while (bucketP->tokens < amount) {
+        uint64_t const shortfall = amount - bucketP->tokens;
+
+        xmlrpc_millisecond_sleep(
+            (unsigned int)((shortfall * 1000 + bucketP->rate - 1) /
+                           bucketP->rate));
+
+        tokenBucketFill(bucketP);
+    }
+    bucketP->tokens -= amount;
+}
+
+
+
+#define SENDFILE_CHUNK_MAX (1u << 30)
+    /* Most we ask the channel to send from a file at once when not rate
+       limiting.  Just a bound on the uint32_t.
+    */
+
+#define SENDFILE_CHUNK_METERED (64u * 1024u)
+    /* Most we send from a file at once when rate limiting, so the sending
+       is reasonably smooth.
+    */
+
+
+
+static void
+sendFromFile(TConn *              const connectionP,
+             const TFile *        const fileP,
+             uint64_t             const start,
+             uint64_t             const totalBytes,
+             struct tokenBucket * const bucketP,
+             uint64_t *           const bytesSentP,
+             bool *               const failedP) {
+/*----------------------------------------------------------------------------
+   Send 'totalBytes' bytes of file *fileP, starting at offset 'start', by
+   having the channel take them straight from the file.
+
+   Meter with *bucketP, or not at all if 'bucketP' is NULL.
+-----------------------------------------------------------------------------*/
+    uint32_t const chunkMax =
+        bucketP ?
+        MIN(bucketP->capacity, SENDFILE_CHUNK_METERED) : SENDFILE_CHUNK_MAX;
+
+    uint64_t bytesSent;
+    bool failed, eof;
+
+    for (bytesSent = 0, failed = false, eof = false;
+         bytesSent < totalBytes && !failed && !eof;
+        ) {
+        uint32_t const chunkSize =
+            (uint32_t)MIN(chunkMax, totalBytes - bytesSent);
+
+        uint32_t bytesSentThisTime;
+
+        if (bucketP)
+            tokenBucketTake(bucketP, chunkSize);
+
+        ChannelSendFile(connectionP->channelP, fileP->fd,
+                        start + bytesSent, chunkSize,
+                        &bytesSentThisTime, &failed);
+
+        if (connectionP->trace)
+            fprintf(stderr, "%s %u BYTES FROM FILE TO CHANNEL\n\n",
+                    failed ? "FAILED TO SEND" : "SENT", bytesSentThisTime);
+
+        bytesSent += bytesSentThisTime;
+        connectionP->outbytes += bytesSentThisTime;
+
+        eof = bytesSentThisTime < chunkSize;
+    }
+    *bytesSentP = bytesSent;
+    *failedP    = failed;
+}
+
+
+
+static void
+copyFromFile(TConn *              const connectionP,
+             const TFile *        const fileP,
+             uint64_t             const start,
+             uint64_t             const totalBytes,
+             void *               const buffer,
+             uint32_t             const buffersize,
+             struct tokenBucket * const bucketP,
+             uint64_t *           const bytesSentP) {
+/*----------------------------------------------------------------------------
+   Same as sendFromFile(), but read the file into the 'buffersize' bytes at
+   'buffer' and write it from there, a buffer-full at a time.
+-----------------------------------------------------------------------------*/
+    uint32_t const chunkMax =
+        bucketP ? MIN(buffersize, bucketP->capacity) : buffersize;
+
+    uint64_t bytesSent;
+
+    bytesSent = 0;  /* initial value */
+
+    if (FileSeek(fileP, start, SEEK_SET)) {
+        bool done;
+
+        for (done = false; bytesSent < totalBytes && !done; ) {
+            uint32_t const bytesToRead =
+                (uint32_t)MIN(chunkMax, totalBytes - bytesSent);
+
+            int32_t bytesReadThisTime;
+
+            if (bucketP)
+                tokenBucketTake(bucketP, bytesToRead);
+
+            bytesReadThisTime = FileRead(fileP, buffer, bytesToRead);
+
+            if (bytesReadThisTime <= 0)
+                done = true;
+            else if (!ConnWrite(connectionP, buffer, bytesReadThisTime,
+                                CONN_EXPECT_NOTHING))
+                done = true;
+            else
+                bytesSent += bytesReadThisTime;
+        }
+    }
+    *bytesSentP = bytesSent;
+}
+
+
+
 bool
 ConnWriteFromFile(TConn *       const connectionP,
                   const TFile * const fileP,
@@ -573,56 +893,46 @@ ConnWriteFromFile(TConn *       const connectionP,
    Write the contents of the file stream *fileP, from offset 'start'
    up through 'last', to the HTTP connection *connectionP.
 
-   Meter the reading so as not to read more than 'rate' bytes per second.
+   Meter the sending so as not to send more than 'rate' bytes per second on
+   average, after an initial burst of up to one second's worth.  'rate' zero
+   means no limit.
 
-   Use the 'bufferSize' bytes at 'buffer' as an internal buffer for this.
+   Where the channel can send straight from a file (e.g. with sendfile() on
+   a plain Unix socket), the file contents never come into our memory.
+   Otherwise, use the 'bufferSize' bytes at 'buffer' as an internal buffer
+   for this.
 -----------------------------------------------------------------------------*/
-    bool retval;
-    uint32_t waittime;
-    bool success;
-    uint32_t readChunkSize;
-
-    if (rate > 0) {
-        readChunkSize = MIN(buffersize, rate);  /* One second's worth */
-        waittime = (1000 * buffersize) / rate;
-    } else {
-        readChunkSize = buffersize;
-        waittime = 0;
-    }
-
-    success = FileSeek(fileP, start, SEEK_SET);
-    if (!success)
-        retval = false;
-    else {
-        uint64_t const totalBytesToRead = last - start + 1;
-        uint64_t bytesread;
-
-        bytesread = 0;  /* initial value */
-
-        while (bytesread < totalBytesToRead) {
-            uint64_t const bytesLeft     = totalBytesToRead - bytesread;
-            uint64_t const bytesToRead64 = MIN(readChunkSize, bytesLeft);
-            uint32_t const bytesToRead   = (uint32_t)bytesToRead64;
+    uint64_t const totalBytes = last - start + 1;
 
-            uint32_t bytesReadThisTime;
+    struct tokenBucket bucket;
+    struct tokenBucket * bucketP;
+    uint64_t bytesSent;
 
-            assert(bytesToRead == bytesToRead64); /* readChunkSize is uint32 */
+    if (rate > 0) {
+        tokenBucketInit(&bucket, rate, rate);
+        bucketP = &bucket;
+    } else
+        bucketP = NULL;
 
-            bytesReadThisTime = FileRead(fileP, buffer, bytesToRead);
-            bytesread += bytesReadThisTime;
+    if (ChannelCanSendFile(connectionP->channelP)) {
+        bool failed;
 
-            if (bytesReadThisTime > 0)
-                ConnWrite(connectionP, buffer, bytesReadThisTime,
-                          CONN_EXPECT_NOTHING);
-            else
-                break;
+        sendFromFile(connectionP, fileP, start, totalBytes, bucketP,
+                     &bytesSent, &failed);
 
-            if (waittime > 0)
-                xmlrpc_millisecond_sleep(waittime);
+        if (failed && bytesSent == 0) {
+            /* The channel may not be able to send from this particular
+               file (sendfile() doesn't work on every kind of file).  The
+               ordinary way will tell if it's the connection that's broken.
+            */
+            copyFromFile(connectionP, fileP, start, totalBytes,
+                         buffer, buffersize, bucketP, &bytesSent);
         }
-        retval = (bytesread >= totalBytesToRead);
-    }
-    return retval;
+    } else
+        copyFromFile(connectionP, fileP, start, totalBytes,
+                     buffer, buffersize, bucketP, &bytesSent);
+
+    return bytesSent >= totalBytes;
 }
 
 
@@ -4,13 +4,15 @@
 #include "bool.h"
 #include "xmlrpc-c/abyss.h"
 #include "thread.h"
+#include "channel.h"
 
 struct TFile;
 
 #define BUFFER_SIZE 4097
-    /* It's a typical page size plus a byte because we always make sure the
-       data in the buffer ends with an ASCII NUL, and this way in a large
-       transfer we actually transfer in 4096 byte chunks.
+    /* The default size of the connection buffer.  It's a typical page size
+       plus a byte because we always make sure the data in the buffer ends
+       with an ASCII NUL, and this way in a large transfer we actually
+       transfer in 4096 byte chunks.
     */
 
 struct _TConn {
@@ -56,14 +58,25 @@ struct _TConn {
            is done with the connection, exits.
         */
     TThreadDoneFn * done;
+    uint32_t bufferAllocSize;
+        /* Size of the connection buffer (buffer, below), in bytes.  It's
+           the server's choice, fixed for the life of the connection; we
+           can't move the buffer because the request header information
+           points into it.
+        */
     union {
-        unsigned char b[BUFFER_SIZE];  /* Just bytes */
-        char          t[BUFFER_SIZE];  /* Taken as text */
+        unsigned char * b;  /* Just bytes */
+        char *          t;  /* Taken as text */
     } buffer;
 };
 
 typedef struct _TConn TConn;
 
+/* This is the maximum amount of stack that a connection's thread uses
+   itself -- does not count what the connection's job function uses.
+*/
+#define CONNJOB_STACK 1024
+
 TConn * ConnAlloc(void);
 
 void ConnFree(TConn * const connectionP);
@@ -77,6 +90,7 @@ ConnCreate(TConn **            const connectionPP,
            size_t              const jobStackSize,
            TThreadDoneFn *     const done,
            enum abyss_foreback const foregroundBackground,
+           TThreadPool *       const threadPoolP,
            bool                const useSigchld,
            const char **       const errorP);
 
@@ -100,6 +114,12 @@ ConnWrite(TConn *          const connectionP,
           uint32_t         const size,
           TConnWriteExpect const expectation);
 
+bool
+ConnWritev(TConn *               const connectionP,
+           const TChannelIoVec * const iov,
+           unsigned int          const iovCt,
+           TConnWriteExpect      const expectation);
+
 void
 ConnRead(TConn *       const connectionP,
          uint32_t      const timeout,
@@ -107,6 +127,14 @@ ConnRead(TConn *       const connectionP,
          bool *        const timedOutP,
          const char ** const errorP);
 
+void
+ConnReadDirect(TConn *       const connectionP,
+               uint32_t      const timeout,
+               void *        const buffer,
+               size_t        const len,
+               size_t *      const bytesReadP,
+               const char ** const errorP);
+
 void
 ConnReadInit(TConn * const connectionP);
 
@@ -24,6 +24,7 @@
 #include <fcntl.h>
 
 #include "bool.h"
+#include "c_util.h"
 #include "int.h"
 #include "girmath.h"
 #include "mallocvar.h"
@@ -566,10 +567,17 @@ sendBody(TSession *      const sessionP,
     else {
         uint64_t i;
         for (i = 0; i <= sessionP->ranges.size; ++i) {
-            ConnWrite(sessionP->connP, "--", 2, CONN_EXPECT_MORE);
-            ConnWrite(sessionP->connP, BOUNDARY, strlen(BOUNDARY),
-                      CONN_EXPECT_MORE);
-            ConnWrite(sessionP->connP, "\r\n", 2, CONN_EXPECT_NOTHING);
+            TChannelIoVec iov[3];
+
+            iov[0].buffer = (const unsigned char *)"--";
+            iov[0].len    = 2;
+            iov[1].buffer = (const unsigned char *)BOUNDARY;
+            iov[1].len    = strlen(BOUNDARY);
+            iov[2].buffer = (const unsigned char *)"\r\n";
+            iov[2].len    = 2;
+
+            ConnWritev(sessionP->connP, iov, ARRAY_SIZE(iov),
+                       CONN_EXPECT_NOTHING);
 
             if (i < sessionP->ranges.size) {
                 uint64_t start;
@@ -14,6 +14,7 @@
 
 #include "xmlrpc_config.h"
 #include "bool.h"
+#include "c_util.h"
 #include "mallocvar.h"
 #include "xmlrpc-c/util.h"
 #include "xmlrpc-c/string_int.h"
@@ -309,19 +310,20 @@ HTTPWriteBodyChunk(TSession *   const sessionP,
 
     if (sessionP->chunkedwrite && sessionP->chunkedwritemode) {
         char chunkHeader[16];
+        TChannelIoVec iov[3];
 
         sprintf(chunkHeader, "%x\r\n", len);
 
-        succeeded =
-            ConnWrite(sessionP->connP, chunkHeader, strlen(chunkHeader),
-                CONN_EXPECT_MORE);
-        if (succeeded) {
-            succeeded = ConnWrite(sessionP->connP, buffer, len,
-                CONN_EXPECT_MORE);
-            if (succeeded)
-                succeeded = ConnWrite(sessionP->connP, "\r\n", 2,
-                    CONN_EXPECT_NOTHING);
-        }
+        /* Header, data, and trailer all in one system call */
+        iov[0].buffer = (const unsigned char *)chunkHeader;
+        iov[0].len    = strlen(chunkHeader);
+        iov[1].buffer = (const unsigned char *)buffer;
+        iov[1].len    = len;
+        iov[2].buffer = (const unsigned char *)"\r\n";
+        iov[2].len    = 2;
+
+        succeeded = ConnWritev(sessionP->connP, iov, ARRAY_SIZE(iov),
+                               CONN_EXPECT_NOTHING);
     } else
         succeeded = ConnWrite(sessionP->connP, buffer, len,
             CONN_EXPECT_NOTHING);
@@ -357,6 +359,7 @@ HTTPKeepalive(TSession * const sessionP) {
 -----------------------------------------------------------------------------*/
     return (sessionP->requestInfo.keepalive &&
             !sessionP->serverDeniesKeepalive &&
+            !sessionP->responseAborted &&
             sessionP->status < 400);
 }
 
@@ -80,6 +80,10 @@ ResponseChunked(TSession * const sessionP) {
 
    This is only a hope, things will be real only after a call of
    ResponseWriteStart()
+
+   Return value is whether the response will really be chunked.  It won't
+   be if the client doesn't speak HTTP 1.1; then the body just goes out
+   as is.
 -----------------------------------------------------------------------------*/
     assert(!sessionP->responseStarted);
 
@@ -89,7 +93,7 @@ ResponseChunked(TSession * const sessionP) {
 
     sessionP->chunkedwritemode = true;
 
-    return true;
+    return sessionP->chunkedwrite;
 }
 
 
@@ -299,32 +303,59 @@ formatFieldValue(const char * const unformatted) {
 
 
 static void
-sendHeader(TConn * const connP,
-           TTable  const fields) {
+sendHeader(TConn *      const connP,
+           const char * const statusLine,
+           TTable       const fields) {
 /*----------------------------------------------------------------------------
-   Send the HTTP response header whose fields are fields[].
-
-   Don't include the blank line that separates the header from the body.
+   Send the HTTP response header with status line 'statusLine' (including
+   its CRLF) and fields fields[], followed by the blank line that separates
+   the header from the body.
 
    fields[] contains syntactically valid HTTP header field names and values.
    But to the extent that int contains undefined field names or semantically
    invalid values, the header we send is invalid.
 
-   Tell connection to expect more data for the same logical message.
+   We send it all in one write, so it normally goes out in one system call
+   and one packet.
 -----------------------------------------------------------------------------*/
-    unsigned int i;
+    unsigned int const iovCt = 1 + fields.size + 1;
 
-    for (i = 0; i < fields.size; ++i) {
-        TTableItem * const fieldP = &fields.item[i];
-        const char * const fieldValue = formatFieldValue(fieldP->value);
+    TChannelIoVec * iov;
+    const char ** lines;
 
-        const char * line;
+    MALLOCARRAY(iov, iovCt);
+    MALLOCARRAY(lines, fields.size + 1);
 
-        xmlrpc_asprintf(&line, "%s: %s\r\n", fieldP->name, fieldValue);
-        ConnWrite(connP, line, strlen(line), CONN_EXPECT_MORE);
-        xmlrpc_strfree(line);
-        xmlrpc_strfree(fieldValue);
-    }
+    if (iov && lines) {
+        unsigned int i;
+
+        iov[0].buffer = (const unsigned char *)statusLine;
+        iov[0].len    = strlen(statusLine);
+
+        for (i = 0; i < fields.size; ++i) {
+            TTableItem * const fieldP = &fields.item[i];
+            const char * const fieldValue = formatFieldValue(fieldP->value);
+
+            xmlrpc_asprintf(&lines[i], "%s: %s\r\n",
+                            fieldP->name, fieldValue);
+            xmlrpc_strfree(fieldValue);
+
+            iov[1 + i].buffer = (const unsigned char *)lines[i];
+            iov[1 + i].len    = strlen(lines[i]);
+        }
+        iov[iovCt - 1].buffer = (const unsigned char *)"\r\n";
+        iov[iovCt - 1].len    = 2;
+
+        ConnWritev(connP, iov, iovCt, CONN_EXPECT_NOTHING);
+
+        for (i = 0; i < fields.size; ++i)
+            xmlrpc_strfree(lines[i]);
+    } else
+        TraceMsg("Abyss could not allocate memory to send an HTTP "
+                 "response header");
+
+    free(lines);
+    free(iov);
 }
 
 
@@ -350,14 +381,6 @@ ResponseWriteStart(TSession * const sessionP) {
 
     sessionP->responseStarted = true;
 
-    {
-        const char * const reason = HTTPReasonByStatus(sessionP->status);
-        const char * line;
-        xmlrpc_asprintf(&line,"HTTP/1.1 %u %s\r\n", sessionP->status, reason);
-        ConnWrite(sessionP->connP, line, strlen(line), CONN_EXPECT_MORE);
-        xmlrpc_strfree(line);
-    }
-
     addConnectionHeaderFld(sessionP);
 
     if (sessionP->chunkedwrite && sessionP->chunkedwritemode)
@@ -368,13 +391,22 @@ ResponseWriteStart(TSession * const sessionP) {
     if (srvP->advertise)
         addServerHeaderFld(sessionP);
 
-    /* Note that sessionP->responseHeaderFields is defined to contain
-       syntactically but not necessarily semantically valid header
-       field names and values.
-    */
-    sendHeader(sessionP->connP, sessionP->responseHeaderFields);
+    {
+        const char * const reason = HTTPReasonByStatus(sessionP->status);
+        const char * statusLine;
 
-    ConnWrite(sessionP->connP, "\r\n", 2, CONN_EXPECT_NOTHING);
+        xmlrpc_asprintf(&statusLine, "HTTP/1.1 %u %s\r\n",
+                        sessionP->status, reason);
+
+        /* Note that sessionP->responseHeaderFields is defined to contain
+           syntactically but not necessarily semantically valid header
+           field names and values.
+        */
+        sendHeader(sessionP->connP, statusLine,
+                   sessionP->responseHeaderFields);
+
+        xmlrpc_strfree(statusLine);
+    }
 }
 
 
@@ -397,6 +429,24 @@ ResponseWriteEnd(TSession * const sessionP) {
 
 
 
+void
+ResponseAbort(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Give up on the response the handler has started sending, e.g. because
+   the handler failed in the middle of generating it.
+
+   We don't finish the response (in particular, we don't send the
+   terminating chunk of a chunked response), and we close the connection
+   instead of keeping it alive.  So the client sees a truncated response
+   rather than a complete one that just happens to contain the wrong data.
+-----------------------------------------------------------------------------*/
+    assert(sessionP->responseStarted);
+
+    sessionP->responseAborted = true;
+}
+
+
+
 abyss_bool
 ResponseContentType(TSession *   const serverP,
                     const char * const type) {
@@ -46,6 +46,7 @@
 #include "http.h"
 #include "handler.h"
 #include "sessionReadRequest.h"
+#include "server_event.h"
 
 #include "server.h"
 
@@ -226,9 +227,12 @@ createServer(struct _TServer ** const srvPP,
 
         if (!*errorP) {
             srvP->builtinHandlerP = HandlerCreate();
+            srvP->threadPoolLockP = xmlrpc_lock_create();
             if (!srvP->builtinHandlerP)
                 xmlrpc_asprintf(errorP, "Unable to allocate space for "
                                 "builtin handler descriptor");
+            else if (!srvP->threadPoolLockP)
+                xmlrpc_asprintf(errorP, "Unable to create thread pool lock");
             else {
                 srvP->defaultHandler   = HandlerDefaultBuiltin;
                 srvP->defaultHandlerContext = srvP->builtinHandlerP;
@@ -243,7 +247,15 @@ createServer(struct _TServer ** const srvPP,
                 srvP->uriHandlerStackSize = 0;
                 srvP->maxConn          = 15;
                 srvP->maxConnBacklog   = 15;
+                srvP->connBufferSize   = BUFFER_SIZE;
                 srvP->maxSessionMem    = 0;
+                srvP->eventDriven      = false;
+                srvP->eventIoThreadCt  = 1;
+                srvP->eventWorkerCt    = 16;
+                srvP->threadPoolMaxCt  = 0;
+                srvP->threadPoolMinCt  = 1;
+                srvP->threadPoolIdleTimeout = 60;
+                srvP->threadPoolP      = NULL;
 
                 initUnixStuff(srvP);
 
@@ -252,9 +264,12 @@ createServer(struct _TServer ** const srvPP,
                 srvP->logfileisopen = false;
 
                 *errorP = NULL;
-
-                if (*errorP)
+            }
+            if (*errorP) {
+                if (srvP->builtinHandlerP)
                     HandlerDestroy(srvP->builtinHandlerP);
+                if (srvP->threadPoolLockP)
+                    srvP->threadPoolLockP->destroy(srvP->threadPoolLockP);
             }
         }
         if (*errorP)
@@ -528,6 +543,8 @@ ServerFree(TServer * const serverP) {
     if (srvP->logfilename)
         xmlrpc_strfree(srvP->logfilename);
 
+    srvP->threadPoolLockP->destroy(srvP->threadPoolLockP);
+
     free(srvP);
 }
 
@@ -644,6 +661,103 @@ ServerSetMaxSessionMem(TServer * const serverP,
 
 
 
+void
+ServerSetConnBufferSize(TServer *       const serverP,
+                        xmlrpc_uint32_t const size) {
+/*----------------------------------------------------------------------------
+   Make each connection's buffer hold 'size' bytes of what the client sends.
+   A bigger buffer takes a big request body in fewer reads, and lets a
+   request header have longer lines.  Zero means the default (4096).  We
+   don't go below 1K or above 1G.
+-----------------------------------------------------------------------------*/
+    if (size > 0)
+        serverP->srvP->connBufferSize = MIN(MAX(size, 1024), 1 << 30) + 1;
+            /* + 1 for the NUL we keep at the end of the data.  The upper
+               limit also keeps that from overflowing.
+            */
+}
+
+
+
+void
+ServerSetEventDriven(TServer *  const serverP,
+                     abyss_bool const eventDriven) {
+
+    serverP->srvP->eventDriven = eventDriven;
+}
+
+
+
+void
+ServerSetEventThreads(TServer *    const serverP,
+                      unsigned int const ioThreadCt,
+                      unsigned int const workerCt) {
+
+    if (ioThreadCt > 0)
+        serverP->srvP->eventIoThreadCt = ioThreadCt;
+    if (workerCt > 0)
+        serverP->srvP->eventWorkerCt = workerCt;
+}
+
+
+
+void
+ServerSetThreadPool(TServer *    const serverP,
+                    unsigned int const minThreadCt,
+                    unsigned int const maxThreadCt,
+                    unsigned int const idleTimeout) {
+/*----------------------------------------------------------------------------
+   Have ServerRun() run connections on a pool of between 'minThreadCt' and
+   'maxThreadCt' threads instead of creating a thread for each connection.
+   A thread beyond the minimum exits after sitting idle for 'idleTimeout'
+   seconds; zero means never.
+
+   'maxThreadCt' zero means no pool.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    srvP->threadPoolMinCt       = minThreadCt;
+    srvP->threadPoolMaxCt       = maxThreadCt;
+    srvP->threadPoolIdleTimeout = idleTimeout;
+}
+
+
+
+void
+ServerGetThreadPoolStats(TServer *                const serverP,
+                         TServerThreadPoolStats * const statsP) {
+/*----------------------------------------------------------------------------
+   Report how busy the server's thread pool is.  All zero if ServerRun()
+   isn't running with a thread pool.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    TThreadPoolStats poolStats;
+
+    srvP->threadPoolLockP->acquire(srvP->threadPoolLockP);
+
+    if (srvP->threadPoolP)
+        ThreadPoolGetStats(srvP->threadPoolP, &poolStats);
+    else {
+        poolStats.threadCt       = 0;
+        poolStats.busyThreadCt   = 0;
+        poolStats.queueDepth     = 0;
+        poolStats.peakThreadCt   = 0;
+        poolStats.peakQueueDepth = 0;
+        poolStats.jobCt          = 0;
+    }
+    srvP->threadPoolLockP->release(srvP->threadPoolLockP);
+
+    statsP->threadCt       = poolStats.threadCt;
+    statsP->busyThreadCt   = poolStats.busyThreadCt;
+    statsP->queueDepth     = poolStats.queueDepth;
+    statsP->peakThreadCt   = poolStats.peakThreadCt;
+    statsP->peakQueueDepth = poolStats.peakQueueDepth;
+    statsP->connectionCt   = poolStats.jobCt;
+}
+
+
+
 static URIHandler2
 makeUriHandler2(const struct uriHandler * const handlerP) {
 
@@ -786,9 +900,10 @@ processRequestFromClient(TConn *         const connectionP,
 
     assert(session.status != 0);
 
-    if (session.responseStarted)
-        ResponseWriteEnd(&session);
-    else
+    if (session.responseStarted) {
+        if (!session.responseAborted)
+            ResponseWriteEnd(&session);
+    } else
         ResponseError(&session);
 
     *keepAliveP = HTTPKeepalive(&session);
@@ -884,6 +999,24 @@ serverFunc(void * const userHandle) {
 
 
 
+void
+ServerProcessConnRequest(TConn * const connectionP,
+                         bool    const lastReqOnConn,
+                         bool *  const keepAliveP) {
+/*----------------------------------------------------------------------------
+   Process one HTTP request from client connection *connectionP, as
+   serverFunc() does for each request on a connection.  This is for an
+   event-driven connection engine that has already seen the request begin to
+   arrive.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = connectionP->server->srvP;
+
+    processRequestFromClient(connectionP, lastReqOnConn, srvP->timeout,
+                             &srvP->tracer, keepAliveP);
+}
+
+
+
 static void
 createSwitchFromPortNum(unsigned short const portNumber,
                         TChanSwitch ** const chanSwitchPP,
@@ -1080,21 +1213,16 @@ freeFinishedConns(outstandingConnList * const listP) {
 
 
 static void
-waitForConnectionFreed(outstandingConnList * const outstandingConnListP
-                       ATTR_UNUSED) {
+waitForConnectionFreed(unsigned int const doneCount) {
 /*----------------------------------------------------------------------------
-  Wait for a connection descriptor in 'connectionPool' to be probably
-  freed.
+  Wait for a connection to finish, having seen all the connections that had
+  finished when ThreadDoneCount() returned 'doneCount'.
 -----------------------------------------------------------------------------*/
 
-    /* TODO: We should do something more sophisticated here.  For pthreads,
-       we can have a thread signal us by semaphore when it terminates.
-       For fork, we might be able to use the "done" handler argument
-       to ConnCreate() to get interrupted when the death of a child
-       signal happens.
+    /* In some configurations (fork without SIGCHLD), nothing tells us when
+       a connection finishes, so we look again after a while regardless.
     */
-
-    xmlrpc_millisecond_sleep(2000);
+    ThreadWaitForDone(doneCount, 2000);
 }
 
 
@@ -1103,10 +1231,12 @@ static void
 waitForNoConnections(outstandingConnList * const outstandingConnListP) {
 
     while (outstandingConnListP->firstP) {
+        unsigned int const doneCount = ThreadDoneCount();
+
         freeFinishedConns(outstandingConnListP);
 
         if (outstandingConnListP->firstP)
-            waitForConnectionFreed(outstandingConnListP);
+            waitForConnectionFreed(doneCount);
     }
 }
 
@@ -1119,9 +1249,12 @@ waitForConnectionCapacity(outstandingConnList * const outstandingConnListP,
    Wait until there are fewer than 'maxConn' connections in progress.
 -----------------------------------------------------------------------------*/
     while (outstandingConnListP->count >= maxConn) {
+        unsigned int const doneCount = ThreadDoneCount();
+
         freeFinishedConns(outstandingConnListP);
-        if (outstandingConnListP->firstP)
-            waitForConnectionFreed(outstandingConnListP);
+
+        if (outstandingConnListP->count >= maxConn)
+            waitForConnectionFreed(doneCount);
     }
 }
 
@@ -1216,7 +1349,7 @@ processNewChannel(TServer *             const serverP,
                &serverFunc,
                SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
                &destroyChannel, ABYSS_BACKGROUND,
-               srvP->useSigchld,
+               srvP->threadPoolP, srvP->useSigchld,
                &error);
     if (!error) {
         addToOutstandingConnList(outstandingConnListP, connectionP);
@@ -1290,6 +1423,62 @@ acceptAndProcessNextConnection(
 
 
 
+static void
+createThreadPool(struct _TServer * const srvP) {
+/*----------------------------------------------------------------------------
+   Create the thread pool the server's connections run on, if it is
+   supposed to have one.  If we can't, the connections get threads of their
+   own.
+-----------------------------------------------------------------------------*/
+    TThreadPool * threadPoolP;
+
+    threadPoolP = NULL;  /* initial value */
+
+    if (srvP->threadPoolMaxCt > 0) {
+        const char * error;
+
+        ThreadPoolCreate(&threadPoolP,
+                         srvP->threadPoolMinCt, srvP->threadPoolMaxCt,
+                         srvP->threadPoolIdleTimeout * 1000,
+                         CONNJOB_STACK + SERVER_FUNC_STACK +
+                         srvP->uriHandlerStackSize,
+                         &error);
+
+        if (error) {
+            TraceMsg("Unable to create a thread pool.  "
+                     "Using a thread or process per connection instead.  %s",
+                     error);
+            xmlrpc_strfree(error);
+            threadPoolP = NULL;
+        }
+    }
+    srvP->threadPoolLockP->acquire(srvP->threadPoolLockP);
+    srvP->threadPoolP = threadPoolP;
+    srvP->threadPoolLockP->release(srvP->threadPoolLockP);
+}
+
+
+
+static void
+destroyThreadPool(struct _TServer * const srvP) {
+
+    TThreadPool * threadPoolP;
+
+    /* We detach the pool under the lock, so ServerGetThreadPoolStats()
+       either sees it whole or not at all, but destroy it outside the lock,
+       because that waits for the pool's threads to finish.
+    */
+    srvP->threadPoolLockP->acquire(srvP->threadPoolLockP);
+    threadPoolP = srvP->threadPoolP;
+    srvP->threadPoolP = NULL;
+    srvP->threadPoolLockP->release(srvP->threadPoolLockP);
+
+    if (threadPoolP)
+        ThreadPoolDestroy(threadPoolP);
+}
+
+
+
 static void
 serverRun2(TServer *     const serverP,
            const char ** const errorP) {
@@ -1299,6 +1488,8 @@ serverRun2(TServer *     const serverP,
 
     createOutstandingConnList(&outstandingConnListP);
 
+    createThreadPool(srvP);
+
     *errorP = NULL;  /* initial value */
 
     trace(&srvP->tracer, "Starting main connection accepting loop");
@@ -1322,6 +1513,7 @@ serverRun2(TServer *     const serverP,
 
         destroyOutstandingConnList(outstandingConnListP);
     }
+    destroyThreadPool(srvP);
 }
 
 
@@ -1343,7 +1535,17 @@ ServerRun(TServer * const serverP) {
     else {
         const char * error;
 
-        serverRun2(serverP, &error);
+        if (srvP->eventDriven && ServerEventEngineIsAvailable())
+            ServerEventRun(serverP,
+                           SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
+                           &error);
+        else {
+            if (srvP->eventDriven)
+                TraceMsg("This Abyss has no event-driven connection engine.  "
+                         "Using a thread or process per connection instead");
+
+            serverRun2(serverP, &error);
+        }
 
         if (error) {
             TraceMsg("Server failed.  %s", error);
@@ -1380,7 +1582,7 @@ serverRunChannel(TServer *     const serverP,
     ConnCreate(&connectionP,
                serverP, channelP, channelInfoP,
                &serverFunc, SERVER_FUNC_STACK + srvP->uriHandlerStackSize,
-               NULL, ABYSS_FOREGROUND, srvP->useSigchld,
+               NULL, ABYSS_FOREGROUND, NULL, srvP->useSigchld,
                &error);
     if (error) {
         xmlrpc_asprintf(errorP, "Couldn't create HTTP connection out of "
@@ -9,6 +9,7 @@
 #include "xmlrpc-c/abyss.h"
 
 #include "data.h"
+#include "thread.h"
 
 struct TFile;
 
@@ -72,6 +73,11 @@ struct _TServer {
            connections on the server's behalf and holds them waiting for the
            server to accept them from the OS.
         */
+    uint32_t connBufferSize;
+        /* Size in bytes of each connection's buffer, including a byte
+           for a terminating NUL.  A line of a request header has to fit in
+           it.
+        */
     size_t maxSessionMem;
         /* The maximum memory the server can use for certain purposes for a
            single session.  These purposes consist of things where the size
@@ -107,6 +113,33 @@ struct _TServer {
            be aware of SIGCHLD and will instead poll for existence of PIDs
            to determine if a child has died.
         */
+    bool eventDriven;
+        /* ServerRun() should use the event-driven connection engine, if
+           there is one, instead of a thread or process per connection.
+        */
+    unsigned int eventIoThreadCt;
+        /* Number of I/O threads the event-driven engine uses */
+    unsigned int eventWorkerCt;
+        /* Number of worker threads (which run the URI handlers) the
+           event-driven engine uses
+        */
+    unsigned int threadPoolMaxCt;
+        /* ServerRun() should run connections on a pool of at most this
+           many threads, which it keeps from one connection to the next,
+           instead of a new thread for each.  Zero means no pool.
+        */
+    unsigned int threadPoolMinCt;
+        /* The thread pool keeps at least this many threads, even idle */
+    unsigned int threadPoolIdleTimeout;
+        /* Seconds a thread beyond the minimum may sit idle in the thread
+           pool before it exits.  Zero means forever.
+        */
+    TThreadPool * threadPoolP;
+        /* The thread pool, while ServerRun() is running.  NULL if there
+           is none.
+        */
+    struct lock * threadPoolLockP;
+        /* Protects 'threadPoolP' while ServerGetThreadPoolStats() uses it */
     size_t uriHandlerStackSize;
         /* The maximum amount of stack any URI handler request handler
            function will use.  Note that this is just the requirement
@@ -0,0 +1,39 @@
+#ifndef SERVER_EVENT_H_INCLUDED
+#define SERVER_EVENT_H_INCLUDED
+
+/*============================================================================
+   This is the interface between the generic server code (server.c) and an
+   event-driven connection engine.
+
+   The traditional way for an Abyss server to run is to give each connection
+   its own thread or process, which blocks reading requests and sits idle in
+   between keepalive requests.  An event-driven engine instead has a few
+   I/O threads watch all the connections and collect request headers without
+   blocking, and hands each complete request header to a bounded pool of
+   worker threads that runs the URI handlers.
+
+   Only some platforms have an event-driven engine.  There is a dummy one for
+   the rest, which says it isn't available.
+============================================================================*/
+
+#include "bool.h"
+#include "xmlrpc-c/abyss.h"
+
+#include "conn.h"
+
+bool
+ServerEventEngineIsAvailable(void);
+
+void
+ServerEventRun(TServer *     const serverP,
+               size_t        const workerStackSize,
+               const char ** const errorP);
+
+/* This is provided by server.c for use by the engine */
+
+void
+ServerProcessConnRequest(TConn * const connectionP,
+                         bool    const lastReqOnConn,
+                         bool *  const keepAliveP);
+
+#endif
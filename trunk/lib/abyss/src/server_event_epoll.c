@@ -0,0 +1,1034 @@
+/*=============================================================================
+                              server_event_epoll
+===============================================================================
+  The event-driven connection engine for the Abyss server, for Linux.
+
+  A few I/O threads own all the idle connections.  Each watches its
+  connections with an epoll instance and reads request headers as they
+  trickle in, never blocking on any one connection.  When an I/O thread has
+  a complete request header, it puts the connection in the work queue, where
+  one of a fixed number of worker threads picks it up and processes the
+  request exactly as a traditional connection thread would -- reading the
+  body, running the URI handlers, and writing the response.  If the client
+  wants to keep the connection alive, the worker gives the connection back
+  to its I/O thread to wait for the next request.
+
+  So an idle keepalive connection costs a descriptor and some memory instead
+  of a thread and its stack.
+
+  Every connection is in exactly one of three places: the "waiting" list of
+  its I/O thread (armed in that thread's epoll instance), the work queue, or
+  the "busy" list (a worker is processing it).  Whoever removes it from one
+  of those owns it until putting it in another one or destroying it.  We
+  arm the descriptors with EPOLLONESHOT, so an I/O thread gets one event
+  per arming.
+=============================================================================*/
+
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+#define _XOPEN_SOURCE 600
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "xmlrpc_config.h"
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+
+#include "xmlrpc-c/abyss.h"
+#include "trace.h"
+#include "thread.h"
+#include "conn.h"
+#include "channel.h"
+#include "chanswitch.h"
+#include "server.h"
+
+#include "server_event.h"
+
+#define MAX_EVENTS 64
+    /* Maximum number of epoll events an I/O thread handles per wait */
+
+#define SWEEP_INTERVAL_MS 1000
+    /* How often, at most, an I/O thread checks its connections for
+       timeouts.  Timeouts are in whole seconds, so this is plenty.
+    */
+
+#define IO_THREAD_STACK (16*1024)
+
+
+
+struct eventConn {
+/*----------------------------------------------------------------------------
+   A connection being served by the engine.
+-----------------------------------------------------------------------------*/
+    struct eventConn * prevP;
+    struct eventConn * nextP;
+        /* Links in the list the connection is in: I/O thread waiting
+           list, work queue, or busy list.
+        */
+    TConn * connP;
+    int fd;
+        /* Descriptor the I/O thread watches; -1 if the channel doesn't
+           have one, in which case the connection never waits in an I/O
+           thread.
+        */
+    struct ioThread * ioThreadP;
+        /* The I/O thread that watches this connection */
+    unsigned int requestCount;
+        /* Number of requests we've processed on this connection */
+    bool headerStarted;
+        /* At least part of the next request is in the connection buffer */
+    time_t deadline;
+        /* Meaningful only while waiting: when we give up on the client */
+};
+
+
+
+struct connList {
+    struct eventConn * firstP;
+    struct eventConn * lastP;
+    unsigned int count;
+};
+
+
+
+struct ioThread {
+    struct eventEngine * engineP;
+    TThread * threadP;
+    int epollFd;
+    int wakeFd;
+        /* An eventfd that is in the epoll set.  Someone writes to it to
+           tell the thread to stop.
+        */
+    pthread_mutex_t mutex;
+        /* Protects 'waiting', which workers add to */
+    struct connList waiting;
+};
+
+
+
+struct eventEngine {
+    TServer * serverP;
+    struct _TServer * srvP;
+
+    pthread_mutex_t mutex;
+        /* Protects everything below */
+    pthread_cond_t workAvailable;
+        /* Signalled when 'queue' gets a member or 'stopping' is set */
+    pthread_cond_t connFreed;
+        /* Signalled when 'connCount' goes down */
+    struct connList queue;
+        /* Connections with a request ready for a worker */
+    struct connList busy;
+        /* Connections a worker is processing */
+    unsigned int connCount;
+        /* Number of connections in existence */
+    bool stopping;
+
+    unsigned int ioThreadCt;
+    struct ioThread * ioThreads;
+    unsigned int nextIoThread;
+        /* Index of the I/O thread to get the next new connection */
+
+    unsigned int workerCt;
+    TThread ** workers;
+};
+
+
+
+bool
+ServerEventEngineIsAvailable(void) {
+
+    return true;
+}
+
+
+
+static void
+trace(struct _TServer * const srvP,
+      const char *      const fmt,
+      ...) {
+
+    if (srvP->tracer.traceIsActive) {
+        va_list argptr;
+
+        va_start(argptr, fmt);
+        vfprintf(stderr, fmt, argptr);
+        va_end(argptr);
+
+        fprintf(stderr, "\n");
+    }
+}
+
+
+
+static void
+connListInit(struct connList * const listP) {
+
+    listP->firstP = NULL;
+    listP->lastP  = NULL;
+    listP->count  = 0;
+}
+
+
+
+static void
+connListAppend(struct connList *  const listP,
+               struct eventConn * const ecP) {
+
+    ecP->nextP = NULL;
+    ecP->prevP = listP->lastP;
+
+    if (listP->lastP)
+        listP->lastP->nextP = ecP;
+    else
+        listP->firstP = ecP;
+
+    listP->lastP = ecP;
+
+    ++listP->count;
+}
+
+
+
+static void
+connListRemove(struct connList *  const listP,
+               struct eventConn * const ecP) {
+
+    if (ecP->prevP)
+        ecP->prevP->nextP = ecP->nextP;
+    else
+        listP->firstP = ecP->nextP;
+
+    if (ecP->nextP)
+        ecP->nextP->prevP = ecP->prevP;
+    else
+        listP->lastP = ecP->prevP;
+
+    ecP->prevP = ecP->nextP = NULL;
+
+    assert(listP->count > 0);
+    --listP->count;
+}
+
+
+
+static struct eventConn *
+connListPopFirst(struct connList * const listP) {
+
+    struct eventConn * const ecP = listP->firstP;
+
+    if (ecP)
+        connListRemove(listP, ecP);
+
+    return ecP;
+}
+
+
+
+static bool
+headerIsComplete(TConn * const connP) {
+/*----------------------------------------------------------------------------
+   The connection buffer contains the whole header of the next request, so
+   SessionReadRequest() will not have to wait for the client.
+
+   Note that a header line can't contain a NUL, so stopping at the first one
+   (SessionReadRequest will reject the request) is harmless.
+-----------------------------------------------------------------------------*/
+    const char * const next = &connP->buffer.t[connP->bufferpos];
+
+    return strstr(next, "\n\r\n") != NULL || strstr(next, "\n\n") != NULL;
+}
+
+
+
+static void
+destroyConn(struct eventEngine * const engineP,
+            struct eventConn *   const ecP) {
+/*----------------------------------------------------------------------------
+   Close the connection and release everything about it.
+
+   Caller owns *ecP; it is in no list.
+-----------------------------------------------------------------------------*/
+    TConn * const connP = ecP->connP;
+
+    ChannelDestroy(connP->channelP);
+    free(connP->channelInfoP);
+    ConnWaitAndRelease(connP);
+
+    free(ecP);
+
+    pthread_mutex_lock(&engineP->mutex);
+
+    assert(engineP->connCount > 0);
+    --engineP->connCount;
+
+    pthread_cond_signal(&engineP->connFreed);
+
+    pthread_mutex_unlock(&engineP->mutex);
+}
+
+
+
+static void
+queueConn(struct eventEngine * const engineP,
+          struct eventConn *   const ecP) {
+/*----------------------------------------------------------------------------
+   Give the connection to a worker to process the request that has begun to
+   arrive on it.
+-----------------------------------------------------------------------------*/
+    pthread_mutex_lock(&engineP->mutex);
+
+    connListAppend(&engineP->queue, ecP);
+
+    pthread_cond_signal(&engineP->workAvailable);
+
+    pthread_mutex_unlock(&engineP->mutex);
+}
+
+
+
+static void
+armConn(struct eventEngine * const engineP,
+        struct eventConn *   const ecP,
+        int                  const op) {
+/*----------------------------------------------------------------------------
+   Give the connection to its I/O thread to wait for more of the request
+   (or a new request), until ecP->deadline.
+
+   'op' is EPOLL_CTL_ADD for a connection the I/O thread has never seen and
+   EPOLL_CTL_MOD for one that it has.
+-----------------------------------------------------------------------------*/
+    struct ioThread * const ioThreadP = ecP->ioThreadP;
+
+    struct epoll_event event;
+    int rc;
+
+    event.events   = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = ecP;
+
+    /* We insert in the waiting list before arming, with the list locked, so
+       that the I/O thread can't see an event for a connection that isn't
+       in the list yet.
+    */
+    pthread_mutex_lock(&ioThreadP->mutex);
+
+    connListAppend(&ioThreadP->waiting, ecP);
+
+    rc = epoll_ctl(ioThreadP->epollFd, op, ecP->fd, &event);
+
+    if (rc != 0)
+        connListRemove(&ioThreadP->waiting, ecP);
+
+    pthread_mutex_unlock(&ioThreadP->mutex);
+
+    if (rc != 0) {
+        TraceMsg("Abyss event engine could not watch connection.  "
+                 "epoll_ctl() failed with errno %d (%s)",
+                 errno, strerror(errno));
+        destroyConn(engineP, ecP);
+    }
+}
+
+
+
+static void
+waitForNextRequest(struct eventEngine * const engineP,
+                   struct eventConn *   const ecP,
+                   int                  const op) {
+/*----------------------------------------------------------------------------
+   Arrange for the next request on the connection to get processed, whether
+   it's already in the buffer or still to come from the client.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = engineP->srvP;
+    TConn * const connP = ecP->connP;
+
+    ecP->headerStarted = connP->buffersize > connP->bufferpos;
+
+    if (ecP->headerStarted && headerIsComplete(connP))
+        queueConn(engineP, ecP);
+    else if (op == EPOLL_CTL_MOD && ChannelReadPending(connP->channelP))
+        /* The channel already took the rest of the request off the socket
+           (e.g. TLS decrypted a whole record), so epoll won't tell us about
+           it.  The worker will read it.
+        */
+        queueConn(engineP, ecP);
+    else {
+        ecP->deadline = time(NULL) +
+            (ecP->headerStarted ? srvP->timeout : srvP->keepalivetimeout);
+        armConn(engineP, ecP, op);
+    }
+}
+
+
+
+static void
+handleReadable(struct ioThread *  const ioThreadP,
+               struct eventConn * const ecP) {
+/*----------------------------------------------------------------------------
+   Take whatever the client has sent on the connection, and decide
+   what to do next.
+
+   This runs in the I/O thread.  We own *ecP (the event disarmed it, and
+   we have removed it from the waiting list).
+-----------------------------------------------------------------------------*/
+    struct eventEngine * const engineP = ioThreadP->engineP;
+    struct _TServer * const srvP = engineP->srvP;
+    TConn * const connP = ecP->connP;
+
+    bool eof, timedOut;
+    const char * error;
+
+    /* A zero timeout makes this a nonblocking read; epoll has told us
+       there is something to read.
+    */
+    ConnRead(connP, 0, &eof, &timedOut, &error);
+
+    if (error) {
+        trace(srvP, "Failed to read from Abyss connection.  %s", error);
+        xmlrpc_strfree(error);
+        destroyConn(engineP, ecP);
+    } else if (eof) {
+        destroyConn(engineP, ecP);
+    } else if (timedOut) {
+        /* Spurious wakeup; keep waiting with the same deadline */
+        armConn(engineP, ecP, EPOLL_CTL_MOD);
+    } else if (headerIsComplete(connP) || ConnBufferSpace(connP) == 0) {
+        /* If the buffer is full without a complete header, the header is
+           too big.  The worker will find that out and tell the client.
+        */
+        queueConn(engineP, ecP);
+    } else {
+        if (!ecP->headerStarted) {
+            ecP->headerStarted = true;
+            ecP->deadline = time(NULL) + srvP->timeout;
+        }
+        armConn(engineP, ecP, EPOLL_CTL_MOD);
+    }
+}
+
+
+
+static void
+closeTimedOutConns(struct ioThread * const ioThreadP,
+                   time_t            const now) {
+
+    struct connList expired;
+    struct eventConn * ecP;
+    struct eventConn * nextP;
+
+    connListInit(&expired);
+
+    pthread_mutex_lock(&ioThreadP->mutex);
+
+    for (ecP = ioThreadP->waiting.firstP; ecP; ecP = nextP) {
+        nextP = ecP->nextP;
+
+        if (ecP->deadline <= now) {
+            connListRemove(&ioThreadP->waiting, ecP);
+            connListAppend(&expired, ecP);
+        }
+    }
+    pthread_mutex_unlock(&ioThreadP->mutex);
+
+    while ((ecP = connListPopFirst(&expired))) {
+        /* We do this before the next epoll_wait(), so it can't return an
+           event for this connection.
+        */
+        epoll_ctl(ioThreadP->epollFd, EPOLL_CTL_DEL, ecP->fd, NULL);
+
+        destroyConn(ioThreadP->engineP, ecP);
+    }
+}
+
+
+
+static TThreadProc ioThreadRun;
+
+static void
+ioThreadRun(void * const arg) {
+
+    struct ioThread * const ioThreadP = arg;
+
+    bool stop;
+    time_t lastSweep;
+
+    stop = false;
+    lastSweep = time(NULL);
+
+    while (!stop) {
+        struct epoll_event events[MAX_EVENTS];
+        time_t now;
+        int rc;
+
+        rc = epoll_wait(ioThreadP->epollFd, events, MAX_EVENTS,
+                        SWEEP_INTERVAL_MS);
+
+        if (rc < 0) {
+            if (errno != EINTR) {
+                TraceMsg("Abyss event engine I/O thread failed.  "
+                         "epoll_wait() failed with errno %d (%s)",
+                         errno, strerror(errno));
+                stop = true;
+            }
+        } else {
+            unsigned int i;
+
+            for (i = 0; i < (unsigned int)rc; ++i) {
+                struct eventConn * const ecP = events[i].data.ptr;
+
+                if (ecP == NULL)
+                    stop = true;  /* Somebody wrote to 'wakeFd' */
+                else {
+                    pthread_mutex_lock(&ioThreadP->mutex);
+                    connListRemove(&ioThreadP->waiting, ecP);
+                    pthread_mutex_unlock(&ioThreadP->mutex);
+
+                    handleReadable(ioThreadP, ecP);
+                }
+            }
+        }
+        now = time(NULL);
+
+        if (now != lastSweep) {
+            closeTimedOutConns(ioThreadP, now);
+            lastSweep = now;
+        }
+    }
+}
+
+
+
+static void
+processRequest(struct eventEngine * const engineP,
+               struct eventConn *   const ecP,
+               bool *               const keepaliveP) {
+/*----------------------------------------------------------------------------
+   Process the request that has arrived, at least in part, on the
+   connection.
+
+   This runs in a worker thread.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = engineP->srvP;
+    TConn * const connP = ecP->connP;
+
+    bool const lastReqOnConn =
+        ecP->fd < 0 || ecP->requestCount + 1 >= srvP->keepalivemaxconn;
+        /* We can't keep alive a connection we can't watch */
+
+    trace(srvP, "HTTP request %u at least partially received.  "
+          "Receiving the rest and processing", ecP->requestCount);
+
+    ServerProcessConnRequest(connP, lastReqOnConn, keepaliveP);
+
+    trace(srvP, "Done processing the HTTP request.  Keepalive = %s",
+          *keepaliveP ? "YES" : "NO");
+
+    ++ecP->requestCount;
+
+    ConnReadInit(connP);
+}
+
+
+
+static TThreadProc workerRun;
+
+static void
+workerRun(void * const arg) {
+
+    struct eventEngine * const engineP = arg;
+
+    pthread_mutex_lock(&engineP->mutex);
+
+    while (!engineP->stopping) {
+        struct eventConn * const ecP = connListPopFirst(&engineP->queue);
+
+        if (ecP) {
+            bool keepalive;
+
+            connListAppend(&engineP->busy, ecP);
+
+            pthread_mutex_unlock(&engineP->mutex);
+
+            processRequest(engineP, ecP, &keepalive);
+
+            pthread_mutex_lock(&engineP->mutex);
+            connListRemove(&engineP->busy, ecP);
+            pthread_mutex_unlock(&engineP->mutex);
+
+            if (!keepalive || engineP->srvP->terminationRequested)
+                destroyConn(engineP, ecP);
+            else
+                waitForNextRequest(engineP, ecP, EPOLL_CTL_MOD);
+
+            pthread_mutex_lock(&engineP->mutex);
+        } else
+            pthread_cond_wait(&engineP->workAvailable, &engineP->mutex);
+    }
+    pthread_mutex_unlock(&engineP->mutex);
+}
+
+
+
+static TThreadDoneFn threadDone;
+
+static void
+threadDone(void * const arg ATTR_UNUSED) {
+
+}
+
+
+
+static void
+createIoThread(struct eventEngine * const engineP,
+               struct ioThread *    const ioThreadP,
+               const char **        const errorP) {
+
+    ioThreadP->engineP = engineP;
+    connListInit(&ioThreadP->waiting);
+
+    ioThreadP->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (ioThreadP->epollFd < 0)
+        xmlrpc_asprintf(errorP, "epoll_create1() failed with errno %d (%s)",
+                        errno, strerror(errno));
+    else {
+        ioThreadP->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        if (ioThreadP->wakeFd < 0)
+            xmlrpc_asprintf(errorP, "eventfd() failed with errno %d (%s)",
+                            errno, strerror(errno));
+        else {
+            struct epoll_event event;
+
+            event.events   = EPOLLIN;
+            event.data.ptr = NULL;
+
+            if (epoll_ctl(ioThreadP->epollFd, EPOLL_CTL_ADD,
+                          ioThreadP->wakeFd, &event) != 0)
+                xmlrpc_asprintf(errorP, "epoll_ctl() failed with "
+                                "errno %d (%s)", errno, strerror(errno));
+            else {
+                pthread_mutex_init(&ioThreadP->mutex, NULL);
+
+                ThreadCreate(&ioThreadP->threadP, ioThreadP,
+                             &ioThreadRun, &threadDone, false,
+                             IO_THREAD_STACK, errorP);
+
+                if (*errorP)
+                    pthread_mutex_destroy(&ioThreadP->mutex);
+            }
+            if (*errorP)
+                close(ioThreadP->wakeFd);
+        }
+        if (*errorP)
+            close(ioThreadP->epollFd);
+    }
+}
+
+
+
+static void
+destroyConnList(struct eventEngine * const engineP,
+                struct connList *    const listP) {
+
+    struct eventConn * ecP;
+
+    while ((ecP = connListPopFirst(listP)))
+        destroyConn(engineP, ecP);
+}
+
+
+
+static void
+stopIoThread(struct ioThread * const ioThreadP) {
+
+    uint64_t const one = 1;
+
+    ssize_t rc;
+
+    rc = write(ioThreadP->wakeFd, &one, sizeof(one));
+
+    if (rc != sizeof(one))
+        TraceMsg("Failed to wake Abyss event engine I/O thread.  "
+                 "errno %d (%s)", errno, strerror(errno));
+
+    ThreadWaitAndRelease(ioThreadP->threadP);
+}
+
+
+
+static void
+destroyIoThread(struct ioThread * const ioThreadP) {
+/*----------------------------------------------------------------------------
+   Release the resources of a stopped I/O thread, including any connections
+   still waiting in it.
+-----------------------------------------------------------------------------*/
+    destroyConnList(ioThreadP->engineP, &ioThreadP->waiting);
+
+    pthread_mutex_destroy(&ioThreadP->mutex);
+    close(ioThreadP->wakeFd);
+    close(ioThreadP->epollFd);
+}
+
+
+
+static void
+stopWorkers(struct eventEngine * const engineP,
+            unsigned int         const workerCt) {
+/*----------------------------------------------------------------------------
+   Stop the first 'workerCt' workers of the engine and wait for them to
+   exit.  Any that are processing a request finish it, but we interrupt
+   any wait they are doing for the client.
+-----------------------------------------------------------------------------*/
+    struct eventConn * ecP;
+    unsigned int i;
+
+    pthread_mutex_lock(&engineP->mutex);
+
+    engineP->stopping = true;
+
+    for (ecP = engineP->busy.firstP; ecP; ecP = ecP->nextP)
+        ChannelInterrupt(ecP->connP->channelP);
+
+    pthread_cond_broadcast(&engineP->workAvailable);
+
+    pthread_mutex_unlock(&engineP->mutex);
+
+    for (i = 0; i < workerCt; ++i)
+        ThreadWaitAndRelease(engineP->workers[i]);
+}
+
+
+
+static void
+createWorkers(struct eventEngine * const engineP,
+              size_t               const stackSize,
+              const char **        const errorP) {
+
+    MALLOCARRAY(engineP->workers, engineP->workerCt);
+
+    if (engineP->workers == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate worker array");
+    else {
+        unsigned int i;
+
+        for (i = 0, *errorP = NULL; i < engineP->workerCt && !*errorP; ++i) {
+            const char * error;
+
+            ThreadCreate(&engineP->workers[i], engineP, &workerRun,
+                         &threadDone, false, stackSize, &error);
+
+            if (error) {
+                xmlrpc_asprintf(errorP, "Failed to create worker thread "
+                                "%u.  %s", i, error);
+                xmlrpc_strfree(error);
+                stopWorkers(engineP, i);
+            }
+        }
+        if (*errorP)
+            free(engineP->workers);
+    }
+}
+
+
+
+static void
+createIoThreads(struct eventEngine * const engineP,
+                const char **        const errorP) {
+
+    MALLOCARRAY(engineP->ioThreads, engineP->ioThreadCt);
+
+    if (engineP->ioThreads == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate I/O thread array");
+    else {
+        unsigned int i;
+
+        for (i = 0, *errorP = NULL; i < engineP->ioThreadCt && !*errorP;
+             ++i) {
+            const char * error;
+
+            createIoThread(engineP, &engineP->ioThreads[i], &error);
+
+            if (error) {
+                unsigned int j;
+
+                xmlrpc_asprintf(errorP, "Failed to create I/O thread "
+                                "%u.  %s", i, error);
+                xmlrpc_strfree(error);
+
+                for (j = 0; j < i; ++j) {
+                    stopIoThread(&engineP->ioThreads[j]);
+                    destroyIoThread(&engineP->ioThreads[j]);
+                }
+            }
+        }
+        if (*errorP)
+            free(engineP->ioThreads);
+    }
+}
+
+
+
+static void
+createEngine(struct eventEngine ** const enginePP,
+             TServer *             const serverP,
+             size_t                const workerStackSize,
+             const char **         const errorP) {
+
+    struct _TServer * const srvP = serverP->srvP;
+
+    struct eventEngine * engineP;
+
+    MALLOCVAR(engineP);
+
+    if (engineP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate event engine descriptor");
+    else {
+        engineP->serverP      = serverP;
+        engineP->srvP         = srvP;
+        engineP->connCount    = 0;
+        engineP->stopping     = false;
+        engineP->ioThreadCt   = srvP->eventIoThreadCt;
+        engineP->workerCt     = srvP->eventWorkerCt;
+        engineP->nextIoThread = 0;
+
+        connListInit(&engineP->queue);
+        connListInit(&engineP->busy);
+
+        pthread_mutex_init(&engineP->mutex, NULL);
+        pthread_cond_init(&engineP->workAvailable, NULL);
+        pthread_cond_init(&engineP->connFreed, NULL);
+
+        createWorkers(engineP, workerStackSize, errorP);
+
+        if (!*errorP) {
+            createIoThreads(engineP, errorP);
+
+            if (*errorP) {
+                stopWorkers(engineP, engineP->workerCt);
+                free(engineP->workers);
+            }
+        }
+        if (*errorP) {
+            pthread_cond_destroy(&engineP->connFreed);
+            pthread_cond_destroy(&engineP->workAvailable);
+            pthread_mutex_destroy(&engineP->mutex);
+            free(engineP);
+        }
+    }
+    *enginePP = engineP;
+}
+
+
+
+static void
+destroyEngine(struct eventEngine * const engineP) {
+/*----------------------------------------------------------------------------
+   Stop the engine and close every connection it has.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+
+    for (i = 0; i < engineP->ioThreadCt; ++i)
+        stopIoThread(&engineP->ioThreads[i]);
+
+    stopWorkers(engineP, engineP->workerCt);
+
+    /* Now nobody but us touches the engine */
+
+    for (i = 0; i < engineP->ioThreadCt; ++i)
+        destroyIoThread(&engineP->ioThreads[i]);
+
+    destroyConnList(engineP, &engineP->queue);
+
+    assert(engineP->busy.count == 0);
+    assert(engineP->connCount == 0);
+
+    free(engineP->ioThreads);
+    free(engineP->workers);
+
+    pthread_cond_destroy(&engineP->connFreed);
+    pthread_cond_destroy(&engineP->workAvailable);
+    pthread_mutex_destroy(&engineP->mutex);
+
+    free(engineP);
+}
+
+
+
+static void
+waitForConnCapacity(struct eventEngine * const engineP) {
+/*----------------------------------------------------------------------------
+   Wait until there are fewer than the server's maximum number of
+   connections, or the user asks the server to terminate.
+
+   Nothing tells us about the latter, so we look every second.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = engineP->srvP;
+
+    pthread_mutex_lock(&engineP->mutex);
+
+    while (engineP->connCount >= srvP->maxConn &&
+           !srvP->terminationRequested) {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+
+        pthread_cond_timedwait(&engineP->connFreed, &engineP->mutex,
+                               &deadline);
+    }
+    pthread_mutex_unlock(&engineP->mutex);
+}
+
+
+
+static void
+addChannel(struct eventEngine * const engineP,
+           TChannel *           const channelP,
+           void *               const channelInfoP,
+           const char **        const errorP) {
+
+    struct eventConn * ecP;
+
+    MALLOCVAR(ecP);
+
+    if (ecP == NULL)
+        xmlrpc_asprintf(errorP, "Could not allocate connection descriptor");
+    else {
+        TConn * connP;
+        const char * error;
+
+        /* The connection doesn't get a thread of its own, and we never call
+           ConnProcess() on it, so it doesn't need a job.
+        */
+        ConnCreate(&connP, engineP->serverP, channelP, channelInfoP,
+                   NULL, 0, NULL, ABYSS_FOREGROUND, NULL, false,
+                   &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP, "Failed to create an Abyss "
+                            "connection.  %s", error);
+            xmlrpc_strfree(error);
+            free(ecP);
+        } else {
+            *errorP = NULL;
+
+            ecP->connP         = connP;
+            ecP->fd            = ChannelPollFd(channelP);
+            ecP->requestCount  = 0;
+            ecP->headerStarted = false;
+            ecP->ioThreadP     =
+                &engineP->ioThreads[engineP->nextIoThread];
+
+            engineP->nextIoThread =
+                (engineP->nextIoThread + 1) % engineP->ioThreadCt;
+
+            pthread_mutex_lock(&engineP->mutex);
+            ++engineP->connCount;
+            pthread_mutex_unlock(&engineP->mutex);
+
+            if (ecP->fd < 0) {
+                /* We can't watch this channel, so a worker will wait for
+                   the request (and serve only one).
+                */
+                queueConn(engineP, ecP);
+            } else
+                waitForNextRequest(engineP, ecP, EPOLL_CTL_ADD);
+        }
+    }
+}
+
+
+
+static void
+acceptAndAddNextChannel(struct eventEngine * const engineP,
+                        const char **        const errorP) {
+
+    struct _TServer * const srvP = engineP->srvP;
+
+    TChannel * channelP;
+    void * channelInfoP;
+    const char * error;
+
+    waitForConnCapacity(engineP);
+
+    if (srvP->terminationRequested)
+        *errorP = NULL;
+    else {
+        ChanSwitchAccept(srvP->chanSwitchP, &channelP, &channelInfoP, &error);
+
+        if (error) {
+            xmlrpc_asprintf(errorP,
+                            "Failed to accept the next connection from a "
+                            "client at the channel level.  %s", error);
+            xmlrpc_strfree(error);
+        } else if (channelP) {
+            const char * error;
+
+            trace(srvP, "Got a new channel from channel switch");
+
+            addChannel(engineP, channelP, channelInfoP, &error);
+
+            if (error) {
+                TraceMsg("Failed to use new channel.  %s", error);
+                xmlrpc_strfree(error);
+                ChannelDestroy(channelP);
+                free(channelInfoP);
+            }
+            *errorP = NULL;
+        } else {
+            /* Accept function was interrupted before it got a connection */
+            trace(srvP, "Wait for new channel from switch was interrupted");
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
+void
+ServerEventRun(TServer *     const serverP,
+               size_t        const workerStackSize,
+               const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Accept and serve connections as ServerRun() does, but with the event
+   engine.  Return when the user asks the server to terminate, with every
+   connection closed.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = serverP->srvP;
+
+    struct eventEngine * engineP;
+    const char * error;
+
+    createEngine(&engineP, serverP, workerStackSize, &error);
+
+    if (error) {
+        xmlrpc_asprintf(errorP, "Failed to start event engine.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        trace(srvP, "Starting event-driven connection accepting loop with "
+              "%u I/O threads and %u workers",
+              engineP->ioThreadCt, engineP->workerCt);
+
+        *errorP = NULL;  /* initial value */
+
+        while (!srvP->terminationRequested && !*errorP)
+            acceptAndAddNextChannel(engineP, errorP);
+
+        trace(srvP, "Main connection accepting loop is done.  "
+              "Closing %u connections", engineP->connCount);
+
+        destroyEngine(engineP);
+    }
+}
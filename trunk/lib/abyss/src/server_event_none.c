@@ -0,0 +1,33 @@
+/*=============================================================================
+                              server_event_none
+===============================================================================
+  The event-driven connection engine for platforms that don't have one.
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+#include "bool.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+
+#include "xmlrpc-c/abyss.h"
+
+#include "server_event.h"
+
+
+
+bool
+ServerEventEngineIsAvailable(void) {
+
+    return false;
+}
+
+
+
+void
+ServerEventRun(TServer *     const serverP ATTR_UNUSED,
+               size_t        const workerStackSize ATTR_UNUSED,
+               const char ** const errorP) {
+
+    xmlrpc_asprintf(errorP, "This Abyss has no event-driven "
+                    "connection engine");
+}
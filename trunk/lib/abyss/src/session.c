@@ -18,14 +18,12 @@
 
 
 static void
-refillBuffer(TSession *    const sessionP,
-             const char ** const errorP) {
-
-    struct _TServer * const srvP = sessionP->connP->server->srvP;
-
-    /* Reset our read buffer and flush data from previous reads. */
-    ConnReadInit(sessionP->connP);
-
+sendContinueIfRequired(TSession *    const sessionP,
+                       const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   If the client is waiting for us to say "100 Continue" before it sends the
+   body, say it.
+-----------------------------------------------------------------------------*/
     *errorP = NULL;  /* initial assumption */
 
     if (sessionP->continueRequired) {
@@ -36,11 +34,26 @@ refillBuffer(TSession *    const sessionP,
                             "to the client to tell it to go ahead with "
                             "sending the body");
     }
+    if (!*errorP)
+        sessionP->continueRequired = false;
+}
+
+
+
+static void
+refillBuffer(TSession *    const sessionP,
+             const char ** const errorP) {
+
+    struct _TServer * const srvP = sessionP->connP->server->srvP;
+
+    /* Reset our read buffer and flush data from previous reads. */
+    ConnReadInit(sessionP->connP);
+
+    sendContinueIfRequired(sessionP, errorP);
+
     if (!*errorP) {
         const char * error;
 
-        sessionP->continueRequired = false;
-
         /* Read more network data into our buffer.  Fail if we time out
            before client sends any data or client closes the connection or
            there's some network error.  We're very forgiving about the
@@ -182,7 +195,7 @@ getLine(TConn *       const connectionP,
         unsigned int const usedByteCt =
             connectionP->buffersize - connectionP->bufferpos;
 
-        if (usedByteCt + 1 >= BUFFER_SIZE) {
+        if (usedByteCt + 1 >= connectionP->bufferAllocSize) {
             /* + 1 for a NUL.
 
                We don't have a full line yet, and a buffer refill won't
@@ -559,6 +572,118 @@ SessionGetBody(TSession *    const sessionP,
 
 
 
+static void
+readUnchunkedBody(TSession *    const sessionP,
+                  char *        const buffer,
+                  size_t        const len,
+                  const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Same as SessionReadBody(), but assuming the body is not chunked.
+-----------------------------------------------------------------------------*/
+    struct _TServer * const srvP = sessionP->connP->server->srvP;
+
+    const char * bufferedData;
+    size_t bytesRead;
+
+    /* Take what's already in the connection buffer first */
+    getSomeUnchunkedRequestBody(sessionP, len, &bufferedData, &bytesRead);
+
+    memcpy(buffer, bufferedData, bytesRead);
+
+    if (bytesRead < len) {
+        /* The connection buffer is empty now; the rest comes straight
+           from the channel.
+        */
+        ConnReadInit(sessionP->connP);
+
+        sendContinueIfRequired(sessionP, errorP);
+    } else
+        *errorP = NULL;
+
+    while (!*errorP && bytesRead < len) {
+        size_t bytesReadThisTime;
+
+        ConnReadDirect(sessionP->connP, srvP->timeout,
+                       &buffer[bytesRead], len - bytesRead,
+                       &bytesReadThisTime, errorP);
+
+        if (!*errorP)
+            bytesRead += bytesReadThisTime;
+    }
+}
+
+
+
+static void
+readChunkedBody(TSession *    const sessionP,
+                char *        const buffer,
+                size_t        const len,
+                const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Same as SessionReadBody(), but assuming the body is chunked.  The chunk
+   headers have to go through the connection buffer, so this is no faster
+   than SessionGetBody().
+-----------------------------------------------------------------------------*/
+    size_t bytesRead;
+    abyss_bool eof;
+
+    for (bytesRead = 0, eof = false, *errorP = NULL;
+         bytesRead < len && !eof && !*errorP; ) {
+
+        const char * chunk;
+        size_t chunkLen;
+
+        SessionGetBody(sessionP, len - bytesRead, &eof, &chunk, &chunkLen,
+                       errorP);
+
+        if (!*errorP && !eof) {
+            memcpy(&buffer[bytesRead], chunk, chunkLen);
+            bytesRead += chunkLen;
+        }
+    }
+    if (!*errorP && eof)
+        xmlrpc_asprintf(errorP, "Request body ended after %lu bytes, "
+                        "before the %lu bytes we expected",
+                        (unsigned long)bytesRead, (unsigned long)len);
+}
+
+
+
+void
+SessionReadBody(TSession *    const sessionP,
+                void *        const buffer,
+                size_t        const len,
+                const char ** const errorP) {
+/*-----------------------------------------------------------------------------
+   Read the next 'len' bytes of the HTTP request body into Caller's 'buffer',
+   waiting for them to arrive as necessary (subject to the server's timeout
+   parameters).
+
+   We take what the server has already read and buffered, then read the rest
+   from the connection straight into 'buffer', without going through the
+   session's buffer.  So this is the efficient way to get a body whose size
+   Caller knows, e.g. from the Content-length header field.
+
+   Fail if the body ends before we get 'len' bytes.
+
+   Assume the session has already received and processed the HTTP header.
+-----------------------------------------------------------------------------*/
+    if (sessionP->failureReason)
+        xmlrpc_asprintf(errorP, "The session has previously failed: %s",
+                        sessionP->failureReason);
+    else {
+        if (sessionP->requestIsChunked)
+            readChunkedBody(sessionP, buffer, len, errorP);
+        else
+            readUnchunkedBody(sessionP, buffer, len, errorP);
+
+        if (*errorP && !sessionP->failureReason)
+            sessionP->failureReason = xmlrpc_strdupsol(*errorP);
+    }
+}
+
+
+
 void
 SessionGetRequestInfo(TSession *            const sessionP,
                       const TRequestInfo ** const requestInfoPP) {
@@ -641,6 +766,7 @@ SessionInit(TSession * const sessionP,
     sessionP->connP = connectionP;
 
     sessionP->responseStarted = false;
+    sessionP->responseAborted = false;
 
     sessionP->chunkedwrite = false;
     sessionP->chunkedwritemode = false;
@@ -73,6 +73,10 @@ struct _TSession {
         /* Handler has at least started the response (i.e. called
            ResponseWriteStart())
         */
+    bool responseAborted;
+        /* Handler has given up on the response it started (i.e. called
+           ResponseAbort()), so we must not finish it.
+        */
 
     struct _TConn * connP;
 
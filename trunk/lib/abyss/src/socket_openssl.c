@@ -13,6 +13,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -21,13 +23,23 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <time.h>
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/rand.h>
+#include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
+#include "c_util.h"
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
 #include "bool.h"
 #include "mallocvar.h"
 #include "trace.h"
@@ -51,6 +63,22 @@
 #define HAVE_SSL_ERROR_WANT_ACCEPT 0
 #endif
 
+/* OpenSSL 3 replaced the HMAC_CTX in the session ticket key callback with
+   an EVP_MAC_CTX.
+*/
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+typedef EVP_MAC_CTX TicketHmacCtx;
+#else
+typedef HMAC_CTX TicketHmacCtx;
+#endif
+
+
+
+static int switchExIndex;
+    /* Index of the OpenSSL "ex_data" slot in which an SSL connection object
+       being accepted points to the channel switch that is accepting it.
+    */
+
 
 
 static void
@@ -207,33 +235,203 @@ traceCipherList(SSL * const sslP) {
 
 
 static void
-sslAccept(SSL *         const sslP,
-          const char ** const errorP) {
+deadlineSet(struct timespec * const deadlineP,
+            uint32_t          const timeoutMs) {
+
+    clock_gettime(CLOCK_MONOTONIC, deadlineP);
+
+    deadlineP->tv_sec  += timeoutMs / 1000;
+    deadlineP->tv_nsec += (timeoutMs % 1000) * 1000000;
+
+    if (deadlineP->tv_nsec >= 1000000000) {
+        ++deadlineP->tv_sec;
+        deadlineP->tv_nsec -= 1000000000;
+    }
+}
+
+
+
+static int
+pollTimeout(uint32_t                const timeoutMs,
+            const struct timespec * const deadlineP) {
+/*----------------------------------------------------------------------------
+   The poll() timeout argument to wait until *deadlineP, which is
+   'timeoutMs' after some start time.  timeoutMs == TIME_INFINITE means
+   forever.
+-----------------------------------------------------------------------------*/
+    int retval;
+
+    if (timeoutMs == TIME_INFINITE)
+        retval = -1;
+    else {
+        struct timespec now;
+        int64_t leftMs;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        leftMs = (int64_t)(deadlineP->tv_sec - now.tv_sec) * 1000 +
+            (deadlineP->tv_nsec - now.tv_nsec + 999999) / 1000000;
+
+        retval = leftMs > 0 ? (int)leftMs : 0;
+    }
+    return retval;
+}
+
+
 
+static short
+pollEventsWanted(int const resultCode) {
+/*----------------------------------------------------------------------------
+   The poll() events on the socket for which OpenSSL is waiting, given the
+   SSL_get_error() result code of a call that did not succeed.  0 if it
+   isn't waiting -- the call failed for real.
+-----------------------------------------------------------------------------*/
+    switch (resultCode) {
+    case SSL_ERROR_WANT_READ:  return POLLIN;
+    case SSL_ERROR_WANT_WRITE: return POLLOUT;
+    default:                   return 0;
+    }
+}
+
+
+
+static void
+waitForSocket(int                    const fd,
+              short                  const events,
+              sockutil_InterruptPipe const interruptPipe,
+              int                    const timeoutMs,
+              short *                const reventsP,
+              bool *                 const failedP) {
+/*----------------------------------------------------------------------------
+   Wait for any of poll() events 'events' on socket 'fd', but no longer than
+   'timeoutMs' milliseconds (-1 means forever).
+
+   Stop waiting if someone sends a byte through 'interruptPipe' (or has sent
+   one before) or a (caught) signal arrives.
+
+   Return as *reventsP the events that happened, including error and hangup,
+   which the next OpenSSL call will report.  0 means we stopped waiting for
+   one of the other reasons.
+-----------------------------------------------------------------------------*/
+    struct pollfd pollfds[2];
     int rc;
 
-    if (SwitchTraceIsActive)
-        traceCipherList(sslP);
+    pollfds[0].fd = fd;
+    pollfds[0].events = events;
 
-    rc = SSL_accept(sslP);
+    pollfds[1].fd = interruptPipe.interrupteeFd;
+    pollfds[1].events = POLLIN;
 
-    if (rc == 1)
-        *errorP = NULL;
+    rc = poll(pollfds, ARRAY_SIZE(pollfds), timeoutMs);
+
+    if (rc < 0) {
+        *failedP  = errno != EINTR;
+        *reventsP = 0;
+    } else {
+        *failedP  = false;
+        *reventsP = pollfds[1].revents ? 0 : pollfds[0].revents;
+    }
+}
+
+
+
+static void
+setNonBlocking(int           const fd,
+               int *         const oldFlagsP,
+               const char ** const errorP) {
+
+    int const flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        xmlrpc_asprintf(errorP, "Failed to make socket %d nonblocking.  "
+                        "fcntl() failed with errno %d (%s)",
+                        fd, errno, strerror(errno));
     else {
-        int const resultCode = SSL_get_error(sslP, rc);
+        if (oldFlagsP)
+            *oldFlagsP = flags;
+        *errorP = NULL;
+    }
+}
 
-        const char * const errorStack = sslErrorMsg();
 
-        xmlrpc_asprintf(errorP, "SSL_accept() failed.  rc=%d/%d: %s.  "
-                        "OpenSSL error stack: %s\n",
-                        rc, resultCode, sslResultMsg(resultCode), errorStack);
 
-        xmlrpc_strfree(errorStack);
+static void
+sslHandshake(SSL *                   const sslP,
+             int                     const fd,
+             sockutil_InterruptPipe  const interruptPipe,
+             uint32_t                const timeoutMs,
+             const struct timespec * const deadlineP,
+             bool *                  const doneP,
+             const char **           const errorP) {
+/*----------------------------------------------------------------------------
+   Do as much of the TLS handshake on 'sslP' as the peer lets us before
+   *deadlineP, which is 'timeoutMs' after some start time (TIME_INFINITE
+   means never).  Return *doneP == true iff the handshake is complete.
+
+   The socket is nonblocking, so OpenSSL never waits in it; we do.  Running
+   out of time, or someone interrupting us through 'interruptPipe', just
+   leaves the handshake for another try.  Only a handshake that fails for
+   real is an error.
+-----------------------------------------------------------------------------*/
+    bool waitOver;
+
+    *doneP  = false;
+    *errorP = NULL;
+
+    for (waitOver = false; !*doneP && !waitOver && !*errorP; ) {
+        int rc;
+
+        ERR_clear_error();
+
+        rc = SSL_do_handshake(sslP);
+
+        if (rc == 1)
+            *doneP = true;
+        else {
+            int const resultCode = SSL_get_error(sslP, rc);
+            short const events = pollEventsWanted(resultCode);
+
+            if (events) {
+                short revents;
+                bool failed;
+
+                waitForSocket(fd, events, interruptPipe,
+                              pollTimeout(timeoutMs, deadlineP),
+                              &revents, &failed);
+
+                if (failed)
+                    xmlrpc_asprintf(errorP, "Wait for peer during TLS "
+                                    "handshake failed.  errno=%d (%s)",
+                                    errno, strerror(errno));
+                else if (!revents)
+                    /* Timeout, interruption, or signal */
+                    waitOver = true;
+            } else {
+                const char * const errorStack = sslErrorMsg();
+
+                xmlrpc_asprintf(errorP, "SSL_do_handshake() failed.  "
+                                "rc=%d/%d: %s.  "
+                                "OpenSSL error stack: %s\n",
+                                rc, resultCode, sslResultMsg(resultCode),
+                                errorStack);
+
+                xmlrpc_strfree(errorStack);
+            }
+        }
     }
 }
 
 
 
+struct ChanSwitchOpenSsl;
+
+static void
+countHandshake(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+               SSL *                      const sslP,
+               bool                       const failed);
+
+
+
 struct ChannelOpenSsl {
 /*----------------------------------------------------------------------------
    The properties/state of a TChannel unique to the OpenSSL variety.
@@ -245,6 +443,19 @@ struct ChannelOpenSsl {
         /* SSL connection handle */
     bool userSuppliedSsl;
         /* The SSL connection belongs to the user; we did not create it. */
+    int userFdFlags;
+        /* The file status flags (fcntl(F_GETFL)) of the socket before we
+           made it nonblocking.  Meaningful only if 'userSuppliedSsl'.
+        */
+    sockutil_InterruptPipe interruptPipe;
+        /* We use this to interrupt a wait for the client */
+    bool handshakeDone;
+        /* The TLS handshake is complete */
+    struct ChanSwitchOpenSsl * chanSwitchOpenSslP;
+        /* The channel switch that accepted the connection, which counts
+           how its handshake went.  NULL if we didn't get the connection
+           from a switch or have told the switch already.
+        */
 };
 
 
@@ -256,7 +467,13 @@ SocketOpenSslInit(const char ** const errorP) {
         /* readable error messages, don't call this if memory is tight */
 	SSL_library_init();   /* initialize library */
 
-	*errorP = NULL;
+    switchExIndex = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+
+    if (switchExIndex < 0)
+        xmlrpc_asprintf(errorP, "Failed to get an OpenSSL ex_data index "
+                        "for connection objects");
+    else
+        *errorP = NULL;
 }
 
 
@@ -274,6 +491,86 @@ SocketOpenSslTerm(void) {
       TChannel
 =============================================================================*/
 
+static void
+reportHandshake(struct ChannelOpenSsl * const channelOpenSslP,
+                bool                    const failed) {
+/*----------------------------------------------------------------------------
+   Tell the switch that accepted the connection, if we haven't already, how
+   the handshake went.
+-----------------------------------------------------------------------------*/
+    if (channelOpenSslP->chanSwitchOpenSslP) {
+        countHandshake(channelOpenSslP->chanSwitchOpenSslP,
+                       channelOpenSslP->sslP, failed);
+
+        SSL_set_ex_data(channelOpenSslP->sslP, switchExIndex, NULL);
+
+        channelOpenSslP->chanSwitchOpenSslP = NULL;
+    }
+}
+
+
+
+static void
+completeHandshake(struct ChannelOpenSsl * const channelOpenSslP,
+                  uint32_t                const timeoutMs,
+                  const struct timespec * const deadlineP,
+                  bool *                  const failedP) {
+/*----------------------------------------------------------------------------
+   Finish the TLS handshake if it isn't finished yet, waiting no longer
+   than sslHandshake() does.  Caller can tell from
+   channelOpenSslP->handshakeDone whether it is finished.
+
+   The channel switch doesn't do the handshake when it accepts the
+   connection, because then one client that is slow about it would keep
+   the switch from accepting anyone else.  Instead, the connection does it
+   on its first read, write or wait, in its own thread and under its own
+   timeout.
+-----------------------------------------------------------------------------*/
+    *failedP = false;
+
+    if (!channelOpenSslP->handshakeDone) {
+        const char * error;
+
+        sslHandshake(channelOpenSslP->sslP, channelOpenSslP->fd,
+                     channelOpenSslP->interruptPipe, timeoutMs, deadlineP,
+                     &channelOpenSslP->handshakeDone, &error);
+
+        if (error) {
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss channel: TLS handshake failed.  %s\n",
+                        error);
+            xmlrpc_strfree(error);
+
+            reportHandshake(channelOpenSslP, true);
+
+            *failedP = true;
+        } else if (channelOpenSslP->handshakeDone)
+            reportHandshake(channelOpenSslP, false);
+    }
+}
+
+
+
+static void
+completeHandshakeForIo(struct ChannelOpenSsl * const channelOpenSslP,
+                       bool *                  const failedP) {
+/*----------------------------------------------------------------------------
+   Finish the TLS handshake before a read or write.  Like the read or write
+   itself, we wait as long as it takes, but we can be interrupted, which
+   makes the read or write fail.
+-----------------------------------------------------------------------------*/
+    struct timespec deadline;
+
+    deadlineSet(&deadline, 0);
+
+    completeHandshake(channelOpenSslP, TIME_INFINITE, &deadline, failedP);
+
+    if (!channelOpenSslP->handshakeDone)
+        *failedP = true;
+}
+
+
+
 static ChannelDestroyImpl channelDestroy;
 
 static void
@@ -281,14 +578,87 @@ channelDestroy(TChannel * const channelP) {
 
     struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
 
-    if (!channelOpenSslP->userSuppliedSsl)
-        SSL_shutdown(channelOpenSslP->sslP);
+    /* A handshake the client never finished counts as a failed one */
+    reportHandshake(channelOpenSslP, true);
+
+    sockutil_interruptPipeTerm(channelOpenSslP->interruptPipe);
 
+    if (channelOpenSslP->userSuppliedSsl)
+        fcntl(channelOpenSslP->fd, F_SETFL, channelOpenSslP->userFdFlags);
+    else {
+        if (channelOpenSslP->handshakeDone)
+            SSL_shutdown(channelOpenSslP->sslP);
+        SSL_free(channelOpenSslP->sslP);
+        close(channelOpenSslP->fd);
+    }
     free(channelOpenSslP);
 }
 
 
 
+static void
+sslWrite(struct ChannelOpenSsl * const channelOpenSslP,
+         const unsigned char *   const buffer,
+         uint32_t                const len,
+         bool *                  const failedP) {
+
+    unsigned int bytesLeft;
+    bool error;
+
+    assert(sizeof(int) >= sizeof(len));
+
+    completeHandshakeForIo(channelOpenSslP, &error);
+
+    for (bytesLeft = len; bytesLeft > 0 && !error; ) {
+        uint32_t const maxSend = (uint32_t)(-1) >> 1;
+
+        int rc;
+
+        ERR_clear_error();
+
+        /* If this doesn't go through because the socket won't take it yet,
+           OpenSSL requires us to try again with the same arguments, which
+           we do.
+        */
+        rc = SSL_write(channelOpenSslP->sslP, &buffer[len-bytesLeft],
+                       MIN(maxSend, bytesLeft));
+
+        if (rc > 0) {
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss socket: sent %u bytes: '%.*s'\n",
+                        rc, rc, &buffer[len-bytesLeft]);
+
+            bytesLeft -= rc;
+        } else {
+            int const resultCode = SSL_get_error(channelOpenSslP->sslP, rc);
+            short const events = pollEventsWanted(resultCode);
+
+            short revents;
+            bool failed;
+
+            if (events)
+                /* Like a blocking send(), we wait as long as it takes, but
+                   we can be interrupted.
+                */
+                waitForSocket(channelOpenSslP->fd, events,
+                              channelOpenSslP->interruptPipe, -1,
+                              &revents, &failed);
+
+            if (!events || failed || !revents) {
+                if (ChannelTraceIsActive)
+                    fprintf(stderr,
+                            "Abyss socket: SSL_write() failed.  rc=%d/%d",
+                            rc, resultCode);
+                /* 0 means connection closed; < 0 means severe error */
+                error = true;
+            }
+        }
+    }
+    *failedP = error;
+}
+
+
+
 static ChannelWriteImpl channelWrite;
 
 #pragma GCC diagnostic push
@@ -301,37 +671,80 @@ channelWrite(TChannel *            const channelP,
              TChanWriteExpect      const expectation,
              bool *                const failedP) {
 
-    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+    sslWrite(channelP->implP, buffer, len, failedP);
+}
+#pragma GCC diagnostic pop
 
-    unsigned int bytesLeft;
-    bool error;
 
-    assert(sizeof(int) >= sizeof(len));
 
-    for (bytesLeft = len, error = false; bytesLeft > 0 && !error; ) {
-        uint32_t const maxSend = (uint32_t)(-1) >> 1;
+#define SSL_RECORD_SIZE 16384
+    /* Most plaintext one TLS record carries */
 
-        int rc;
+static ChannelWritevImpl channelWritev;
 
-        rc = SSL_write(channelOpenSslP->sslP, &buffer[len-bytesLeft],
-                       MIN(maxSend, bytesLeft));
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
 
-        if (ChannelTraceIsActive) {
-            if (rc <= 0)
-                fprintf(stderr,
-                        "Abyss socket: SSL_write() failed.  rc=%d/%d",
-                        rc, SSL_get_error(channelOpenSslP->sslP, rc));
-            else
-                fprintf(stderr, "Abyss socket: sent %u bytes: '%.*s'\n",
-                        rc, rc, &buffer[len-bytesLeft]);
+static void
+channelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              TChanWriteExpect      const expectation,
+              bool *                const failedP) {
+/*----------------------------------------------------------------------------
+   OpenSSL has no scatter-gather write, and each SSL_write() makes at least
+   one TLS record and one write to the socket.  So we pack the pieces into
+   full records' worth and SSL_write() those.  Where a piece is more than a
+   record by itself, we SSL_write() whole records of it straight from
+   Caller's buffer.
+-----------------------------------------------------------------------------*/
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+
+    unsigned char * const batch = malloc(SSL_RECORD_SIZE);
+
+    if (!batch) {
+        unsigned int i;
+
+        for (i = 0, *failedP = false; i < iovCt && !*failedP; ++i)
+            sslWrite(channelOpenSslP, iov[i].buffer, iov[i].len, failedP);
+    } else {
+        uint32_t fill;
+            /* Number of bytes in batch[] */
+        unsigned int i;
+        bool error;
+
+        for (i = 0, fill = 0, error = false; i < iovCt && !error; ++i) {
+            const unsigned char * p;
+            uint32_t left;
+
+            for (p = iov[i].buffer, left = iov[i].len; left > 0 && !error; ) {
+                if (fill == 0 && left >= SSL_RECORD_SIZE) {
+                    uint32_t const directLen =
+                        left - left % SSL_RECORD_SIZE;
+
+                    sslWrite(channelOpenSslP, p, directLen, &error);
+                    p += directLen; left -= directLen;
+                } else {
+                    uint32_t const copyLen =
+                        MIN(left, SSL_RECORD_SIZE - fill);
+
+                    memcpy(&batch[fill], p, copyLen);
+                    fill += copyLen; p += copyLen; left -= copyLen;
+
+                    if (fill == SSL_RECORD_SIZE) {
+                        sslWrite(channelOpenSslP, batch, fill, &error);
+                        fill = 0;
+                    }
+                }
+            }
         }
-        if (rc <= 0)
-            /* 0 means connection closed; < 0 means severe error */
-            error = true;
-        else
-            bytesLeft -= rc;
+        if (fill > 0 && !error)
+            sslWrite(channelOpenSslP, batch, fill, &error);
+
+        *failedP = error;
+
+        free(batch);
     }
-    *failedP = error;
 }
 #pragma GCC diagnostic pop
 
@@ -345,26 +758,91 @@ channelRead(TChannel *      const channelP,
             uint32_t        const bufferSize,
             uint32_t *      const bytesReceivedP,
             bool *          const failedP) {
-
+/*----------------------------------------------------------------------------
+   Callers normally use channelWait() first, so there is plaintext for us to
+   get right away.  Where there isn't, we wait for it the way a read from a
+   blocking socket would, except that we can be interrupted.
+-----------------------------------------------------------------------------*/
     struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
 
-    int rc;
-    rc = SSL_read(channelOpenSslP->sslP, buffer, bufferSize);
+    bool done;
 
-    if (rc < 0) {
-        *failedP = true;
-        if (ChannelTraceIsActive)
-            fprintf(stderr, "Failed to receive data from OpenSSL connection.  "
-                    "SSL_read() failed with rc %d/%d\n",
-                    rc, SSL_get_error(channelOpenSslP->sslP, rc));
-    } else {
-        *failedP = false;
-        *bytesReceivedP = rc;
+    completeHandshakeForIo(channelOpenSslP, failedP);
+
+    for (done = *failedP; !done; ) {
+        int rc;
+
+        ERR_clear_error();
+
+        rc = SSL_read(channelOpenSslP->sslP, buffer, bufferSize);
+
+        if (rc > 0) {
+            *bytesReceivedP = rc;
+            done = true;
+
+            if (ChannelTraceIsActive)
+                fprintf(stderr, "Abyss channel: read %u bytes: '%.*s'\n",
+                        *bytesReceivedP, (int)(*bytesReceivedP), buffer);
+        } else {
+            int const resultCode = SSL_get_error(channelOpenSslP->sslP, rc);
+            short const events = pollEventsWanted(resultCode);
+
+            if (events) {
+                short revents;
+                bool failed;
+
+                waitForSocket(channelOpenSslP->fd, events,
+                              channelOpenSslP->interruptPipe, -1,
+                              &revents, &failed);
+
+                if (failed || !revents) {
+                    *failedP = true;
+                    done = true;
+                }
+            } else if (rc == 0 || resultCode == SSL_ERROR_ZERO_RETURN) {
+                /* Client closed the connection */
+                *bytesReceivedP = 0;
+                done = true;
+            } else {
+                *failedP = true;
+                done = true;
+            }
+            if (*failedP && ChannelTraceIsActive)
+                fprintf(stderr, "Failed to receive data from OpenSSL "
+                        "connection.  SSL_read() failed with rc %d/%d\n",
+                        rc, resultCode);
+        }
+    }
+}
+
+
+
+static short
+sslPlaintextWants(SSL * const sslP) {
+/*----------------------------------------------------------------------------
+   The poll() events for which OpenSSL must wait on the socket before it can
+   give us a byte of plaintext, or 0 if it can give us one now -- or tell us
+   of end of stream or an error, which a reader wants to know just as
+   promptly.
 
-        if (ChannelTraceIsActive)
-            fprintf(stderr, "Abyss channel: read %u bytes: '%.*s'\n",
-                    *bytesReceivedP, (int)(*bytesReceivedP), buffer);
+   We have OpenSSL read and process whatever it can from the socket to find
+   out.
+-----------------------------------------------------------------------------*/
+    short retval;
+
+    if (SSL_pending(sslP) > 0)
+        retval = 0;
+    else {
+        unsigned char byte;
+        int rc;
+
+        ERR_clear_error();
+
+        rc = SSL_peek(sslP, &byte, 1);
+
+        retval = rc > 0 ? 0 : pollEventsWanted(SSL_get_error(sslP, rc));
     }
+    return retval;
 }
 
 
@@ -372,27 +850,78 @@ channelRead(TChannel *      const channelP,
 static ChannelWaitImpl channelWait;
 
 static void
-channelWait(TChannel * const channelP ATTR_UNUSED,
-            bool       const waitForRead ATTR_UNUSED,
-            bool       const waitForWrite ATTR_UNUSED,
-            uint32_t   const timeoutMs ATTR_UNUSED,
+channelWait(TChannel * const channelP,
+            bool       const waitForRead,
+            bool       const waitForWrite,
+            uint32_t   const timeoutMs,
             bool *     const readyToReadP,
             bool *     const readyToWriteP,
             bool *     const failedP) {
 /*----------------------------------------------------------------------------
-  See socket_unix.c for an explanation of the purpose of this
-  subroutine.
+   See socket_unix.c for an explanation of the purpose of this
+   subroutine.
 
-  We don't actually fulfill that purpose, though, because we don't know
-  how yet.  Instead, we return immediately and hope that if Caller
-  subsequently does a read or write, it blocks until it can do its thing.
+   Readable here means OpenSSL has plaintext for us, which is more than
+   the socket being readable: the socket may have only part of a TLS record,
+   or only TLS protocol traffic.  So each time the socket has something, we
+   let OpenSSL process it and then wait for whatever OpenSSL says it wants
+   next, until it has plaintext or the time is up.
+
+   Neither can happen before the TLS handshake is done, so if it isn't, we
+   start by finishing it, within the same time limit.
 -----------------------------------------------------------------------------*/
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+
+    struct timespec deadline;
+    bool readyToRead, readyToWrite, failed;
+    bool done;
+
+    deadlineSet(&deadline, timeoutMs == TIME_INFINITE ? 0 : timeoutMs);
+
+    readyToRead  = false;
+    readyToWrite = false;
+
+    completeHandshake(channelOpenSslP, timeoutMs, &deadline, &failed);
+
+    for (done = failed || !channelOpenSslP->handshakeDone; !done; ) {
+        short events;
+
+        events = waitForWrite ? POLLOUT : 0;
+
+        if (waitForRead) {
+            short const sslWants = sslPlaintextWants(channelOpenSslP->sslP);
+
+            if (sslWants)
+                events |= sslWants;
+            else
+                readyToRead = true;
+        }
+        if (readyToRead)
+            done = true;
+        else {
+            short revents;
+
+            waitForSocket(channelOpenSslP->fd, events,
+                          channelOpenSslP->interruptPipe,
+                          pollTimeout(timeoutMs, &deadline),
+                          &revents, &failed);
+
+            if (failed || !revents)
+                /* Failure, timeout, interruption, or signal */
+                done = true;
+            else if (waitForWrite && (revents & (POLLOUT | POLLERR | POLLHUP))) {
+                readyToWrite = true;
+                done = true;
+            }
+            /* Otherwise, OpenSSL has more to read; go let it */
+        }
+    }
+    if (failedP)
+        *failedP       = failed;
     if (readyToReadP)
-        *readyToReadP = true;
+        *readyToReadP  = readyToRead;
     if (readyToWriteP)
-        *readyToWriteP = true;
-    if (failedP)
-        *failedP = false;
+        *readyToWriteP = readyToWrite;
 }
 
 
@@ -400,13 +929,17 @@ channelWait(TChannel * const channelP ATTR_UNUSED,
 static ChannelInterruptImpl channelInterrupt;
 
 static void
-channelInterrupt(TChannel * const channelP ATTR_UNUSED) {
+channelInterrupt(TChannel * const channelP) {
 /*----------------------------------------------------------------------------
   Interrupt any waiting that a thread might be doing in channelWait()
   now or in the future.
+
+  TODO: Make a way to reset this so that future channelWait()s can once
+  again wait.
 -----------------------------------------------------------------------------*/
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
 
-    /* This is trivial, since channelWait() doesn't actually wait */
+    sockutil_interruptPipeInterrupt(channelOpenSslP->interruptPipe);
 }
 
 
@@ -424,6 +957,33 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelPollFdImpl channelPollFd;
+
+static int
+channelPollFd(TChannel * const channelP) {
+
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+
+    return channelOpenSslP->fd;
+}
+
+
+
+static ChannelReadPendingImpl channelReadPending;
+
+static bool
+channelReadPending(TChannel * const channelP) {
+/*----------------------------------------------------------------------------
+   OpenSSL has plaintext left from a record it has already taken off the
+   socket.
+-----------------------------------------------------------------------------*/
+    struct ChannelOpenSsl * const channelOpenSslP = channelP->implP;
+
+    return SSL_pending(channelOpenSslP->sslP) > 0;
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
@@ -431,6 +991,10 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    &channelPollFd,
+    &channelWritev,
+    &channelReadPending,
+    NULL,  /* sendFile: everything must go through the TLS layer */
 };
 
 
@@ -496,11 +1060,18 @@ makeChannelInfo(struct abyss_openSsl_chaninfo ** const channelInfoPP,
 
 
 static void
-makeChannelFromSsl(SSL *         const sslP,
-                   bool          const userSuppliedSsl,
-                   TChannel **   const channelPP,
-                   const char ** const errorP) {
+makeChannelFromSsl(SSL *                      const sslP,
+                   bool                       const userSuppliedSsl,
+                   struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                   TChannel **                const channelPP,
+                   const char **              const errorP) {
+/*----------------------------------------------------------------------------
+   Make a channel for the SSL connection 'sslP', which may or may not have
+   done its handshake yet.
 
+   'chanSwitchOpenSslP' is the channel switch that accepted the connection,
+   which is to count its handshake, or NULL if it didn't come from a switch.
+-----------------------------------------------------------------------------*/
     struct ChannelOpenSsl * channelOpenSslP;
 
     MALLOCVAR(channelOpenSslP);
@@ -509,20 +1080,40 @@ makeChannelFromSsl(SSL *         const sslP,
         xmlrpc_asprintf(errorP, "Unable to allocate memory for OpenSSL "
                         "socket descriptor");
     else {
-        TChannel * channelP;
-
         channelOpenSslP->sslP = sslP;
         channelOpenSslP->userSuppliedSsl = userSuppliedSsl;
+        channelOpenSslP->fd = SSL_get_fd(sslP);
+        channelOpenSslP->handshakeDone = SSL_is_init_finished(sslP);
+        channelOpenSslP->chanSwitchOpenSslP = chanSwitchOpenSslP;
 
-        /* This should be ok as far as I can tell */
-        ChannelCreate(&channelVtbl, channelOpenSslP, &channelP);
+        /* We wait for the socket ourselves, so that we can time out and
+           be interrupted; OpenSSL must never block in it.
+        */
+        setNonBlocking(channelOpenSslP->fd, &channelOpenSslP->userFdFlags,
+                       errorP);
 
-        if (channelP == NULL)
-            xmlrpc_asprintf(errorP, "Unable to allocate memory for "
-                            "channel descriptor.");
-        else {
-            *channelPP = channelP;
-            *errorP = NULL;
+        if (!*errorP) {
+            sockutil_interruptPipeInit(&channelOpenSslP->interruptPipe,
+                                       errorP);
+
+            if (!*errorP) {
+                TChannel * channelP;
+
+                ChannelCreate(&channelVtbl, channelOpenSslP, &channelP);
+
+                if (channelP == NULL)
+                    xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                                    "channel descriptor.");
+                else
+                    *channelPP = channelP;
+
+                if (*errorP)
+                    sockutil_interruptPipeTerm(
+                        channelOpenSslP->interruptPipe);
+            }
+            if (*errorP && userSuppliedSsl)
+                fcntl(channelOpenSslP->fd, F_SETFL,
+                      channelOpenSslP->userFdFlags);
         }
         if (*errorP)
             free(channelOpenSslP);
@@ -543,7 +1134,7 @@ ChannelOpenSslCreateSsl(SSL *                            const sslP,
     if (!*errorP) {
         bool const userSuppliedTrue = true;
 
-        makeChannelFromSsl(sslP, userSuppliedTrue, channelPP, errorP);
+        makeChannelFromSsl(sslP, userSuppliedTrue, NULL, channelPP, errorP);
 
         if (*errorP) {
             free(*channelInfoPP);
@@ -557,6 +1148,24 @@ ChannelOpenSslCreateSsl(SSL *                            const sslP,
       TChanSwitch
 =============================================================================*/
 
+#define TICKET_KEY_CT 3
+    /* Number of session ticket keys we keep: the one we issue tickets
+       under and the ones before it, which we still accept.
+    */
+
+struct TicketKey {
+    bool exists;
+        /* This slot contains a key.  The others members are meaningful only
+           if it does.
+        */
+    unsigned char name[16];
+        /* What the ticket says about which key it is under */
+    unsigned char aesKey[32];
+    unsigned char hmacKey[32];
+    time_t birth;
+        /* When we started issuing tickets under this key */
+};
+
 struct ChanSwitchOpenSsl {
 /*----------------------------------------------------------------------------
    The properties/state of a TChanSwitch uniqe to the OpenSSL variety.
@@ -579,10 +1188,244 @@ struct ChanSwitchOpenSsl {
 
     sockutil_InterruptPipe interruptPipe;
         /* We use this to interrupt a wait for the next client to arrive */
+
+    struct lock * lockP;
+        /* Protects the ticket keys and 'stats', which accepts in multiple
+           threads may use at once
+        */
+    unsigned int ticketKeyLifetime;
+        /* Seconds we issue tickets under one key.  0 means we issue no
+           tickets.
+        */
+    struct TicketKey ticketKeys[TICKET_KEY_CT];
+    unsigned int curTicketKey;
+        /* Index in 'ticketKeys' of the key under which we issue tickets */
+    struct abyss_openSsl_handshakestats stats;
 };
 
 
 
+/*=============================================================================
+      Session tickets
+===============================================================================
+  A session ticket is the session state, encrypted and authenticated under a
+  key only we know, which we give to the client so that the client can hand
+  it back later to resume the session without our having to remember it.
+
+  We keep a small ring of keys: we issue tickets under the newest one and
+  replace the oldest one with a fresh random key when the newest one has been
+  in use for the switch's ticket key lifetime.  So a stolen key is good only
+  for a few lifetimes, and a client holding a ticket issued under a retired
+  key still gets to resume (and gets a new ticket).
+=============================================================================*/
+
+
+
+static void
+ticketKeyGenerate(struct TicketKey * const keyP,
+                  time_t             const now) {
+
+    keyP->exists =
+        RAND_bytes(keyP->name,    sizeof(keyP->name))    == 1 &&
+        RAND_bytes(keyP->aesKey,  sizeof(keyP->aesKey))  == 1 &&
+        RAND_bytes(keyP->hmacKey, sizeof(keyP->hmacKey)) == 1;
+
+    keyP->birth = now;
+}
+
+
+
+static const struct TicketKey *
+currentTicketKey(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                 time_t                     const now) {
+/*----------------------------------------------------------------------------
+   The key under which to issue a ticket now, rotating keys if it is time.
+   NULL if we can't make a key.
+-----------------------------------------------------------------------------*/
+    struct TicketKey * curKeyP;
+
+    curKeyP = &chanSwitchOpenSslP->ticketKeys[chanSwitchOpenSslP->curTicketKey];
+
+    if (!curKeyP->exists ||
+        now - curKeyP->birth >= chanSwitchOpenSslP->ticketKeyLifetime) {
+
+        unsigned int const newKey =
+            (chanSwitchOpenSslP->curTicketKey + 1) % TICKET_KEY_CT;
+        struct TicketKey * const newKeyP =
+            &chanSwitchOpenSslP->ticketKeys[newKey];
+
+        ticketKeyGenerate(newKeyP, now);
+
+        if (newKeyP->exists) {
+            chanSwitchOpenSslP->curTicketKey = newKey;
+            curKeyP = newKeyP;
+        }
+    }
+    return curKeyP->exists ? curKeyP : NULL;
+}
+
+
+
+static const struct TicketKey *
+ticketKeyByName(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                const unsigned char *      const name,
+                time_t                     const now) {
+/*----------------------------------------------------------------------------
+   The key named 'name', if we still accept tickets issued under it; NULL
+   otherwise.
+
+   Rotation normally retires a key, but if no one has connected for a while
+   there has been nothing to rotate, so we check its age too.
+-----------------------------------------------------------------------------*/
+    const struct TicketKey * retval;
+    unsigned int i;
+
+    for (i = 0, retval = NULL; i < TICKET_KEY_CT && !retval; ++i) {
+        const struct TicketKey * const keyP =
+            &chanSwitchOpenSslP->ticketKeys[i];
+
+        if (keyP->exists &&
+            memcmp(keyP->name, name, sizeof(keyP->name)) == 0 &&
+            now - keyP->birth <
+            (time_t)TICKET_KEY_CT * chanSwitchOpenSslP->ticketKeyLifetime)
+            retval = keyP;
+    }
+    return retval;
+}
+
+
+
+static bool
+ticketHmacInit(TicketHmacCtx *          const hmacCtxP,
+               const struct TicketKey * const keyP) {
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+    OSSL_PARAM parms[3];
+
+    parms[0] = OSSL_PARAM_construct_octet_string(
+        OSSL_MAC_PARAM_KEY, (void *)keyP->hmacKey, sizeof(keyP->hmacKey));
+    parms[1] = OSSL_PARAM_construct_utf8_string(
+        OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+    parms[2] = OSSL_PARAM_construct_end();
+
+    return EVP_MAC_CTX_set_params(hmacCtxP, parms) == 1;
+#else
+    return HMAC_Init_ex(hmacCtxP, keyP->hmacKey, sizeof(keyP->hmacKey),
+                        EVP_sha256(), NULL) == 1;
+#endif
+}
+
+
+
+static int
+issueTicket(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+            unsigned char *            const keyName,
+            unsigned char *            const iv,
+            EVP_CIPHER_CTX *           const cipherCtxP,
+            TicketHmacCtx *            const hmacCtxP) {
+
+    const struct TicketKey * const keyP =
+        currentTicketKey(chanSwitchOpenSslP, time(NULL));
+
+    int retval;
+
+    if (!keyP)
+        retval = 0;
+    else if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+        retval = 0;
+    else {
+        memcpy(keyName, keyP->name, sizeof(keyP->name));
+
+        if (EVP_EncryptInit_ex(cipherCtxP, EVP_aes_256_cbc(), NULL,
+                               keyP->aesKey, iv) != 1)
+            retval = -1;
+        else
+            retval = ticketHmacInit(hmacCtxP, keyP) ? 1 : -1;
+    }
+    return retval;
+}
+
+
+
+static int
+acceptTicket(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+             const unsigned char *      const keyName,
+             const unsigned char *      const iv,
+             EVP_CIPHER_CTX *           const cipherCtxP,
+             TicketHmacCtx *            const hmacCtxP) {
+
+    time_t const now = time(NULL);
+
+    const struct TicketKey * const curKeyP =
+        currentTicketKey(chanSwitchOpenSslP, now);
+        /* We rotate here too so that a ticket under a key that should have
+           been rotated out gets renewed.
+        */
+    const struct TicketKey * const keyP =
+        ticketKeyByName(chanSwitchOpenSslP, keyName, now);
+
+    int retval;
+
+    if (!keyP)
+        retval = 0;  /* Unknown or retired key: do a full handshake */
+    else if (!ticketHmacInit(hmacCtxP, keyP))
+        retval = -1;
+    else if (EVP_DecryptInit_ex(cipherCtxP, EVP_aes_256_cbc(), NULL,
+                                keyP->aesKey, iv) != 1)
+        retval = -1;
+    else {
+        /* 2 tells OpenSSL to issue a new ticket, under the current key */
+        retval = keyP == curKeyP ? 1 : 2;
+    }
+    return retval;
+}
+
+
+
+static int
+ticketKeyCallback(SSL *            const sslP,
+                  unsigned char *  const keyName,
+                  unsigned char *  const iv,
+                  EVP_CIPHER_CTX * const cipherCtxP,
+                  TicketHmacCtx *  const hmacCtxP,
+                  int              const enc) {
+/*----------------------------------------------------------------------------
+   This is an OpenSSL session ticket key callback.
+
+   We get the switch from the connection object.  Any connection that one
+   of our switches did not accept, or whose handshake is over, gets no
+   ticket and has its tickets ignored.
+-----------------------------------------------------------------------------*/
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP =
+        SSL_get_ex_data(sslP, switchExIndex);
+
+    int retval;
+
+    if (!chanSwitchOpenSslP || chanSwitchOpenSslP->ticketKeyLifetime == 0)
+        retval = 0;
+    else {
+        chanSwitchOpenSslP->lockP->acquire(chanSwitchOpenSslP->lockP);
+
+        if (enc)
+            retval = issueTicket(chanSwitchOpenSslP,
+                                 keyName, iv, cipherCtxP, hmacCtxP);
+        else
+            retval = acceptTicket(chanSwitchOpenSslP,
+                                  keyName, iv, cipherCtxP, hmacCtxP);
+
+        chanSwitchOpenSslP->lockP->release(chanSwitchOpenSslP->lockP);
+    }
+    return retval;
+}
+
+
+
+/*=============================================================================
+      TChanSwitch methods
+=============================================================================*/
+
+
+
 static SwitchDestroyImpl chanSwitchDestroy;
 
 static void
@@ -595,6 +1438,8 @@ chanSwitchDestroy(TChanSwitch * const chanSwitchP) {
     if (!chanSwitchOpenSslP->userSuppliedFd)
         close(chanSwitchOpenSslP->listenFd);
 
+    chanSwitchOpenSslP->lockP->destroy(chanSwitchOpenSslP->lockP);
+
     free(chanSwitchOpenSslP);
 }
 
@@ -615,15 +1460,37 @@ chanSwitchListen(TChanSwitch * const chanSwitchP,
 
 
 static void
-createSslFromAcceptedConn(int           const acceptedFd,
-                          SSL_CTX *     const sslCtxP,
-                          SSL **        const sslPP,
-                          const char ** const errorP) {
+countHandshake(struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+               SSL *                      const sslP,
+               bool                       const failed) {
+
+    struct abyss_openSsl_handshakestats * const statsP =
+        &chanSwitchOpenSslP->stats;
+
+    chanSwitchOpenSslP->lockP->acquire(chanSwitchOpenSslP->lockP);
+
+    if (failed)
+        ++statsP->failedCt;
+    else if (SSL_session_reused(sslP))
+        ++statsP->resumedCt;
+    else
+        ++statsP->fullCt;
+
+    chanSwitchOpenSslP->lockP->release(chanSwitchOpenSslP->lockP);
+}
+
+
+
+static void
+createSslFromAcceptedConn(int                        const acceptedFd,
+                          struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+                          SSL **                     const sslPP,
+                          const char **              const errorP) {
 
     SSL * sslP;
     const char * error;
 
-    sslCreate(sslCtxP, &sslP, &error);
+    sslCreate(chanSwitchOpenSslP->sslCtxP, &sslP, &error);
 
     if (error) {
         xmlrpc_asprintf(errorP, "Failed to create SSL connection "
@@ -639,17 +1506,18 @@ createSslFromAcceptedConn(int           const acceptedFd,
                             "connection.  %s", error);
             xmlrpc_strfree(error);
         } else {
-            const char * error;
+            if (SwitchTraceIsActive)
+                traceCipherList(sslP);
+
+            /* The channel does the handshake; see completeHandshake() */
+            SSL_set_accept_state(sslP);
 
-            sslAccept(sslP, &error);
+            /* The session ticket key callback finds us through this, until
+               the handshake is done.
+            */
+            SSL_set_ex_data(sslP, switchExIndex, chanSwitchOpenSslP);
 
-            if (error) {
-                xmlrpc_asprintf(errorP,
-                                "Failed to set up SSL communication on "
-                                "working TCP connection.  %s", error);
-                xmlrpc_strfree(error);
-            } else
-                *errorP = NULL;
+            *errorP = NULL;
         }
         if (*errorP)
             SSL_free(sslP);
@@ -662,50 +1530,40 @@ createSslFromAcceptedConn(int           const acceptedFd,
 
 
 static void
-createChannelFromAcceptedConn(int             const acceptedFd,
-                              SSL_CTX *       const sslCtxP,
-                              TChannel **     const channelPP,
-                              void **         const channelInfoPP,
-                              const char **   const errorP) {
-
-    struct ChannelOpenSsl * channelOpenSslP;
+createChannelFromAcceptedConn(
+    int                        const acceptedFd,
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP,
+    TChannel **                const channelPP,
+    void **                    const channelInfoPP,
+    const char **              const errorP) {
 
-    MALLOCVAR(channelOpenSslP);
-
-    if (!channelOpenSslP)
-        xmlrpc_asprintf(errorP, "Unable to allocate memory");
-    else {
-        SSL * sslP;
-        const char * error;
+    SSL * sslP;
+    const char * error;
 
-        createSslFromAcceptedConn(acceptedFd, sslCtxP, &sslP, &error);
+    createSslFromAcceptedConn(acceptedFd, chanSwitchOpenSslP,
+                              &sslP, &error);
 
-        if (error) {
-            xmlrpc_asprintf(errorP, "Failed to create an OpenSSL connection "
-                            "from the accepted TCP connection.  %s", error);
-            xmlrpc_strfree(error);
-        } else {
-            struct abyss_openSsl_chaninfo * channelInfoP;
+    if (error) {
+        xmlrpc_asprintf(errorP, "Failed to create an OpenSSL connection "
+                        "from the accepted TCP connection.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
+        struct abyss_openSsl_chaninfo * channelInfoP;
 
-            makeChannelInfo(&channelInfoP, sslP, errorP);
-            if (!*errorP) {
-                bool const userSuppliedFalse = false;
+        makeChannelInfo(&channelInfoP, sslP, errorP);
+        if (!*errorP) {
+            bool const userSuppliedFalse = false;
 
-                makeChannelFromSsl(sslP, userSuppliedFalse,
-                                   channelPP, errorP);
+            makeChannelFromSsl(sslP, userSuppliedFalse, chanSwitchOpenSslP,
+                               channelPP, errorP);
 
-                if (*errorP)
-                    free(channelInfoP);
-                else
-                    *channelInfoPP = channelInfoP;
-            }
             if (*errorP)
-                SSL_free(sslP);
+                free(channelInfoP);
             else
-                channelOpenSslP->sslP = sslP;
+                *channelInfoPP = channelInfoP;
         }
         if (*errorP)
-            free(channelOpenSslP);
+            SSL_free(sslP);
     }
 }
 
@@ -724,6 +1582,10 @@ chanSwitchAccept(TChanSwitch * const chanSwitchP,
 
    If no connection is waiting at *chanSwitchP, wait until one is.
 
+   We only accept the TCP connection.  The channel does the TLS handshake
+   when it is first used, so that a client that is slow about it doesn't
+   hold up the next one.
+
    If we receive a signal while waiting, return immediately with
    *channelPP == NULL.
 -----------------------------------------------------------------------------*/
@@ -737,39 +1599,47 @@ chanSwitchAccept(TChanSwitch * const chanSwitchP,
     *errorP     = NULL;  /* No error yet */
 
     while (!channelP && !*errorP && !interrupted) {
-        struct sockaddr peerAddr;
-        socklen_t peerAddrLen;
-        int rc;
 
-        peerAddrLen = sizeof(peerAddr);  /* initial value */
+        sockutil_waitForConnection(chanSwitchOpenSslP->listenFd,
+                                   chanSwitchOpenSslP->interruptPipe,
+                                   &interrupted, errorP);
 
-        rc = accept(chanSwitchOpenSslP->listenFd, &peerAddr, &peerAddrLen);
+        if (!*errorP && !interrupted) {
+            struct sockaddr peerAddr;
+            socklen_t peerAddrLen;
+            int rc;
 
-        if (rc >= 0) {
-            int const acceptedFd = rc;
+            peerAddrLen = sizeof(peerAddr);  /* initial value */
 
-            const char * error;
+            rc = accept(chanSwitchOpenSslP->listenFd,
+                        &peerAddr, &peerAddrLen);
 
-            createChannelFromAcceptedConn(
-                acceptedFd, chanSwitchOpenSslP->sslCtxP,
-                &channelP, channelInfoPP, &error);
+            if (rc >= 0) {
+                int const acceptedFd = rc;
 
-            if (error) {
-                close(acceptedFd);
+                const char * error;
 
-                if (SwitchTraceIsActive)
-                    fprintf(stderr,
-                            "Failed to create a channel from the "
-                            "TCP connection we accepted.  %s.  "
-                            "Closing TCP connection, waiting for the "
-                            "next one\n", error);
-                xmlrpc_strfree(error);
-            }
-        } else if (errno == EINTR)
-            interrupted = true;
-        else
-            xmlrpc_asprintf(errorP, "accept() failed, errno = %d (%s)",
-                            errno, strerror(errno));
+                createChannelFromAcceptedConn(
+                    acceptedFd, chanSwitchOpenSslP,
+                    &channelP, channelInfoPP, &error);
+
+                if (error) {
+                    close(acceptedFd);
+
+                    if (SwitchTraceIsActive)
+                        fprintf(stderr,
+                                "Failed to create a channel from the "
+                                "TCP connection we accepted.  %s.  "
+                                "Closing TCP connection, waiting for the "
+                                "next one\n", error);
+                    xmlrpc_strfree(error);
+                }
+            } else if (errno == EINTR)
+                interrupted = true;
+            else
+                xmlrpc_asprintf(errorP, "accept() failed, errno = %d (%s)",
+                                errno, strerror(errno));
+        }
     }
     *channelPP = channelP;
 }
@@ -827,27 +1697,48 @@ createChanSwitch(int            const fd,
                         "channel switch descriptor.");
     else {
         TChanSwitch * chanSwitchP;
+        unsigned int i;
 
         chanSwitchOpenSslP->sslCtxP = sslCtxP;
 
         chanSwitchOpenSslP->listenFd = fd;
         chanSwitchOpenSslP->userSuppliedFd = userSuppliedFd;
 
-        sockutil_interruptPipeInit(&chanSwitchOpenSslP->interruptPipe, errorP);
+        chanSwitchOpenSslP->ticketKeyLifetime = 0;
+        for (i = 0; i < TICKET_KEY_CT; ++i)
+            chanSwitchOpenSslP->ticketKeys[i].exists = false;
+        chanSwitchOpenSslP->curTicketKey = 0;
 
-        if (!*errorP) {
-            ChanSwitchCreate(&chanSwitchVtbl, chanSwitchOpenSslP,
-                             &chanSwitchP);
-            if (*errorP)
-                sockutil_interruptPipeTerm(chanSwitchOpenSslP->interruptPipe);
-
-            if (chanSwitchP == NULL)
-                xmlrpc_asprintf(errorP, "Unable to allocate memory for "
-                                "channel switch descriptor");
-            else {
-                *chanSwitchPP = chanSwitchP;
-                *errorP = NULL;
+        chanSwitchOpenSslP->stats.fullCt    = 0;
+        chanSwitchOpenSslP->stats.resumedCt = 0;
+        chanSwitchOpenSslP->stats.failedCt  = 0;
+
+        chanSwitchOpenSslP->lockP = xmlrpc_lock_create();
+
+        if (!chanSwitchOpenSslP->lockP)
+            xmlrpc_asprintf(errorP, "Unable to create lock for OpenSSL "
+                            "channel switch");
+        else {
+            sockutil_interruptPipeInit(&chanSwitchOpenSslP->interruptPipe,
+                                       errorP);
+
+            if (!*errorP) {
+                ChanSwitchCreate(&chanSwitchVtbl, chanSwitchOpenSslP,
+                                 &chanSwitchP);
+                if (*errorP)
+                    sockutil_interruptPipeTerm(
+                        chanSwitchOpenSslP->interruptPipe);
+
+                if (chanSwitchP == NULL)
+                    xmlrpc_asprintf(errorP, "Unable to allocate memory for "
+                                    "channel switch descriptor");
+                else {
+                    *chanSwitchPP = chanSwitchP;
+                    *errorP = NULL;
+                }
             }
+            if (*errorP)
+                chanSwitchOpenSslP->lockP->destroy(chanSwitchOpenSslP->lockP);
         }
         if (*errorP)
             free(chanSwitchOpenSslP);
@@ -1004,3 +1895,115 @@ ChanSwitchOpenSslCreateFd(int            const fd,
 
 
 
+static const unsigned char sessionIdContext[] = "Abyss";
+
+
+
+static void
+setSessionCache(SSL_CTX *                                 const sslCtxP,
+                const struct abyss_openSsl_sessionparms * const parmsP,
+                const char **                             const errorP) {
+/*----------------------------------------------------------------------------
+   Set up OpenSSL's own server-side session cache in *sslCtxP.  OpenSSL
+   locks it, so all the threads accepting connections share it; it
+   enforces the size bound by evicting the least recently used session and
+   every so often flushes the ones that have timed out.
+
+   The session ID context is required for resumption of sessions in which
+   the client authenticated with a certificate.
+-----------------------------------------------------------------------------*/
+    if (SSL_CTX_set_session_id_context(sslCtxP, sessionIdContext,
+                                       sizeof(sessionIdContext)) != 1) {
+        const char * const sslMsg = sslErrorMsg();
+
+        xmlrpc_asprintf(errorP, "SSL_CTX_set_session_id_context() "
+                        "failed.  %s", sslMsg);
+
+        xmlrpc_strfree(sslMsg);
+    } else {
+        if (parmsP->cacheSize > 0) {
+            SSL_CTX_set_session_cache_mode(sslCtxP, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_sess_set_cache_size(sslCtxP, parmsP->cacheSize);
+        } else
+            SSL_CTX_set_session_cache_mode(sslCtxP, SSL_SESS_CACHE_OFF);
+
+        if (parmsP->timeout > 0)
+            SSL_CTX_set_timeout(sslCtxP, parmsP->timeout);
+
+        *errorP = NULL;
+    }
+}
+
+
+
+static void
+setTickets(SSL_CTX *    const sslCtxP,
+           unsigned int const ticketKeyLifetime) {
+
+    if (ticketKeyLifetime > 0) {
+        SSL_CTX_clear_options(sslCtxP, SSL_OP_NO_TICKET);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(sslCtxP, &ticketKeyCallback);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(sslCtxP, &ticketKeyCallback);
+#endif
+    } else
+        SSL_CTX_set_options(sslCtxP, SSL_OP_NO_TICKET);
+}
+
+
+
+void
+ChanSwitchOpenSslSetSessionParms(
+    TChanSwitch *                             const chanSwitchP,
+    const struct abyss_openSsl_sessionparms * const parmsP,
+    const char **                             const errorP) {
+/*----------------------------------------------------------------------------
+   Make the switch let clients resume TLS sessions as described by *parmsP.
+
+   This changes the switch's SSL_CTX, so it affects anything else that uses
+   that SSL_CTX too.
+
+   Call this before the switch starts accepting connections.
+-----------------------------------------------------------------------------*/
+    if (chanSwitchP->vtbl.accept != &chanSwitchAccept)
+        xmlrpc_asprintf(errorP, "Channel switch is not an OpenSSL one");
+    else {
+        struct ChanSwitchOpenSsl * const chanSwitchOpenSslP =
+            chanSwitchP->implP;
+
+        setSessionCache(chanSwitchOpenSslP->sslCtxP, parmsP, errorP);
+
+        if (!*errorP) {
+            setTickets(chanSwitchOpenSslP->sslCtxP,
+                       parmsP->ticketKeyLifetime);
+
+            chanSwitchOpenSslP->ticketKeyLifetime = parmsP->ticketKeyLifetime;
+        }
+    }
+}
+
+
+
+void
+ChanSwitchOpenSslGetHandshakeStats(
+    TChanSwitch *                         const chanSwitchP,
+    struct abyss_openSsl_handshakestats * const statsP) {
+/*----------------------------------------------------------------------------
+   The counts of the TLS handshakes the switch has done since it was
+   created.  Comparing the resumed count to the full count tells you how
+   well the session parameters are working.
+-----------------------------------------------------------------------------*/
+    struct ChanSwitchOpenSsl * const chanSwitchOpenSslP = chanSwitchP->implP;
+
+    assert(chanSwitchP->vtbl.accept == &chanSwitchAccept);
+
+    chanSwitchOpenSslP->lockP->acquire(chanSwitchOpenSslP->lockP);
+
+    *statsP = chanSwitchOpenSslP->stats;
+
+    chanSwitchOpenSslP->lockP->release(chanSwitchOpenSslP->lockP);
+}
+
+
+
@@ -16,6 +16,7 @@
 #include <poll.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/time.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -26,6 +27,9 @@
 #if HAVE_SYS_FILIO_H
   #include <sys/filio.h>
 #endif
+#if HAVE_SYS_SENDFILE_H
+  #include <sys/sendfile.h>
+#endif
 
 #include "c_util.h"
 #include "int.h"
@@ -170,6 +174,160 @@ channelWrite(TChannel *            const channelP,
 
 
 
+#define IOV_BATCH 64
+    /* Most pieces we give to one sendmsg().  Comfortably less than any
+       system's IOV_MAX.
+    */
+
+static void
+advanceIov(const TChannelIoVec * const iov,
+           unsigned int          const iovCt,
+           size_t                const bytesSent,
+           unsigned int *        const doneP,
+           uint32_t *            const offsetP) {
+/*----------------------------------------------------------------------------
+   Update our position in iov[], *doneP (the number of pieces entirely sent)
+   and *offsetP (how much of the next one is sent) for 'bytesSent' more
+   bytes sent, then skip any empty pieces.
+-----------------------------------------------------------------------------*/
+    size_t bytesLeft;
+
+    for (bytesLeft = bytesSent; bytesLeft > 0; ) {
+        uint32_t const pieceRest = iov[*doneP].len - *offsetP;
+
+        if (bytesLeft >= pieceRest) {
+            bytesLeft -= pieceRest;
+            ++*doneP;
+            *offsetP = 0;
+        } else {
+            *offsetP += bytesLeft;
+            bytesLeft = 0;
+        }
+    }
+    while (*doneP < iovCt && iov[*doneP].len == *offsetP) {
+        ++*doneP;
+        *offsetP = 0;
+    }
+}
+
+
+
+static ChannelWritevImpl channelWritev;
+
+static void
+channelWritev(TChannel *            const channelP,
+              const TChannelIoVec * const iov,
+              unsigned int          const iovCt,
+              TChanWriteExpect      const expectation,
+              bool *                const failedP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    unsigned int done;
+        /* Number of pieces of iov[] entirely sent */
+    uint32_t offset;
+        /* Number of bytes of iov[done] sent */
+    bool error;
+
+    done = 0; offset = 0;
+    advanceIov(iov, iovCt, 0, &done, &offset);
+
+    for (error = false; done < iovCt && !error; ) {
+        struct iovec batch[IOV_BATCH];
+        struct msghdr msg;
+        unsigned int batchCt;
+        ssize_t rc;
+
+        for (batchCt = 0;
+             batchCt < IOV_BATCH && done + batchCt < iovCt;
+             ++batchCt) {
+            const TChannelIoVec * const pieceP = &iov[done + batchCt];
+            uint32_t const skip = batchCt == 0 ? offset : 0;
+
+            batch[batchCt].iov_base = (void *)&pieceP->buffer[skip];
+            batch[batchCt].iov_len  = pieceP->len - skip;
+        }
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = batch;
+        msg.msg_iovlen = batchCt;
+
+        rc = sendmsg(socketUnixP->fd, &msg,
+                     expectation == CHAN_EXPECT_MORE || done + batchCt < iovCt ?
+                     msgMore : 0);
+
+        if (ChannelTraceIsActive) {
+            if (rc < 0)
+                fprintf(stderr, "Abyss channel: sendmsg() failed.  "
+                        "errno=%d (%s)", errno, strerror(errno));
+            else
+                fprintf(stderr, "Abyss channel: sent %u bytes from "
+                        "%u pieces\n", (unsigned)rc, batchCt);
+        }
+        if (rc <= 0)
+            /* 0 means connection closed; < 0 means severe error */
+            error = true;
+        else
+            advanceIov(iov, iovCt, rc, &done, &offset);
+    }
+    *failedP = error;
+}
+
+
+
+#if HAVE_SYS_SENDFILE_H
+
+static ChannelSendFileImpl channelSendFile;
+
+static void
+channelSendFile(TChannel * const channelP,
+                int        const fileFd,
+                uint64_t   const offset,
+                uint32_t   const len,
+                uint32_t * const bytesSentP,
+                bool *     const failedP) {
+/*----------------------------------------------------------------------------
+   The kernel copies the file to the socket; the bytes never come to us.
+-----------------------------------------------------------------------------*/
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    off_t fileOffset;
+    uint32_t bytesLeft;
+    bool error, eof;
+
+    fileOffset = (off_t)offset;
+
+    for (bytesLeft = len, error = false, eof = false;
+         bytesLeft > 0 && !error && !eof;
+        ) {
+        ssize_t rc;
+
+        /* sendfile() advances 'fileOffset' by what it sends */
+        rc = sendfile(socketUnixP->fd, fileFd, &fileOffset, bytesLeft);
+
+        if (ChannelTraceIsActive) {
+            if (rc < 0)
+                fprintf(stderr, "Abyss channel: sendfile() failed.  "
+                        "errno=%d (%s)", errno, strerror(errno));
+            else
+                fprintf(stderr, "Abyss channel: sent %u bytes from "
+                        "file\n", (unsigned)rc);
+        }
+        if (rc < 0)
+            error = true;
+        else if (rc == 0)
+            /* The file is shorter than Caller thought */
+            eof = true;
+        else
+            bytesLeft -= rc;
+    }
+    *bytesSentP = len - bytesLeft;
+    *failedP    = error;
+}
+
+#endif
+
+
+
 static ChannelReadImpl channelRead;
 
 static void
@@ -340,6 +498,18 @@ channelFormatPeerInfo(TChannel *    const channelP,
 
 
 
+static ChannelPollFdImpl channelPollFd;
+
+static int
+channelPollFd(TChannel * const channelP) {
+
+    struct socketUnix * const socketUnixP = channelP->implP;
+
+    return socketUnixP->fd;
+}
+
+
+
 static struct TChannelVtbl const channelVtbl = {
     &channelDestroy,
     &channelWrite,
@@ -347,6 +517,14 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    &channelPollFd,
+    &channelWritev,
+    NULL,  /* readPending: we don't buffer */
+#if HAVE_SYS_SENDFILE_H
+    &channelSendFile,
+#else
+    NULL,  /* sendFile */
+#endif
 };
 
 
@@ -565,6 +565,10 @@ static struct TChannelVtbl const channelVtbl = {
     &channelWait,
     &channelInterrupt,
     &channelFormatPeerInfo,
+    NULL,  /* pollFd */
+    NULL,  /* writev */
+    NULL,  /* readPending */
+    NULL,  /* sendFile */
 };
 
 
@@ -6,6 +6,7 @@
 *********************************************************************/
 
 #include "bool.h"
+#include "int.h"
 
 typedef struct abyss_thread TThread;
 
@@ -49,6 +50,74 @@ ThreadForks(void);
 void
 ThreadUpdateStatus(TThread * const threadP);
 
+/* A thread's "done" function (see ThreadCreate) calls ThreadNotifyDone() to
+   tell anyone waiting in ThreadWaitForDone() that a thread is done.  The
+   waiter gets ThreadDoneCount() before looking for finished threads, so it
+   doesn't miss a notification that comes in between.
+
+   In a thread implementation where the "done" function runs in a signal
+   handler, ThreadNotifyDone() is async-signal-safe.
+*/
+
+void
+ThreadNotifyDone(void);
+
+unsigned int
+ThreadDoneCount(void);
+
+void
+ThreadWaitForDone(unsigned int const doneCount,
+                  uint32_t     const timeoutMs);
+
+/* A thread pool runs jobs on threads it keeps from one job to the next.
+   ThreadCreatePooled() creates a TThread that is such a job; you use it
+   just like one from ThreadCreate(), except that ThreadExit() returns
+   instead of exiting the pool's thread, and Caller must then return from
+   its thread function.
+
+   Not every thread implementation has thread pools.  Where there aren't
+   any, ThreadPoolCreate() fails.
+*/
+
+typedef struct abyss_threadPool TThreadPool;
+
+typedef struct {
+    unsigned int  threadCt;
+        /* Threads in the pool */
+    unsigned int  busyThreadCt;
+        /* Threads in the pool running a job */
+    unsigned int  queueDepth;
+        /* Jobs waiting for a thread */
+    unsigned int  peakThreadCt;
+    unsigned int  peakQueueDepth;
+    unsigned long jobCt;
+        /* Jobs the pool's threads have started */
+} TThreadPoolStats;
+
+void
+ThreadPoolCreate(TThreadPool ** const poolPP,
+                 unsigned int   const minThreadCt,
+                 unsigned int   const maxThreadCt,
+                 uint32_t       const idleTimeoutMs,
+                 size_t         const stackSize,
+                 const char **  const errorP);
+
+void
+ThreadPoolDestroy(TThreadPool * const poolP);
+
+void
+ThreadPoolGetStats(TThreadPool *      const poolP,
+                   TThreadPoolStats * const statsP);
+
+void
+ThreadCreatePooled(TThread **      const threadPP,
+                   TThreadPool *   const poolP,
+                   void *          const userHandle,
+                   TThreadProc   * const func,
+                   TThreadDoneFn * const threadDone,
+                   size_t          const stackSize,
+                   const char **   const errorP);
+
 #if !MSVCRT
 void
 ThreadHandleSigchld(pid_t const pid);
@@ -5,6 +5,8 @@
 #include <errno.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include "xmlrpc_config.h"
 #include "xmlrpc-c/string_int.h"
@@ -59,6 +61,44 @@ static struct {
    
 
 
+/* This is how the parent learns that a child is done (see
+   ThreadNotifyDone()).  ThreadNotifyDone() normally runs in a SIGCHLD
+   handler, so it can't do much more than write to a pipe.
+*/
+static struct {
+    int pipeFd[2];
+        /* A "self pipe".  ThreadNotifyDone() writes a byte to [1];
+           ThreadWaitForDone() polls [0].  -1 means not created yet.
+        */
+    volatile sig_atomic_t count;
+} ThreadsDone = {{-1, -1}, 0};
+
+
+
+static void
+createDonePipe(void) {
+/*----------------------------------------------------------------------------
+   Create the pipe that tells the parent a child is done, if we haven't
+   already.  If we can't, ThreadWaitForDone() just waits for the timeout.
+-----------------------------------------------------------------------------*/
+    if (ThreadsDone.pipeFd[0] < 0) {
+        int pipeFd[2];
+
+        if (pipe(pipeFd) == 0) {
+            unsigned int i;
+
+            for (i = 0; i < 2; ++i) {
+                fcntl(pipeFd[i], F_SETFL, O_NONBLOCK);
+                fcntl(pipeFd[i], F_SETFD, FD_CLOEXEC);
+            }
+            ThreadsDone.pipeFd[1] = pipeFd[1];
+            ThreadsDone.pipeFd[0] = pipeFd[0];
+        }
+    }
+}
+
+
+
 void
 ThreadPoolInit(void) {
 
@@ -176,6 +216,8 @@ ThreadCreate(TThread **      const threadPP,
         threadP->useSigchld  = useSigchld;
         threadP->pid         = 0;
 
+        createDonePipe();
+
         /* We have to be sure we don't get the SIGCHLD for this child's
            death until the child is properly registered in the thread pool
            so that the handler will know who he is.
@@ -291,3 +333,109 @@ ThreadForks(void) {
 
 
 
+void
+ThreadNotifyDone(void) {
+
+    ++ThreadsDone.count;
+
+    if (ThreadsDone.pipeFd[1] >= 0) {
+        unsigned char const zero[1] = {0u};
+
+        /* The pipe is nonblocking; if it's full, the parent has a wakeup
+           coming already.
+        */
+        write(ThreadsDone.pipeFd[1], &zero, sizeof(zero));
+    }
+}
+
+
+
+unsigned int
+ThreadDoneCount(void) {
+
+    return ThreadsDone.count;
+}
+
+
+
+void
+ThreadWaitForDone(unsigned int const doneCount,
+                  uint32_t     const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Wait until some child is done after ThreadDoneCount() returned
+   'doneCount', but no more than 'timeoutMs' milliseconds.
+
+   We wake up early for any signal, because the signal may be the SIGCHLD
+   that tells the user a child is done.  We also wake up early
+   sometimes for a child that finished before ThreadDoneCount(), because
+   its byte is still in the pipe.  Caller just looks again.
+-----------------------------------------------------------------------------*/
+    if ((unsigned int)ThreadsDone.count == doneCount) {
+        struct pollfd pollfd;
+
+        pollfd.fd     = ThreadsDone.pipeFd[0];  /* poll ignores -1 */
+        pollfd.events = POLLIN;
+
+        if (poll(&pollfd, 1, timeoutMs) > 0) {
+            char buffer[64];
+
+            /* Drain the pipe; every byte in it was a notification */
+            while (read(ThreadsDone.pipeFd[0], buffer, sizeof(buffer)) > 0);
+        }
+    }
+}
+
+
+
+void
+ThreadPoolCreate(TThreadPool ** const poolPP ATTR_UNUSED,
+                 unsigned int   const minThreadCt ATTR_UNUSED,
+                 unsigned int   const maxThreadCt ATTR_UNUSED,
+                 uint32_t       const idleTimeoutMs ATTR_UNUSED,
+                 size_t         const stackSize ATTR_UNUSED,
+                 const char **  const errorP) {
+
+    /* A pool of processes would be no use, because a process can't run
+       another job after it has been forked for one.
+    */
+
+    xmlrpc_asprintf(errorP, "There are no thread pools with fork threads");
+}
+
+
+
+void
+ThreadPoolDestroy(TThreadPool * const poolP ATTR_UNUSED) {
+
+}
+
+
+
+void
+ThreadPoolGetStats(TThreadPool *      const poolP ATTR_UNUSED,
+                   TThreadPoolStats * const statsP) {
+
+    statsP->threadCt       = 0;
+    statsP->busyThreadCt   = 0;
+    statsP->queueDepth     = 0;
+    statsP->peakThreadCt   = 0;
+    statsP->peakQueueDepth = 0;
+    statsP->jobCt          = 0;
+}
+
+
+
+void
+ThreadCreatePooled(TThread **      const threadPP ATTR_UNUSED,
+                   TThreadPool *   const poolP ATTR_UNUSED,
+                   void *          const userHandle ATTR_UNUSED,
+                   TThreadProc   * const func ATTR_UNUSED,
+                   TThreadDoneFn * const threadDone ATTR_UNUSED,
+                   size_t          const stackSize ATTR_UNUSED,
+                   const char **   const errorP) {
+
+    xmlrpc_asprintf(errorP, "There are no thread pools with fork threads");
+}
+
+
+
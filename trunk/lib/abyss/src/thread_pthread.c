@@ -2,6 +2,7 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "xmlrpc_config.h"
@@ -19,11 +20,61 @@
 
 struct abyss_thread {
     pthread_t       thread;
+        /* The thread that runs this.  For a job in a thread pool, this is
+           meaningful only while 'running' is true.
+        */
     void *          userHandle;
     TThreadProc *   func;
     TThreadDoneFn * threadDone;
+    TThreadPool *   poolP;
+        /* The thread pool whose threads run this; NULL if this has its
+           own thread.  The rest of the members are for pool jobs only.
+        */
+    struct abyss_thread * nextInQueueP;
+    bool            running;
+        /* A pool thread is running this now */
+    bool            complete;
+        /* A pool thread has run this, including its "done" function */
+    bool            released;
+        /* Nobody is going to wait for this; whoever completes it frees it */
 };
 
+struct abyss_threadPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t  workAvailable;
+        /* Signalled when a job enters the queue or the pool is terminating */
+    pthread_cond_t  jobComplete;
+        /* Broadcast when a job becomes complete */
+    pthread_cond_t  threadGone;
+        /* Broadcast when a pool thread exits */
+    unsigned int    minThreadCt;
+    unsigned int    maxThreadCt;
+    uint32_t        idleTimeoutMs;
+        /* How long a thread beyond the minimum waits for a job before it
+           exits.  Zero means forever.
+        */
+    size_t          stackSize;
+    TThread *       queueHeadP;
+    TThread *       queueTailP;
+        /* Jobs waiting for a thread, oldest first */
+    unsigned int    queueDepth;
+    unsigned int    threadCt;
+    unsigned int    busyThreadCt;
+    unsigned int    peakThreadCt;
+    unsigned int    peakQueueDepth;
+    unsigned long   jobCt;
+    bool            terminating;
+};
+
+/* This is how a thread tells the server that it is done (see
+   ThreadNotifyDone()).
+*/
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    unsigned int    count;
+} threadsDone = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0};
+
 /* We used to have MIN_STACK_SIZE = 16K, which was said to be the
    minimum stack size on Win32.  Scott Kolodzeski found in November
    2005 that this was insufficient for 64 bit Solaris -- we fail
@@ -96,13 +147,19 @@ ThreadCreate(TThread **      const threadPP,
             threadP->userHandle = userHandle;
             threadP->func       = func;
             threadP->threadDone = threadDone;
+            threadP->poolP      = NULL;
+
+            /* The thread function may use *threadPP (e.g. to call
+               ThreadExit()) as soon as the thread starts, so it must be
+               set before that.
+            */
+            *threadPP = threadP;
 
             rc = pthread_create(&threadP->thread, &attr,
                                 execute, threadP);
-            if (rc == 0) {
+            if (rc == 0)
                 *errorP = NULL;
-                *threadPP = threadP;
-            } else
+            else
                 xmlrpc_asprintf(
                     errorP, "pthread_create() failed, errno = %d (%s)",
                     errno, strerror(errno));
@@ -132,9 +189,23 @@ ThreadStop(TThread * const threadP ATTR_UNUSED) {
 
 
 bool
-ThreadKill(TThread * const threadP ATTR_UNUSED) {
+ThreadKill(TThread * const threadP) {
+
+    bool retval;
+
+    if (threadP->poolP) {
+        TThreadPool * const poolP = threadP->poolP;
+
+        pthread_mutex_lock(&poolP->mutex);
+
+        retval = threadP->running &&
+            pthread_kill(threadP->thread, SIGTERM) == 0;
 
-    return (pthread_kill(threadP->thread, SIGTERM) == 0);
+        pthread_mutex_unlock(&poolP->mutex);
+    } else
+        retval = (pthread_kill(threadP->thread, SIGTERM) == 0);
+
+    return retval;
 }
 
 
@@ -142,24 +213,40 @@ ThreadKill(TThread * const threadP ATTR_UNUSED) {
 void
 ThreadWaitAndRelease(TThread * const threadP) {
 
-    void * threadReturn;
+    if (threadP->poolP) {
+        TThreadPool * const poolP = threadP->poolP;
+
+        pthread_mutex_lock(&poolP->mutex);
+
+        while (!threadP->complete)
+            pthread_cond_wait(&poolP->jobComplete, &poolP->mutex);
 
-    pthread_join(threadP->thread, &threadReturn);
+        pthread_mutex_unlock(&poolP->mutex);
+    } else {
+        void * threadReturn;
 
+        pthread_join(threadP->thread, &threadReturn);
+    }
     free(threadP);
 }
 
 
 
 void
-ThreadExit(TThread * const threadP ATTR_UNUSED,
+ThreadExit(TThread * const threadP,
            int       const retValue) {
 
-    pthread_exit((void*)&retValue);
+    if (threadP->poolP) {
+        /* The thread belongs to the pool, so we don't exit it.  We return
+           and Caller returns to the pool, which runs the "done" function.
+        */
+    } else {
+        pthread_exit((void*)&retValue);
 
-    /* Note that the above runs our cleanup routine (which we registered
-       with pthread_cleanup_push() before exiting.
-    */
+        /* Note that the above runs our cleanup routine (which we registered
+           with pthread_cleanup_push() before exiting.
+        */
+    }
 }
 
 
@@ -167,9 +254,25 @@ ThreadExit(TThread * const threadP ATTR_UNUSED,
 void
 ThreadRelease(TThread * const threadP) {
 
-    pthread_detach(threadP->thread);
+    if (threadP->poolP) {
+        TThreadPool * const poolP = threadP->poolP;
+        bool complete;
 
-    free(threadP);
+        pthread_mutex_lock(&poolP->mutex);
+
+        complete = threadP->complete;
+        if (!complete)
+            threadP->released = true;
+
+        pthread_mutex_unlock(&poolP->mutex);
+
+        if (complete)
+            free(threadP);
+    } else {
+        pthread_detach(threadP->thread);
+
+        free(threadP);
+    }
 }
 
 
@@ -200,3 +303,417 @@ ThreadHandleSigchld(pid_t const pid ATTR_UNUSED) {
 
 
 
+static void
+computeDeadline(uint32_t          const timeoutMs,
+                struct timespec * const deadlineP) {
+/*----------------------------------------------------------------------------
+   The time 'timeoutMs' milliseconds from now, in the form
+   pthread_cond_timedwait() takes.
+-----------------------------------------------------------------------------*/
+    clock_gettime(CLOCK_REALTIME, deadlineP);
+
+    deadlineP->tv_sec  += timeoutMs / 1000;
+    deadlineP->tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (deadlineP->tv_nsec >= 1000000000L) {
+        deadlineP->tv_nsec -= 1000000000L;
+        ++deadlineP->tv_sec;
+    }
+}
+
+
+
+void
+ThreadNotifyDone(void) {
+
+    pthread_mutex_lock(&threadsDone.mutex);
+
+    ++threadsDone.count;
+
+    pthread_cond_broadcast(&threadsDone.cond);
+
+    pthread_mutex_unlock(&threadsDone.mutex);
+}
+
+
+
+unsigned int
+ThreadDoneCount(void) {
+
+    unsigned int retval;
+
+    pthread_mutex_lock(&threadsDone.mutex);
+
+    retval = threadsDone.count;
+
+    pthread_mutex_unlock(&threadsDone.mutex);
+
+    return retval;
+}
+
+
+
+void
+ThreadWaitForDone(unsigned int const doneCount,
+                  uint32_t     const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Wait until some thread is done after ThreadDoneCount() returned
+   'doneCount', but no more than 'timeoutMs' milliseconds.
+-----------------------------------------------------------------------------*/
+    struct timespec deadline;
+    bool timedOut;
+
+    computeDeadline(timeoutMs, &deadline);
+
+    pthread_mutex_lock(&threadsDone.mutex);
+
+    for (timedOut = false; threadsDone.count == doneCount && !timedOut; ) {
+        int const rc = pthread_cond_timedwait(&threadsDone.cond,
+                                              &threadsDone.mutex, &deadline);
+        timedOut = (rc == ETIMEDOUT);
+    }
+    pthread_mutex_unlock(&threadsDone.mutex);
+}
+
+
+
+/*=========================================================================
+  Thread pool
+
+  A pool keeps threads around to run jobs one after another, so that a job
+  doesn't have to pay for creating and destroying a thread.
+  ThreadCreatePooled() puts the job in the pool's queue (ThreadRun() on a
+  pool job does nothing).  A thread that is idle takes it from there.  If all the threads are busy, the pool creates another one, up to
+  its maximum.  Otherwise the job waits in the queue.  A thread beyond the
+  pool's minimum exits after it has been idle for the pool's idle timeout.
+=========================================================================*/
+
+static pthreadStartRoutine poolThread;
+
+
+
+static void
+spawnPoolThread(TThreadPool * const poolP,
+                const char ** const errorP) {
+/*----------------------------------------------------------------------------
+   Add a thread to the pool.
+
+   We assume Caller holds the pool lock.
+-----------------------------------------------------------------------------*/
+    pthread_attr_t attr;
+    pthread_t thread;
+    int rc;
+
+    pthread_attr_init(&attr);
+
+    pthread_attr_setstacksize(&attr, MAX(MIN_STACK_SIZE, poolP->stackSize));
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    rc = pthread_create(&thread, &attr, poolThread, poolP);
+
+    if (rc == 0) {
+        ++poolP->threadCt;
+        poolP->peakThreadCt = MAX(poolP->peakThreadCt, poolP->threadCt);
+        *errorP = NULL;
+    } else
+        xmlrpc_asprintf(errorP, "pthread_create() failed, errno = %d (%s)",
+                        rc, strerror(rc));
+
+    pthread_attr_destroy(&attr);
+}
+
+
+
+static void
+runPoolJob(TThreadPool * const poolP,
+           TThread *     const jobP) {
+/*----------------------------------------------------------------------------
+   Run job *jobP, which we have just taken from the pool's queue.
+
+   We assume Caller holds the pool lock.  We release it while the job runs.
+-----------------------------------------------------------------------------*/
+    jobP->thread  = pthread_self();
+    jobP->running = true;
+
+    ++poolP->busyThreadCt;
+    ++poolP->jobCt;
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    jobP->func(jobP->userHandle);
+
+    jobP->threadDone(jobP->userHandle);
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    --poolP->busyThreadCt;
+
+    jobP->running  = false;
+    jobP->complete = true;
+
+    if (jobP->released)
+        free(jobP);
+    else
+        pthread_cond_broadcast(&poolP->jobComplete);
+}
+
+
+
+static bool
+waitForPoolJob(TThreadPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Wait for a job to show up in the pool's queue, or for the pool to start
+   terminating.
+
+   Return false iff we gave up because we were idle for the pool's idle
+   timeout and the pool can do without this thread.
+
+   We assume Caller holds the pool lock.
+-----------------------------------------------------------------------------*/
+    bool retval;
+
+    if (poolP->idleTimeoutMs == 0 ||
+        poolP->threadCt <= poolP->minThreadCt) {
+
+        pthread_cond_wait(&poolP->workAvailable, &poolP->mutex);
+
+        retval = true;
+    } else {
+        struct timespec deadline;
+        int rc;
+
+        computeDeadline(poolP->idleTimeoutMs, &deadline);
+
+        rc = pthread_cond_timedwait(&poolP->workAvailable, &poolP->mutex,
+                                    &deadline);
+
+        retval = !(rc == ETIMEDOUT && !poolP->queueHeadP &&
+                   poolP->threadCt > poolP->minThreadCt);
+    }
+    return retval;
+}
+
+
+
+static void *
+poolThread(void * const arg) {
+/*----------------------------------------------------------------------------
+   This is the root function of a pool thread.  It runs jobs from the pool's
+   queue until the pool is terminating and the queue is empty or the thread
+   has been idle too long.
+-----------------------------------------------------------------------------*/
+    TThreadPool * const poolP = arg;
+
+    bool quit;
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    for (quit = false; !quit; ) {
+        if (poolP->queueHeadP) {
+            TThread * const jobP = poolP->queueHeadP;
+
+            poolP->queueHeadP = jobP->nextInQueueP;
+            if (!poolP->queueHeadP)
+                poolP->queueTailP = NULL;
+            --poolP->queueDepth;
+
+            runPoolJob(poolP, jobP);
+        } else if (poolP->terminating)
+            quit = true;
+        else
+            quit = !waitForPoolJob(poolP);
+    }
+    --poolP->threadCt;
+
+    pthread_cond_broadcast(&poolP->threadGone);
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    return NULL;
+}
+
+
+
+void
+ThreadPoolCreate(TThreadPool ** const poolPP,
+                 unsigned int   const minThreadCt,
+                 unsigned int   const maxThreadCt,
+                 uint32_t       const idleTimeoutMs,
+                 size_t         const stackSize,
+                 const char **  const errorP) {
+/*----------------------------------------------------------------------------
+   Create a thread pool that keeps at least 'minThreadCt' and at most
+   'maxThreadCt' threads, each with a stack of 'stackSize' bytes.
+
+   The pool always has at least one thread, so a job in the queue always
+   gets run eventually.
+-----------------------------------------------------------------------------*/
+    TThreadPool * poolP;
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        xmlrpc_asprintf(errorP, "Can't allocate memory for thread pool");
+    else {
+        unsigned int i;
+
+        pthread_mutex_init(&poolP->mutex, NULL);
+        pthread_cond_init(&poolP->workAvailable, NULL);
+        pthread_cond_init(&poolP->jobComplete, NULL);
+        pthread_cond_init(&poolP->threadGone, NULL);
+
+        poolP->maxThreadCt    = MAX(1, maxThreadCt);
+        poolP->minThreadCt    = MAX(1, MIN(minThreadCt, poolP->maxThreadCt));
+        poolP->idleTimeoutMs  = idleTimeoutMs;
+        poolP->stackSize      = stackSize;
+        poolP->queueHeadP     = NULL;
+        poolP->queueTailP     = NULL;
+        poolP->queueDepth     = 0;
+        poolP->threadCt       = 0;
+        poolP->busyThreadCt   = 0;
+        poolP->peakThreadCt   = 0;
+        poolP->peakQueueDepth = 0;
+        poolP->jobCt          = 0;
+        poolP->terminating    = false;
+
+        pthread_mutex_lock(&poolP->mutex);
+
+        for (i = 0, *errorP = NULL; i < poolP->minThreadCt && !*errorP; ++i)
+            spawnPoolThread(poolP, errorP);
+
+        pthread_mutex_unlock(&poolP->mutex);
+
+        if (*errorP) {
+            const char * const error = *errorP;
+
+            ThreadPoolDestroy(poolP);
+
+            xmlrpc_asprintf(errorP, "Failed to create thread %u of the "
+                            "pool.  %s", i, error);
+            xmlrpc_strfree(error);
+        }
+    }
+    *poolPP = poolP;
+}
+
+
+
+void
+ThreadPoolDestroy(TThreadPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Destroy a thread pool.  The threads finish the jobs already in the
+   queue, then exit; we wait for that.
+-----------------------------------------------------------------------------*/
+    pthread_mutex_lock(&poolP->mutex);
+
+    poolP->terminating = true;
+
+    pthread_cond_broadcast(&poolP->workAvailable);
+
+    while (poolP->threadCt > 0)
+        pthread_cond_wait(&poolP->threadGone, &poolP->mutex);
+
+    pthread_mutex_unlock(&poolP->mutex);
+
+    pthread_cond_destroy(&poolP->threadGone);
+    pthread_cond_destroy(&poolP->jobComplete);
+    pthread_cond_destroy(&poolP->workAvailable);
+    pthread_mutex_destroy(&poolP->mutex);
+
+    free(poolP);
+}
+
+
+
+void
+ThreadPoolGetStats(TThreadPool *      const poolP,
+                   TThreadPoolStats * const statsP) {
+
+    pthread_mutex_lock(&poolP->mutex);
+
+    statsP->threadCt       = poolP->threadCt;
+    statsP->busyThreadCt   = poolP->busyThreadCt;
+    statsP->queueDepth     = poolP->queueDepth;
+    statsP->peakThreadCt   = poolP->peakThreadCt;
+    statsP->peakQueueDepth = poolP->peakQueueDepth;
+    statsP->jobCt          = poolP->jobCt;
+
+    pthread_mutex_unlock(&poolP->mutex);
+}
+
+
+
+void
+ThreadCreatePooled(TThread **      const threadPP,
+                   TThreadPool *   const poolP,
+                   void *          const userHandle,
+                   TThreadProc   * const func,
+                   TThreadDoneFn * const threadDone,
+                   size_t          const stackSize,
+                   const char **   const errorP) {
+/*----------------------------------------------------------------------------
+   Like ThreadCreate(), except that one of the threads of pool *poolP runs
+   'func', as soon as one is available.
+-----------------------------------------------------------------------------*/
+    if (stackSize > poolP->stackSize)
+        xmlrpc_asprintf(errorP, "Thread needs a %lu-byte stack, but "
+                        "threads in the pool have only %lu bytes",
+                        (unsigned long)stackSize,
+                        (unsigned long)poolP->stackSize);
+    else {
+        TThread * threadP;
+
+        MALLOCVAR(threadP);
+        if (threadP == NULL)
+            xmlrpc_asprintf(errorP,
+                            "Can't allocate memory for thread descriptor.");
+        else {
+            threadP->userHandle   = userHandle;
+            threadP->func         = func;
+            threadP->threadDone   = threadDone;
+            threadP->poolP        = poolP;
+            threadP->nextInQueueP = NULL;
+            threadP->running      = false;
+            threadP->complete     = false;
+            threadP->released     = false;
+
+            /* A pool thread may run the job as soon as we queue it, and
+               the job may use *threadPP, so it must be set before that.
+            */
+            *threadPP = threadP;
+
+            pthread_mutex_lock(&poolP->mutex);
+
+            if (poolP->queueTailP)
+                poolP->queueTailP->nextInQueueP = threadP;
+            else
+                poolP->queueHeadP = threadP;
+            poolP->queueTailP = threadP;
+
+            ++poolP->queueDepth;
+            poolP->peakQueueDepth =
+                MAX(poolP->peakQueueDepth, poolP->queueDepth);
+
+            if (poolP->queueDepth > poolP->threadCt - poolP->busyThreadCt &&
+                poolP->threadCt < poolP->maxThreadCt) {
+                const char * error;
+
+                spawnPoolThread(poolP, &error);
+
+                if (error) {
+                    /* Never mind; one of the threads we have will run it
+                       when it's free.
+                    */
+                    xmlrpc_strfree(error);
+                }
+            }
+            pthread_cond_signal(&poolP->workAvailable);
+
+            pthread_mutex_unlock(&poolP->mutex);
+
+            *errorP = NULL;
+        }
+    }
+}
+
+
+
@@ -35,6 +35,32 @@ struct abyss_thread {
 
 #define  MIN_THREAD_STACK_SIZE (16*1024L)
 
+/* This is how a thread tells the server that it is done (see
+   ThreadNotifyDone()).  'event' is an auto-reset event, created the
+   first time somebody needs it.
+*/
+static struct {
+    HANDLE volatile event;
+    LONG volatile   count;
+} threadsDone = {NULL, 0};
+
+
+
+static HANDLE
+threadsDoneEvent(void) {
+
+    if (threadsDone.event == NULL) {
+        HANDLE const event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+        if (event) {
+            if (InterlockedCompareExchangePointer(&threadsDone.event,
+                                                  event, NULL) != NULL)
+                CloseHandle(event);  /* Somebody beat us to it */
+        }
+    }
+    return threadsDone.event;
+}
+
 
 typedef uint32_t (WINAPI WinThreadProc)(void *);
 
@@ -166,6 +192,101 @@ ThreadUpdateStatus(TThread * const threadP ATTR_UNUSED) {
        to do here.
     */
 }
- 
- 
+
+
+
+void
+ThreadNotifyDone(void) {
+
+    HANDLE const event = threadsDoneEvent();
+
+    InterlockedIncrement(&threadsDone.count);
+
+    if (event)
+        SetEvent(event);
+}
+
+
+
+unsigned int
+ThreadDoneCount(void) {
+
+    return (unsigned int)threadsDone.count;
+}
+
+
+
+void
+ThreadWaitForDone(unsigned int const doneCount,
+                  uint32_t     const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Wait until some thread is done after ThreadDoneCount() returned
+   'doneCount', but no more than 'timeoutMs' milliseconds.
+
+   We may wake up early for a thread that finished before
+   ThreadDoneCount(), because the event stays set.  Caller just looks again.
+-----------------------------------------------------------------------------*/
+    HANDLE const event = threadsDoneEvent();
+
+    if ((unsigned int)threadsDone.count == doneCount) {
+        if (event)
+            WaitForSingleObject(event, timeoutMs);
+        else
+            Sleep(timeoutMs);
+    }
+}
+
+
+
+void
+ThreadPoolCreate(TThreadPool ** const poolPP ATTR_UNUSED,
+                 unsigned int   const minThreadCt ATTR_UNUSED,
+                 unsigned int   const maxThreadCt ATTR_UNUSED,
+                 uint32_t       const idleTimeoutMs ATTR_UNUSED,
+                 size_t         const stackSize ATTR_UNUSED,
+                 const char **  const errorP) {
+
+    /* Nobody has written thread pools for Windows threads yet. */
+
+    xmlrpc_asprintf(errorP,
+                    "There are no thread pools with Windows threads");
+}
+
+
+
+void
+ThreadPoolDestroy(TThreadPool * const poolP ATTR_UNUSED) {
+
+}
+
+
+
+void
+ThreadPoolGetStats(TThreadPool *      const poolP ATTR_UNUSED,
+                   TThreadPoolStats * const statsP) {
+
+    statsP->threadCt       = 0;
+    statsP->busyThreadCt   = 0;
+    statsP->queueDepth     = 0;
+    statsP->peakThreadCt   = 0;
+    statsP->peakQueueDepth = 0;
+    statsP->jobCt          = 0;
+}
+
+
+
+void
+ThreadCreatePooled(TThread **      const threadPP ATTR_UNUSED,
+                   TThreadPool *   const poolP ATTR_UNUSED,
+                   void *          const userHandle ATTR_UNUSED,
+                   TThreadProc   * const func ATTR_UNUSED,
+                   TThreadDoneFn * const threadDone ATTR_UNUSED,
+                   size_t          const stackSize ATTR_UNUSED,
+                   const char **   const errorP) {
+
+    xmlrpc_asprintf(errorP,
+                    "There are no thread pools with Windows threads");
+}
+
+
 
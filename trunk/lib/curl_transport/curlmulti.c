@@ -5,28 +5,37 @@
 
    1) It has a lock so multiple threads can use it simultaneously.
 
-   2) Its "select" file descriptor vectors are self-contained.  CURLM
-      requires the user to maintain them separately.
+   2) It knows how to wait for there to be work for the multi manager to do,
+      so its user doesn't have to deal with the file descriptors libcurl
+      is using.  Or it can tell its user what to wait for, so the user
+      can wait for that in its own event loop.
+
+   There are two ways we drive the multi manager.
+
+   Where we have epoll and a libcurl that can tell us what sockets and
+   timeouts it cares about, we use libcurl's "multi_socket" interface:
+   libcurl calls our socket function whenever it wants us to start or stop
+   watching a socket, and we keep an epoll instance watching exactly those.
+   It calls our timer function to tell us when it next has scheduled work
+   to do (e.g. time out a connection attempt).  When something happens, we
+   tell libcurl which socket it happened on, and libcurl does only the work
+   for the transfers on that socket.  So the cost of a wait and of a round
+   of work does not grow with the number of transfers in progress, and
+   there is no limit on the value of a file descriptor.
+
+   Otherwise, we do it the classic way: before each wait, we ask libcurl
+   for "select" file descriptor vectors of every socket it is interested in,
+   and after it, we have libcurl look at every transfer.  That costs time
+   proportional to the number of transfers for every event, and doesn't work
+   for file descriptors > FD_SETSIZE (typically 1023); for those, the user of
+   this code ends up busywaiting for there to be work to do on them.
 =============================================================================*/
 
 /* Engineering note: Modern Curl has an easier interface for waiting for
-   there to be something for libcurl to do: 'curl_multi_poll'.  Besides
-   being easier to code, it handles all file descriptors, whereas
-   the code here doesn't work for file descriptors > FD_SET (typically
-   1023).  For those, the user of this code ends up busywaiting for there
-   to be work to do on them.
-
-   'curl_multi_poll' is awkwardly nonmodular in the way it deals with programs
-   that need to wait simultaneously for libcurl to have work to do and for
-   other things, but our only user doesn't need to wait for anything but
-   libcurl to have work to do, so that is not a practical problem.
-
-   One thing 'curl_multi_poll' lacks that the current implementation has is
-   the ability to reliably stop waiting when a signal is received.
-   I.e. 'curl_multi_poll' does 'poll', not 'ppoll'.
-
-   But we ought to use 'curl_multi_poll' if we can.  We could use
-   HAVE_CURL_MULTI_POLL (set in Makefile, but not used today) for that.
+   there to be something for libcurl to do: 'curl_multi_poll'.  But it does
+   'poll', not 'ppoll', so it lacks the ability to reliably stop waiting when
+   a signal is received, which our user needs.  And like the classic
+   interface, it looks at every transfer every time.
 */
 
 #define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
@@ -34,9 +43,15 @@
 #include "xmlrpc_config.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #if HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
+#ifdef HAVE_EPOLL
+#include <unistd.h>
+#include <sys/epoll.h>
+#endif
 
 #include <curl/curl.h>
 #ifdef NEED_CURL_TYPES_H
@@ -46,8 +61,12 @@
 #include <curl/multi.h>
 
 #include "mallocvar.h"
+#include "girmath.h"
+#include "linklist.h"
 #include "xmlrpc-c/util.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/select_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/lock.h"
 #include "xmlrpc-c/lock_platform.h"
 
@@ -55,6 +74,17 @@
 
 #include "curlmulti.h"
 
+#if defined(HAVE_EPOLL) && HAVE_CURL_MULTI_SOCKET
+  #define USE_MULTI_SOCKET 1
+#else
+  #define USE_MULTI_SOCKET 0
+#endif
+
+#define MAX_EVENTS 256
+    /* Maximum number of epoll events we collect per wait.  If more sockets
+       than this are ready, the rest are still ready at the next wait.
+    */
+
 
 
 static void
@@ -70,26 +100,304 @@ interpretCurlMultiError(const char ** const descriptionP,
 
 
 
+#if USE_MULTI_SOCKET
+
+struct watchedSocket {
+/*----------------------------------------------------------------------------
+   A socket libcurl has told us to watch.  libcurl keeps a pointer to this
+   with the socket (curl_multi_assign()) and hands it back to us each time it
+   tells us something about the socket.
+-----------------------------------------------------------------------------*/
+    struct list_head listHeader;
+    curl_socket_t fd;
+    bool inEpoll;
+        /* The socket is in the epoll set.  It isn't when libcurl wants
+           nothing from it, because then a hangup on it would wake us
+           over and over for nothing.
+        */
+};
+
+#endif
+
+
+
 struct curlMulti {
     CURLM * curlMultiP;
     struct lock * lockP;
-        /* Hold this lock while accessing or using *curlMultiP.  You're
-           using the multi manager whenever you're calling a Curl
-           library multi manager function.
+        /* Hold this lock while accessing or using *curlMultiP, or
+           the members below.  You're using the multi manager whenever
+           you're calling a Curl library multi manager function.  Note that
+           libcurl calls our socket and timer functions from inside those,
+           so they already have the lock.
+        */
+    unsigned int handleCt;
+        /* Number of easy handles in the multi manager */
+    unsigned int peakHandleCt;
+        /* The most easy handles the multi manager has had at once since
+           it was last empty
+        */
+    unsigned int minMaxConnects;
+        /* What curlMulti_setMaxConnects() said; zero if it hasn't been
+           called.
+        */
+#if USE_MULTI_SOCKET
+    int epollFd;
+        /* The epoll instance that watches the sockets in 'watchList' */
+    struct list_head watchList;
+        /* The sockets libcurl has told us to watch (struct watchedSocket) */
+    bool timerSet;
+    xmlrpc_timespec timerDeadline;
+        /* When libcurl next has scheduled work to do.  Meaningless if
+           !timerSet; that means libcurl has nothing scheduled.
         */
+    struct epoll_event readyEvent[MAX_EVENTS];
+    unsigned int readyCt;
+        /* readyEvent[0] through readyEvent[readyCt-1] are what the last
+           wait found.  The next curlMulti_perform() tells libcurl about them.
+        */
+    bool pokeAll;
+        /* The next curlMulti_perform() should give every transfer a turn,
+           not just the ones whose sockets are ready.
+        */
+    int runningHandleCt;
+        /* What libcurl said the last time we asked it to do work */
+#else
     /* The following file descriptor sets are an integral part of the
-       CURLM object; Our curlMulti_fdset() routine binds them to the
-       CURLM object, and said object expects us to use them in a very
-       specific way, including doing a select() on them.  It is very,
-       very messy.
+       CURLM object; Our fdset() routine binds them to the CURLM object,
+       and said object expects us to use them in a very specific way,
+       including doing a select() on them.  It is very, very messy.
     */
     fd_set readFdSet;
     fd_set writeFdSet;
     fd_set exceptFdSet;
+#endif
 };
 
 
 
+#if USE_MULTI_SOCKET
+
+static void
+addMilliseconds(xmlrpc_timespec   const addend,
+                unsigned int      const adder,
+                xmlrpc_timespec * const sumP) {
+
+    unsigned int const million = 1000000;
+    unsigned int const billion = 1000000000;
+
+    xmlrpc_timespec sum;
+
+    sum.tv_sec  = addend.tv_sec + adder / 1000;
+    sum.tv_nsec = addend.tv_nsec + (adder % 1000) * million;
+
+    if ((uint32_t)sum.tv_nsec >= billion) {
+        sum.tv_sec += 1;
+        sum.tv_nsec -= billion;
+    }
+    *sumP = sum;
+}
+
+
+
+static int
+timeDiffMillisec(xmlrpc_timespec const minuend,
+                 xmlrpc_timespec const subtractor) {
+/*----------------------------------------------------------------------------
+   minuend - subtractor, in milliseconds, rounded up so that we don't
+   wake up just before a deadline.
+-----------------------------------------------------------------------------*/
+    unsigned int const million = 1000000;
+
+    return (minuend.tv_sec - subtractor.tv_sec) * 1000 +
+        (minuend.tv_nsec - subtractor.tv_nsec + million - 1) / million;
+}
+
+
+
+static bool
+setEpoll(curlMulti *            const curlMultiP,
+         struct watchedSocket * const sockP,
+         int                    const what) {
+/*----------------------------------------------------------------------------
+   Make the epoll set watch socket *sockP for what libcurl says it wants
+   ('what', a CURL_POLL_* value other than CURL_POLL_REMOVE).
+
+   Return true iff we can't.
+-----------------------------------------------------------------------------*/
+    struct epoll_event event;
+    int rc;
+
+    event.events =
+        ((what & CURL_POLL_IN)  ? EPOLLIN  : 0) |
+        ((what & CURL_POLL_OUT) ? EPOLLOUT : 0);
+    event.data.fd = sockP->fd;
+
+    if (event.events == 0) {
+        if (sockP->inEpoll)
+            epoll_ctl(curlMultiP->epollFd, EPOLL_CTL_DEL, sockP->fd, NULL);
+        sockP->inEpoll = false;
+        rc = 0;
+    } else if (sockP->inEpoll)
+        rc = epoll_ctl(curlMultiP->epollFd, EPOLL_CTL_MOD, sockP->fd, &event);
+    else {
+        rc = epoll_ctl(curlMultiP->epollFd, EPOLL_CTL_ADD, sockP->fd, &event);
+
+        if (rc < 0 && errno == EEXIST)
+            rc = epoll_ctl(curlMultiP->epollFd, EPOLL_CTL_MOD, sockP->fd,
+                           &event);
+        if (rc == 0)
+            sockP->inEpoll = true;
+    }
+    return rc < 0;
+}
+
+
+
+static int
+socketFunction(CURL *        const curlSessionP ATTR_UNUSED,
+               curl_socket_t const fd,
+               int           const what,
+               void *        const userp,
+               void *        const socketp) {
+/*----------------------------------------------------------------------------
+   This is libcurl's CURLMOPT_SOCKETFUNCTION: libcurl tells us what it
+   wants us to watch socket 'fd' for.  'socketp' is what we assigned to the
+   socket; NULL if we haven't seen it before.
+-----------------------------------------------------------------------------*/
+    curlMulti *            const curlMultiP = userp;
+    struct watchedSocket * const oldSockP   = socketp;
+
+    int retval;
+
+    if (what == CURL_POLL_REMOVE) {
+        if (oldSockP) {
+            if (oldSockP->inEpoll)
+                epoll_ctl(curlMultiP->epollFd, EPOLL_CTL_DEL, fd, NULL);
+            list_remove(&oldSockP->listHeader);
+            free(oldSockP);
+        }
+        retval = 0;
+    } else if (oldSockP)
+        retval = setEpoll(curlMultiP, oldSockP, what) ? -1 : 0;
+    else {
+        struct watchedSocket * sockP;
+
+        MALLOCVAR(sockP);
+
+        if (sockP == NULL)
+            retval = -1;
+        else {
+            sockP->fd      = fd;
+            sockP->inEpoll = false;
+
+            if (setEpoll(curlMultiP, sockP, what)) {
+                free(sockP);
+                retval = -1;
+            } else {
+                list_init_header(&sockP->listHeader, sockP);
+                list_add_tail(&curlMultiP->watchList, &sockP->listHeader);
+                curl_multi_assign(curlMultiP->curlMultiP, fd, sockP);
+                retval = 0;
+            }
+        }
+    }
+    return retval;
+}
+
+
+
+static int
+timerFunction(CURLM * const curlMultiP ATTR_UNUSED,
+              long    const timeoutMs,
+              void *  const userp) {
+/*----------------------------------------------------------------------------
+   This is libcurl's CURLMOPT_TIMERFUNCTION: libcurl tells us it has
+   scheduled work to do 'timeoutMs' milliseconds from now, or -1 to say it
+   has none.
+-----------------------------------------------------------------------------*/
+    curlMulti * const multiP = userp;
+
+    if (timeoutMs < 0)
+        multiP->timerSet = false;
+    else {
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&now);
+
+        addMilliseconds(now, (unsigned int)timeoutMs, &multiP->timerDeadline);
+
+        multiP->timerSet = true;
+    }
+    return 0;
+}
+
+
+
+static void
+destroyWatchList(curlMulti * const curlMultiP) {
+
+    while (!list_is_empty(&curlMultiP->watchList)) {
+        struct list_head * const headerP =
+            list_remove_head(&curlMultiP->watchList);
+
+        free(headerP->itemP);
+    }
+}
+
+
+
+static bool
+setupMultiSocket(curlMulti * const curlMultiP) {
+/*----------------------------------------------------------------------------
+   Get ready to drive the multi manager with libcurl's multi_socket
+   interface.
+
+   Return true iff we can't.
+-----------------------------------------------------------------------------*/
+    bool failed;
+
+    curlMultiP->epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (curlMultiP->epollFd < 0)
+        failed = true;
+    else {
+        list_make_empty(&curlMultiP->watchList);
+        curlMultiP->timerSet        = false;
+        curlMultiP->readyCt         = 0;
+        curlMultiP->pokeAll         = false;
+        curlMultiP->runningHandleCt = 0;
+
+        curl_multi_setopt(curlMultiP->curlMultiP, CURLMOPT_SOCKETFUNCTION,
+                          socketFunction);
+        curl_multi_setopt(curlMultiP->curlMultiP, CURLMOPT_SOCKETDATA,
+                          curlMultiP);
+        curl_multi_setopt(curlMultiP->curlMultiP, CURLMOPT_TIMERFUNCTION,
+                          timerFunction);
+        curl_multi_setopt(curlMultiP->curlMultiP, CURLMOPT_TIMERDATA,
+                          curlMultiP);
+        failed = false;
+    }
+    return failed;
+}
+
+
+
+static void
+takedownMultiSocket(curlMulti * const curlMultiP) {
+/*----------------------------------------------------------------------------
+   Undo setupMultiSocket().  The CURLM object is gone already; it may have
+   told us to stop watching its sockets as it closed them, or it may not
+   have.
+-----------------------------------------------------------------------------*/
+    destroyWatchList(curlMultiP);
+
+    close(curlMultiP->epollFd);
+}
+
+#endif  /* USE_MULTI_SOCKET */
+
+
+
 curlMulti *
 curlMulti_create(void) {
 
@@ -109,9 +417,18 @@ curlMulti_create(void) {
             curlMultiP->curlMultiP = curl_multi_init();
             if (curlMultiP->curlMultiP == NULL)
                 retval = NULL;
-            else
-                retval = curlMultiP;
-
+            else {
+                curlMultiP->handleCt       = 0;
+                curlMultiP->peakHandleCt   = 0;
+                curlMultiP->minMaxConnects = 0;
+#if USE_MULTI_SOCKET
+                if (setupMultiSocket(curlMultiP)) {
+                    curl_multi_cleanup(curlMultiP->curlMultiP);
+                    retval = NULL;
+                } else
+#endif
+                    retval = curlMultiP;
+            }
             if (retval == NULL)
                 curlMultiP->lockP->destroy(curlMultiP->lockP);
         }
@@ -128,6 +445,10 @@ curlMulti_destroy(curlMulti * const curlMultiP) {
 
     curl_multi_cleanup(curlMultiP->curlMultiP);
 
+#if USE_MULTI_SOCKET
+    takedownMultiSocket(curlMultiP);
+#endif
+
     curlMultiP->lockP->destroy(curlMultiP->lockP);
 
     free(curlMultiP);
@@ -135,6 +456,190 @@ curlMulti_destroy(curlMulti * const curlMultiP) {
 
 
 
+static void
+updateMaxConnects(curlMulti * const curlMultiP ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Set the most idle connections libcurl keeps open for the multi manager:
+   what curlMulti_setMaxConnects() said, or 4 per transfer the multi manager
+   has had at once lately, whichever is more.  4 per transfer is libcurl's
+   own default.
+
+   A limit below the number of connections in the cache makes libcurl look
+   for an idle connection to close every time a transfer finishes, and that
+   search takes time proportional to the number of connections.  So we don't
+   lower the limit as a burst of transfers finishes, only once they all
+   have.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+#if HAVE_CURL_MULTI_MAXCONNECTS
+    if (curlMultiP->minMaxConnects > 0)
+        curl_multi_setopt(curlMultiP->curlMultiP, CURLMOPT_MAXCONNECTS,
+                          (long)MAX(curlMultiP->minMaxConnects,
+                                    4 * curlMultiP->peakHandleCt));
+#endif
+}
+
+
+
+void
+curlMulti_setMaxConnects(curlMulti *  const curlMultiP,
+                         unsigned int const maxConnects) {
+/*----------------------------------------------------------------------------
+   Make libcurl keep open at least 'maxConnects' idle connections for the
+   multi manager.  When a transfer finishes and there are more than the
+   limit, libcurl closes the oldest.
+-----------------------------------------------------------------------------*/
+    curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+    curlMultiP->minMaxConnects = maxConnects;
+
+    updateMaxConnects(curlMultiP);
+
+    curlMultiP->lockP->release(curlMultiP->lockP);
+}
+
+
+
+#if USE_MULTI_SOCKET
+
+static void
+socketAction(xmlrpc_env *  const envP,
+             curlMulti *   const curlMultiP,
+             curl_socket_t const fd,
+             int           const evBitmask,
+             bool *        const immediateWorkToDoP) {
+/*----------------------------------------------------------------------------
+   Tell libcurl that 'evBitmask' (CURL_CSELECT_*) has happened on socket
+   'fd', or that its timer has expired if 'fd' is CURL_SOCKET_TIMEOUT, and
+   have it do the work for the transfers that affects.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    CURLMcode rc;
+
+    rc = curl_multi_socket_action(curlMultiP->curlMultiP, fd, evBitmask,
+                                  &curlMultiP->runningHandleCt);
+
+    if (rc == CURLM_CALL_MULTI_PERFORM)
+        *immediateWorkToDoP = true;
+    else if (rc != CURLM_OK && rc != CURLM_BAD_SOCKET) {
+        /* CURLM_BAD_SOCKET just means libcurl closed the socket after
+           our wait found it ready.
+        */
+        const char * reason;
+        interpretCurlMultiError(&reason, rc);
+        xmlrpc_faultf(envP, "Impossible failure of "
+                      "curl_multi_socket_action(): %s", reason);
+        xmlrpc_strfree(reason);
+    }
+}
+
+
+
+static void
+pokeAllSockets(xmlrpc_env * const envP,
+               curlMulti *  const curlMultiP,
+               bool *       const immediateWorkToDoP) {
+/*----------------------------------------------------------------------------
+   Have libcurl give a turn to the transfers on every socket we watch,
+   whether anything has happened on it or not.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    /* libcurl may tell us to stop watching sockets while we do this, so we
+       work from a copy of the list.
+    */
+    unsigned int const sockCt = list_count(&curlMultiP->watchList);
+
+    curl_socket_t * fds;
+
+    MALLOCARRAY(fds, sockCt);
+
+    if (fds == NULL)
+        xmlrpc_faultf(envP, "Couldn't get memory for a list of %u sockets",
+                      sockCt);
+    else {
+        struct list_head * p;
+        unsigned int i;
+
+        for (p = curlMultiP->watchList.nextP, i = 0;
+             p != &curlMultiP->watchList;
+             p = p->nextP, ++i) {
+
+            struct watchedSocket * const sockP = p->itemP;
+            fds[i] = sockP->fd;
+        }
+        for (i = 0; i < sockCt && !envP->fault_occurred; ++i)
+            socketAction(envP, curlMultiP, fds[i], 0, immediateWorkToDoP);
+
+        free(fds);
+    }
+}
+
+
+
+static void
+performMultiSocket(xmlrpc_env * const envP,
+                   curlMulti *  const curlMultiP,
+                   bool *       const immediateWorkToDoP) {
+/*----------------------------------------------------------------------------
+   Tell libcurl about whatever the last wait found, and about its timer if
+   that has expired, and have it do the work.
+
+   Caller must hold the lock.
+-----------------------------------------------------------------------------*/
+    unsigned int i;
+    bool timerDue;
+
+    *immediateWorkToDoP = false;
+
+    for (i = 0; i < curlMultiP->readyCt && !envP->fault_occurred; ++i) {
+        uint32_t const events = curlMultiP->readyEvent[i].events;
+
+        socketAction(envP, curlMultiP,
+                     curlMultiP->readyEvent[i].data.fd,
+                     ((events & EPOLLIN)  ? CURL_CSELECT_IN  : 0) |
+                     ((events & EPOLLOUT) ? CURL_CSELECT_OUT : 0) |
+                     ((events & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0),
+                     immediateWorkToDoP);
+    }
+    if (!envP->fault_occurred && curlMultiP->pokeAll)
+        pokeAllSockets(envP, curlMultiP, immediateWorkToDoP);
+
+    if (curlMultiP->timerSet) {
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&now);
+
+        timerDue = timeDiffMillisec(curlMultiP->timerDeadline, now) <= 0;
+    } else
+        timerDue = false;
+
+    /* The timer is one-shot: libcurl calls our timer function again while
+       it handles the expiry only if it has more scheduled work, and not
+       necessarily even then if that work is due at the same time.
+
+       If there was nothing else to do, we still ask libcurl about its
+       timer, because that's how we find out how many transfers are
+       still running.
+    */
+    if (timerDue)
+        curlMultiP->timerSet = false;
+
+    if (!envP->fault_occurred &&
+        (timerDue || curlMultiP->pokeAll || curlMultiP->readyCt == 0))
+        socketAction(envP, curlMultiP, CURL_SOCKET_TIMEOUT, 0,
+                     immediateWorkToDoP);
+
+    curlMultiP->readyCt = 0;
+    curlMultiP->pokeAll = false;
+}
+
+#endif  /* USE_MULTI_SOCKET */
+
+
+
 void
 curlMulti_perform(xmlrpc_env * const envP,
                   curlMulti *  const curlMultiP,
@@ -152,6 +657,15 @@ curlMulti_perform(xmlrpc_env * const envP,
    Return as *runningHandleCtP the number of Curl easy handles under the
    multi manager's control that are still running -- yet to finish.
 -----------------------------------------------------------------------------*/
+#if USE_MULTI_SOCKET
+    curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+    performMultiSocket(envP, curlMultiP, immediateWorkToDoP);
+
+    *runningHandleCtP = curlMultiP->runningHandleCt;
+
+    curlMultiP->lockP->release(curlMultiP->lockP);
+#else
     CURLMcode rc;
 
     curlMultiP->lockP->acquire(curlMultiP->lockP);
@@ -173,6 +687,28 @@ curlMulti_perform(xmlrpc_env * const envP,
             xmlrpc_strfree(reason);
         }
     }
+#endif
+}
+
+
+
+void
+curlMulti_pokeAll(curlMulti * const curlMultiP ATTR_UNUSED) {
+/*----------------------------------------------------------------------------
+   Make the next curlMulti_perform() give every transfer a turn, not just
+   the ones with something to do.  In particular, libcurl then calls every
+   transfer's progress function, which is how a transfer finds out it has
+   been interrupted.
+
+   Classic curl_multi_perform() gives every transfer a turn anyway.
+-----------------------------------------------------------------------------*/
+#if USE_MULTI_SOCKET
+    curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+    curlMultiP->pokeAll = true;
+
+    curlMultiP->lockP->release(curlMultiP->lockP);
+#endif
 }
 
 
@@ -188,6 +724,14 @@ curlMulti_addHandle(xmlrpc_env *       const envP,
 
     rc = curl_multi_add_handle(curlMultiP->curlMultiP, curlSessionP);
 
+    if (rc == CURLM_OK || rc == CURLM_CALL_MULTI_PERFORM) {
+        ++curlMultiP->handleCt;
+
+        if (curlMultiP->handleCt > curlMultiP->peakHandleCt) {
+            curlMultiP->peakHandleCt = curlMultiP->handleCt;
+            updateMaxConnects(curlMultiP);
+        }
+    }
     curlMultiP->lockP->release(curlMultiP->lockP);
 
     /* Old libcurl (e.g. 7.12) actually returns CURLM_CALL_MULTI_PERFORM
@@ -210,10 +754,20 @@ void
 curlMulti_removeHandle(curlMulti *       const curlMultiP,
                        CURL *            const curlSessionP) {
 
+    CURLMcode rc;
+
     curlMultiP->lockP->acquire(curlMultiP->lockP);
 
-    curl_multi_remove_handle(curlMultiP->curlMultiP, curlSessionP);
+    rc = curl_multi_remove_handle(curlMultiP->curlMultiP, curlSessionP);
+
+    if (rc == CURLM_OK) {
+        --curlMultiP->handleCt;
 
+        if (curlMultiP->handleCt == 0) {
+            curlMultiP->peakHandleCt = 0;
+            updateMaxConnects(curlMultiP);
+        }
+    }
     curlMultiP->lockP->release(curlMultiP->lockP);
 }
 
@@ -253,13 +807,15 @@ curlMulti_getMessage(curlMulti * const curlMultiP,
 
 
 
-void
-curlMulti_fdset(xmlrpc_env * const envP,
-                curlMulti *  const curlMultiP,
-                fd_set *     const readFdSetP,
-                fd_set *     const writeFdSetP,
-                fd_set *     const exceptFdSetP,
-                int *        const maxFdP) {
+#if !USE_MULTI_SOCKET
+
+static void
+fdset(xmlrpc_env * const envP,
+      curlMulti *  const curlMultiP,
+      fd_set *     const readFdSetP,
+      fd_set *     const writeFdSetP,
+      fd_set *     const exceptFdSetP,
+      int *        const maxFdP) {
 /*----------------------------------------------------------------------------
    Set the CURLM object's file descriptor sets to those in the
    curlMulti object, update those file descriptor sets with the
@@ -321,14 +877,14 @@ curlMulti_fdset(xmlrpc_env * const envP,
 
 
 
-void
-curlMulti_updateFdSet(curlMulti * const curlMultiP,
-                      fd_set      const readFdSet,
-                      fd_set      const writeFdSet,
-                      fd_set      const exceptFdSet) {
+static void
+updateFdSet(curlMulti * const curlMultiP,
+            fd_set      const readFdSet,
+            fd_set      const writeFdSet,
+            fd_set      const exceptFdSet) {
 /*----------------------------------------------------------------------------
    curl_multi_perform() expects the file descriptor sets, which were bound
-   to the CURLM object via a prior curlMulti_fdset(), to contain the results
+   to the CURLM object via a prior fdset(), to contain the results
    of a recent select().  This subroutine provides you a way to supply those.
 -----------------------------------------------------------------------------*/
     curlMultiP->readFdSet   = readFdSet;
@@ -338,3 +894,265 @@ curlMulti_updateFdSet(curlMulti * const curlMultiP,
 
 
 
+static void
+waitSelect(xmlrpc_env *            const envP,
+           curlMulti *             const curlMultiP,
+           const xmlrpc_timespec * const timeoutP,
+           sigset_t *              const sigmaskP) {
+
+    fd_set readFdSet;
+    fd_set writeFdSet;
+    fd_set exceptFdSet;
+    int maxFd;
+
+    fdset(envP, curlMultiP, &readFdSet, &writeFdSet, &exceptFdSet, &maxFd);
+
+    if (!envP->fault_occurred) {
+        if (maxFd == -1) {
+            /* There are no Curl file descriptors on which to wait.
+               So either there's work to do right now or all transactions
+               are already complete.
+
+               It may also be the case that there are Curl file descriptors on
+               which Caller should wait, but they are too high (> FD_SETSIZE)
+               to use with 'pselect'.  Libcurl doesn't provide a way to deal
+               with this case gracefully, so Caller will unfortunately end up
+               busywaiting for there to be work for libcurl to do.
+            */
+        } else {
+            int rc;
+
+            rc = xmlrpc_pselect(maxFd+1, &readFdSet, &writeFdSet, &exceptFdSet,
+                                timeoutP, sigmaskP);
+
+            if (rc < 0 && errno != EINTR)
+                xmlrpc_faultf(envP, "Impossible failure of pselect() "
+                              "with errno %d (%s)",
+                              errno, strerror(errno));
+            else {
+                /* Believe it or not, the Curl multi manager needs the
+                   results of our pselect().  So hand them over:
+                */
+                updateFdSet(curlMultiP, readFdSet, writeFdSet, exceptFdSet);
+            }
+        }
+    }
+}
+
+
+
+static void
+getPollfdsSelect(xmlrpc_env *           const envP,
+                 curlMulti *            const curlMultiP,
+                 struct xmlrpc_pollfd * const pollfds,
+                 unsigned int           const maxCt,
+                 unsigned int *         const pollfdCtP,
+                 int *                  const timeoutMsP) {
+
+    fd_set readFdSet;
+    fd_set writeFdSet;
+    fd_set exceptFdSet;
+    int maxFd;
+
+    fdset(envP, curlMultiP, &readFdSet, &writeFdSet, &exceptFdSet, &maxFd);
+
+    if (!envP->fault_occurred) {
+        unsigned int pollfdCt;
+        int fd;
+        long timeoutMs;
+
+        for (fd = 0, pollfdCt = 0; fd <= maxFd; ++fd) {
+            unsigned int const events =
+                (FD_ISSET(fd, &readFdSet)  ? XMLRPC_POLL_IN  : 0) |
+                (FD_ISSET(fd, &writeFdSet) ? XMLRPC_POLL_OUT : 0);
+
+            if (events) {
+                if (pollfdCt < maxCt) {
+                    pollfds[pollfdCt].fd     = fd;
+                    pollfds[pollfdCt].events = events;
+                }
+                ++pollfdCt;
+            }
+        }
+        curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+        if (curlMultiP->handleCt == 0)
+            timeoutMs = -1;
+        else if (maxFd == -1) {
+            /* Either there is work to do right now, or the transfers' file
+               descriptors are too high for curl_multi_fdset() to tell us
+               about.  Either way, all Caller can do is call us right back.
+            */
+            timeoutMs = 0;
+        } else {
+#if HAVE_CURL_MULTI_TIMEOUT
+            curl_multi_timeout(curlMultiP->curlMultiP, &timeoutMs);
+#else
+            /* We don't know when libcurl has scheduled work, so we assume
+               it is at least every 3 seconds, as the transport does.
+            */
+            timeoutMs = 3000;
+#endif
+        }
+        curlMultiP->lockP->release(curlMultiP->lockP);
+
+        *pollfdCtP  = pollfdCt;
+        *timeoutMsP = timeoutMs;
+    }
+}
+
+#else  /* USE_MULTI_SOCKET */
+
+static void
+waitEpoll(xmlrpc_env *            const envP,
+          curlMulti *             const curlMultiP,
+          const xmlrpc_timespec * const timeoutP,
+          sigset_t *              const sigmaskP) {
+
+    unsigned int const million = 1000000;
+
+    int timeoutMs;
+    bool nothingToWaitFor;
+
+    timeoutMs = timeoutP->tv_sec * 1000 +
+        (timeoutP->tv_nsec + million - 1) / million;
+
+    curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+    /* Libcurl's scheduled work is work to do just like a ready socket */
+    if (curlMultiP->timerSet) {
+        xmlrpc_timespec now;
+        int timerMs;
+
+        xmlrpc_gettimeofday(&now);
+
+        timerMs = timeDiffMillisec(curlMultiP->timerDeadline, now);
+
+        timeoutMs = MIN(timeoutMs, MAX(0, timerMs));
+    }
+    nothingToWaitFor =
+        !curlMultiP->timerSet && list_is_empty(&curlMultiP->watchList);
+
+    curlMultiP->readyCt = 0;
+
+    curlMultiP->lockP->release(curlMultiP->lockP);
+
+    if (nothingToWaitFor) {
+        /* All transactions are already complete, or there's work to do
+           right now.
+        */
+    } else {
+        struct epoll_event readyEvent[MAX_EVENTS];
+        int rc;
+
+        /* We don't hold the lock while we wait, so other threads can add
+           transfers meanwhile.  epoll lets libcurl change what the epoll
+           set watches while we wait on it.
+        */
+        rc = epoll_pwait(curlMultiP->epollFd, readyEvent, MAX_EVENTS,
+                         timeoutMs, sigmaskP);
+
+        if (rc < 0) {
+            if (errno != EINTR)
+                xmlrpc_faultf(envP, "Impossible failure of epoll_pwait() "
+                              "with errno %d (%s)",
+                              errno, strerror(errno));
+        } else {
+            curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+            memcpy(curlMultiP->readyEvent, readyEvent,
+                   rc * sizeof(readyEvent[0]));
+            curlMultiP->readyCt = rc;
+
+            curlMultiP->lockP->release(curlMultiP->lockP);
+        }
+    }
+}
+
+
+
+static void
+getPollfdsEpoll(curlMulti *            const curlMultiP,
+                struct xmlrpc_pollfd * const pollfds,
+                unsigned int           const maxCt,
+                unsigned int *         const pollfdCtP,
+                int *                  const timeoutMsP) {
+/*----------------------------------------------------------------------------
+   The epoll instance is readable whenever any socket it watches is ready,
+   so it is the only file descriptor Caller needs.
+-----------------------------------------------------------------------------*/
+    if (maxCt > 0) {
+        pollfds[0].fd     = curlMultiP->epollFd;
+        pollfds[0].events = XMLRPC_POLL_IN;
+    }
+    *pollfdCtP = 1;
+
+    curlMultiP->lockP->acquire(curlMultiP->lockP);
+
+    if (curlMultiP->pokeAll)
+        *timeoutMsP = 0;
+    else if (curlMultiP->timerSet) {
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&now);
+
+        *timeoutMsP = MAX(0, timeDiffMillisec(curlMultiP->timerDeadline, now));
+    } else
+        *timeoutMsP = -1;
+
+    curlMultiP->lockP->release(curlMultiP->lockP);
+}
+
+#endif  /* USE_MULTI_SOCKET */
+
+
+
+void
+curlMulti_wait(xmlrpc_env *            const envP,
+               curlMulti *             const curlMultiP,
+               const xmlrpc_timespec * const timeoutP,
+               sigset_t *              const sigmaskP) {
+/*----------------------------------------------------------------------------
+   Wait for the Curl multi manager to have work to do, for *timeoutP to
+   elapse, or for a signal to be received (and caught), whichever comes
+   first.  Remember what work we found, for the next curlMulti_perform().
+
+   Return immediately if there is nothing to wait for -- either there's
+   work to do right now or all transactions are already complete.
+
+   Wait under signal mask *sigmaskP, atomically unblocking whatever it
+   unblocks for the duration of the wait, as pselect() does.  If sigmaskP is
+   NULL, wait under whatever the current signal mask is.
+-----------------------------------------------------------------------------*/
+#if USE_MULTI_SOCKET
+    waitEpoll(envP, curlMultiP, timeoutP, sigmaskP);
+#else
+    waitSelect(envP, curlMultiP, timeoutP, sigmaskP);
+#endif
+}
+
+
+
+void
+curlMulti_getPollfds(xmlrpc_env *           const envP ATTR_UNUSED,
+                     curlMulti *            const curlMultiP,
+                     struct xmlrpc_pollfd * const pollfds,
+                     unsigned int           const maxCt,
+                     unsigned int *         const pollfdCtP,
+                     int *                  const timeoutMsP) {
+/*----------------------------------------------------------------------------
+   Tell what curlMulti_wait() would wait for, so Caller can wait for it
+   along with other things of its own:  the file descriptors in pollfds[]
+   becoming ready, and *timeoutMsP milliseconds passing (-1 means forever).
+   After that, Caller should call curlMulti_wait() with a zero timeout to
+   collect what happened, then curlMulti_perform().
+
+   We return at most 'maxCt' file descriptors, but *pollfdCtP is how many
+   there are.
+-----------------------------------------------------------------------------*/
+#if USE_MULTI_SOCKET
+    getPollfdsEpoll(curlMultiP, pollfds, maxCt, pollfdCtP, timeoutMsP);
+#else
+    getPollfdsSelect(envP, curlMultiP, pollfds, maxCt, pollfdCtP, timeoutMsP);
+#endif
+}
@@ -3,6 +3,9 @@
 
 #include "bool.h"
 #include "xmlrpc-c/util.h"
+#include "xmlrpc-c/client.h"  /* for struct xmlrpc_pollfd */
+#include "xmlrpc-c/select_int.h"  /* for sigset_t */
+#include "xmlrpc-c/time_int.h"
 
 #include "curltransaction.h"
 
@@ -14,6 +17,10 @@ curlMulti_create(void);
 void
 curlMulti_destroy(curlMulti * const curlMultiP);
 
+void
+curlMulti_setMaxConnects(curlMulti *  const curlMultiP,
+                         unsigned int const maxConnects);
+
 void
 curlMulti_perform(xmlrpc_env * const envP,
                   curlMulti *  const curlMultiP,
@@ -35,17 +42,20 @@ curlMulti_getMessage(curlMulti * const curlMultiP,
                      CURLMsg *   const curlMsgP);
 
 void
-curlMulti_fdset(xmlrpc_env * const envP,
-                curlMulti *  const curlMultiP,
-                fd_set *     const readFdSetP,
-                fd_set *     const writeFdSetP,
-                fd_set *     const exceptFdSetP,
-                int *        const maxFdP);
+curlMulti_pokeAll(curlMulti * const curlMultiP);
+
+void
+curlMulti_wait(xmlrpc_env *            const envP,
+               curlMulti *             const curlMultiP,
+               const xmlrpc_timespec * const timeoutP,
+               sigset_t *              const sigmaskP);
 
 void
-curlMulti_updateFdSet(curlMulti * const curlMultiP,
-                      fd_set      const readFdSet,
-                      fd_set      const writeFdSet,
-                      fd_set      const exceptFdSet);
+curlMulti_getPollfds(xmlrpc_env *           const envP,
+                     curlMulti *            const curlMultiP,
+                     struct xmlrpc_pollfd * const pollfds,
+                     unsigned int           const maxCt,
+                     unsigned int *         const pollfdCtP,
+                     int *                  const timeoutMsP);
 
 #endif
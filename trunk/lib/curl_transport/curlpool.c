@@ -0,0 +1,449 @@
+/*=============================================================================
+                               curlSessionPool
+===============================================================================
+   A pool of idle Curl sessions (CURL objects) for asynchronous RPCs, so
+   that an RPC can use a session an earlier RPC to the same server left
+   behind instead of creating one from scratch.
+
+   It also owns a Curl share object (CURLSH) that every session the
+   transport makes uses: the DNS cache and the TLS session cache.  So a new
+   RPC need not look up the server's name again and can resume a TLS
+   session rather than do a full handshake.
+
+   The share object does not share the cache of open connections.  libcurl
+   does not support sharing that between threads that run transfers at the
+   same time, and ours do: each synchronous RPC runs in its caller's thread
+   under a multi manager of its own.  So open connections stay in the
+   cache of the multi manager that opened them.
+
+   The share object shares cookies too, but libcurl uses them only in
+   sessions that have cookies turned on, which the pooled ones don't.
+
+   Sessions are pooled by server URL.  A session that has done one RPC to a
+   server has that server's name resolved and may have a connection open to
+   it, so that is who should get it next.
+=============================================================================*/
+
+#define _XOPEN_SOURCE 600  /* Make sure strdup() is in <string.h> */
+
+#include "xmlrpc_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+#ifdef NEED_CURL_TYPES_H
+#include <curl/types.h>
+#endif
+#include <curl/easy.h>
+
+#include "mallocvar.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/lock.h"
+#include "xmlrpc-c/lock_platform.h"
+
+#include "curlversion.h"
+
+#include "curlpool.h"
+
+
+
+struct serverPool {
+/*----------------------------------------------------------------------------
+   The idle sessions last used for RPCs to one server.
+-----------------------------------------------------------------------------*/
+    struct serverPool * nextP;
+    const char * serverUrl;
+    unsigned int idleCt;
+    CURL ** idle;
+        /* idle[0] through idle[idleCt-1] are the idle sessions.  The array
+           has room for the pool's 'maxIdlePerServer'.
+        */
+};
+
+
+
+struct curlSessionPool {
+    struct lock * lockP;
+        /* Hold this lock while accessing the members below */
+    unsigned int maxIdlePerServer;
+        /* The most idle sessions we keep for one server.  Zero means
+           we don't pool at all; every RPC gets a new session.
+        */
+    struct serverPool * serverListP;
+        /* Linked list of the servers for which we have pooled sessions.
+           A transport typically talks to a handful of servers, so we just
+           search it.
+        */
+    CURLSH * curlShareP;
+        /* The Curl share object every session we make uses */
+    struct lock * shareLockP[CURL_LOCK_DATA_LAST];
+        /* The locks libcurl asks us to hold while it accesses the various
+           kinds of data in *curlShareP, plus the one for the share object
+           itself (CURL_LOCK_DATA_SHARE).  NULL for a kind we don't share.
+        */
+    unsigned long hitCt;
+    unsigned long missCt;
+    unsigned long discardCt;
+};
+
+
+
+static void
+lockShare(CURL *           const curlSessionP ATTR_UNUSED,
+          curl_lock_data   const data,
+          curl_lock_access const access ATTR_UNUSED,
+          void *           const userptr) {
+
+    curlSessionPool * const poolP = userptr;
+
+    if (poolP->shareLockP[data])
+        poolP->shareLockP[data]->acquire(poolP->shareLockP[data]);
+}
+
+
+
+static void
+unlockShare(CURL *         const curlSessionP ATTR_UNUSED,
+            curl_lock_data const data,
+            void *         const userptr) {
+
+    curlSessionPool * const poolP = userptr;
+
+    if (poolP->shareLockP[data])
+        poolP->shareLockP[data]->release(poolP->shareLockP[data]);
+}
+
+
+
+static void
+destroyShareLocks(curlSessionPool * const poolP) {
+
+    unsigned int i;
+
+    for (i = 0; i < CURL_LOCK_DATA_LAST; ++i) {
+        if (poolP->shareLockP[i])
+            poolP->shareLockP[i]->destroy(poolP->shareLockP[i]);
+    }
+}
+
+
+
+static void
+shareData(curlSessionPool * const poolP,
+          curl_lock_data    const data,
+          bool *            const failedP) {
+/*----------------------------------------------------------------------------
+   Make the share object share data of kind 'data', under a lock of its own.
+
+   We need the lock because the sessions that use the share may be in
+   different threads; e.g. a synchronous RPC in one and asynchronous RPCs in
+   another.  libcurl does the locking itself, but only with the functions
+   we give it.
+-----------------------------------------------------------------------------*/
+    poolP->shareLockP[data] = xmlrpc_lock_create();
+
+    if (poolP->shareLockP[data] == NULL)
+        *failedP = true;
+    else {
+        curl_share_setopt(poolP->curlShareP, CURLSHOPT_SHARE, data);
+        *failedP = false;
+    }
+}
+
+
+
+static void
+createShare(curlSessionPool * const poolP,
+            bool *            const failedP) {
+
+    unsigned int i;
+
+    for (i = 0; i < CURL_LOCK_DATA_LAST; ++i)
+        poolP->shareLockP[i] = NULL;
+
+    poolP->curlShareP = curl_share_init();
+
+    if (poolP->curlShareP == NULL)
+        *failedP = true;
+    else {
+        bool failed;
+
+        /* libcurl locks CURL_LOCK_DATA_SHARE to guard the share object's
+           own bookkeeping while a session attaches to it or detaches from
+           it.  It isn't a kind of data one asks to share, but it needs a
+           lock all the same.
+        */
+        poolP->shareLockP[CURL_LOCK_DATA_SHARE] = xmlrpc_lock_create();
+        failed = (poolP->shareLockP[CURL_LOCK_DATA_SHARE] == NULL);
+
+        if (!failed)
+            shareData(poolP, CURL_LOCK_DATA_DNS, &failed);
+        if (!failed)
+            shareData(poolP, CURL_LOCK_DATA_SSL_SESSION, &failed);
+        if (!failed)
+            shareData(poolP, CURL_LOCK_DATA_COOKIE, &failed);
+        if (!failed) {
+            curl_share_setopt(poolP->curlShareP, CURLSHOPT_LOCKFUNC,
+                              lockShare);
+            curl_share_setopt(poolP->curlShareP, CURLSHOPT_UNLOCKFUNC,
+                              unlockShare);
+            curl_share_setopt(poolP->curlShareP, CURLSHOPT_USERDATA,
+                              poolP);
+        }
+        if (failed) {
+            curl_share_cleanup(poolP->curlShareP);
+            destroyShareLocks(poolP);
+        }
+        *failedP = failed;
+    }
+}
+
+
+
+curlSessionPool *
+curlSessionPool_create(unsigned int const maxIdlePerServer) {
+
+    curlSessionPool * retval;
+    curlSessionPool * poolP;
+
+    MALLOCVAR(poolP);
+
+    if (poolP == NULL)
+        retval = NULL;
+    else {
+        poolP->lockP = xmlrpc_lock_create();
+
+        if (poolP->lockP == NULL)
+            retval = NULL;
+        else {
+            bool failed;
+
+            createShare(poolP, &failed);
+
+            if (failed)
+                retval = NULL;
+            else {
+                poolP->maxIdlePerServer = maxIdlePerServer;
+                poolP->serverListP      = NULL;
+                poolP->hitCt            = 0;
+                poolP->missCt           = 0;
+                poolP->discardCt        = 0;
+
+                retval = poolP;
+            }
+            if (retval == NULL)
+                poolP->lockP->destroy(poolP->lockP);
+        }
+        if (retval == NULL)
+            free(poolP);
+    }
+    return retval;
+}
+
+
+
+void
+curlSessionPool_destroy(curlSessionPool * const poolP) {
+/*----------------------------------------------------------------------------
+   Destroy the pool and every idle session in it.
+
+   Every other session made with curlSessionPool_setupSession() must be
+   destroyed already, because it uses the share object we destroy here.
+-----------------------------------------------------------------------------*/
+    struct serverPool * serverP;
+    struct serverPool * nextP;
+
+    for (serverP = poolP->serverListP; serverP; serverP = nextP) {
+        unsigned int i;
+
+        nextP = serverP->nextP;
+
+        for (i = 0; i < serverP->idleCt; ++i)
+            curl_easy_cleanup(serverP->idle[i]);
+
+        free(serverP->idle);
+        xmlrpc_strfree(serverP->serverUrl);
+        free(serverP);
+    }
+    curl_share_cleanup(poolP->curlShareP);
+
+    destroyShareLocks(poolP);
+
+    poolP->lockP->destroy(poolP->lockP);
+
+    free(poolP);
+}
+
+
+
+void
+curlSessionPool_setupSession(curlSessionPool * const poolP,
+                             CURL *            const curlSessionP) {
+/*----------------------------------------------------------------------------
+   Make the new Curl session *curlSessionP use the pool's caches.
+
+   This sticks through curl_easy_reset(), so it is once per session.
+-----------------------------------------------------------------------------*/
+    curl_easy_setopt(curlSessionP, CURLOPT_SHARE, poolP->curlShareP);
+}
+
+
+
+static struct serverPool *
+serverPoolFor(curlSessionPool * const poolP,
+              const char *      const serverUrl) {
+/*----------------------------------------------------------------------------
+   The pool of sessions for server 'serverUrl'; NULL if there isn't one.
+
+   Caller must hold the pool lock.
+-----------------------------------------------------------------------------*/
+    struct serverPool * serverP;
+
+    for (serverP = poolP->serverListP;
+         serverP && !xmlrpc_streq(serverP->serverUrl, serverUrl);
+         serverP = serverP->nextP);
+
+    return serverP;
+}
+
+
+
+static struct serverPool *
+addServerPool(curlSessionPool * const poolP,
+              const char *      const serverUrl) {
+/*----------------------------------------------------------------------------
+   Add an empty pool for server 'serverUrl'.  Return NULL if we can't get
+   the memory.
+
+   Caller must hold the pool lock.
+-----------------------------------------------------------------------------*/
+    struct serverPool * serverP;
+
+    MALLOCVAR(serverP);
+
+    if (serverP) {
+        MALLOCARRAY(serverP->idle, poolP->maxIdlePerServer);
+        serverP->serverUrl = strdup(serverUrl);
+
+        if (serverP->idle == NULL || serverP->serverUrl == NULL) {
+            if (serverP->idle)
+                free(serverP->idle);
+            if (serverP->serverUrl)
+                xmlrpc_strfree(serverP->serverUrl);
+            free(serverP);
+            serverP = NULL;
+        } else {
+            serverP->idleCt = 0;
+            serverP->nextP  = poolP->serverListP;
+            poolP->serverListP = serverP;
+        }
+    }
+    return serverP;
+}
+
+
+
+void
+curlSessionPool_get(xmlrpc_env *      const envP,
+                    curlSessionPool * const poolP,
+                    const char *      const serverUrl,
+                    CURL **           const curlSessionPP) {
+/*----------------------------------------------------------------------------
+   Get a Curl session for an RPC to server 'serverUrl': an idle one from the
+   pool if there is one, or a new one.
+
+   Either way, its options are all default except that it uses the pool's
+   caches.  When the RPC is done, give it back with curlSessionPool_put().
+-----------------------------------------------------------------------------*/
+    struct serverPool * serverP;
+    CURL * curlSessionP;
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    serverP = serverPoolFor(poolP, serverUrl);
+
+    if (serverP && serverP->idleCt > 0) {
+        curlSessionP = serverP->idle[--serverP->idleCt];
+        ++poolP->hitCt;
+    } else {
+        curlSessionP = NULL;
+        ++poolP->missCt;
+    }
+    poolP->lockP->release(poolP->lockP);
+
+    if (curlSessionP == NULL) {
+        curlSessionP = curl_easy_init();
+
+        if (curlSessionP == NULL)
+            xmlrpc_faultf(envP, "Could not create Curl session.  "
+                          "curl_easy_init() failed.");
+        else
+            curlSessionPool_setupSession(poolP, curlSessionP);
+    }
+    *curlSessionPP = curlSessionP;
+}
+
+
+
+void
+curlSessionPool_put(curlSessionPool * const poolP,
+                    const char *      const serverUrl,
+                    CURL *            const curlSessionP) {
+/*----------------------------------------------------------------------------
+   Give back Curl session *curlSessionP, which Caller got from
+   curlSessionPool_get() for an RPC to server 'serverUrl' and is done
+   with.
+
+   We keep it for the next RPC to that server if there is room for it;
+   otherwise we destroy it.
+-----------------------------------------------------------------------------*/
+    bool kept;
+
+    /* This forgets the options the RPC set, but not the connection
+       or the caches.
+    */
+    curl_easy_reset(curlSessionP);
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    if (poolP->maxIdlePerServer > 0) {
+        struct serverPool * serverP;
+
+        serverP = serverPoolFor(poolP, serverUrl);
+
+        if (!serverP)
+            serverP = addServerPool(poolP, serverUrl);
+
+        if (serverP && serverP->idleCt < poolP->maxIdlePerServer) {
+            serverP->idle[serverP->idleCt++] = curlSessionP;
+            kept = true;
+        } else
+            kept = false;
+    } else
+        kept = false;
+
+    if (!kept)
+        ++poolP->discardCt;
+
+    poolP->lockP->release(poolP->lockP);
+
+    if (!kept)
+        curl_easy_cleanup(curlSessionP);
+}
+
+
+
+void
+curlSessionPool_getStats(curlSessionPool *              const poolP,
+                         struct xmlrpc_curl_poolstats * const statsP) {
+
+    poolP->lockP->acquire(poolP->lockP);
+
+    statsP->hits     = poolP->hitCt;
+    statsP->misses   = poolP->missCt;
+    statsP->discards = poolP->discardCt;
+
+    poolP->lockP->release(poolP->lockP);
+}
@@ -0,0 +1,36 @@
+#ifndef CURLPOOL_H_INCLUDED
+#define CURLPOOL_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/client.h"
+#include <curl/curl.h>
+
+typedef struct curlSessionPool curlSessionPool;
+
+curlSessionPool *
+curlSessionPool_create(unsigned int const maxIdlePerServer);
+
+void
+curlSessionPool_destroy(curlSessionPool * const poolP);
+
+void
+curlSessionPool_setupSession(curlSessionPool * const poolP,
+                             CURL *            const curlSessionP);
+
+void
+curlSessionPool_get(xmlrpc_env *      const envP,
+                    curlSessionPool * const poolP,
+                    const char *      const serverUrl,
+                    CURL **           const curlSessionPP);
+
+void
+curlSessionPool_put(curlSessionPool * const poolP,
+                    const char *      const serverUrl,
+                    CURL *            const curlSessionP);
+
+void
+curlSessionPool_getStats(curlSessionPool *              const poolP,
+                         struct xmlrpc_curl_poolstats * const statsP);
+
+#endif
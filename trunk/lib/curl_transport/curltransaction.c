@@ -14,6 +14,7 @@
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/client.h"
 #include "xmlrpc-c/client_int.h"
+#include "xmlrpc-c/compress_int.h"
 #include "version.h"
 
 #include <curl/curl.h>
@@ -108,6 +109,10 @@ struct curlTransaction {
         /* The URL for the transaction */
     xmlrpc_mem_block * postDataP;
         /* The data to send for the POST method */
+    xmlrpc_mem_block * compressedPostDataP;
+        /* The gzip-compressed version of *postDataP, which is what we
+           actually send if this is non-null.
+        */
     xmlrpc_mem_block * responseDataP;
         /* This is normally where to put the body of the HTTP response.  But
            because of a quirk of Curl, if the response is not valid HTTP,
@@ -295,6 +300,7 @@ createCurlHeaderList(xmlrpc_env *               const envP,
                      const char *               const authHdrValue,
                      bool                       const dontAdvertise,
                      const char *               const userAgent,
+                     bool                       const gzipped,
                      struct curl_slist **       const headerListP) {
 
     struct curl_slist * headerList;
@@ -310,6 +316,8 @@ createCurlHeaderList(xmlrpc_env *               const envP,
         }
         if (!envP->fault_occurred)
             addExpectHeader(envP, &headerList);
+        if (!envP->fault_occurred && gzipped)
+            addHeader(envP, &headerList, "Content-Encoding: gzip");
     }
     if (envP->fault_occurred)
         curl_slist_free_all(headerList);
@@ -752,6 +760,51 @@ setupOldOpenSslOpts(CURL *                   const curlSessionP,
 
 
 
+static void
+setupPostData(xmlrpc_env *             const envP,
+              curlTransaction *        const transP,
+              const struct curlSetup * const curlSetupP) {
+/*----------------------------------------------------------------------------
+   Set up the Curl session for the transaction *transP to send the call
+   *transP->postDataP as the body of the POST.
+
+   If the transport is set up to compress calls and this one is big enough
+   to be worth it, we send it gzip-compressed and create
+   *transP->compressedPostDataP to hold that.  The server has to be able to
+   decode that; there's no way to know before we send it.
+-----------------------------------------------------------------------------*/
+    CURL * const curlSessionP = transP->curlSessionP;
+    size_t const postLen = XMLRPC_MEMBLOCK_SIZE(char, transP->postDataP);
+
+    transP->compressedPostDataP = NULL;
+
+    if (curlSetupP->compressionLevel > 0 &&
+        postLen >= curlSetupP->compressionThreshold &&
+        xmlrpc_compressionAvailable()) {
+
+        xmlrpc_compress(envP, XMLRPC_CODING_GZIP,
+                        curlSetupP->compressionLevel,
+                        XMLRPC_MEMBLOCK_CONTENTS(char, transP->postDataP),
+                        postLen,
+                        &transP->compressedPostDataP);
+    }
+    if (!envP->fault_occurred) {
+        xmlrpc_mem_block * const bodyP =
+            transP->compressedPostDataP ?
+            transP->compressedPostDataP : transP->postDataP;
+        size_t const bodyLen = XMLRPC_MEMBLOCK_SIZE(char, bodyP);
+
+        /* We always say the size because a compressed body isn't a string
+           and the Curl session may be reused for the next call.
+        */
+        curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDSIZE, (long)bodyLen);
+        curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDS,
+                         XMLRPC_MEMBLOCK_CONTENTS(char, bodyP));
+    }
+}
+
+
+
 static void
 setupCurlSession(xmlrpc_env *               const envP,
                  curlTransaction *          const transP,
@@ -805,10 +858,8 @@ setupCurlSession(xmlrpc_env *               const envP,
                          CURLOPT_UNIX_SOCKET_PATH, unixSocketPath);
     }
 
-    XMLRPC_MEMBLOCK_APPEND(char, envP, transP->postDataP, "\0", 1);
+    setupPostData(envP, transP, curlSetupP);
     if (!envP->fault_occurred) {
-        curl_easy_setopt(curlSessionP, CURLOPT_POSTFIELDS,
-                         XMLRPC_MEMBLOCK_CONTENTS(char, transP->postDataP));
         curl_easy_setopt(curlSessionP, CURLOPT_WRITEFUNCTION, collect);
         curl_easy_setopt(curlSessionP, CURLOPT_FILE, transP->responseDataP);
             /* CURLOPT_FILE is the older name for CURLOPT_WRITEDATA */
@@ -890,6 +941,14 @@ setupCurlSession(xmlrpc_env *               const envP,
         if (curlSetupP->verbose)
             curl_easy_setopt(curlSessionP, CURLOPT_VERBOSE, 1l);
 
+        if (curlSetupP->acceptCompressed)
+            curl_easy_setopt(curlSessionP, CURLOPT_ENCODING, "");
+                /* CURLOPT_ENCODING is the older name for
+                   CURLOPT_ACCEPT_ENCODING.  The null string means every
+                   coding this libcurl can decode.  libcurl then decodes the
+                   response as it arrives, so 'collect' sees plain XML.
+                */
+
         if (curlSetupP->timeout)
             setCurlTimeout(curlSessionP, curlSetupP->timeout);
 
@@ -927,6 +986,7 @@ setupCurlSession(xmlrpc_env *               const envP,
                 struct curl_slist * headerList;
                 createCurlHeaderList(envP, authHdrValue,
                                      dontAdvertise, userAgent,
+                                     !!transP->compressedPostDataP,
                                      &headerList);
                 if (!envP->fault_occurred) {
                     curl_easy_setopt(
@@ -987,6 +1047,9 @@ curlTransaction_create(xmlrpc_env *               const envP,
                          curlSetupStuffP);
 
         if (envP->fault_occurred) {
+            if (curlTransactionP->compressedPostDataP)
+                XMLRPC_MEMBLOCK_FREE(char,
+                                     curlTransactionP->compressedPostDataP);
             xmlrpc_strfree(curlTransactionP->serverUrl);
             free(curlTransactionP);
         }
@@ -1002,6 +1065,9 @@ curlTransaction_destroy(curlTransaction * const curlTransactionP) {
     curl_slist_free_all(curlTransactionP->headerList);
     xmlrpc_strfree(curlTransactionP->serverUrl);
 
+    if (curlTransactionP->compressedPostDataP)
+        XMLRPC_MEMBLOCK_FREE(char, curlTransactionP->compressedPostDataP);
+
     free(curlTransactionP);
 }
 
@@ -95,6 +95,13 @@ struct curlSetup {
     unsigned int tcpKeepidle;
     unsigned int tcpKeepintvl;
 
+    unsigned int compressionLevel;
+        /* zlib level at which to compress calls; 0 means don't */
+    size_t       compressionThreshold;
+        /* Don't compress a call smaller than this */
+    bool         acceptCompressed;
+        /* Ask the server for a compressed response */
+
     bool verbose;
 };
 
@@ -26,6 +26,24 @@
   #define HAVE_CURL_KEEPALIVE 0
 #endif
 
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 17)
+  #define HAVE_CURL_MULTI_MAXCONNECTS 1
+#else
+  #define HAVE_CURL_MULTI_MAXCONNECTS 0
+#endif
+
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 16)
+  #define HAVE_CURL_MULTI_SOCKET 1
+#else
+  #define HAVE_CURL_MULTI_SOCKET 0
+#endif
+
+#if CMAJOR > 7 || (CMAJOR == 7 && CMINOR >= 16)
+  #define HAVE_CURL_MULTI_TIMEOUT 1
+#else
+  #define HAVE_CURL_MULTI_TIMEOUT 0
+#endif
+
 #undef CMAJOR
 #undef CMINOR
 
@@ -92,6 +92,7 @@
 
 #include "curltransaction.h"
 #include "curlmulti.h"
+#include "curlpool.h"
 #include "curlversion.h"
 
 #if MSVCRT
@@ -107,6 +108,12 @@
 
 typedef struct rpc rpc;
 
+#define MAX_IDLE_CONNECTIONS 64
+    /* The most idle connections to servers the transport keeps open for
+       asynchronous RPCs.  (Each synchronous session keeps its own, under
+       libcurl's default limit).
+    */
+
 
 
 static void
@@ -187,32 +194,45 @@ addMilliseconds(xmlrpc_timespec   const addend,
 
 
 
-struct xmlrpc_client_transport {
-    CURL * syncCurlSessionP;
-        /* Handle for a Curl library session object that we use for
-           all synchronous RPCs.  An async RPC has one of its own,
-           and consequently does not share things such as persistent
-           connections and cookies with any other RPC.
-        */
-    struct lock * syncCurlSessionLockP;
-        /* Hold this lock while accessing or using *syncCurlSessionP.
-           You're using the session from the time you set any
-           attributes in it or start a transaction with it until any
-           transaction has finished and you've lost interest in any
-           attributes of the session.
-        */
-    curlMulti * syncCurlMultiP;
-        /* The Curl multi manager that this transport uses to execute
-           Curl transactions for RPCs requested via the synchronous
-           interface.  The fact that there is never more than one such
-           transaction going at a time might make you wonder why a
+struct syncSession {
+/*----------------------------------------------------------------------------
+   A Curl session for synchronous RPCs, with the Curl multi manager that
+   executes its transactions.  One synchronous RPC at a time uses it.
+-----------------------------------------------------------------------------*/
+    struct syncSession * nextP;
+    CURL * curlSessionP;
+    curlMulti * curlMultiP;
+        /* The Curl multi manager that executes the Curl transactions on
+           'curlSessionP'.  The fact that there is never more than one
+           such transaction going at a time might make you wonder why a
            "multi" manager is needed.  The reason is that it is the only
            interface in libcurl that gives us the flexibility to execute
-           the transaction with proper interruptibility.  The only Curl
-           transaction ever attached to this multi manager is
-           'syncCurlSessionP'.
+           the transaction with proper interruptibility.
+        */
+};
 
-           This is constant (the handle, not the object).
+
+
+struct xmlrpc_client_transport {
+    struct syncSession * idleSyncSessionListP;
+        /* The Curl sessions for synchronous RPCs that no RPC is using now,
+           as a stack.  A synchronous RPC takes one (or makes one if there
+           are none) and puts it back when it is done, so the transport
+           has as many as the most synchronous RPCs that have ever been in
+           progress at once, in different threads.
+
+           These sessions share cookies with each other, via the share
+           object in 'sessionPoolP'.  An async RPC has a session of its own
+           from 'sessionPoolP', and consequently does not share cookies
+           with any other RPC.
+
+           Each session's multi manager has its own cache of open
+           connections, so a session reuses the connections it opened
+           itself, but no other session's.
+        */
+    struct lock * syncSessionListLockP;
+        /* Hold this lock while accessing 'idleSyncSessionListP'.  Not
+           while using a session you took from it -- that's yours.
         */
     curlMulti * asyncCurlMultiP;
         /* The Curl multi manager that this transport uses to execute
@@ -248,6 +268,20 @@ struct xmlrpc_client_transport {
         */
     struct curlSetup curlSetupStuff;
         /* This is constant */
+    unsigned int sessionPoolSize;
+        /* The most idle Curl sessions 'sessionPoolP' keeps for one server.
+           Zero means it keeps none.
+
+           This is constant.
+        */
+    curlSessionPool * sessionPoolP;
+        /* Where asynchronous RPCs get their Curl sessions and return them
+           when they are done.  Every Curl session the transport makes,
+           including the ones for synchronous RPCs, uses its DNS, TLS
+           session, and cookie caches.
+
+           This is constant (the handle, not the object).
+        */
     int * interruptP;
         /* Pointer to a value that user sets to nonzero to indicate he wants
            the transport to give up on whatever it is doing and return ASAP.
@@ -263,6 +297,10 @@ struct xmlrpc_client_transport {
 struct rpc {
     struct xmlrpc_client_transport * transportP;
         /* The client XML transport that transports this RPC */
+    const char * serverUrl;
+        /* The URL of the server to which the RPC goes.  Ours; the
+           requester may destroy its server info before the RPC finishes.
+        */
     curlTransaction * curlTransactionP;
         /* The object which does the HTTP transaction, with no knowledge
            of XML-RPC or Xmlrpc-c.
@@ -287,17 +325,17 @@ struct rpc {
 
 
 static void
-lockSyncCurlSession(struct xmlrpc_client_transport * const transportP) {
-    transportP->syncCurlSessionLockP->acquire(
-        transportP->syncCurlSessionLockP);
+lockSyncSessionList(struct xmlrpc_client_transport * const transportP) {
+    transportP->syncSessionListLockP->acquire(
+        transportP->syncSessionListLockP);
 }
 
 
 
 static void
-unlockSyncCurlSession(struct xmlrpc_client_transport * const transportP) {
-    transportP->syncCurlSessionLockP->release(
-        transportP->syncCurlSessionLockP);
+unlockSyncSessionList(struct xmlrpc_client_transport * const transportP) {
+    transportP->syncSessionListLockP->release(
+        transportP->syncSessionListLockP);
 }
 
 
@@ -367,27 +405,27 @@ curlHasNosignal(void) {
 
 
 static xmlrpc_timespec
-pselectTimeout(xmlrpc_timeoutType const timeoutType,
-               xmlrpc_timespec    const timeoutDt) {
+waitTimeout(xmlrpc_timeoutType const timeoutType,
+            xmlrpc_timespec    const timeoutDt) {
 /*----------------------------------------------------------------------------
-   Return the value that should be used in the select() call to wait for
-   there to be work for the Curl multi manager to do, given that the user
-   wants to timeout according to 'timeoutType' and 'timeoutDt'.
+   Return how long we should wait for there to be work for the Curl multi
+   manager to do, given that the user wants to timeout according to
+   'timeoutType' and 'timeoutDt'.
 -----------------------------------------------------------------------------*/
     unsigned int const million = 1000000;
 
-    unsigned int selectTimeoutMillisec;
+    unsigned int waitTimeoutMillisec;
     xmlrpc_timespec retval;
 
-    /* We assume there is work to do at least every 3 seconds, because
-       the Curl multi manager often has retries and other scheduled work
-       that doesn't involve file handles on which we can select().
-       One thing that might cause work to do without any file handle becoming
-       ready is Curl timing out a request.
+    /* We assume there is work to do at least every 3 seconds.  Where
+       libcurl tells us when it has scheduled work (e.g. timing out a
+       request), the wait ends then anyway, but with the classic select()
+       interface we don't know, and either way another thread may give the
+       multi manager a new transaction while we wait.
     */
     switch (timeoutType) {
     case timeout_no:
-        selectTimeoutMillisec = 3000;
+        waitTimeoutMillisec = 3000;
         break;
     case timeout_yes: {
         xmlrpc_timespec nowTime;
@@ -396,41 +434,109 @@ pselectTimeout(xmlrpc_timeoutType const timeoutType,
         xmlrpc_gettimeofday(&nowTime);
         timeLeft = timeDiffMillisec(timeoutDt, nowTime);
 
-        selectTimeoutMillisec = MIN(3000, MAX(0, timeLeft));
+        waitTimeoutMillisec = MIN(3000, MAX(0, timeLeft));
     } break;
     }
-    retval.tv_sec = selectTimeoutMillisec / 1000;
-    retval.tv_nsec = (uint32_t)((selectTimeoutMillisec % 1000) * million);
+    retval.tv_sec = waitTimeoutMillisec / 1000;
+    retval.tv_nsec = (uint32_t)((waitTimeoutMillisec % 1000) * million);
 
     return retval;
 }
 
 
 
+static void
+getCurlMessages(curlMulti *    const curlMultiP,
+                CURLMsg **     const curlMsgsP,
+                unsigned int * const msgCtP,
+                bool *         const endOfMessagesP) {
+/*----------------------------------------------------------------------------
+   Take all the messages off the Curl multi manager's queue and return them
+   as a newly malloc'ed array.
+
+   If we run out of memory, return just the ones we have room for, with
+   *endOfMessagesP false to say there are more in the queue.
+-----------------------------------------------------------------------------*/
+    CURLMsg * curlMsgs;
+    unsigned int allocCt;
+    unsigned int msgCt;
+    bool endOfMessages;
+    bool full;
+
+    curlMsgs = NULL;
+    allocCt  = 0;
+    msgCt    = 0;
+    endOfMessages = false;
+    full = false;
+
+    while (!endOfMessages && !full) {
+        if (msgCt >= allocCt) {
+            unsigned int const newAllocCt = MAX(64, allocCt * 2);
+
+            CURLMsg * const newCurlMsgs =
+                realloc(curlMsgs, newAllocCt * sizeof(curlMsgs[0]));
+
+            if (newCurlMsgs) {
+                curlMsgs = newCurlMsgs;
+                allocCt  = newAllocCt;
+            } else
+                full = true;
+        }
+        if (!full) {
+            curlMulti_getMessage(curlMultiP, &endOfMessages,
+                                 &curlMsgs[msgCt]);
+            if (!endOfMessages)
+                ++msgCt;
+        }
+    }
+    *curlMsgsP      = curlMsgs;
+    *msgCtP         = msgCt;
+    *endOfMessagesP = endOfMessages;
+}
+
+
+
 static void
 processCurlMessages(xmlrpc_env * const envP,
                     curlMulti *  const curlMultiP) {
 
+    /* We take all the messages off the queue before acting on any of them,
+       because finishing a transaction removes its Curl session from the
+       multi manager, and libcurl searches the message queue for messages
+       about the session when it does that.  With thousands of transactions
+       finishing at once, going one message at a time would take time
+       proportional to the square of the number of them.
+    */
     bool endOfMessages;
 
     endOfMessages = false;   /* initial assumption */
 
     while (!endOfMessages && !envP->fault_occurred) {
-        CURLMsg curlMsg;
+        CURLMsg * curlMsgs;
+        unsigned int msgCt;
+
+        getCurlMessages(curlMultiP, &curlMsgs, &msgCt, &endOfMessages);
 
-        curlMulti_getMessage(curlMultiP, &endOfMessages, &curlMsg);
+        if (msgCt == 0 && !endOfMessages)
+            xmlrpc_faultf(envP, "Couldn't get memory for the Curl multi "
+                          "manager's messages");
+        else {
+            unsigned int i;
 
-        if (!endOfMessages) {
-            if (curlMsg.msg == CURLMSG_DONE) {
-                curlTransaction * curlTransactionP;
+            for (i = 0; i < msgCt && !envP->fault_occurred; ++i) {
+                if (curlMsgs[i].msg == CURLMSG_DONE) {
+                    curlTransaction * curlTransactionP;
 
-                curl_easy_getinfo(curlMsg.easy_handle, CURLINFO_PRIVATE,
-                                  (void *)&curlTransactionP);
+                    curl_easy_getinfo(curlMsgs[i].easy_handle,
+                                      CURLINFO_PRIVATE,
+                                      (void *)&curlTransactionP);
 
-                curlTransaction_finish(envP,
-                                       curlTransactionP, curlMsg.data.result);
+                    curlTransaction_finish(envP, curlTransactionP,
+                                           curlMsgs[i].data.result);
+                }
             }
         }
+        free(curlMsgs);
     }
 }
 
@@ -446,8 +552,7 @@ waitForWork(xmlrpc_env *       const envP,
    Wait for the Curl multi manager to have work to do, time to run out,
    or a signal to be received (and caught), whichever comes first.
 
-   Update the Curl multi manager's file descriptor sets to indicate what
-   work we found for it to do.
+   Tell the Curl multi manager what work we found for it to do.
 
    Wait under signal mask *sigmaskP.  The point of this is that Caller can
    make sure that arrival of a signal of a certain class interrupts our wait,
@@ -457,58 +562,19 @@ waitForWork(xmlrpc_env *       const envP,
    NOT blocked.  Thus, if a signal of that class arrived any time after Caller
    checked, we will return immediately and if it arrives while we're waiting,
    we will return then.  Note that we can provide this service only because
-   pselect() has the same atomic unblock/wait feature.
+   pselect() and epoll_pwait() have the same atomic unblock/wait feature.
 
    If sigmaskP is NULL, wait under whatever the current signal mask is.
 -----------------------------------------------------------------------------*/
-    fd_set readFdSet;
-    fd_set writeFdSet;
-    fd_set exceptFdSet;
-    int maxFd;
+    xmlrpc_timespec const waitTimeoutArg = waitTimeout(timeoutType, deadline);
 
-    trace("Waiting for work");
+    trace("Waiting for a Curl file descriptor to be ready or %u.%03u sec",
+          waitTimeoutArg.tv_sec, waitTimeoutArg.tv_nsec/1000000);
 
-    curlMulti_fdset(envP, curlMultiP,
-                    &readFdSet, &writeFdSet, &exceptFdSet, &maxFd);
-    if (!envP->fault_occurred) {
-        if (maxFd == -1) {
-            /* There are no Curl file descriptors on which to wait.
-               So either there's work to do right now or all transactions
-               are already complete.
-
-               It may also be the case that there are Curl file descriptors on
-               which Caller should wait, but they are too high (> FD_SETSIZE)
-               to use with 'pselect'.  Libcurl doesn't provide a way to deal
-               with this case gracefully, so Caller will unfortunately end up
-               busywaiting for there to be work for libcurl to do.
-            */
-        } else {
-            xmlrpc_timespec const pselectTimeoutArg =
-                pselectTimeout(timeoutType, deadline);
-
-            int rc;
-
-            trace("No work available; waiting for a Curl file descriptor to "
-                  "be ready or %u.%03u sec",
-                  pselectTimeoutArg.tv_sec, pselectTimeoutArg.tv_nsec/1000000);
-
-            rc = xmlrpc_pselect(maxFd+1, &readFdSet, &writeFdSet, &exceptFdSet,
-                                &pselectTimeoutArg, sigmaskP);
-
-            if (rc < 0 && errno != EINTR)
-                xmlrpc_faultf(envP, "Impossible failure of pselect() "
-                              "with errno %d (%s)",
-                              errno, strerror(errno));
-            else {
-                /* Believe it or not, the Curl multi manager needs the
-                   results of our pselect().  So hand them over:
-                */
-                curlMulti_updateFdSet(curlMultiP,
-                                      readFdSet, writeFdSet, exceptFdSet);
-            }
-        }
+    curlMulti_wait(envP, curlMultiP, &waitTimeoutArg, sigmaskP);
+
+    if (!envP->fault_occurred)
         trace("Wait is over");
-    }
 }
 
 
@@ -661,9 +727,16 @@ finishCurlMulti(xmlrpc_env *       const envP,
                of libcurl calling its progress function when we tell it to do
                all available work).
             */
-            if (interruptP && *interruptP)
+            if (interruptP && *interruptP) {
                 curlCalledSinceInterrupt = true;
 
+                /* libcurl ordinarily does work only for the transactions
+                   whose connections are ready, and those aren't necessarily
+                   the ones that need to see the interrupt.
+                */
+                curlMulti_pokeAll(curlMultiP);
+            }
+
             doCurlWork(envP, curlMultiP, &rpcStillRunning);
 
             xmlrpc_gettimeofday(&nowTime);
@@ -734,6 +807,38 @@ getConnectTimeoutParm(
 
 
 
+static void
+getCompressionParms(
+    xmlrpc_env *                          const envP,
+    const struct xmlrpc_curl_xportparms * const curlXportParmsP,
+    size_t                                const parmSize,
+    struct curlSetup *                    const curlSetupP) {
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(compression_level))
+        curlSetupP->compressionLevel = 0;
+    else {
+        if (curlXportParmsP->compression_level > 9)
+            xmlrpc_faultf(envP, "Compression level %u is invalid.  "
+                          "zlib levels are 1 through 9",
+                          curlXportParmsP->compression_level);
+        else
+            curlSetupP->compressionLevel = curlXportParmsP->compression_level;
+    }
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(compression_threshold)
+        || curlXportParmsP->compression_threshold == 0)
+        curlSetupP->compressionThreshold = 1024;
+    else
+        curlSetupP->compressionThreshold =
+            curlXportParmsP->compression_threshold;
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(accept_compressed))
+        curlSetupP->acceptCompressed = false;
+    else
+        curlSetupP->acceptCompressed = !!curlXportParmsP->accept_compressed;
+}
+
+
+
 static void
 setVerbose(bool * const verboseP) {
 
@@ -962,6 +1067,20 @@ getXportParms(xmlrpc_env *                          const envP,
         curlSetupP->tcpKeepintvl = 0;
     else
         curlSetupP->tcpKeepintvl = curlXportParmsP->tcp_keepintvl_sec;
+
+    getCompressionParms(envP, curlXportParmsP, parmSize, curlSetupP);
+
+    if (!curlXportParmsP || parmSize < XMLRPC_CXPSIZE(no_session_pool) ||
+        !curlXportParmsP->no_session_pool) {
+
+        if (!curlXportParmsP ||
+            parmSize < XMLRPC_CXPSIZE(session_pool_size) ||
+            curlXportParmsP->session_pool_size == 0)
+            transportP->sessionPoolSize = 8;
+        else
+            transportP->sessionPoolSize = curlXportParmsP->session_pool_size;
+    } else
+        transportP->sessionPoolSize = 0;
 }
 
 
@@ -1010,8 +1129,9 @@ freeXportParms(const struct xmlrpc_client_transport * const transportP) {
 
 
 static void
-createSyncCurlSession(xmlrpc_env * const envP,
-                      CURL **      const curlSessionPP) {
+createSyncCurlSession(xmlrpc_env *      const envP,
+                      curlSessionPool * const sessionPoolP,
+                      CURL **           const curlSessionPP) {
 /*----------------------------------------------------------------------------
    Create a Curl session to be used for multiple serial transactions.
    The Curl session we create is not complete -- it still has to be
@@ -1047,6 +1167,8 @@ createSyncCurlSession(xmlrpc_env * const envP,
         */
         curl_easy_setopt(curlSessionP, CURLOPT_COOKIEFILE, "");
 
+        curlSessionPool_setupSession(sessionPoolP, curlSessionP);
+
         *curlSessionPP = curlSessionP;
     }
 }
@@ -1062,44 +1184,136 @@ destroySyncCurlSession(CURL * const curlSessionP) {
 
 
 static void
-makeSyncCurlSession(xmlrpc_env *                     const envP,
-                    struct xmlrpc_client_transport * const transportP) {
+createSyncSession(xmlrpc_env *                     const envP,
+                  struct xmlrpc_client_transport * const transportP,
+                  struct syncSession **            const syncSessionPP) {
 
-    transportP->syncCurlSessionLockP = xmlrpc_lock_create();
-    if (transportP->syncCurlSessionLockP == NULL)
-        xmlrpc_faultf(envP, "Unable to create lock for "
-                      "synchronous Curl session.");
+    struct syncSession * syncSessionP;
+
+    MALLOCVAR(syncSessionP);
+
+    if (syncSessionP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate memory for "
+                      "synchronous Curl session");
     else {
-        createSyncCurlSession(envP, &transportP->syncCurlSessionP);
+        createSyncCurlSession(envP, transportP->sessionPoolP,
+                              &syncSessionP->curlSessionP);
 
         if (!envP->fault_occurred) {
             /* We'll need a multi manager to actually execute this session: */
-            transportP->syncCurlMultiP = curlMulti_create();
+            syncSessionP->curlMultiP = curlMulti_create();
 
-            if (transportP->syncCurlMultiP == NULL)
+            if (syncSessionP->curlMultiP == NULL)
                 xmlrpc_faultf(envP, "Unable to create Curl multi manager for "
                               "synchronous RPCs");
 
             if (envP->fault_occurred)
-                destroySyncCurlSession(transportP->syncCurlSessionP);
+                destroySyncCurlSession(syncSessionP->curlSessionP);
         }
         if (envP->fault_occurred)
-            transportP->syncCurlSessionLockP->destroy(
-                transportP->syncCurlSessionLockP);
+            free(syncSessionP);
     }
+    *syncSessionPP = syncSessionP;
 }
 
 
 
 static void
-unmakeSyncCurlSession(struct xmlrpc_client_transport * const transportP) {
+destroySyncSession(struct syncSession * const syncSessionP) {
 
-    curlMulti_destroy(transportP->syncCurlMultiP);
+    curlMulti_destroy(syncSessionP->curlMultiP);
 
-    destroySyncCurlSession(transportP->syncCurlSessionP);
+    destroySyncCurlSession(syncSessionP->curlSessionP);
 
-    transportP->syncCurlSessionLockP->destroy(
-        transportP->syncCurlSessionLockP);
+    free(syncSessionP);
+}
+
+
+
+static void
+getSyncSession(xmlrpc_env *                     const envP,
+               struct xmlrpc_client_transport * const transportP,
+               struct syncSession **            const syncSessionPP) {
+/*----------------------------------------------------------------------------
+   Get a Curl session for a synchronous RPC: one that no other RPC is
+   using, so the RPC can proceed at the same time as synchronous RPCs in
+   other threads.  When the RPC is done, give it back with
+   putSyncSession().
+-----------------------------------------------------------------------------*/
+    struct syncSession * syncSessionP;
+
+    lockSyncSessionList(transportP);
+
+    syncSessionP = transportP->idleSyncSessionListP;
+    if (syncSessionP)
+        transportP->idleSyncSessionListP = syncSessionP->nextP;
+
+    unlockSyncSessionList(transportP);
+
+    if (syncSessionP)
+        *syncSessionPP = syncSessionP;
+    else
+        createSyncSession(envP, transportP, syncSessionPP);
+}
+
+
+
+static void
+putSyncSession(struct xmlrpc_client_transport * const transportP,
+               struct syncSession *             const syncSessionP) {
+
+    lockSyncSessionList(transportP);
+
+    syncSessionP->nextP = transportP->idleSyncSessionListP;
+    transportP->idleSyncSessionListP = syncSessionP;
+
+    unlockSyncSessionList(transportP);
+}
+
+
+
+static void
+makeSyncSessionList(xmlrpc_env *                     const envP,
+                    struct xmlrpc_client_transport * const transportP) {
+/*----------------------------------------------------------------------------
+   Set up the list of Curl sessions for synchronous RPCs, with one session
+   in it, which is all a program that does one synchronous RPC at a time
+   ever needs.
+-----------------------------------------------------------------------------*/
+    transportP->syncSessionListLockP = xmlrpc_lock_create();
+    if (transportP->syncSessionListLockP == NULL)
+        xmlrpc_faultf(envP, "Unable to create lock for "
+                      "synchronous Curl sessions.");
+    else {
+        createSyncSession(envP, transportP,
+                          &transportP->idleSyncSessionListP);
+
+        if (!envP->fault_occurred)
+            transportP->idleSyncSessionListP->nextP = NULL;
+        else
+            transportP->syncSessionListLockP->destroy(
+                transportP->syncSessionListLockP);
+    }
+}
+
+
+
+static void
+unmakeSyncSessionList(struct xmlrpc_client_transport * const transportP) {
+
+    struct syncSession * syncSessionP;
+    struct syncSession * nextP;
+
+    for (syncSessionP = transportP->idleSyncSessionListP;
+         syncSessionP;
+         syncSessionP = nextP) {
+
+        nextP = syncSessionP->nextP;
+
+        destroySyncSession(syncSessionP);
+    }
+    transportP->syncSessionListLockP->destroy(
+        transportP->syncSessionListLockP);
 }
 
 
@@ -1134,14 +1348,29 @@ create(xmlrpc_env *                      const envP,
             xmlrpc_faultf(envP, "Unable to create Curl multi manager for "
                           "asynchronous RPCs");
         else {
+            curlMulti_setMaxConnects(transportP->asyncCurlMultiP,
+                                     MAX_IDLE_CONNECTIONS);
+
             getXportParms(envP, curlXportParmsP, parm_size, transportP);
 
+            /* getXportParms() can fail only after it has gotten all
+               the strings, so freeXportParms() is right either way.
+            */
             if (!envP->fault_occurred) {
-                makeSyncCurlSession(envP, transportP);
+                transportP->sessionPoolP =
+                    curlSessionPool_create(transportP->sessionPoolSize);
 
-                if (envP->fault_occurred)
-                    freeXportParms(transportP);
+                if (transportP->sessionPoolP == NULL)
+                    xmlrpc_faultf(envP, "Unable to create Curl session pool");
+                else {
+                    makeSyncSessionList(envP, transportP);
+
+                    if (envP->fault_occurred)
+                        curlSessionPool_destroy(transportP->sessionPoolP);
+                }
             }
+            if (envP->fault_occurred)
+                freeXportParms(transportP);
             if (envP->fault_occurred)
                 curlMulti_destroy(transportP->asyncCurlMultiP);
         }
@@ -1197,23 +1426,31 @@ destroy(struct xmlrpc_client_transport * const clientTransportP) {
    flag to 1 first, which will make all outstanding RPCs fail
    immediately.
 -----------------------------------------------------------------------------*/
+    struct syncSession * syncSessionP;
+
     XMLRPC_ASSERT(clientTransportP != NULL);
 
     assertNoOutstandingCurlWork(clientTransportP->asyncCurlMultiP);
         /* We know this is true because a condition of destroying the
            transport is that there be no outstanding asynchronous RPCs.
         */
-    assertNoOutstandingCurlWork(clientTransportP->syncCurlMultiP);
+    for (syncSessionP = clientTransportP->idleSyncSessionListP;
+         syncSessionP;
+         syncSessionP = syncSessionP->nextP)
+        assertNoOutstandingCurlWork(syncSessionP->curlMultiP);
         /* This is because a condition of destroying the transport is
            that no transport method be running.  The only way a
            synchronous RPC can be in progress is for the 'perform' method
-           to be running.
+           to be running.  That also means every synchronous session is
+           idle, i.e. in the list.
         */
 
-    unmakeSyncCurlSession(clientTransportP);
+    unmakeSyncSessionList(clientTransportP);
 
     curlMulti_destroy(clientTransportP->asyncCurlMultiP);
 
+    curlSessionPool_destroy(clientTransportP->sessionPoolP);
+
     freeXportParms(clientTransportP);
 
     free(clientTransportP);
@@ -1308,29 +1545,36 @@ createRpc(xmlrpc_env *                     const envP,
             curlProgressFn = NULL;
         }
         rpcP->transportP   = clientTransportP;
+        rpcP->serverUrl    = strdup(serverP->serverUrl);
         rpcP->curlSessionP = curlSessionP;
         rpcP->callInfoP    = callInfoP;
         rpcP->complete     = complete;
         rpcP->progress     = progress;
         rpcP->responseXmlP = responseXmlP;
 
-        curlTransaction_create(envP,
-                               curlSessionP,
-                               serverP,
-                               callXmlP, responseXmlP,
-                               clientTransportP->dontAdvertise,
-                               clientTransportP->userAgent,
-                               &clientTransportP->curlSetupStuff,
-                               rpcP,
-                               complete ? &finishRpcCurlTransaction : NULL,
-                               curlProgressFn,
-                               &rpcP->curlTransactionP);
+        if (rpcP->serverUrl == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate memory for server URL");
+        else
+            curlTransaction_create(envP,
+                                   curlSessionP,
+                                   serverP,
+                                   callXmlP, responseXmlP,
+                                   clientTransportP->dontAdvertise,
+                                   clientTransportP->userAgent,
+                                   &clientTransportP->curlSetupStuff,
+                                   rpcP,
+                                   complete ? &finishRpcCurlTransaction : NULL,
+                                   curlProgressFn,
+                                   &rpcP->curlTransactionP);
         if (!envP->fault_occurred) {
             if (envP->fault_occurred)
                 curlTransaction_destroy(rpcP->curlTransactionP);
         }
-        if (envP->fault_occurred)
+        if (envP->fault_occurred) {
+            if (rpcP->serverUrl)
+                xmlrpc_strfree(rpcP->serverUrl);
             free(rpcP);
+        }
     }
     *rpcPP = rpcP;
 }
@@ -1344,6 +1588,8 @@ destroyRpc(rpc * const rpcP) {
 
     curlTransaction_destroy(rpcP->curlTransactionP);
 
+    xmlrpc_strfree(rpcP->serverUrl);
+
     free(rpcP);
 }
 
@@ -1372,8 +1618,9 @@ finishRpcCurlTransaction(xmlrpc_env * const envP ATTR_UNUSED,
 
   Tell the requester of the RPC the results.
 
-  Remove the Curl session from its Curl multi manager and destroy the
-  Curl session, the XML response buffer, the Curl transaction, and the RPC.
+  Remove the Curl session from its Curl multi manager and give it back to
+  the session pool.  Destroy the XML response buffer, the Curl transaction,
+  and the RPC.
 -----------------------------------------------------------------------------*/
     rpc * const rpcP = userContextP;
     curlTransaction * const curlTransactionP = rpcP->curlTransactionP;
@@ -1394,7 +1641,8 @@ finishRpcCurlTransaction(xmlrpc_env * const envP ATTR_UNUSED,
         xmlrpc_env_clean(&env);
     }
 
-    curl_easy_cleanup(rpcP->curlSessionP);
+    curlSessionPool_put(transportP->sessionPoolP, rpcP->serverUrl,
+                        rpcP->curlSessionP);
 
     XMLRPC_MEMBLOCK_FREE(char, rpcP->responseXmlP);
 
@@ -1479,12 +1727,12 @@ sendRequest(xmlrpc_env *                     const envP,
 
     responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
     if (!envP->fault_occurred) {
-        CURL * const curlSessionP = curl_easy_init();
+        CURL * curlSessionP;
 
-        if (curlSessionP == NULL)
-            xmlrpc_faultf(envP, "Could not create Curl session.  "
-                          "curl_easy_init() failed.");
-        else {
+        curlSessionPool_get(envP, clientTransportP->sessionPoolP,
+                            serverP->serverUrl, &curlSessionP);
+
+        if (!envP->fault_occurred) {
             createRpc(envP, clientTransportP, curlSessionP, serverP,
                       callXmlP, responseXmlP, complete, progress, callInfoP,
                       &rpcP);
@@ -1496,14 +1744,15 @@ sendRequest(xmlrpc_env *                     const envP,
                     destroyRpc(rpcP);
             }
             if (envP->fault_occurred)
-                curl_easy_cleanup(curlSessionP);
+                curlSessionPool_put(clientTransportP->sessionPoolP,
+                                    serverP->serverUrl, curlSessionP);
         }
         if (envP->fault_occurred)
             XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
     }
     /* If we're returning success, the user's eventual finish_asynch
-       call will destroy this RPC, Curl session, and response buffer
-       and remove the Curl session from the Curl multi manager.
+       call will destroy this RPC and response buffer, remove the Curl
+       session from the Curl multi manager, and give it back to the pool.
        (If we're returning failure, we didn't create any of those).
     */
 }
@@ -1526,13 +1775,8 @@ finishAsynch(
 
    This does the 'finish_asynch' operation for a Curl client transport.
 
-   It would be cool to replace this with something analogous to the
-   Curl asynchronous interface: Have something like curl_multi_fdset()
-   that returns a bunch of file descriptors on which the user can wait
-   (along with possibly other file descriptors of his own) and
-   something like curl_multi_perform() to finish whatever RPCs are
-   ready to finish at that moment.  The implementation would be little
-   more than wrapping curl_multi_fdset() and curl_multi_perform().
+   To wait in some other event loop instead, the user calls getPollfds()
+   and performAsynch().
 
    Note that the user can call this multiple times, because of timeouts,
    but must eventually call it once with no timeout so he
@@ -1585,6 +1829,60 @@ finishAsynch(
 
 
 
+static void
+getPollfds(xmlrpc_env *                     const envP,
+           struct xmlrpc_client_transport * const clientTransportP,
+           struct xmlrpc_pollfd *           const pollfds,
+           unsigned int                     const maxCt,
+           unsigned int *                   const pollfdCtP,
+           int *                            const timeoutMsP) {
+/*----------------------------------------------------------------------------
+   Tell what the outstanding asynchronous RPCs are waiting for, so the user
+   can wait for it in an event loop of the user's own and then call
+   performAsynch().
+
+   This does the 'get_pollfds' operation for a Curl client transport.
+-----------------------------------------------------------------------------*/
+    curlMulti_getPollfds(envP, clientTransportP->asyncCurlMultiP,
+                         pollfds, maxCt, pollfdCtP, timeoutMsP);
+}
+
+
+
+static void
+performAsynch(xmlrpc_env *                     const envP,
+              struct xmlrpc_client_transport * const clientTransportP) {
+/*----------------------------------------------------------------------------
+   Do whatever work the Curl multi manager has ready for the outstanding
+   asynchronous RPCs, and finish the RPCs that completes.  Don't wait.
+
+   This is one turn of the loop in finishCurlMulti(), with the wait done by
+   the user instead of us.
+
+   This does the 'perform_asynch' operation for a Curl client transport.
+-----------------------------------------------------------------------------*/
+    curlMulti * const curlMultiP = clientTransportP->asyncCurlMultiP;
+
+    xmlrpc_timespec noWait;
+
+    noWait.tv_sec  = 0;
+    noWait.tv_nsec = 0;
+
+    /* This just collects what the user's wait found */
+    curlMulti_wait(envP, curlMultiP, &noWait, NULL);
+
+    if (!envP->fault_occurred) {
+        bool rpcStillRunning;
+
+        if (clientTransportP->interruptP && *clientTransportP->interruptP)
+            curlMulti_pokeAll(curlMultiP);
+
+        doCurlWork(envP, curlMultiP, &rpcStillRunning);
+    }
+}
+
+
+
 static void
 call(xmlrpc_env *                     const envP,
      struct xmlrpc_client_transport * const clientTransportP,
@@ -1602,25 +1900,30 @@ call(xmlrpc_env *                     const envP,
 
     responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
     if (!envP->fault_occurred) {
-        /* Only one RPC at a time can use a Curl session, so we have to
-           hold the lock as long as our RPC exists.
+        /* Only one RPC at a time can use a Curl session, so we need one
+           of our own as long as our RPC exists.
         */
-        lockSyncCurlSession(clientTransportP);
-        createRpc(envP, clientTransportP, clientTransportP->syncCurlSessionP,
-                  serverP,
-                  callXmlP, responseXmlP,
-                  NULL, NULL, NULL,
-                  &rpcP);
+        struct syncSession * syncSessionP;
+
+        getSyncSession(envP, clientTransportP, &syncSessionP);
 
         if (!envP->fault_occurred) {
-            performRpc(envP, rpcP, clientTransportP->syncCurlMultiP,
-                       clientTransportP->interruptP);
+            createRpc(envP, clientTransportP, syncSessionP->curlSessionP,
+                      serverP,
+                      callXmlP, responseXmlP,
+                      NULL, NULL, NULL,
+                      &rpcP);
 
-            *responseXmlPP = responseXmlP;
+            if (!envP->fault_occurred) {
+                performRpc(envP, rpcP, syncSessionP->curlMultiP,
+                           clientTransportP->interruptP);
+
+                *responseXmlPP = responseXmlP;
 
-            destroyRpc(rpcP);
+                destroyRpc(rpcP);
+            }
+            putSyncSession(clientTransportP, syncSessionP);
         }
-        unlockSyncCurlSession(clientTransportP);
         if (envP->fault_occurred)
             XMLRPC_MEMBLOCK_FREE(char, responseXmlP);
     }
@@ -1661,6 +1964,22 @@ teardownGlobalConstants(void) {
 
 
 
+void
+xmlrpc_curl_transport_get_pool_stats(
+    struct xmlrpc_client_transport * const transportP,
+    struct xmlrpc_curl_poolstats *   const statsP) {
+/*----------------------------------------------------------------------------
+   Report how well the transport's pool of Curl sessions for asynchronous
+   RPCs has worked, since the transport was created.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_PTR_OK(transportP);
+    XMLRPC_ASSERT_PTR_OK(statsP);
+
+    curlSessionPool_getStats(transportP->sessionPoolP, statsP);
+}
+
+
+
 struct xmlrpc_client_transport_ops xmlrpc_curl_transport_ops = {
     &setupGlobalConstants,
     &teardownGlobalConstants,
@@ -1670,4 +1989,6 @@ struct xmlrpc_client_transport_ops xmlrpc_curl_transport_ops = {
     &call,
     &finishAsynch,
     &setInterrupt,
+    &getPollfds,
+    &performAsynch,
 };
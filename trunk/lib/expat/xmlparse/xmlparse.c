@@ -3101,8 +3101,12 @@ processContentToken(XML_Parser       const xmlParserP,
             reportDefault(xmlParserP, enc, s, *nextP);
         result = doCdataSection(xmlParserP, enc, nextP, end, nextPtr);
         if (!*nextP) {
+            /* The section doesn't end in this buffer; the rest of it goes
+               to cdataSectionProcessor when more arrives.
+            */
             processor = cdataSectionProcessor;
             *errorCodeP = result;
+            *doneP = true;
         }
     } break;
     case XML_TOK_TRAILING_RSQB:
@@ -2,7 +2,12 @@
 
 #include "xmlrpc_config.h"
 
+#if HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "bool.h"
+#include "girmath.h"
 #include "xmlrpc-c/util_int.h"
 #include "int.h"
 #include "xmlrpc-c/base64_int.h"
@@ -142,11 +147,428 @@ static char table_a2b_base64[] = {
 
 #define BASE64_PAD '='
 #define BASE64_MAXBIN 57    /* Max binary chunk size (76 char line) */
-#define BASE64_LINE_SZ 128      /* Buffer size for a single line. */    
 
 static unsigned char const table_b2a_base64[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/* The encode and decode kernels work on whole groups: 3 bytes of binary,
+   4 characters of base64.  Where the CPU has vector instructions, they do
+   4 or 8 groups at a time.  The code that calls them deals with line
+   breaks, padding, and anything else out of the ordinary.
+*/
+
+typedef size_t EncodeFn(const unsigned char * const in,
+                        size_t                const inLen,
+                        size_t                const inAvail,
+                        unsigned char *       const out);
+    /* Encode as many whole groups from the front of in[] (of length
+       'inLen') as there are, into out[].  Return the number of bytes
+       encoded.  We may look at, but don't encode, bytes up to
+       in[inAvail-1].
+    */
+
+typedef size_t DecodeFn(const char *    const in,
+                        size_t          const inLen,
+                        unsigned char * const out,
+                        size_t          const outRoom);
+    /* Decode as much from the front of in[] (of length 'inLen') as we
+       can with vector instructions, into out[], which has room for
+       'outRoom' bytes.  That means whole vectors of nothing but base64
+       digits.  Return the number of characters decoded.
+    */
+
+
+
+static size_t
+encodeScalar(const unsigned char * const in,
+             size_t                const inLen,
+             size_t                const inAvail ATTR_UNUSED,
+             unsigned char *       const out) {
+
+    unsigned char * p;
+    size_t i;
+
+    for (i = 0, p = &out[0]; i + 3 <= inLen; i += 3) {
+        uint32_t const group = in[i] << 16 | in[i+1] << 8 | in[i+2];
+
+        *p++ = table_b2a_base64[(group >> 18) & 0x3f];
+        *p++ = table_b2a_base64[(group >> 12) & 0x3f];
+        *p++ = table_b2a_base64[(group >>  6) & 0x3f];
+        *p++ = table_b2a_base64[(group >>  0) & 0x3f];
+    }
+    return i;
+}
+
+
+
+#if HAVE_X86_SIMD
+
+/* The vector kernels are after Wojciech Mula and Daniel Lemire, "Faster
+   Base64 Encoding and Decoding Using AVX2 Instructions" (2018).
+*/
+
+__attribute__((target("ssse3")))
+static __m128i
+encodeLookupSsse3(__m128i const indices) {
+/*----------------------------------------------------------------------------
+   The base64 digits for the 16 6-bit numbers 'indices'.
+-----------------------------------------------------------------------------*/
+    __m128i const shiftLut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+
+    __m128i const less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+
+    __m128i range;
+        /* 0 for 26-51, 1-10 for 52-61, 11 for 62, 12 for 63, 13 for 0-25 */
+
+    range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+
+    return _mm_add_epi8(indices, _mm_shuffle_epi8(shiftLut, range));
+}
+
+
+
+__attribute__((target("ssse3")))
+static size_t
+encodeSsse3(const unsigned char * const in,
+            size_t                const inLen,
+            size_t                const inAvail,
+            unsigned char *       const out) {
+
+    __m128i const shuf =
+        _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+
+    size_t i, o;
+
+    for (i = 0, o = 0; i + 12 <= inLen && i + 16 <= inAvail;
+         i += 12, o += 16) {
+        __m128i const v =
+            _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&in[i]), shuf);
+        __m128i const hi = _mm_mulhi_epu16(
+            _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)),
+            _mm_set1_epi32(0x04000040));
+        __m128i const lo = _mm_mullo_epi16(
+            _mm_and_si128(v, _mm_set1_epi32(0x003f03f0)),
+            _mm_set1_epi32(0x01000010));
+
+        _mm_storeu_si128((__m128i *)&out[o],
+                         encodeLookupSsse3(_mm_or_si128(hi, lo)));
+    }
+    return i + encodeScalar(&in[i], inLen - i, inAvail - i, &out[o]);
+}
+
+
+
+__attribute__((target("avx2")))
+static __m256i
+encodeLookupAvx2(__m256i const indices) {
+
+    __m256i const shiftLut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+        '/' - 63, 'A', 0, 0);
+
+    __m256i const less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+
+    __m256i range;
+
+    range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    range = _mm256_or_si256(range,
+                            _mm256_and_si256(less, _mm256_set1_epi8(13)));
+
+    return _mm256_add_epi8(indices, _mm256_shuffle_epi8(shiftLut, range));
+}
+
+
+
+__attribute__((target("avx2")))
+static size_t
+encodeAvx2(const unsigned char * const in,
+           size_t                const inLen,
+           size_t                const inAvail,
+           unsigned char *       const out) {
+
+    __m256i const shuf = _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+
+    size_t i, o;
+
+    for (i = 0, o = 0; i + 24 <= inLen && i + 28 <= inAvail;
+         i += 24, o += 32) {
+        /* Each 128 bit lane gets 12 bytes */
+        __m256i const v = _mm256_shuffle_epi8(
+            _mm256_inserti128_si256(
+                _mm256_castsi128_si256(
+                    _mm_loadu_si128((const __m128i *)&in[i])),
+                _mm_loadu_si128((const __m128i *)&in[i + 12]), 1),
+            shuf);
+        __m256i const hi = _mm256_mulhi_epu16(
+            _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+            _mm256_set1_epi32(0x04000040));
+        __m256i const lo = _mm256_mullo_epi16(
+            _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+            _mm256_set1_epi32(0x01000010));
+
+        _mm256_storeu_si256((__m256i *)&out[o],
+                            encodeLookupAvx2(_mm256_or_si256(hi, lo)));
+    }
+    return i + encodeSsse3(&in[i], inLen - i, inAvail - i, &out[o]);
+}
+
+
+
+__attribute__((target("ssse3")))
+static size_t
+decodeSsse3(const char *    const in,
+            size_t          const inLen,
+            unsigned char * const out,
+            size_t          const outRoom) {
+
+    /* A character is a base64 digit if and only if the bits lutLo gives
+       for its low nibble and lutHi gives for its high nibble don't meet.
+       lutRoll gives what to add to a digit to get its value.
+    */
+    __m128i const lutLo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    __m128i const lutHi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    __m128i const lutRoll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i const pack = _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    __m128i const nibble = _mm_set1_epi8(0x0f);
+
+    size_t i, o;
+
+    for (i = 0, o = 0; i + 16 <= inLen && o + 16 <= outRoom;
+         i += 16, o += 12) {
+        __m128i const v = _mm_loadu_si128((const __m128i *)&in[i]);
+        __m128i const hiNibbles =
+            _mm_and_si128(_mm_srli_epi32(v, 4), nibble);
+        __m128i const loNibbles = _mm_and_si128(v, nibble);
+        __m128i const bad = _mm_and_si128(_mm_shuffle_epi8(lutLo, loNibbles),
+                                          _mm_shuffle_epi8(lutHi, hiNibbles));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128()))
+            != 0xffff)
+            break;
+        else {
+            __m128i const isSlash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+            __m128i const values = _mm_add_epi8(
+                v, _mm_shuffle_epi8(lutRoll,
+                                    _mm_add_epi8(isSlash, hiNibbles)));
+            __m128i const pairs =
+                _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+            __m128i const groups =
+                _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+            _mm_storeu_si128((__m128i *)&out[o],
+                             _mm_shuffle_epi8(groups, pack));
+        }
+    }
+    return i;
+}
+
+
+
+__attribute__((target("avx2")))
+static size_t
+decodeAvx2(const char *    const in,
+           size_t          const inLen,
+           unsigned char * const out,
+           size_t          const outRoom) {
+
+    __m256i const lutLo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    __m256i const lutHi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    __m256i const lutRoll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    __m256i const pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    __m256i const nibble = _mm256_set1_epi8(0x0f);
+
+    size_t i, o;
+
+    for (i = 0, o = 0; i + 32 <= inLen && o + 32 <= outRoom;
+         i += 32, o += 24) {
+        __m256i const v = _mm256_loadu_si256((const __m256i *)&in[i]);
+        __m256i const hiNibbles =
+            _mm256_and_si256(_mm256_srli_epi32(v, 4), nibble);
+        __m256i const loNibbles = _mm256_and_si256(v, nibble);
+        __m256i const bad =
+            _mm256_and_si256(_mm256_shuffle_epi8(lutLo, loNibbles),
+                             _mm256_shuffle_epi8(lutHi, hiNibbles));
+
+        if (_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(bad, _mm256_setzero_si256())) != -1)
+            break;
+        else {
+            __m256i const isSlash =
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+            __m256i const values = _mm256_add_epi8(
+                v, _mm256_shuffle_epi8(lutRoll,
+                                       _mm256_add_epi8(isSlash, hiNibbles)));
+            __m256i const pairs =
+                _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            __m256i const groups =
+                _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+
+            /* Each lane has 12 bytes; put them together */
+            _mm256_storeu_si256(
+                (__m256i *)&out[o],
+                _mm256_permutevar8x32_epi32(
+                    _mm256_shuffle_epi8(groups, pack),
+                    _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7)));
+        }
+    }
+    return i + decodeSsse3(&in[i], inLen - i, &out[o], outRoom - o);
+}
+
+#endif  /* HAVE_X86_SIMD */
+
+
+
+static EncodeFn *
+encodeFn(void) {
+/*----------------------------------------------------------------------------
+   The best encode kernel for the CPU we are running on.
+-----------------------------------------------------------------------------*/
+#if HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return &encodeAvx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return &encodeSsse3;
+#endif
+    return &encodeScalar;
+}
+
+
+
+static DecodeFn *
+decodeFn(void) {
+/*----------------------------------------------------------------------------
+   The best decode kernel for the CPU we are running on; NULL if there is
+   none better than going a character at a time.
+-----------------------------------------------------------------------------*/
+#if HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return &decodeAvx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return &decodeSsse3;
+#endif
+    return NULL;
+}
+
+
+
+static unsigned char *
+encodeChunk(EncodeFn *            const encode,
+            const unsigned char * const in,
+            size_t                const inLen,
+            size_t                const inAvail,
+            unsigned char *       const out) {
+/*----------------------------------------------------------------------------
+   Encode in[] (of length 'inLen'), with padding at the end, into out[].
+   Return the end of what we write.
+
+   We may look at, but don't encode, bytes up to in[inAvail-1].
+-----------------------------------------------------------------------------*/
+    size_t const done = encode(in, inLen, inAvail, out);
+
+    unsigned char * p;
+
+    p = &out[done / 3 * 4];
+
+    if (inLen - done == 1) {
+        uint32_t const group = in[done] << 16;
+
+        *p++ = table_b2a_base64[(group >> 18) & 0x3f];
+        *p++ = table_b2a_base64[(group >> 12) & 0x3f];
+        *p++ = BASE64_PAD;
+        *p++ = BASE64_PAD;
+    } else if (inLen - done == 2) {
+        uint32_t const group = in[done] << 16 | in[done+1] << 8;
+
+        *p++ = table_b2a_base64[(group >> 18) & 0x3f];
+        *p++ = table_b2a_base64[(group >> 12) & 0x3f];
+        *p++ = table_b2a_base64[(group >>  6) & 0x3f];
+        *p++ = BASE64_PAD;
+    }
+    return p;
+}
+
+
+
+void
+xmlrpc_base64EncodeAppend(xmlrpc_env *          const envP,
+                          xmlrpc_mem_block *    const outputP,
+                          const unsigned char * const binData,
+                          size_t                const binLen,
+                          bool                  const wantNewlines) {
+/*----------------------------------------------------------------------------
+   Append the base64 encoding of binData[] (of length 'binLen') to *outputP.
+
+   If 'wantNewlines' is true, break the encoding into lines of 76
+   characters, each ending with CRLF (and empty data encodes as a bare
+   CRLF).
+-----------------------------------------------------------------------------*/
+    EncodeFn * const encode = encodeFn();
+    size_t const startSize = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+    size_t const lineCt =
+        wantNewlines ? MAX(1, (binLen + BASE64_MAXBIN - 1) / BASE64_MAXBIN) :
+        0;
+    size_t const encodedLen = (binLen + 2) / 3 * 4 + 2 * lineCt;
+
+    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, startSize + encodedLen);
+
+    if (!envP->fault_occurred) {
+        unsigned char * const start =
+            XMLRPC_MEMBLOCK_CONTENTS(unsigned char, outputP) + startSize;
+
+        unsigned char * p;
+
+        if (wantNewlines) {
+            size_t chunkStart;
+
+            for (chunkStart = 0, p = start;
+                 chunkStart < binLen || p == start;
+                 chunkStart += BASE64_MAXBIN) {
+
+                size_t const chunkLen =
+                    MIN(BASE64_MAXBIN, binLen - chunkStart);
+
+                p = encodeChunk(encode, &binData[chunkStart], chunkLen,
+                                binLen - chunkStart, p);
+
+                /* Append a courtesy CRLF. */
+                *p++ = CR;
+                *p++ = LF;
+            }
+        } else
+            p = encodeChunk(encode, binData, binLen, binLen, start);
+
+        XMLRPC_ASSERT(p == start + encodedLen);
+    }
+}
+
 
 
 static xmlrpc_mem_block *
@@ -155,77 +577,18 @@ base64Encode(xmlrpc_env *          const envP,
              size_t                const binLen,
              bool                  const wantNewlines) {
 
-    size_t chunkStart, chunkLeft;
-    unsigned char * asciiData;
-    int leftbits;
-    unsigned char thisCh;
-    unsigned int leftchar;
     xmlrpc_mem_block * outputP;
-    unsigned char lineBuffer[BASE64_LINE_SZ];
-    const unsigned char * cursor;
 
-    /* Create a block to hold our lines when we finish them. */
     outputP = xmlrpc_mem_block_new(envP, 0);
-    XMLRPC_FAIL_IF_FAULT(envP);
 
-    /* Deal with empty data blocks gracefully. Yuck. */
-    if (binLen == 0) {
-        if (wantNewlines)
-            XMLRPC_MEMBLOCK_APPEND(char, envP, outputP, CRLF, 2);
-        goto cleanup;
-    }
-
-    /* Process our binary data in line-sized chunks. */
-    for (chunkStart = 0, cursor = &binData[0];
-         chunkStart < binLen;
-         chunkStart += BASE64_MAXBIN) {
-
-        /* Set up our per-line state. */
-        asciiData = &lineBuffer[0];
-        chunkLeft = binLen - chunkStart;
-        if (chunkLeft > BASE64_MAXBIN)
-            chunkLeft = BASE64_MAXBIN;
-        leftbits = 0;
-        leftchar = 0;
-
-        for(; chunkLeft > 0; --chunkLeft, ++cursor) {
-            /* Shift the data into our buffer */
-            leftchar = (leftchar << 8) | *cursor;
-            leftbits += 8;
-
-            /* See if there are 6-bit groups ready */
-            while (leftbits >= 6) {
-                thisCh = (leftchar >> (leftbits-6)) & 0x3f;
-                leftbits -= 6;
-                *asciiData++ = table_b2a_base64[thisCh];
-            }
-        }
-        if (leftbits == 2) {
-            *asciiData++ = table_b2a_base64[(leftchar&3) << 4];
-            *asciiData++ = BASE64_PAD;
-            *asciiData++ = BASE64_PAD;
-        } else if (leftbits == 4) {
-            *asciiData++ = table_b2a_base64[(leftchar&0xf) << 2];
-            *asciiData++ = BASE64_PAD;
-        } 
-
-        /* Append a courtesy CRLF. */
-        if (wantNewlines) {
-            *asciiData++ = CR;
-            *asciiData++ = LF;
-        }
-    
-        /* Save our line. */
-        XMLRPC_MEMBLOCK_APPEND(char, envP, outputP, lineBuffer,
-                               asciiData - &lineBuffer[0]);
-        XMLRPC_FAIL_IF_FAULT(envP);
-    }
+    if (!envP->fault_occurred) {
+        xmlrpc_base64EncodeAppend(envP, outputP, binData, binLen,
+                                  wantNewlines);
 
- cleanup:
-    if (envP->fault_occurred) {
-        if (outputP)
+        if (envP->fault_occurred) {
             xmlrpc_mem_block_free(outputP);
-        return NULL;
+            outputP = NULL;
+        }
     }
     return outputP;
 }
@@ -252,11 +615,24 @@ xmlrpc_base64_encode_without_newlines(xmlrpc_env *          const envP,
 
 
 
+static bool
+isPad(char const c) {
+
+    return (c & 0x7f) == BASE64_PAD;
+}
+
+
+
 xmlrpc_mem_block *
 xmlrpc_base64_decode(xmlrpc_env * const envP,
                      const char * const asciiData,
                      size_t       const acsiiLen) {
 
+    /* The vector kernel may write a little past what it decodes */
+    size_t const slop = 32;
+
+    DecodeFn * const decode = decodeFn();
+
     unsigned char * binData;
     int leftbits;
     unsigned char thisCh;
@@ -270,7 +646,7 @@ xmlrpc_base64_decode(xmlrpc_env * const envP,
     /* Create a block to hold our chunks when we finish them.
     ** We overestimate the size now, and fix it later. */
     bufferSize = ((acsiiLen + 3) / 4) * 3;
-    outputP = xmlrpc_mem_block_new(envP, bufferSize);
+    outputP = xmlrpc_mem_block_new(envP, bufferSize + slop);
     XMLRPC_FAIL_IF_FAULT(envP);
 
     /* Set up our decoder state. */
@@ -284,6 +660,49 @@ xmlrpc_base64_decode(xmlrpc_env * const envP,
          remainingLen > 0; 
          --remainingLen, ++nextCharP) {
 
+        if (decode && leftbits == 0 && npad == 0) {
+            /* We're between groups, so we can let the kernel do as much
+               as it can.
+            */
+            size_t const decodedLen =
+                decode(nextCharP, remainingLen, binData,
+                       bufferSize + slop - binLen);
+
+            binData      += decodedLen / 4 * 3;
+            binLen       += decodedLen / 4 * 3;
+            nextCharP    += decodedLen;
+            remainingLen -= decodedLen;
+
+            if (remainingLen == 0)
+                break;
+        }
+        if (leftbits == 0 && npad == 0) {
+            /* Do as many whole groups of 4 base64 digits as there are */
+            while (remainingLen >= 4) {
+                unsigned char const a = table_a2b_base64[nextCharP[0] & 0x7f];
+                unsigned char const b = table_a2b_base64[nextCharP[1] & 0x7f];
+                unsigned char const c = table_a2b_base64[nextCharP[2] & 0x7f];
+                unsigned char const d = table_a2b_base64[nextCharP[3] & 0x7f];
+
+                if ((a | b | c | d) >= 64 ||
+                    isPad(nextCharP[0]) || isPad(nextCharP[1]) ||
+                    isPad(nextCharP[2]) || isPad(nextCharP[3]))
+                    break;
+                else {
+                    binData[0] = a << 2 | b >> 4;
+                    binData[1] = (b & 0xf) << 4 | c >> 2;
+                    binData[2] = (c & 0x3) << 6 | d;
+
+                    binData      += 3;
+                    binLen       += 3;
+                    nextCharP    += 4;
+                    remainingLen -= 4;
+                }
+            }
+            if (remainingLen == 0)
+                break;
+        }
+
         /* Skip some punctuation. */
         thisCh = (*nextCharP & 0x7f);
         if (thisCh == '\r' || thisCh == '\n' || thisCh == ' ')
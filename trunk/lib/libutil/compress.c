@@ -0,0 +1,466 @@
+#define _DEFAULT_SOURCE /* New name for SVID & BSD source defines */
+#define _BSD_SOURCE   /* For xmlrpc_strcaseeq() */
+
+#include "xmlrpc_config.h"
+
+#include <string.h>
+#include <limits.h>
+
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "bool.h"
+#include "mallocvar.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/compress_int.h"
+
+#define OUTPUT_STEP (16*1024)
+    /* How much room we add to the output block at a time */
+
+
+
+bool
+xmlrpc_compressionAvailable(void) {
+
+    return HAVE_ZLIB;
+}
+
+
+
+const char *
+xmlrpc_contentCodingName(xmlrpc_contentCoding const coding) {
+/*----------------------------------------------------------------------------
+   The name of content coding 'coding' as it appears in an HTTP
+   Content-Encoding or Accept-Encoding header.
+-----------------------------------------------------------------------------*/
+    switch (coding) {
+    case XMLRPC_CODING_IDENTITY: return "identity";
+    case XMLRPC_CODING_GZIP:     return "gzip";
+    case XMLRPC_CODING_DEFLATE:  return "deflate";
+    }
+    return "?";
+}
+
+
+
+void
+xmlrpc_contentCodingFromName(const char *           const name,
+                             bool *                 const recognizedP,
+                             xmlrpc_contentCoding * const codingP) {
+/*----------------------------------------------------------------------------
+   Interpret 'name' as the name of a content coding from an HTTP header.
+   Return *recognizedP false if it's not one we know.
+
+   "x-gzip" is what some old clients call gzip (RFC 7230 says to treat
+   them as the same).
+-----------------------------------------------------------------------------*/
+    *recognizedP = true;
+
+    if (xmlrpc_strcaseeq(name, "identity"))
+        *codingP = XMLRPC_CODING_IDENTITY;
+    else if (xmlrpc_strcaseeq(name, "gzip") ||
+             xmlrpc_strcaseeq(name, "x-gzip"))
+        *codingP = XMLRPC_CODING_GZIP;
+    else if (xmlrpc_strcaseeq(name, "deflate"))
+        *codingP = XMLRPC_CODING_DEFLATE;
+    else
+        *recognizedP = false;
+}
+
+
+
+#if HAVE_ZLIB
+
+struct xmlrpc_zstream {
+    z_stream     z;
+    bool         isDeflate;
+        /* We compress.  Otherwise, we decompress */
+    bool         ended;
+        /* We've seen (when decompressing) or produced (when compressing)
+           the end of the compressed stream.
+        */
+    size_t       maxSize;
+        /* Most decompressed output we're willing to produce */
+    size_t       produced;
+        /* How much output we've produced so far */
+};
+
+
+
+static void
+createZstream(xmlrpc_env *      const envP,
+              bool              const isDeflate,
+              size_t            const maxSize,
+              xmlrpc_zstream ** const zsPP) {
+
+    xmlrpc_zstream * zsP;
+
+    MALLOCVAR(zsP);
+
+    if (zsP == NULL)
+        xmlrpc_faultf(envP, "Unable to allocate compression stream");
+    else {
+        memset(&zsP->z, 0, sizeof(zsP->z));
+        zsP->z.zalloc  = Z_NULL;
+        zsP->z.zfree   = Z_NULL;
+        zsP->z.opaque  = Z_NULL;
+        zsP->isDeflate = isDeflate;
+        zsP->ended     = false;
+        zsP->maxSize   = maxSize;
+        zsP->produced  = 0;
+
+        *zsPP = zsP;
+    }
+}
+
+
+
+static int
+windowBits(xmlrpc_contentCoding const coding) {
+
+    /* zlib's convention: adding 16 means a gzip wrapper instead of a zlib
+       one.
+    */
+    return coding == XMLRPC_CODING_GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+}
+
+
+
+void
+xmlrpc_zstreamCreateDeflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding,
+                            int                    const level,
+                            xmlrpc_zstream **      const zsPP) {
+/*----------------------------------------------------------------------------
+   Create a stream that compresses into content coding 'coding' at zlib
+   compression level 'level' (1-9, or Z_DEFAULT_COMPRESSION).
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(coding != XMLRPC_CODING_IDENTITY);
+
+    createZstream(envP, true, 0, zsPP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_zstream * const zsP = *zsPP;
+
+        int rc;
+
+        rc = deflateInit2(&zsP->z, level, Z_DEFLATED, windowBits(coding),
+                          8, Z_DEFAULT_STRATEGY);
+
+        if (rc != Z_OK) {
+            xmlrpc_faultf(envP, "zlib deflateInit2() failed with rc %d.  %s",
+                          rc, zsP->z.msg ? zsP->z.msg : "");
+            free(zsP);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_zstreamCreateInflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding,
+                            size_t                 const maxSize,
+                            xmlrpc_zstream **      const zsPP) {
+/*----------------------------------------------------------------------------
+   Create a stream that decompresses content coding 'coding'.
+
+   Feeding it data that decompresses to more than 'maxSize' bytes is a
+   failure.  That's the defense against a tiny body that decompresses to
+   gigabytes.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(coding != XMLRPC_CODING_IDENTITY);
+
+    createZstream(envP, false, maxSize, zsPP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_zstream * const zsP = *zsPP;
+
+        int rc;
+
+        rc = inflateInit2(&zsP->z, windowBits(coding));
+
+        if (rc != Z_OK) {
+            xmlrpc_faultf(envP, "zlib inflateInit2() failed with rc %d.  %s",
+                          rc, zsP->z.msg ? zsP->z.msg : "");
+            free(zsP);
+        }
+    }
+}
+
+
+
+void
+xmlrpc_zstreamDestroy(xmlrpc_zstream * const zsP) {
+
+    if (zsP->isDeflate)
+        deflateEnd(&zsP->z);
+    else
+        inflateEnd(&zsP->z);
+
+    free(zsP);
+}
+
+
+
+static void
+runStream(xmlrpc_env *       const envP,
+          xmlrpc_zstream *   const zsP,
+          const void *       const data,
+          size_t             const len,
+          bool               const finish,
+          xmlrpc_mem_block * const outputP) {
+/*----------------------------------------------------------------------------
+   Push 'data' through the stream, appending what comes out to *outputP.
+   With 'finish', also flush the end of the stream (compressing) or make
+   sure the stream has ended (decompressing).
+
+   We make room in *outputP a step at a time and give back what we didn't
+   use at the end, so *outputP is exactly the output when we return.
+-----------------------------------------------------------------------------*/
+    size_t const origSize = xmlrpc_mem_block_size(outputP);
+
+    const Bytef * nextIn;
+    size_t inLeft;
+        /* How much of 'data' we haven't given to zlib yet */
+    size_t outSize;
+        /* How much of *outputP is real output */
+    bool done;
+
+    nextIn = data;
+    inLeft = len;
+    outSize = origSize;
+    zsP->z.avail_in = 0;
+
+    for (done = false; !done && !envP->fault_occurred; ) {
+        if (zsP->z.avail_in == 0 && inLeft > 0) {
+            /* zlib counts input in uInt, which may be smaller than size_t */
+            uInt const inNow = inLeft > UINT_MAX ? UINT_MAX : inLeft;
+
+            zsP->z.next_in  = (Bytef *)nextIn;
+            zsP->z.avail_in = inNow;
+            nextIn += inNow;
+            inLeft -= inNow;
+        }
+        xmlrpc_mem_block_resize(envP, outputP, outSize + OUTPUT_STEP);
+
+        if (!envP->fault_occurred) {
+            bool const allIn = (inLeft == 0);
+
+            int rc;
+
+            zsP->z.next_out  =
+                (Bytef *)xmlrpc_mem_block_contents(outputP) + outSize;
+            zsP->z.avail_out = OUTPUT_STEP;
+
+            if (zsP->isDeflate)
+                rc = deflate(&zsP->z,
+                             finish && allIn ? Z_FINISH : Z_NO_FLUSH);
+            else
+                rc = inflate(&zsP->z, Z_NO_FLUSH);
+
+            outSize       += OUTPUT_STEP - zsP->z.avail_out;
+            zsP->produced += OUTPUT_STEP - zsP->z.avail_out;
+
+            switch (rc) {
+            case Z_STREAM_END:
+                zsP->ended = true;
+                if (zsP->z.avail_in > 0 || inLeft > 0)
+                    xmlrpc_env_set_fault(
+                        envP, XMLRPC_PARSE_ERROR,
+                        "Garbage after the end of the compressed data");
+                done = true;
+                break;
+            case Z_OK:
+                /* zlib stopped either because it ran out of input or
+                   because it ran out of room for output.  In the latter
+                   case, we go around again with more room.  A compressor
+                   that is finishing keeps going until it says the stream
+                   has ended.
+                */
+                if (zsP->z.avail_out > 0 && zsP->z.avail_in == 0 && allIn &&
+                    !(zsP->isDeflate && finish))
+                    done = true;
+                break;
+            case Z_BUF_ERROR:
+                /* No progress possible: no input left to work on */
+                done = true;
+                break;
+            case Z_MEM_ERROR:
+                xmlrpc_faultf(envP, "zlib ran out of memory");
+                break;
+            default:
+                xmlrpc_env_set_fault_formatted(
+                    envP, XMLRPC_PARSE_ERROR,
+                    "Compressed data is invalid.  zlib says rc %d: %s",
+                    rc, zsP->z.msg ? zsP->z.msg : "");
+            }
+            if (!envP->fault_occurred && !zsP->isDeflate &&
+                zsP->produced > zsP->maxSize)
+                xmlrpc_env_set_fault_formatted(
+                    envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
+                    "Compressed data decompresses to more than %lu bytes",
+                    (unsigned long)zsP->maxSize);
+        }
+    }
+    {
+        xmlrpc_env env;
+        xmlrpc_env_init(&env);
+        /* Shrinking never fails */
+        xmlrpc_mem_block_resize(&env, outputP,
+                                envP->fault_occurred ? origSize : outSize);
+        xmlrpc_env_clean(&env);
+    }
+    if (!envP->fault_occurred && finish && !zsP->ended)
+        xmlrpc_env_set_fault(envP, XMLRPC_PARSE_ERROR,
+                             "Compressed data ends prematurely");
+}
+
+
+
+void
+xmlrpc_zstreamFeed(xmlrpc_env *       const envP,
+                   xmlrpc_zstream *   const zsP,
+                   const void *       const data,
+                   size_t             const len,
+                   xmlrpc_mem_block * const outputP) {
+/*----------------------------------------------------------------------------
+   Compress or decompress the next 'len' bytes of the stream, at 'data',
+   appending whatever output that produces to *outputP.
+
+   Output can lag input; xmlrpc_zstreamFinish() gets the rest.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (zsP->ended) {
+        if (len > 0)
+            xmlrpc_env_set_fault(
+                envP, XMLRPC_PARSE_ERROR,
+                "Garbage after the end of the compressed data");
+    } else
+        runStream(envP, zsP, data, len, false, outputP);
+}
+
+
+
+void
+xmlrpc_zstreamFinish(xmlrpc_env *       const envP,
+                     xmlrpc_zstream *   const zsP,
+                     xmlrpc_mem_block * const outputP) {
+/*----------------------------------------------------------------------------
+   End the stream: when compressing, append the rest of the compressed data
+   to *outputP; when decompressing, fail if the data we've been fed so far
+   isn't a whole compressed stream.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (!zsP->ended)
+        runStream(envP, zsP, NULL, 0, true, outputP);
+}
+
+
+
+#else  /* HAVE_ZLIB */
+
+struct xmlrpc_zstream {
+    int dummy;
+};
+
+
+
+static void
+setNoZlibFault(xmlrpc_env * const envP) {
+
+    xmlrpc_faultf(envP, "This Xmlrpc-c was built without zlib, so it can't "
+                  "compress or decompress");
+}
+
+
+
+void
+xmlrpc_zstreamCreateDeflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding ATTR_UNUSED,
+                            int                    const level ATTR_UNUSED,
+                            xmlrpc_zstream **      const zsPP ATTR_UNUSED) {
+
+    setNoZlibFault(envP);
+}
+
+
+
+void
+xmlrpc_zstreamCreateInflate(xmlrpc_env *           const envP,
+                            xmlrpc_contentCoding   const coding ATTR_UNUSED,
+                            size_t                 const maxSize ATTR_UNUSED,
+                            xmlrpc_zstream **      const zsPP ATTR_UNUSED) {
+
+    setNoZlibFault(envP);
+}
+
+
+
+void
+xmlrpc_zstreamDestroy(xmlrpc_zstream * const zsP ATTR_UNUSED) {
+
+    XMLRPC_ASSERT(false);
+}
+
+
+
+void
+xmlrpc_zstreamFeed(xmlrpc_env *       const envP,
+                   xmlrpc_zstream *   const zsP ATTR_UNUSED,
+                   const void *       const data ATTR_UNUSED,
+                   size_t             const len ATTR_UNUSED,
+                   xmlrpc_mem_block * const outputP ATTR_UNUSED) {
+
+    setNoZlibFault(envP);
+}
+
+
+
+void
+xmlrpc_zstreamFinish(xmlrpc_env *       const envP,
+                     xmlrpc_zstream *   const zsP ATTR_UNUSED,
+                     xmlrpc_mem_block * const outputP ATTR_UNUSED) {
+
+    setNoZlibFault(envP);
+}
+
+#endif  /* HAVE_ZLIB */
+
+
+
+void
+xmlrpc_compress(xmlrpc_env *          const envP,
+                xmlrpc_contentCoding  const coding,
+                int                   const level,
+                const void *          const data,
+                size_t                const len,
+                xmlrpc_mem_block **   const outputPP) {
+/*----------------------------------------------------------------------------
+   Compress all of 'data' at once, into a new memory block.
+-----------------------------------------------------------------------------*/
+    xmlrpc_zstream * zsP;
+
+    xmlrpc_zstreamCreateDeflate(envP, coding, level, &zsP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_mem_block * const outputP = xmlrpc_mem_block_new(envP, 0);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_zstreamFeed(envP, zsP, data, len, outputP);
+
+            if (!envP->fault_occurred)
+                xmlrpc_zstreamFinish(envP, zsP, outputP);
+
+            if (envP->fault_occurred)
+                xmlrpc_mem_block_free(outputP);
+            else
+                *outputPP = outputP;
+        }
+        xmlrpc_zstreamDestroy(zsP);
+    }
+}
@@ -14,6 +14,11 @@
 #include "xmlrpc-c/util.h"
 
 #define BLOCK_ALLOC_MIN (16)
+#define ARENA_BLOCK_MAX (64*1024)
+    /* We don't grow a block in an arena past this size; the arena would
+       keep every old copy of it until the arena dies.  We move it to the
+       heap instead.
+    */
 
 static bool const tracingMemory =
 #ifdef EFENCE
@@ -35,6 +40,14 @@ struct _xmlrpc_mem_block {
            (pointed to by 'blockP')
         */
     void * blockP;
+    xmlrpc_mem_pool * arenaP;
+        /* The pool in whose arena this descriptor lives; NULL if it is
+           on the heap.  The block holds a reference to the pool.
+        */
+    bool contentsInArena;
+        /* The contents (*blockP) are in the arena of *arenaP, as opposed to
+           on the heap.
+        */
 };
 
 
@@ -60,6 +73,9 @@ xmlrpc_mem_block_new_pool(xmlrpc_env *      const envP,
         else {
             blockP->poolP = poolP;
 
+            blockP->arenaP          = NULL;
+            blockP->contentsInArena = false;
+
             blockP->size = size;
 
             if (tracingMemory)
@@ -91,6 +107,43 @@ xmlrpc_mem_block_new_pool(xmlrpc_env *      const envP,
 
 
 
+xmlrpc_mem_block *
+xmlrpc_mem_block_new_arena(xmlrpc_env *      const envP,
+                           size_t            const size,
+                           xmlrpc_mem_pool * const arenaP) {
+/*----------------------------------------------------------------------------
+   Create an xmlrpc_mem_block of size 'size' in the arena of pool *arenaP.
+
+   The block holds a reference to the pool, so the arena lives as long as
+   the block does.  Only the thread whose current arena *arenaP is may
+   create or grow a block in it (see xmlrpc_mem_pool_set_current()); if
+   someone else grows the block, its contents move to the heap.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * blockP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(arenaP != NULL);
+
+    blockP = xmlrpc_mem_pool_get(envP, arenaP, sizeof(*blockP));
+
+    if (!envP->fault_occurred) {
+        blockP->poolP           = NULL;
+        blockP->arenaP          = arenaP;
+        blockP->contentsInArena = true;
+        blockP->size            = size;
+        blockP->allocated       = MAX(BLOCK_ALLOC_MIN, size);
+        blockP->blockP = xmlrpc_mem_pool_get(envP, arenaP, blockP->allocated);
+
+        if (envP->fault_occurred)
+            blockP = NULL;
+        else
+            xmlrpc_mem_pool_ref(arenaP);
+    }
+    return blockP;
+}
+
+
+
 xmlrpc_mem_block * 
 xmlrpc_mem_block_new(xmlrpc_env * const envP, 
                      size_t       const size) {
@@ -113,9 +166,13 @@ xmlrpc_mem_block_free(xmlrpc_mem_block * const blockP) {
     if (blockP->poolP)
         xmlrpc_mem_pool_release(blockP->poolP, blockP->allocated);
 
-    free(blockP->blockP);
+    if (!blockP->contentsInArena)
+        free(blockP->blockP);
 
-    free(blockP);
+    if (blockP->arenaP)
+        xmlrpc_mem_pool_free(blockP->arenaP);
+    else
+        free(blockP);
 }
 
 
@@ -143,9 +200,11 @@ xmlrpc_mem_block_contents(const xmlrpc_mem_block * const blockP) {
 
 
 static size_t
-allocSize(size_t const requestedSize) {
+allocSize(size_t const requestedSize,
+          size_t const currentSize) {
 /*----------------------------------------------------------------------------
-   The size we allocate when the user requests to resize to 'requesteddSize'.
+   The size we allocate when the user requests to resize to 'requesteddSize'
+   a block for which we have allocated 'currentSize' bytes.
 
    We give him more than he requested in an attempt to avoid lots of copying
    when Caller repeatedly resizes by small amounts.
@@ -161,11 +220,23 @@ allocSize(size_t const requestedSize) {
         retval = requestedSize;
     else {
         /* We make it a power of two unless it is more than a megabyte,
-           in which case we just make it a multiple of a megabyte.
+           in which case we make it at least half again as big as it was,
+           rounded up to a multiple of a megabyte.  Growing by a fixed
+           amount would make appending to a big block (e.g. serializing a
+           big response) cost time proportional to the square of the size.
         */
-        if (requestedSize >= oneMegabyte)
-            retval = ROUNDUPU(requestedSize, oneMegabyte);
-        else {
+        if (requestedSize >= oneMegabyte) {
+            size_t const grownSize = currentSize + currentSize / 2;
+
+            if (grownSize < currentSize)  /* overflow */
+                retval = requestedSize;
+            else {
+                size_t const target = MAX(requestedSize, grownSize);
+                size_t const rounded = ROUNDUPU(target, oneMegabyte);
+
+                retval = rounded < target ? requestedSize : rounded;
+            }
+        } else {
             unsigned int i;
             for (i = BLOCK_ALLOC_MIN; i < requestedSize; i *= 2);
             retval = i;
@@ -176,52 +247,96 @@ allocSize(size_t const requestedSize) {
 
 
 
+static void
+growInArena(xmlrpc_env *       const envP,
+            xmlrpc_mem_block * const blockP,
+            size_t             const newAllocSize) {
+/*----------------------------------------------------------------------------
+   Move the contents of *blockP to a new 'newAllocSize'-byte piece of its
+   arena.  The old piece stays in the arena until the arena dies.
+-----------------------------------------------------------------------------*/
+    void * const newMem =
+        xmlrpc_mem_pool_get(envP, blockP->arenaP, newAllocSize);
+
+    if (!envP->fault_occurred) {
+        memcpy(newMem, blockP->blockP, blockP->size);
+
+        blockP->blockP    = newMem;
+        blockP->allocated = newAllocSize;
+    }
+}
+
+
+
+static void
+growOnHeap(xmlrpc_env *       const envP,
+           xmlrpc_mem_block * const blockP,
+           size_t             const newAllocSize) {
+/*----------------------------------------------------------------------------
+   Make the contents of *blockP a 'newAllocSize'-byte piece of the heap.
+
+   If they're on the heap already, we realloc them, which often can grow
+   the memory in place.  For a big block, the C library typically has the
+   memory mapped by itself, and realloc remaps the pages (e.g. GNU libc
+   uses mremap) instead of copying them, so even then there is no copying.
+-----------------------------------------------------------------------------*/
+    void * newMem;
+
+    if (blockP->contentsInArena) {
+        newMem = malloc(newAllocSize);
+        if (newMem)
+            memcpy(newMem, blockP->blockP, blockP->size);
+    } else
+        newMem = realloc(blockP->blockP, newAllocSize);
+
+    if (!newMem)
+        xmlrpc_faultf(envP,
+                      "Failed to allocate %lu bytes of memory from the OS",
+                      (unsigned long)newAllocSize);
+    else {
+        blockP->contentsInArena = false;
+        blockP->blockP          = newMem;
+        blockP->allocated       = newAllocSize;
+    }
+}
+
+
+
 void 
 xmlrpc_mem_block_resize(xmlrpc_env *       const envP,
                         xmlrpc_mem_block * const blockP,
                         size_t             const size) {
 /*----------------------------------------------------------------------------
-  Resize an xmlrpc_mem_block by allocating new memory for it and copying
-  whatever might be in it to the new memory.
------------------------------------------------------------------------------*/
-    size_t const newAllocSize = allocSize(size);
+  Resize an xmlrpc_mem_block, keeping whatever is in it (up to the new size).
 
+  If we fail, the block is as it was.
+-----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(blockP != NULL);
 
-    if (newAllocSize > blockP->allocated) {
-        /* Reallocate */
+    if (size > blockP->allocated) {
+        size_t const newAllocSize = allocSize(size, blockP->allocated);
+        size_t const oldAllocSize = blockP->allocated;
 
         if (blockP->poolP)
             xmlrpc_mem_pool_alloc(envP, blockP->poolP,
-                                  newAllocSize - blockP->allocated);
+                                  newAllocSize - oldAllocSize);
 
         if (!envP->fault_occurred) {
-            void * newMem;
-
-            newMem = malloc(newAllocSize);
-            if (!newMem)
-                xmlrpc_faultf(envP, 
-                              "Failed to allocate %u bytes of memory "
-                              "from the OS",
-                              (unsigned) size);
-            else {
-                /* Copy over the data */
-                size_t const sizeToCopy = MIN(blockP->size, size);
-                assert(sizeToCopy <= newAllocSize);
-                memcpy(newMem, blockP->blockP, sizeToCopy);
-                
-                free(blockP->blockP);
-                
-                blockP->blockP    = newMem;
-                blockP->allocated = newAllocSize;
-            }
-            if (envP->fault_occurred)
+            if (blockP->contentsInArena &&
+                blockP->arenaP == xmlrpc_mem_pool_current() &&
+                newAllocSize <= ARENA_BLOCK_MAX)
+                growInArena(envP, blockP, newAllocSize);
+            else
+                growOnHeap(envP, blockP, newAllocSize);
+
+            if (envP->fault_occurred && blockP->poolP)
                 xmlrpc_mem_pool_release(blockP->poolP,
-                                        newAllocSize - blockP->allocated);
+                                        newAllocSize - oldAllocSize);
         }
     }
-    blockP->size = size;
+    if (!envP->fault_occurred)
+        blockP->size = size;
 }
 
 
@@ -1,6 +1,7 @@
 #include "xmlrpc_config.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -12,11 +13,62 @@
 #include "xmlrpc-c/util_int.h"
 #include "xmlrpc-c/util.h"
 
+/* A pool is also an arena: you can carve memory out of it with
+   xmlrpc_mem_pool_get() and it all goes back to the system at once when the
+   pool dies.  The arena is a list of chunks that we fill from front to back.
+*/
+
+#define ARENA_CHUNK_MIN (4*1024)
+#define ARENA_CHUNK_MAX (256*1024)
+
+typedef union {
+/*----------------------------------------------------------------------------
+   Something with the strictest alignment any object we hand out from an
+   arena could need.
+-----------------------------------------------------------------------------*/
+    void *      p;
+    double      d;
+    long double ld;
+    long long   ll;
+} maxAlign;
+
+typedef struct arenaChunk {
+    struct arenaChunk * nextP;
+    size_t              size;
+        /* Size of the whole chunk, including this header */
+    maxAlign            data[1];
+        /* The chunk's memory starts here */
+} arenaChunk;
+
 struct _xmlrpc_mem_pool {
     size_t       size;
     size_t       allocated;
+    unsigned int refcount;
+        /* One for the creator, plus one for each object we gave arena memory
+           to (for which somebody called xmlrpc_mem_pool_ref()).  The pool
+           dies when this goes to zero.
+        */
+    arenaChunk * chunkListP;
+        /* The arena's chunks, newest first.  NULL if no arena memory yet */
+    char *       arenaNext;
+        /* The unused part of the newest chunk starts here */
+    size_t       arenaLeft;
+        /* Size of the unused part of the newest chunk */
+    size_t       arenaAllocated;
+        /* How much of 'allocated' is the arena's chunks */
+    xmlrpc_mem_pool * chargePoolP;
+        /* The pool to which we also charge arena growth.  NULL if none.
+           See xmlrpc_mem_pool_charge_arena().
+        */
+    size_t       charged;
+        /* How much we have charged to *chargePoolP */
 };
 
+static XMLRPC_THREAD_LOCAL xmlrpc_mem_pool * currentArenaP;
+    /* The pool that is this thread's current arena.  See
+       xmlrpc_mem_pool_set_current().
+    */
+
 
 
 xmlrpc_mem_pool * 
@@ -38,6 +90,14 @@ xmlrpc_mem_pool_new(xmlrpc_env * const envP,
 
         poolP->allocated = 0;
     
+        poolP->refcount       = 1;
+        poolP->chunkListP     = NULL;
+        poolP->arenaNext      = NULL;
+        poolP->arenaLeft      = 0;
+        poolP->arenaAllocated = 0;
+        poolP->chargePoolP    = NULL;
+        poolP->charged        = 0;
+
         if (envP->fault_occurred)
             free(poolP);
     }
@@ -46,16 +106,64 @@ xmlrpc_mem_pool_new(xmlrpc_env * const envP,
 
 
 
+static void
+destroyPool(xmlrpc_mem_pool * const poolP) {
+
+    arenaChunk * chunkP;
+    arenaChunk * nextP;
+
+    XMLRPC_ASSERT(poolP->allocated == poolP->arenaAllocated);
+
+    XMLRPC_ASSERT(poolP != currentArenaP);
+
+    XMLRPC_ASSERT(poolP->chargePoolP == NULL);
+
+    for (chunkP = poolP->chunkListP; chunkP; chunkP = nextP) {
+        nextP = chunkP->nextP;
+        free(chunkP);
+    }
+    free(poolP);
+}
+
+
+
+void
+xmlrpc_mem_pool_ref(xmlrpc_mem_pool * const poolP) {
+/*----------------------------------------------------------------------------
+   Keep pool *poolP alive until a matching xmlrpc_mem_pool_free().
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(poolP != NULL);
+
+#if HAVE_ATOMIC_REFCOUNT
+    __atomic_add_fetch(&poolP->refcount, 1, __ATOMIC_RELAXED);
+#else
+    ++poolP->refcount;
+#endif
+}
+
+
+
 void
 xmlrpc_mem_pool_free(xmlrpc_mem_pool * const poolP) {
 /*----------------------------------------------------------------------------
    Destroy xmlrpc_mem_pool *poolP.
+
+   If there are still objects living in the pool's arena, the pool actually
+   lives on until the last of them is gone.
 -----------------------------------------------------------------------------*/
+    bool died;
+
     XMLRPC_ASSERT(poolP != NULL);
+    XMLRPC_ASSERT(poolP->refcount > 0);
 
-    XMLRPC_ASSERT(poolP->allocated == 0);
+#if HAVE_ATOMIC_REFCOUNT
+    died = (__atomic_sub_fetch(&poolP->refcount, 1, __ATOMIC_ACQ_REL) == 0);
+#else
+    died = (--poolP->refcount == 0);
+#endif
 
-    free(poolP);
+    if (died)
+        destroyPool(poolP);
 }
 
 
@@ -96,3 +204,187 @@ xmlrpc_mem_pool_release(xmlrpc_mem_pool * const poolP,
 
 
 
+void
+xmlrpc_mem_pool_charge_arena(xmlrpc_mem_pool * const poolP,
+                             xmlrpc_mem_pool * const chargePoolP) {
+/*----------------------------------------------------------------------------
+   From now on, charge the growth of the arena of *poolP to pool
+   *chargePoolP too, so it counts against that pool's limit.  NULL means
+   charge it to nothing else.
+
+   We first give back whatever we charged to the previous such pool.  So a
+   user that needs the arena only to be bounded while it is building (e.g. a
+   parser, whose results outlive the pool it was given) calls this again
+   with NULL when it is done.  It must do so before *chargePoolP dies and
+   before *poolP does.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT(poolP != NULL);
+
+    if (poolP->chargePoolP)
+        xmlrpc_mem_pool_release(poolP->chargePoolP, poolP->charged);
+
+    poolP->chargePoolP = chargePoolP;
+    poolP->charged     = 0;
+}
+
+
+
+static void
+chargeChunk(xmlrpc_env *      const envP,
+            xmlrpc_mem_pool * const poolP,
+            size_t            const chunkSize) {
+/*----------------------------------------------------------------------------
+   Take 'chunkSize' bytes for a new arena chunk from pool *poolP, and from
+   the pool to which it charges its arena growth, if any.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_pool_alloc(envP, poolP, chunkSize);
+
+    if (!envP->fault_occurred && poolP->chargePoolP) {
+        xmlrpc_mem_pool_alloc(envP, poolP->chargePoolP, chunkSize);
+
+        if (envP->fault_occurred)
+            xmlrpc_mem_pool_release(poolP, chunkSize);
+        else
+            poolP->charged += chunkSize;
+    }
+}
+
+
+
+static void
+unchargeChunk(xmlrpc_mem_pool * const poolP,
+              size_t            const chunkSize) {
+
+    xmlrpc_mem_pool_release(poolP, chunkSize);
+
+    if (poolP->chargePoolP) {
+        xmlrpc_mem_pool_release(poolP->chargePoolP, chunkSize);
+        poolP->charged -= chunkSize;
+    }
+}
+
+
+
+static void
+addChunk(xmlrpc_env *      const envP,
+         xmlrpc_mem_pool * const poolP,
+         size_t            const minSize) {
+/*----------------------------------------------------------------------------
+   Add a chunk to the arena of *poolP with at least 'minSize' bytes of free
+   space.
+
+   Each chunk is twice as big as the one before, up to a limit, so a small
+   arena costs little and a big one doesn't need many chunks.
+-----------------------------------------------------------------------------*/
+    size_t const headerSize = offsetof(arenaChunk, data);
+    size_t const lastSize   =
+        poolP->chunkListP ? poolP->chunkListP->size : ARENA_CHUNK_MIN / 2;
+    size_t const chunkSize  =
+        MAX(MIN(lastSize * 2, ARENA_CHUNK_MAX), headerSize + minSize);
+
+    if (chunkSize < minSize)
+        xmlrpc_faultf(envP, "Arena allocation of %lu bytes is too big",
+                      (unsigned long)minSize);
+    else {
+        chargeChunk(envP, poolP, chunkSize);
+
+        if (!envP->fault_occurred) {
+            arenaChunk * const chunkP = malloc(chunkSize);
+
+            if (chunkP == NULL) {
+                xmlrpc_faultf(envP, "Can't allocate %lu-byte arena chunk",
+                              (unsigned long)chunkSize);
+                unchargeChunk(poolP, chunkSize);
+            } else {
+                chunkP->size  = chunkSize;
+                chunkP->nextP = poolP->chunkListP;
+
+                poolP->chunkListP      = chunkP;
+                poolP->arenaNext       = (char *)chunkP->data;
+                poolP->arenaLeft       = chunkSize - headerSize;
+                poolP->arenaAllocated += chunkSize;
+            }
+        }
+    }
+}
+
+
+
+void *
+xmlrpc_mem_pool_get(xmlrpc_env *      const envP,
+                    xmlrpc_mem_pool * const poolP,
+                    size_t            const size) {
+/*----------------------------------------------------------------------------
+   Allocate 'size' bytes from the arena of pool *poolP.
+
+   There is no way to give the memory back individually; it all goes when
+   the pool dies.  So whatever uses the memory should hold a reference to
+   the pool (xmlrpc_mem_pool_ref()) while it does.
+
+   The arena has no locking; only one thread at a time may use this on a
+   given pool.
+-----------------------------------------------------------------------------*/
+    size_t const alignedSize = ROUNDUPU(size, sizeof(maxAlign));
+
+    void * retval;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(poolP != NULL);
+
+    if (alignedSize < size) {
+        xmlrpc_faultf(envP, "Arena allocation of %lu bytes is too big",
+                      (unsigned long)size);
+        retval = NULL;
+    } else {
+        if (poolP->arenaLeft < alignedSize)
+            addChunk(envP, poolP, alignedSize);
+
+        if (envP->fault_occurred)
+            retval = NULL;
+        else {
+            retval = poolP->arenaNext;
+
+            poolP->arenaNext += alignedSize;
+            poolP->arenaLeft -= alignedSize;
+        }
+    }
+    return retval;
+}
+
+
+
+xmlrpc_mem_pool *
+xmlrpc_mem_pool_set_current(xmlrpc_mem_pool * const poolP) {
+/*----------------------------------------------------------------------------
+   Make *poolP the calling thread's current arena, and return the one it
+   replaces.  NULL means no arena.
+
+   Code that builds objects that can live in an arena (e.g. xmlrpc_value
+   constructors) takes their memory from the current arena, if any, instead
+   of from the system.  So whoever sets the current arena should set it back
+   as soon as it's done building.
+
+   Where the compiler has no thread-local variables, there is never a
+   current arena; this does nothing.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_pool * const oldP = currentArenaP;
+
+#if HAVE_THREAD_LOCAL && HAVE_ATOMIC_REFCOUNT
+    currentArenaP = poolP;
+#endif
+
+    return oldP;
+}
+
+
+
+xmlrpc_mem_pool *
+xmlrpc_mem_pool_current(void) {
+/*----------------------------------------------------------------------------
+   The calling thread's current arena; NULL if none.
+-----------------------------------------------------------------------------*/
+    return currentArenaP;
+}
+
+
+
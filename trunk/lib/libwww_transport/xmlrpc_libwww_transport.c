@@ -953,4 +953,6 @@ struct xmlrpc_client_transport_ops xmlrpc_libwww_transport_ops = {
     &call,
     &finishAsynch,
     NULL,
+    NULL,
+    NULL,
 };
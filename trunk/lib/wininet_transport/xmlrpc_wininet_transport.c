@@ -971,6 +971,8 @@ struct xmlrpc_client_transport_ops xmlrpc_wininet_transport_ops = {
     &call,
     &finishAsynch,
     NULL,
+    NULL,
+    NULL,
 };
 
 
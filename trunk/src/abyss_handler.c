@@ -13,6 +13,7 @@
 
 #include "bool.h"
 #include "int.h"
+#include "girmath.h"
 #include "mallocvar.h"
 #include "xmlrpc-c/abyss.h"
 
@@ -20,6 +21,9 @@
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/compress_int.h"
+#include "parse_stream.h"
+#include "registry.h"
 
 #include "abyss_handler.h"
 
@@ -56,13 +60,46 @@ addAuthCookie(xmlrpc_env * const envP,
 
 
 
+static bool
+writeBody(TSession *   const abyssSessionP,
+          const char * const data,
+          size_t       const len) {
+/*----------------------------------------------------------------------------
+   Send 'len' bytes of response body at 'data', as one or more chunks if the
+   response is chunked.
+
+   Abyss takes at most 4 GiB at a time, so we may have to give it to Abyss
+   in pieces.
+
+   Return value is whether we succeeded; we fail if the client went away.
+-----------------------------------------------------------------------------*/
+    size_t const pieceMax = 0x40000000;  /* 1 GiB */
+
+    size_t done;
+    bool succeeded;
+
+    for (done = 0, succeeded = true; done < len && succeeded; ) {
+        size_t const pieceLen = MIN(pieceMax, len - done);
+
+        succeeded =
+            ResponseWriteBody(abyssSessionP, &data[done], (uint32_t)pieceLen);
+
+        done += pieceLen;
+    }
+    return succeeded;
+}
+
+
+
 static void
-sendResponse(xmlrpc_env *      const envP,
-             TSession *        const abyssSessionP,
-             const char *      const body,
-             size_t            const len,
-             bool              const chunked,
-             ResponseAccessCtl const accessControl) {
+sendResponse(xmlrpc_env *         const envP,
+             TSession *           const abyssSessionP,
+             const char *         const body,
+             size_t               const len,
+             xmlrpc_contentCoding const coding,
+             bool                 const varyOnEncoding,
+             bool                 const chunked,
+             ResponseAccessCtl    const accessControl) {
 /*----------------------------------------------------------------------------
    Generate an HTTP response containing body 'body' of length 'len'
    characters.
@@ -70,6 +107,10 @@ sendResponse(xmlrpc_env *      const envP,
    This is meant to run in the context of an Abyss URI handler for
    Abyss session 'abyssSessionP'.
 
+   'coding' is the content coding 'body' is in.  'varyOnEncoding' means
+   whether we used a content coding depended on the client's
+   Accept-Encoding header, so caches should know that.
+
    'chunked' means to make it a chunked response if possible.
 -----------------------------------------------------------------------------*/
     const char * http_cookie = NULL;
@@ -97,21 +138,20 @@ sendResponse(xmlrpc_env *      const envP,
         /* There's an auth cookie, so pass it back in the response. */
         addAuthCookie(envP, abyssSessionP, http_cookie);
 
-    if ((size_t)(uint32_t)len != len)
-        xmlrpc_faultf(envP, "XML-RPC method generated a response too "
-                      "large for Abyss to send");
-    else {
-        uint32_t const abyssLen = (uint32_t)len;
+    /* See discussion below of quotes around "utf-8" */
+    ResponseContentType(abyssSessionP, "text/xml; charset=utf-8");
+    ResponseContentLength(abyssSessionP, len);
+    ResponseAccessControl(abyssSessionP, accessControl);
 
-        /* See discussion below of quotes around "utf-8" */
-        ResponseContentType(abyssSessionP, "text/xml; charset=utf-8");
-        ResponseContentLength(abyssSessionP, abyssLen);
-        ResponseAccessControl(abyssSessionP, accessControl);
+    if (coding != XMLRPC_CODING_IDENTITY)
+        ResponseAddField(abyssSessionP, "Content-Encoding",
+                         xmlrpc_contentCodingName(coding));
+    if (varyOnEncoding)
+        ResponseAddField(abyssSessionP, "Vary", "Accept-Encoding");
 
-        ResponseWriteStart(abyssSessionP);
-        ResponseWriteBody(abyssSessionP, body, abyssLen);
-        ResponseWriteEnd(abyssSessionP);
-    }
+    ResponseWriteStart(abyssSessionP);
+    writeBody(abyssSessionP, body, len);
+    ResponseWriteEnd(abyssSessionP);
 }
 
 
@@ -146,81 +186,356 @@ sendError(TSession *   const abyssSessionP,
 
 
 
-static void
-traceChunkRead(TSession * const abyssSessionP) {
-
-    fprintf(stderr, "XML-RPC handler got a chunk of %u bytes\n",
-            (unsigned int)SessionReadDataAvail(abyssSessionP));
-}
+#define BODY_PIECE_SIZE (64 * 1024)
+    /* How much of the body we read at a time where we process it a piece at
+       a time
+    */
 
 
 
 static void
-refillBufferFromConnection(xmlrpc_env * const envP,
-                           TSession *   const abyssSessionP,
-                           const char * const trace) {
+readBody(xmlrpc_env * const envP,
+         TSession *   const abyssSessionP,
+         char *       const buffer,
+         size_t       const len,
+         const char * const trace) {
 /*----------------------------------------------------------------------------
-   Get the next chunk of data from the connection into the buffer.
+   Read the next 'len' bytes of the body into 'buffer'.
+
+   Abyss reads straight into 'buffer', so a big body arrives in a few big
+   reads instead of a connection buffer-full at a time.
 -----------------------------------------------------------------------------*/
-    bool succeeded;
+    const char * error;
 
-    succeeded = SessionRefillBuffer(abyssSessionP);
+    SessionReadBody(abyssSessionP, buffer, len, &error);
 
-    if (!succeeded)
+    if (error) {
         xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_TIMEOUT_ERROR, "Timed out waiting for "
-            "client to send its POST data");
-    else {
+            envP, XMLRPC_TIMEOUT_ERROR, "Failed to get the client's "
+            "POST data.  %s", error);
+        xmlrpc_strfree(error);
+    } else {
         if (trace)
-            traceChunkRead(abyssSessionP);
+            fprintf(stderr, "XML-RPC handler got %u bytes of body\n",
+                    (unsigned int)len);
     }
 }
 
 
 
 static void
-getBody(xmlrpc_env *        const envP,
-        TSession *          const abyssSessionP,
-        size_t              const contentSize,
-        const char *        const trace,
-        xmlrpc_mem_block ** const bodyP) {
+createDecoder(xmlrpc_env *           const envP,
+              xmlrpc_contentCoding   const coding,
+              xmlrpc_zstream **      const decoderPP) {
+/*----------------------------------------------------------------------------
+   Create something to decode a body in content coding 'coding', or return
+   *decoderPP == NULL if there's nothing to decode.
+
+   The XML size limit applies to the decoded body, so a small compressed
+   body can't make us use a lot of memory.
+-----------------------------------------------------------------------------*/
+    if (coding == XMLRPC_CODING_IDENTITY)
+        *decoderPP = NULL;
+    else
+        xmlrpc_zstreamCreateInflate(envP, coding,
+                                    xmlrpc_limit_get(XMLRPC_XML_SIZE_LIMIT_ID),
+                                    decoderPP);
+}
+
+
+
+static void
+getBody(xmlrpc_env *         const envP,
+        TSession *           const abyssSessionP,
+        size_t               const contentSize,
+        xmlrpc_contentCoding const coding,
+        const char *         const trace,
+        xmlrpc_mem_block **  const bodyP) {
 /*----------------------------------------------------------------------------
    Get the entire body, which is of size 'contentSize' bytes, from the
    Abyss session and return it as the new memblock *bodyP.
 
+   The body is in content coding 'coding'; what we return is decoded.
+
    The first chunk of the body may already be in Abyss's buffer.  We
    retrieve that before reading more.
 -----------------------------------------------------------------------------*/
     xmlrpc_mem_block * body;
+    xmlrpc_zstream * decoderP;
 
     if (trace)
         fprintf(stderr, "XML-RPC handler processing body.  "
                 "Content Size = %u bytes\n", (unsigned)contentSize);
 
-    body = xmlrpc_mem_block_new(envP, 0);
+    createDecoder(envP, coding, &decoderP);
+
+    if (!envP->fault_occurred) {
+        if (!decoderP) {
+            /* We read the body right into its memblock */
+            body = XMLRPC_MEMBLOCK_NEW(char, envP, contentSize);
+
+            if (!envP->fault_occurred)
+                readBody(envP, abyssSessionP,
+                         XMLRPC_MEMBLOCK_CONTENTS(char, body), contentSize,
+                         trace);
+        } else {
+            body = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+
+            if (!envP->fault_occurred) {
+                char * piece;
+
+                MALLOCARRAY(piece, MIN(contentSize, BODY_PIECE_SIZE));
+
+                if (piece == NULL)
+                    xmlrpc_faultf(envP, "Couldn't allocate memory for "
+                                  "reading the body");
+                else {
+                    size_t bytesRead;
+
+                    for (bytesRead = 0;
+                         !envP->fault_occurred && bytesRead < contentSize; ) {
+                        size_t const pieceLen =
+                            MIN(contentSize - bytesRead, BODY_PIECE_SIZE);
+
+                        readBody(envP, abyssSessionP, piece, pieceLen, trace);
+
+                        if (!envP->fault_occurred) {
+                            xmlrpc_zstreamFeed(envP, decoderP,
+                                               piece, pieceLen, body);
+                            bytesRead += pieceLen;
+                        }
+                    }
+                    if (!envP->fault_occurred)
+                        xmlrpc_zstreamFinish(envP, decoderP, body);
+
+                    free(piece);
+                }
+            }
+        }
+        if (!envP->fault_occurred)
+            *bodyP = body;
+        else if (body)
+            XMLRPC_MEMBLOCK_FREE(char, body);
+
+        if (decoderP)
+            xmlrpc_zstreamDestroy(decoderP);
+    }
+}
+
+
+
+static void
+feedCallParser(xmlrpc_env *        const parseEnvP,
+               xmlrpc_callParser * const parserP,
+               const char *        const xmlData,
+               size_t              const xmlDataLen) {
+
+    /* There's no whole call to trace, so we trace each chunk */
+    xmlrpc_traceXml("XML-RPC CALL", xmlData, xmlDataLen);
+
+    if (!parseEnvP->fault_occurred)
+        xmlrpc_callParserFeed(parseEnvP, parserP, xmlData, xmlDataLen);
+}
+
+
+
+static void
+decodeAndFeed(xmlrpc_env *        const envP,
+              xmlrpc_zstream *    const decoderP,
+              xmlrpc_mem_block *  const scratchP,
+              const char *        const data,
+              size_t              const dataLen,
+              bool                const finish,
+              xmlrpc_env *        const parseEnvP,
+              xmlrpc_callParser * const parserP) {
+/*----------------------------------------------------------------------------
+   Decode the next 'dataLen' bytes of the body, at 'data', with *decoderP and
+   feed what that produces to *parserP.  'finish' means this is the end of
+   the body.
+
+   We use *scratchP to hold the decoded text while we feed it.
+-----------------------------------------------------------------------------*/
+    if (finish)
+        xmlrpc_zstreamFinish(envP, decoderP, scratchP);
+    else
+        xmlrpc_zstreamFeed(envP, decoderP, data, dataLen, scratchP);
+
+    if (!envP->fault_occurred) {
+        size_t const decodedLen = XMLRPC_MEMBLOCK_SIZE(char, scratchP);
+
+        if (decodedLen > 0)
+            feedCallParser(parseEnvP, parserP,
+                           XMLRPC_MEMBLOCK_CONTENTS(char, scratchP),
+                           decodedLen);
+
+        /* Shrinking never fails and keeps the memory for next time */
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, scratchP, 0);
+    }
+}
+
+
+
+static void
+parseBody(xmlrpc_env *         const envP,
+          TSession *           const abyssSessionP,
+          size_t               const contentSize,
+          xmlrpc_contentCoding const coding,
+          const char *         const trace,
+          xmlrpc_env *         const parseEnvP,
+          const char **        const methodNameP,
+          xmlrpc_value **      const paramArrayPP) {
+/*----------------------------------------------------------------------------
+   Get the entire body, which is of size 'contentSize' bytes, from the
+   Abyss session and parse it as an XML-RPC call, returning the method
+   name and parameters.
+
+   This is like getBody(), except that we feed the body to the XML parser a
+   chunk at a time as it arrives, so parsing overlaps the client sending the
+   rest and we never hold the whole body in memory.  If the body is
+   compressed ('coding'), we decompress each chunk as it arrives, too.
+
+   If we can't get the body, we fail (*envP).  If we can get it, but it isn't
+   a valid call, we don't fail, but return the reason as *parseEnvP and
+   nothing else.  We still read the whole body in that case.
+-----------------------------------------------------------------------------*/
+    xmlrpc_callParser * parserP;
+    xmlrpc_zstream * decoderP;
+    xmlrpc_mem_block * scratchP;
+
+    if (trace)
+        fprintf(stderr, "XML-RPC handler processing body incrementally.  "
+                "Content Size = %u bytes\n", (unsigned)contentSize);
+
+    createDecoder(envP, coding, &decoderP);
+
     if (!envP->fault_occurred) {
-        size_t bytesRead;
+        scratchP = decoderP ? XMLRPC_MEMBLOCK_NEW(char, envP, 0) : NULL;
+
+        if (!envP->fault_occurred) {
+            xmlrpc_callParserCreate(envP, NULL, true, &parserP);
+
+            if (!envP->fault_occurred) {
+                char * piece;
+
+                MALLOCARRAY(piece, MIN(contentSize, BODY_PIECE_SIZE));
+
+                if (piece == NULL)
+                    xmlrpc_faultf(envP, "Couldn't allocate memory for "
+                                  "reading the body");
+                else {
+                    size_t bytesRead;
+
+                    for (bytesRead = 0;
+                         !envP->fault_occurred && bytesRead < contentSize; ) {
+                        size_t const pieceLen =
+                            MIN(contentSize - bytesRead, BODY_PIECE_SIZE);
+
+                        readBody(envP, abyssSessionP, piece, pieceLen, trace);
+
+                        if (!envP->fault_occurred) {
+                            if (decoderP)
+                                decodeAndFeed(envP, decoderP, scratchP,
+                                              piece, pieceLen, false,
+                                              parseEnvP, parserP);
+                            else
+                                feedCallParser(parseEnvP, parserP,
+                                               piece, pieceLen);
+
+                            bytesRead += pieceLen;
+                        }
+                    }
+                    free(piece);
+                }
+                if (!envP->fault_occurred && decoderP)
+                    decodeAndFeed(envP, decoderP, scratchP, NULL, 0, true,
+                                  parseEnvP, parserP);
+
+                if (!envP->fault_occurred && !parseEnvP->fault_occurred)
+                    xmlrpc_callParserFinish(parseEnvP, parserP,
+                                            methodNameP, paramArrayPP);
+
+                xmlrpc_callParserDestroy(parserP);
+            }
+            if (scratchP)
+                XMLRPC_MEMBLOCK_FREE(char, scratchP);
+        }
+        if (decoderP)
+            xmlrpc_zstreamDestroy(decoderP);
+    }
+}
+
 
-        bytesRead = 0;
 
-        while (!envP->fault_occurred && bytesRead < contentSize) {
-            const char * chunkPtr;
-            size_t chunkLen;
+static void
+executeCall(xmlrpc_env *          const envP,
+            TSession *            const abyssSessionP,
+            size_t                const contentSize,
+            xmlrpc_contentCoding  const coding,
+            xmlrpc_call_processor       xmlProcessor,
+            void *                const xmlProcessorArg,
+            const char *          const trace,
+            xmlrpc_mem_block **   const outputP) {
+/*----------------------------------------------------------------------------
+   Get the call from the Abyss session and execute it with 'xmlProcessor',
+   returning the response as *outputP.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * body;
+
+    getBody(envP, abyssSessionP, contentSize, coding, trace, &body);
+    if (!envP->fault_occurred) {
+        xmlProcessor(
+            envP, xmlProcessorArg,
+            XMLRPC_MEMBLOCK_CONTENTS(char, body),
+            XMLRPC_MEMBLOCK_SIZE(char, body),
+            abyssSessionP,
+            outputP);
+
+        XMLRPC_MEMBLOCK_FREE(char, body);
+    }
+}
 
-            SessionGetReadData(abyssSessionP, contentSize - bytesRead,
-                               &chunkPtr, &chunkLen);
-            bytesRead += chunkLen;
 
-            assert(bytesRead <= contentSize);
 
-            XMLRPC_MEMBLOCK_APPEND(char, envP, body, chunkPtr, chunkLen);
-            if (bytesRead < contentSize)
-                refillBufferFromConnection(envP, abyssSessionP, trace);
+static void
+executeRegistryCall(xmlrpc_env *              const envP,
+                    TSession *                const abyssSessionP,
+                    size_t                    const contentSize,
+                    xmlrpc_contentCoding      const coding,
+                    xmlrpc_registry *         const registryP,
+                    const char *              const trace,
+                    size_t                    const flushSize,
+                    xmlrpc_serializeFlushFn         flush,
+                    void *                    const flushArg,
+                    xmlrpc_mem_block **       const outputP) {
+/*----------------------------------------------------------------------------
+   Same as executeCall(), but with method registry *registryP instead of an
+   arbitrary XML processor.  This is faster, because we can parse the call
+   as it arrives.
+
+   If 'flush' is non-null, we also generate the response a piece at a time,
+   passing 'flushSize', 'flush', and 'flushArg' to
+   xmlrpc_processParsedCallStream().
+-----------------------------------------------------------------------------*/
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_env parseEnv;
+
+    xmlrpc_env_init(&parseEnv);
+
+    parseBody(envP, abyssSessionP, contentSize, coding, trace,
+              &parseEnv, &methodName, &paramArrayP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_processParsedCallStream(envP, registryP, &parseEnv,
+                                       methodName, paramArrayP, abyssSessionP,
+                                       flushSize, flush, flushArg, outputP);
+
+        if (!parseEnv.fault_occurred) {
+            xmlrpc_strfree(methodName);
+            xmlrpc_DECREF(paramArrayP);
         }
-        if (envP->fault_occurred)
-            xmlrpc_mem_block_free(body);
     }
-    *bodyP = body;
+    xmlrpc_env_clean(&parseEnv);
 }
 
 
@@ -303,6 +618,465 @@ processContentLength(TSession *    const httpRequestP,
 
 
 
+static void
+codingFromToken(const char *           const token,
+                size_t                 const tokenLen,
+                bool *                 const recognizedP,
+                xmlrpc_contentCoding * const codingP) {
+/*----------------------------------------------------------------------------
+   Interpret the 'tokenLen' characters at 'token' as the name of a content
+   coding.
+-----------------------------------------------------------------------------*/
+    char name[16];
+
+    if (tokenLen >= sizeof(name))
+        *recognizedP = false;
+    else {
+        memcpy(name, token, tokenLen);
+        name[tokenLen] = '\0';
+
+        xmlrpc_contentCodingFromName(name, recognizedP, codingP);
+    }
+}
+
+
+
+static bool
+isHttpSpace(char const c) {
+
+    return c == ' ' || c == '\t';
+}
+
+
+
+static void
+processContentEncoding(TSession *             const httpRequestP,
+                       xmlrpc_contentCoding * const codingP,
+                       const char **          const errorP) {
+/*----------------------------------------------------------------------------
+   Find out from the content-encoding HTTP header how the body is encoded.
+   Fail if it's a way we can't decode.
+-----------------------------------------------------------------------------*/
+    const char * const contentEncoding =
+        RequestHeaderValue(httpRequestP, "content-encoding");
+
+    if (contentEncoding == NULL) {
+        *codingP = XMLRPC_CODING_IDENTITY;
+        *errorP = NULL;
+    } else {
+        const char * start;
+        const char * end;
+        bool recognized;
+
+        for (start = contentEncoding; isHttpSpace(*start); ++start);
+        for (end = start + strlen(start);
+             end > start && isHttpSpace(end[-1]); --end);
+
+        codingFromToken(start, end - start, &recognized, codingP);
+
+        if (!recognized)
+            xmlrpc_asprintf(errorP, "This server can't decode a body with "
+                            "content-encoding '%s'.  It understands gzip "
+                            "and deflate", contentEncoding);
+        else if (*codingP != XMLRPC_CODING_IDENTITY &&
+                 !xmlrpc_compressionAvailable())
+            xmlrpc_asprintf(errorP, "This server can't decode a body with "
+                            "content-encoding '%s'; it was built without "
+                            "compression", contentEncoding);
+        else
+            *errorP = NULL;
+    }
+}
+
+
+
+static unsigned int
+qvalueFromString(const char * const qvalue) {
+/*----------------------------------------------------------------------------
+   The value of HTTP qvalue 'qvalue' (e.g. "0.5") in thousandths.
+   Garbage counts as zero.
+
+   We don't use strtod(), because it depends on the locale.
+-----------------------------------------------------------------------------*/
+    unsigned int retval;
+
+    if (qvalue[0] == '1')
+        retval = 1000;
+    else if (qvalue[0] == '0' && qvalue[1] == '.') {
+        unsigned int scale;
+        const char * p;
+
+        for (p = &qvalue[2], scale = 100, retval = 0;
+             scale > 0 && *p >= '0' && *p <= '9';
+             ++p, scale /= 10)
+            retval += (*p - '0') * scale;
+    } else
+        retval = 0;
+
+    return retval;
+}
+
+
+
+static void
+chooseResponseCoding(TSession *             const httpRequestP,
+                     xmlrpc_contentCoding * const codingP) {
+/*----------------------------------------------------------------------------
+   Choose the content coding for the response from the ones the client
+   says in its accept-encoding header it accepts, e.g.
+
+     Accept-Encoding: gzip;q=1.0, deflate;q=0.5, *;q=0
+
+   When the client likes gzip and deflate equally, we choose gzip.  When
+   there is no accept-encoding header, it's identity.
+-----------------------------------------------------------------------------*/
+    const char * const acceptEncoding =
+        RequestHeaderValue(httpRequestP, "accept-encoding");
+
+    /* These are qvalues in thousandths; -1 means the header doesn't say */
+    int qGzip, qDeflate, qStar;
+    const char * p;
+
+    qGzip = qDeflate = qStar = -1;
+
+    for (p = acceptEncoding ? acceptEncoding : ""; *p; ) {
+        const char * name;
+        size_t nameLen;
+        unsigned int q;
+
+        while (isHttpSpace(*p) || *p == ',')
+            ++p;
+
+        for (name = p; *p && *p != ',' && *p != ';' && !isHttpSpace(*p); ++p);
+        nameLen = p - name;
+
+        for (q = 1000; *p && *p != ','; ) {
+            if (*p == ';') {
+                for (++p; isHttpSpace(*p); ++p);
+                if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+                    q = qvalueFromString(&p[2]);
+            } else
+                ++p;
+        }
+        if (nameLen == 1 && name[0] == '*')
+            qStar = q;
+        else if (nameLen > 0) {
+            bool recognized;
+            xmlrpc_contentCoding coding;
+
+            codingFromToken(name, nameLen, &recognized, &coding);
+
+            if (recognized) {
+                if (coding == XMLRPC_CODING_GZIP)
+                    qGzip = q;
+                else if (coding == XMLRPC_CODING_DEFLATE)
+                    qDeflate = q;
+            }
+        }
+    }
+    if (qGzip < 0)
+        qGzip = qStar > 0 ? qStar : 0;
+    if (qDeflate < 0)
+        qDeflate = qStar > 0 ? qStar : 0;
+
+    if (qGzip > 0 && qGzip >= qDeflate)
+        *codingP = XMLRPC_CODING_GZIP;
+    else if (qDeflate > 0)
+        *codingP = XMLRPC_CODING_DEFLATE;
+    else
+        *codingP = XMLRPC_CODING_IDENTITY;
+}
+
+
+
+static void
+encodeResponse(xmlrpc_env *          const envP,
+               TSession *            const abyssSessionP,
+               unsigned int          const compressionLevel,
+               size_t                const compressionThreshold,
+               xmlrpc_mem_block **   const outputPP,
+               xmlrpc_contentCoding * const codingP) {
+/*----------------------------------------------------------------------------
+   Compress the response body **outputPP, replacing it, if the client
+   accepts that and the body is big enough to make it worthwhile.  Return
+   the content coding of the result as *codingP.
+-----------------------------------------------------------------------------*/
+    size_t const len = XMLRPC_MEMBLOCK_SIZE(char, *outputPP);
+
+    if (compressionLevel > 0 && len >= compressionThreshold &&
+        xmlrpc_compressionAvailable())
+        chooseResponseCoding(abyssSessionP, codingP);
+    else
+        *codingP = XMLRPC_CODING_IDENTITY;
+
+    if (*codingP != XMLRPC_CODING_IDENTITY) {
+        xmlrpc_mem_block * compressedP;
+
+        xmlrpc_compress(envP, *codingP, compressionLevel,
+                        XMLRPC_MEMBLOCK_CONTENTS(char, *outputPP), len,
+                        &compressedP);
+
+        if (!envP->fault_occurred) {
+            XMLRPC_MEMBLOCK_FREE(char, *outputPP);
+            *outputPP = compressedP;
+        }
+    }
+}
+
+
+
+#define STREAM_CHUNK_SIZE (64*1024)
+    /* When we send a response as we generate it, this is about how much of
+       it we send at a time.  It's about the size of a typical TCP send
+       buffer, so sending a chunk blocks only when the client really is
+       falling behind, and that blocking is what keeps us from generating
+       the response faster than the client takes it: we never hold much more
+       than one chunk of it.
+    */
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   A response we send a chunk at a time, as the serializer generates it.
+-----------------------------------------------------------------------------*/
+    TSession *           abyssSessionP;
+    unsigned int         compressionLevel;
+    size_t               compressionThreshold;
+    ResponseAccessCtl    accessControl;
+    bool                 started;
+        /* We have sent the HTTP header, so we're committed to sending
+           the response as a stream.
+        */
+    bool                 declined;
+        /* We found we can't stream the response (the client doesn't do
+           chunks), so we're leaving it for the serializer to build whole.
+        */
+    xmlrpc_contentCoding coding;
+        /* The content coding of the response we send */
+    xmlrpc_zstream *     zstreamP;
+        /* The compressor through which we send the response; NULL if
+           'coding' is identity.
+        */
+    xmlrpc_mem_block *   compressedP;
+        /* Scratch space for compressed data.  Meaningful only if
+           'zstreamP' is non-null.
+        */
+} responseStream;
+
+
+
+static void
+initResponseStream(responseStream *  const streamP,
+                   TSession *        const abyssSessionP,
+                   unsigned int      const compressionLevel,
+                   size_t            const compressionThreshold,
+                   ResponseAccessCtl const accessControl) {
+
+    streamP->abyssSessionP        = abyssSessionP;
+    streamP->compressionLevel     = compressionLevel;
+    streamP->compressionThreshold = compressionThreshold;
+    streamP->accessControl        = accessControl;
+    streamP->started              = false;
+    streamP->declined             = false;
+    streamP->coding               = XMLRPC_CODING_IDENTITY;
+    streamP->zstreamP             = NULL;
+    streamP->compressedP          = NULL;
+}
+
+
+
+static void
+termResponseStream(responseStream * const streamP) {
+
+    if (streamP->zstreamP) {
+        xmlrpc_zstreamDestroy(streamP->zstreamP);
+        XMLRPC_MEMBLOCK_FREE(char, streamP->compressedP);
+    }
+}
+
+
+
+static void
+setupStreamCompression(xmlrpc_env *     const envP,
+                       responseStream * const streamP,
+                       size_t           const firstChunkSize) {
+/*----------------------------------------------------------------------------
+   Set up to compress the streamed response, if the client accepts that and
+   the response is big enough to make it worthwhile.  We know only that it
+   is at least 'firstChunkSize' bytes, but that usually decides it.
+-----------------------------------------------------------------------------*/
+    xmlrpc_contentCoding coding;
+
+    if (streamP->compressionLevel > 0 &&
+        firstChunkSize >= streamP->compressionThreshold &&
+        xmlrpc_compressionAvailable())
+        chooseResponseCoding(streamP->abyssSessionP, &coding);
+    else
+        coding = XMLRPC_CODING_IDENTITY;
+
+    if (coding != XMLRPC_CODING_IDENTITY) {
+        streamP->compressedP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_zstreamCreateDeflate(envP, coding,
+                                        streamP->compressionLevel,
+                                        &streamP->zstreamP);
+
+            if (envP->fault_occurred) {
+                XMLRPC_MEMBLOCK_FREE(char, streamP->compressedP);
+                streamP->zstreamP = NULL;
+            } else
+                streamP->coding = coding;
+        }
+    }
+}
+
+
+
+static void
+startResponseStream(xmlrpc_env *     const envP,
+                    responseStream * const streamP,
+                    size_t           const firstChunkSize) {
+/*----------------------------------------------------------------------------
+   Send the HTTP header for a streamed response, or decide we can't stream
+   it after all.
+-----------------------------------------------------------------------------*/
+    TSession * const abyssSessionP = streamP->abyssSessionP;
+
+    setupStreamCompression(envP, streamP, firstChunkSize);
+
+    if (!envP->fault_occurred) {
+        if (!ResponseChunked(abyssSessionP)) {
+            /* Client is HTTP 1.0; a response of unknown length would
+               have to end the connection.  We'll send it the usual way,
+               with a content-length header.
+            */
+            streamP->declined = true;
+            termResponseStream(streamP);
+            streamP->zstreamP = NULL;
+            streamP->coding   = XMLRPC_CODING_IDENTITY;
+        } else {
+            ResponseStatus(abyssSessionP, 200);
+            ResponseContentType(abyssSessionP, "text/xml; charset=utf-8");
+            ResponseAccessControl(abyssSessionP, streamP->accessControl);
+
+            if (streamP->coding != XMLRPC_CODING_IDENTITY)
+                ResponseAddField(abyssSessionP, "Content-Encoding",
+                                 xmlrpc_contentCodingName(streamP->coding));
+            if (streamP->compressionLevel > 0)
+                ResponseAddField(abyssSessionP, "Vary", "Accept-Encoding");
+
+            ResponseWriteStart(abyssSessionP);
+
+            streamP->started = true;
+        }
+    }
+}
+
+
+
+static void
+sendStreamData(xmlrpc_env *     const envP,
+               responseStream * const streamP,
+               const char *     const data,
+               size_t           const len) {
+
+    if (len > 0) {
+        bool const succeeded = writeBody(streamP->abyssSessionP, data, len);
+
+        if (!succeeded)
+            xmlrpc_env_set_fault(envP, XMLRPC_NETWORK_ERROR,
+                                 "Failed to send response to the client.  "
+                                 "It probably hung up.");
+    }
+}
+
+
+
+static void
+writeResponseStream(xmlrpc_env *     const envP,
+                    responseStream * const streamP,
+                    const char *     const data,
+                    size_t           const len) {
+/*----------------------------------------------------------------------------
+   Send the 'len' bytes of response at 'data' as the next part of the
+   streamed response.
+-----------------------------------------------------------------------------*/
+    if (streamP->zstreamP) {
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, streamP->compressedP, 0);
+
+        xmlrpc_zstreamFeed(envP, streamP->zstreamP, data, len,
+                           streamP->compressedP);
+
+        if (!envP->fault_occurred)
+            sendStreamData(
+                envP, streamP,
+                XMLRPC_MEMBLOCK_CONTENTS(char, streamP->compressedP),
+                XMLRPC_MEMBLOCK_SIZE(char, streamP->compressedP));
+    } else
+        sendStreamData(envP, streamP, data, len);
+}
+
+
+
+static xmlrpc_serializeFlushFn flushResponseStream;
+
+static void
+flushResponseStream(xmlrpc_env *       const envP,
+                    void *             const arg,
+                    xmlrpc_mem_block * const outputP) {
+/*----------------------------------------------------------------------------
+   This is the flush function for the serializer when we stream the
+   response: send what has been generated so far, as the next chunk of the
+   response.
+-----------------------------------------------------------------------------*/
+    responseStream * const streamP = arg;
+
+    if (!streamP->declined) {
+        if (!streamP->started)
+            startResponseStream(envP, streamP,
+                                XMLRPC_MEMBLOCK_SIZE(char, outputP));
+
+        if (!envP->fault_occurred && streamP->started) {
+            writeResponseStream(envP, streamP,
+                                XMLRPC_MEMBLOCK_CONTENTS(char, outputP),
+                                XMLRPC_MEMBLOCK_SIZE(char, outputP));
+
+            if (!envP->fault_occurred)
+                XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, 0);
+        }
+    }
+}
+
+
+
+static void
+finishResponseStream(xmlrpc_env *       const envP,
+                     responseStream *   const streamP,
+                     xmlrpc_mem_block * const restP) {
+/*----------------------------------------------------------------------------
+   Send the last of the streamed response, which is *restP, and end it.
+-----------------------------------------------------------------------------*/
+    writeResponseStream(envP, streamP,
+                        XMLRPC_MEMBLOCK_CONTENTS(char, restP),
+                        XMLRPC_MEMBLOCK_SIZE(char, restP));
+
+    if (!envP->fault_occurred && streamP->zstreamP) {
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, streamP->compressedP, 0);
+
+        xmlrpc_zstreamFinish(envP, streamP->zstreamP, streamP->compressedP);
+
+        if (!envP->fault_occurred)
+            sendStreamData(
+                envP, streamP,
+                XMLRPC_MEMBLOCK_CONTENTS(char, streamP->compressedP),
+                XMLRPC_MEMBLOCK_SIZE(char, streamP->compressedP));
+    }
+    if (!envP->fault_occurred)
+        ResponseWriteEnd(streamP->abyssSessionP);
+}
+
+
+
 static void
 traceHandlerCalled(TSession * const abyssSessionP) {
 
@@ -340,9 +1114,13 @@ traceHandlerCalled(TSession * const abyssSessionP) {
 static void
 processCall(TSession *            const abyssSessionP,
             size_t                const contentSize,
+            xmlrpc_contentCoding  const coding,
+            xmlrpc_registry *     const registryP,
             xmlrpc_call_processor       xmlProcessor,
             void *                const xmlProcessorArg,
             bool                  const wantChunk,
+            unsigned int          const compressionLevel,
+            size_t                const compressionThreshold,
             ResponseAccessCtl     const accessControl,
             const char *          const trace) {
 /*----------------------------------------------------------------------------
@@ -352,15 +1130,25 @@ processCall(TSession *            const abyssSessionP,
    We get the body of the request, which is the text of the call,
    via the Abyss session 'abyssSessionP'.
 
-   Its content length is 'contentSize' bytes.
+   Its content length is 'contentSize' bytes and its content coding is
+   'coding'.
 
    We send the response to the request (which may contain the RPC response,
    but may be an error indication) via the Abyss session 'abyssSessionP'.
 
    We use 'xmlProcessor', with argument 'xmlProcessorArg' to execute the
-   RPC, i.e. turn the XML-RPC call into an XML-RPC response.
+   RPC, i.e. turn the XML-RPC call into an XML-RPC response.  But if
+   'registryP' is non-null, that is what 'xmlProcessor' would use, so we
+   use it directly instead.
 
-   'wantChunk' means Caller wants the HTTP reponse chunked.
+   'wantChunk' means Caller wants the HTTP reponse chunked.  In that case,
+   if we have 'registryP' and the client understands chunks, we send the
+   response as we generate it, so a big response doesn't have to fit in
+   memory all at once and the client gets the start of it sooner.
+
+   We compress the response with zlib level 'compressionLevel' if the client
+   accepts that and it is at least 'compressionThreshold' bytes.
+   'compressionLevel' zero means don't.
 
    We use the Abyss session's memory pool for some memory allocations -
    essentially those that aren't predictable because they depend upon the data
@@ -368,6 +1156,7 @@ processCall(TSession *            const abyssSessionP,
    limit designed to keep the client from monopolizing the server's memory.
 -----------------------------------------------------------------------------*/
     xmlrpc_env env;
+    responseStream stream;
 
     if (trace)
         fprintf(stderr,
@@ -375,46 +1164,78 @@ processCall(TSession *            const abyssSessionP,
 
     xmlrpc_env_init(&env);
 
+    initResponseStream(&stream, abyssSessionP,
+                       compressionLevel, compressionThreshold, accessControl);
+
     if (contentSize > xmlrpc_limit_get(XMLRPC_XML_SIZE_LIMIT_ID))
         xmlrpc_env_set_fault_formatted(
             &env, XMLRPC_LIMIT_EXCEEDED_ERROR,
             "XML-RPC request too large (%u bytes)", (unsigned)contentSize);
     else {
-        xmlrpc_mem_block * body;
-        /* Read XML data off the wire. */
-        getBody(&env, abyssSessionP, contentSize, trace, &body);
+        xmlrpc_mem_block * output;
+
+        /* Read XML data off the wire and process the RPC. */
+        if (registryP)
+            executeRegistryCall(&env, abyssSessionP, contentSize, coding,
+                                registryP, trace,
+                                STREAM_CHUNK_SIZE,
+                                wantChunk ? &flushResponseStream : NULL,
+                                &stream, &output);
+        else
+            executeCall(&env, abyssSessionP, contentSize, coding,
+                        xmlProcessor, xmlProcessorArg, trace, &output);
+
         if (!env.fault_occurred) {
-            xmlrpc_mem_block * output;
-
-            /* Process the RPC. */
-            xmlProcessor(
-                &env, xmlProcessorArg,
-                XMLRPC_MEMBLOCK_CONTENTS(char, body),
-                XMLRPC_MEMBLOCK_SIZE(char, body),
-                abyssSessionP,
-                &output);
-            if (!env.fault_occurred) {
-                /* Send out the result. */
-                sendResponse(&env, abyssSessionP,
-                             XMLRPC_MEMBLOCK_CONTENTS(char, output),
-                             XMLRPC_MEMBLOCK_SIZE(char, output),
-                             wantChunk, accessControl);
+            if (stream.started)
+                finishResponseStream(&env, &stream, output);
+            else {
+                xmlrpc_contentCoding responseCoding;
 
-                XMLRPC_MEMBLOCK_FREE(char, output);
+                encodeResponse(&env, abyssSessionP,
+                               compressionLevel, compressionThreshold,
+                               &output, &responseCoding);
+
+                /* Send out the result. */
+                if (!env.fault_occurred)
+                    sendResponse(&env, abyssSessionP,
+                                 XMLRPC_MEMBLOCK_CONTENTS(char, output),
+                                 XMLRPC_MEMBLOCK_SIZE(char, output),
+                                 responseCoding, compressionLevel > 0,
+                                 wantChunk, accessControl);
             }
-            XMLRPC_MEMBLOCK_FREE(char, body);
+            XMLRPC_MEMBLOCK_FREE(char, output);
         }
     }
-    if (env.fault_occurred) {
+    if (env.fault_occurred && stream.started) {
+        /* It's too late to send an error response; the client already
+           has part of the real one, with a success status.  All we can do
+           is abort it, so that Abyss closes the connection without the
+           terminating chunk.  The client then sees an incomplete chunked
+           response (which is also not valid XML) rather than a complete
+           one.
+        */
+        if (trace)
+            fprintf(stderr, "Failed in the middle of sending the "
+                    "response.  %s\n", env.fault_string);
+
+        ResponseAbort(abyssSessionP);
+    } else if (env.fault_occurred) {
         uint16_t httpResponseStatus;
         if (env.fault_code == XMLRPC_TIMEOUT_ERROR)
             httpResponseStatus = 408;  /* Request Timeout */
+        else if (env.fault_code == XMLRPC_PARSE_ERROR)
+            /* The only parse error that gets here is a compressed body
+               that doesn't decompress; a bad call gets an XML-RPC fault.
+            */
+            httpResponseStatus = 400;  /* Bad Request */
         else
             httpResponseStatus = 500;  /* Internal Server Error */
 
         sendError(abyssSessionP, httpResponseStatus, env.fault_string);
     }
 
+    termResponseStream(&stream);
+
     xmlrpc_env_clean(&env);
 }
 
@@ -462,9 +1283,12 @@ xmlrpc_termUriHandler(void * const arg) {
 static void
 handleXmlRpcCallReq(TSession *           const abyssSessionP,
                     const TRequestInfo * const requestInfoP ATTR_UNUSED,
+                    xmlrpc_registry *    const registryP,
                     xmlrpc_call_processor      xmlProcessor,
                     void *               const xmlProcessorArg,
                     bool                 const wantChunk,
+                    unsigned int         const compressionLevel,
+                    size_t               const compressionThreshold,
                     ResponseAccessCtl    const accessControl) {
 /*----------------------------------------------------------------------------
    Handle the HTTP request described by *requestInfoP, which arrived over
@@ -473,7 +1297,8 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
    supposed to handle).
 
    Handle it by feeding the XML which is its content to 'xmlProcessor'
-   along with argument 'xmlProcessorArg'.
+   along with argument 'xmlProcessorArg', or to method registry 'registryP'
+   if that is non-null.
 
    (There doesn't seem to be any way 'xmlProcessor' could ever be anything but
    'processXmlrpcCall' in xmlrpc_server_abyss.c (with 'xmlProcessorArg' being
@@ -508,11 +1333,22 @@ handleXmlRpcCallReq(TSession *           const abyssSessionP,
                 sendError(abyssSessionP, 411, "You must send a "
                           "content-length HTTP header in an "
                           "XML-RPC call.");
-            else
-                processCall(abyssSessionP, contentSize,
-                            xmlProcessor, xmlProcessorArg,
-                            wantChunk, accessControl,
-                            trace_abyss);
+            else {
+                xmlrpc_contentCoding coding;
+
+                processContentEncoding(abyssSessionP, &coding, &error);
+
+                if (error) {
+                    sendError(abyssSessionP, 415, error);
+                        /* 415 = Unsupported Media Type */
+                    xmlrpc_strfree(error);
+                } else
+                    processCall(abyssSessionP, contentSize, coding,
+                                registryP, xmlProcessor, xmlProcessorArg,
+                                wantChunk,
+                                compressionLevel, compressionThreshold,
+                                accessControl, trace_abyss);
+            }
         }
     }
 }
@@ -574,9 +1410,12 @@ xmlrpc_handleIfXmlrpcReq(void *        const handlerArg,
         switch (requestInfoP->method) {
         case m_post:
             handleXmlRpcCallReq(abyssSessionP, requestInfoP,
+                                uriHandlerXmlrpcP->registryP,
                                 uriHandlerXmlrpcP->xmlProcessor,
                                 uriHandlerXmlrpcP->xmlProcessorArg,
                                 uriHandlerXmlrpcP->chunkResponse,
+                                uriHandlerXmlrpcP->compressionLevel,
+                                uriHandlerXmlrpcP->compressionThreshold,
                                 uriHandlerXmlrpcP->accessControl);
             break;
         case m_options:
@@ -11,12 +11,19 @@ struct uriHandlerXmlrpc {
    that is specific to the Xmlrpc-c handler.
 -----------------------------------------------------------------------------*/
     xmlrpc_registry *       registryP;
+        /* The method registry 'xmlProcessor' executes calls with, if it is
+           the standard one for a registry.  Null otherwise.
+        */
     const char *            uriPath;  /* malloc'ed */
     bool                    chunkResponse;
         /* The handler should chunk its response whenever possible */
     xmlrpc_call_processor * xmlProcessor;
     void *                  xmlProcessorArg;
     ResponseAccessCtl       accessControl;
+    unsigned int            compressionLevel;
+        /* zlib level at which to compress responses; 0 means don't */
+    size_t                  compressionThreshold;
+        /* Don't compress a response smaller than this */
 };
 
 
@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <cassert>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -21,7 +22,9 @@ using girerr::throwf;
 using girmem::autoObjectPtr;
 using girmem::autoObject;
 #include "xmlrpc-c/env_wrap.hpp"
+#include "xmlrpc-c/Lock.hpp"
 #include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/time_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/client.h"
 #include "xmlrpc-c/transport.h"
@@ -71,6 +74,158 @@ public:
     xmlrpc_mem_block * memblockP;
 };
 
+
+
+struct pendingRpc {
+/*----------------------------------------------------------------------------
+   An RPC a client_xml has started, but is holding so it can send it in
+   one system.multicall request along with others.
+-----------------------------------------------------------------------------*/
+    string               methodName;
+    paramList            params;
+    clientTransactionPtr tranP;
+
+    pendingRpc(string               const& methodName,
+               paramList            const& params,
+               clientTransactionPtr const& tranP) :
+        methodName(methodName), params(params), tranP(tranP) {}
+};
+
+
+
+struct rpcBatch {
+    carriageParm *     carriageParmP;
+    vector<pendingRpc> rpcs;
+
+    rpcBatch() : carriageParmP(NULL) {}
+};
+
+
+
+rpcOutcome
+multicallOutcome(value const& resultV) {
+/*----------------------------------------------------------------------------
+   The outcome of one RPC, given the item for it in the result of a
+   system.multicall RPC: an array of the RPC's one result value, or a fault
+   structure.
+-----------------------------------------------------------------------------*/
+    rpcOutcome retval;
+
+    switch (resultV.type()) {
+    case value::TYPE_ARRAY: {
+        carray const resultArray(value_array(resultV).vectorValueValue());
+
+        if (resultArray.size() != 1)
+            throwf("system.multicall result item is an array of %u items, "
+                   "not 1", (unsigned)resultArray.size());
+
+        retval = rpcOutcome(resultArray[0]);
+    } break;
+    case value::TYPE_STRUCT: {
+        cstruct const faultStruct(value_struct(resultV).cvalue());
+
+        cstruct::const_iterator const codeP(faultStruct.find("faultCode"));
+        cstruct::const_iterator const stringP(
+            faultStruct.find("faultString"));
+
+        if (codeP == faultStruct.end() || stringP == faultStruct.end())
+            throwf("system.multicall result item is a structure, but not "
+                   "a fault structure");
+
+        int const faultCode(value_int(codeP->second));
+        string const faultString(value_string(stringP->second));
+
+        retval = rpcOutcome(fault(faultString,
+                                  static_cast<fault::code_t>(faultCode)));
+    } break;
+    default:
+        throwf("system.multicall result item is neither an array nor "
+               "a structure");
+    }
+    return retval;
+}
+
+
+
+class xmlTransaction_multicall : public xmlTransaction {
+/*----------------------------------------------------------------------------
+   The transaction of a system.multicall RPC that carries a batch of RPCs.
+   Finishing this finishes each of those with its own outcome.
+-----------------------------------------------------------------------------*/
+public:
+    xmlTransaction_multicall(vector<clientTransactionPtr> const& tranList) :
+        tranList(tranList) {}
+
+    void
+    finish(string const& responseXml) const;
+
+    void
+    finishErr(error const& error) const;
+
+    void
+    progress(struct xmlrpc_progress_data const& progressData) const;
+
+private:
+    vector<clientTransactionPtr> const tranList;
+};
+
+
+
+void
+xmlTransaction_multicall::finish(string const& responseXml) const {
+
+    xml::trace("XML-RPC RESPONSE", responseXml);
+
+    vector<rpcOutcome> outcomes;
+
+    try {
+        rpcOutcome outcome;
+
+        xml::parseResponse(responseXml, &outcome);
+
+        if (outcome.succeeded()) {
+            carray const results(
+                value_array(outcome.getResult()).vectorValueValue());
+
+            if (results.size() != this->tranList.size())
+                throwf("system.multicall returned %u results for %u calls",
+                       (unsigned)results.size(),
+                       (unsigned)this->tranList.size());
+
+            for (unsigned int i = 0; i < results.size(); ++i)
+                outcomes.push_back(multicallOutcome(results[i]));
+        } else {
+            // The server failed the whole system.multicall, e.g. because
+            // it doesn't implement it.  That is the outcome of every RPC.
+            outcomes.assign(this->tranList.size(), outcome);
+        }
+    } catch (error const& error) {
+        outcomes.clear();
+        this->finishErr(error);
+    }
+    for (unsigned int i = 0; i < outcomes.size(); ++i)
+        this->tranList[i]->finish(outcomes[i]);
+}
+
+
+
+void
+xmlTransaction_multicall::finishErr(error const& error) const {
+
+    for (unsigned int i = 0; i < this->tranList.size(); ++i)
+        this->tranList[i]->finishErr(error);
+}
+
+
+
+void
+xmlTransaction_multicall::progress(
+    struct xmlrpc_progress_data const& progressData) const {
+
+    for (unsigned int i = 0; i < this->tranList.size(); ++i)
+        this->tranList[i]->progress(progressData);
+}
+
 } // namespace
 
 namespace xmlrpc_c {
@@ -84,17 +239,54 @@ struct client_xml_impl {
     clientXmlTransportPtr transportPtr;
     xmlrpc_dialect dialect;
 
+    unsigned int maxBatchSize;
+        // The most RPCs we send in one system.multicall request.  1 means
+        // we don't batch RPCs; we send each one as it starts.
+    unsigned int batchWindowMs;
+        // How long an RPC may wait in 'batch' for others to join it
+
+    Lock batchLock;
+        // Hold this while accessing the members below
+    rpcBatch batch;
+        // RPCs we have started but not sent
+    xmlrpc_timespec batchStartTime;
+        // When the first RPC in 'batch' started.  Meaningless if there
+        // are no RPCs in 'batch'.
+    multicallStats stats;
+
     client_xml_impl(clientXmlTransport * const transportP,
                     xmlrpc_dialect       const dialect = xmlrpc_dialect_i8) :
         transportP(transportP),
-        dialect(dialect) {}
+        dialect(dialect),
+        maxBatchSize(1),
+        batchWindowMs(0) {}
 
     client_xml_impl(clientXmlTransportPtr const transportPtr,
                     clientXmlTransport *  const transportP,
                     xmlrpc_dialect        const dialect = xmlrpc_dialect_i8) :
         transportP(transportP),
         transportPtr(transportPtr),
-        dialect(dialect) {}
+        dialect(dialect),
+        maxBatchSize(1),
+        batchWindowMs(0) {}
+
+    int
+    batchTimeLeft() const;
+
+    void
+    takeBatch(vector<rpcBatch> * const dueBatchesP);
+
+    void
+    sendBatch(rpcBatch const& batch);
+
+    void
+    startBatched(carriageParm *       const  carriageParmP,
+                 string               const& methodName,
+                 paramList            const& paramList,
+                 clientTransactionPtr const& tranP);
+
+    void
+    flushBatch(bool const dueOnly);
 };
 
 
@@ -478,6 +670,28 @@ clientXmlTransport::finishAsync(xmlrpc_c::timeout) {
 
 
 
+void
+clientXmlTransport::getPollfds(vector<struct xmlrpc_pollfd> * const pollfdsP,
+                               xmlrpc_c::timeout *            const timeoutP) {
+
+    // Since our start() does the whole thing, there is never anything
+    // to wait for.
+
+    pollfdsP->clear();
+    *timeoutP = xmlrpc_c::timeout();
+}
+
+
+
+void
+clientXmlTransport::performAsync() {
+
+    // Since our start() does the whole thing, there's nothing for
+    // us to do.
+}
+
+
+
 void
 clientXmlTransport::asyncComplete(
     struct xmlrpc_call_info * const callInfoP,
@@ -648,6 +862,58 @@ clientXmlTransport_http::finishAsync(xmlrpc_c::timeout const timeout) {
 
 
 
+void
+clientXmlTransport_http::getPollfds(
+    vector<struct xmlrpc_pollfd> * const pollfdsP,
+    xmlrpc_c::timeout *            const timeoutP) {
+
+    if (!this->c_transportOpsP->get_pollfds)
+        throwf("This client XML transport can't be driven by an external "
+               "event loop");
+
+    vector<struct xmlrpc_pollfd> pollfds(16);
+    unsigned int pollfdCt;
+    int timeoutMs;
+
+    for (bool gotAll = false; !gotAll; ) {
+        env_wrap env;
+
+        this->c_transportOpsP->get_pollfds(
+            &env.env_c, this->c_transportP, &pollfds[0], pollfds.size(),
+            &pollfdCt, &timeoutMs);
+
+        throwIfError(env);
+
+        if (pollfdCt > pollfds.size())
+            pollfds.resize(pollfdCt);
+        else
+            gotAll = true;
+    }
+    pollfds.resize(pollfdCt);
+
+    *pollfdsP = pollfds;
+    *timeoutP = timeoutMs < 0 ?
+        xmlrpc_c::timeout() : xmlrpc_c::timeout(timeoutMs);
+}
+
+
+
+void
+clientXmlTransport_http::performAsync() {
+
+    if (!this->c_transportOpsP->perform_asynch)
+        throwf("This client XML transport can't be driven by an external "
+               "event loop");
+
+    env_wrap env;
+
+    this->c_transportOpsP->perform_asynch(&env.env_c, this->c_transportP);
+
+    throwIfError(env);
+}
+
+
+
 void
 clientXmlTransport_http::setInterrupt(int * const interruptP) {
 
@@ -786,6 +1052,28 @@ client::finishAsync(xmlrpc_c::timeout) {
 
 
 
+void
+client::getPollfds(vector<struct xmlrpc_pollfd> * const pollfdsP,
+                   xmlrpc_c::timeout *            const timeoutP) {
+
+    // Since our start() does the whole thing, there is never anything
+    // to wait for.
+
+    pollfdsP->clear();
+    *timeoutP = xmlrpc_c::timeout();
+}
+
+
+
+void
+client::performAsync() {
+
+    // Since our start() does the whole thing, there's nothing for
+    // us to do.
+}
+
+
+
 void
 client::setInterrupt(int *) {
 
@@ -821,6 +1109,175 @@ clientPtr::get() const {
 
 
 
+int
+client_xml_impl::batchTimeLeft() const {
+/*----------------------------------------------------------------------------
+   How many milliseconds until the RPCs in 'batch' must go, whether or not
+   more join them.  Zero if they're overdue; -1 if there aren't any.
+
+   Caller must hold the batch lock.
+-----------------------------------------------------------------------------*/
+    int retval;
+
+    if (this->batch.rpcs.empty())
+        retval = -1;
+    else {
+        xmlrpc_timespec now;
+
+        xmlrpc_gettimeofday(&now);
+
+        int const elapsedMs(
+            (now.tv_sec - this->batchStartTime.tv_sec) * 1000 +
+            ((int)now.tv_nsec - (int)this->batchStartTime.tv_nsec) / 1000000);
+
+        retval = std::max(0, (int)this->batchWindowMs - elapsedMs);
+    }
+    return retval;
+}
+
+
+
+void
+client_xml_impl::takeBatch(vector<rpcBatch> * const dueBatchesP) {
+/*----------------------------------------------------------------------------
+   Take the RPCs out of 'batch', to be sent, and add them to *dueBatchesP.
+
+   Caller must hold the batch lock.
+-----------------------------------------------------------------------------*/
+    unsigned int const rpcCt(this->batch.rpcs.size());
+
+    if (rpcCt == 1)
+        ++this->stats.singleRpcCt;
+    else if (rpcCt > 1) {
+        ++this->stats.batchCt;
+        this->stats.batchedRpcCt += rpcCt;
+        this->stats.maxBatchSize = std::max(this->stats.maxBatchSize, rpcCt);
+    }
+    if (rpcCt > 0) {
+        dueBatchesP->push_back(rpcBatch());
+        dueBatchesP->back().carriageParmP = this->batch.carriageParmP;
+        dueBatchesP->back().rpcs.swap(this->batch.rpcs);
+    }
+}
+
+
+
+void
+client_xml_impl::sendBatch(rpcBatch const& batch) {
+/*----------------------------------------------------------------------------
+   Start the RPCs in 'batch': as one system.multicall RPC, or if there is
+   just one, as itself.
+
+   The RPCs were started long ago as far as their owners are concerned, so
+   we can't throw an error back to them; if we can't start them, we
+   finish them with the error instead.
+-----------------------------------------------------------------------------*/
+    vector<clientTransactionPtr> tranList;
+
+    for (unsigned int i = 0; i < batch.rpcs.size(); ++i)
+        tranList.push_back(batch.rpcs[i].tranP);
+
+    try {
+        string callXml;
+        xmlTransactionPtr xmlTranP;
+
+        if (batch.rpcs.size() == 1) {
+            xml::generateCall(batch.rpcs[0].methodName, batch.rpcs[0].params,
+                              this->dialect, &callXml);
+
+            xmlTranP = xmlTransaction_clientPtr(batch.rpcs[0].tranP);
+        } else {
+            carray calls;
+
+            for (unsigned int i = 0; i < batch.rpcs.size(); ++i) {
+                pendingRpc const& rpc(batch.rpcs[i]);
+
+                carray params;
+                for (unsigned int j = 0; j < rpc.params.size(); ++j)
+                    params.push_back(rpc.params[j]);
+
+                cstruct call;
+                call["methodName"] = value_string(rpc.methodName);
+                call["params"]     = value_array(params);
+
+                calls.push_back(value_struct(call));
+            }
+            paramList multicallParams;
+            multicallParams.add(value_array(calls));
+
+            xml::generateCall("system.multicall", multicallParams,
+                              this->dialect, &callXml);
+
+            xmlTranP = xmlTransactionPtr(
+                new xmlTransaction_multicall(tranList));
+        }
+        xml::trace("XML-RPC CALL", callXml);
+
+        this->transportP->start(batch.carriageParmP, callXml, xmlTranP);
+    } catch (error const& error) {
+        for (unsigned int i = 0; i < tranList.size(); ++i)
+            tranList[i]->finishErr(error);
+    }
+}
+
+
+
+void
+client_xml_impl::startBatched(carriageParm *       const  carriageParmP,
+                              string               const& methodName,
+                              paramList            const& paramList,
+                              clientTransactionPtr const& tranP) {
+/*----------------------------------------------------------------------------
+   Start an RPC by adding it to the batch, and send the batch if that
+   fills it or its time is up.
+
+   A batch is RPCs to one destination: an RPC with a different carriage
+   parameter than those in the batch sends them and starts a new batch.
+-----------------------------------------------------------------------------*/
+    vector<rpcBatch> dueBatches;
+
+    {
+        Lock::Holder holder(&this->batchLock);
+
+        if (this->batch.carriageParmP != carriageParmP)
+            this->takeBatch(&dueBatches);
+
+        if (this->batch.rpcs.empty()) {
+            this->batch.carriageParmP = carriageParmP;
+            xmlrpc_gettimeofday(&this->batchStartTime);
+        }
+        this->batch.rpcs.push_back(pendingRpc(methodName, paramList, tranP));
+
+        if (this->batch.rpcs.size() >= this->maxBatchSize ||
+            this->batchTimeLeft() == 0)
+            this->takeBatch(&dueBatches);
+    }
+    for (unsigned int i = 0; i < dueBatches.size(); ++i)
+        this->sendBatch(dueBatches[i]);
+}
+
+
+
+void
+client_xml_impl::flushBatch(bool const dueOnly) {
+/*----------------------------------------------------------------------------
+   Send the RPCs in the batch -- but if 'dueOnly', only if their time
+   is up.
+-----------------------------------------------------------------------------*/
+    vector<rpcBatch> dueBatches;
+
+    {
+        Lock::Holder holder(&this->batchLock);
+
+        if (!dueOnly || this->batchTimeLeft() == 0)
+            this->takeBatch(&dueBatches);
+    }
+    for (unsigned int i = 0; i < dueBatches.size(); ++i)
+        this->sendBatch(dueBatches[i]);
+}
+
+
+
 client_xml::client_xml(clientXmlTransport * const transportP) {
 
     this->implP = new client_xml_impl(transportP);
@@ -854,6 +1311,12 @@ client_xml::client_xml(clientXmlTransportPtr const transportPtr,
 
 client_xml::~client_xml() {
 
+    // RPCs still in the batch were never sent, but their owners expect
+    // them to finish somehow.
+    for (unsigned int i = 0; i < this->implP->batch.rpcs.size(); ++i)
+        this->implP->batch.rpcs[i].tranP->finishErr(
+            error("Client was destroyed before it sent the RPC"));
+
     delete(this->implP);
 }
 
@@ -896,15 +1359,21 @@ client_xml::start(carriageParm *       const  carriageParmP,
                   paramList            const& paramList,
                   clientTransactionPtr const& tranP) {
 
-    string callXml;
+    // A system.multicall can't be inside a system.multicall
+    if (this->implP->maxBatchSize > 1 && methodName != "system.multicall")
+        this->implP->startBatched(carriageParmP, methodName, paramList, tranP);
+    else {
+        string callXml;
 
-    xml::generateCall(methodName, paramList, this->implP->dialect, &callXml);
+        xml::generateCall(methodName, paramList, this->implP->dialect,
+                          &callXml);
 
-    xml::trace("XML-RPC CALL", callXml);
+        xml::trace("XML-RPC CALL", callXml);
 
-    xmlTransaction_clientPtr const xmlTranP(tranP);
+        xmlTransaction_clientPtr const xmlTranP(tranP);
 
-    this->implP->transportP->start(carriageParmP, callXml, xmlTranP);
+        this->implP->transportP->start(carriageParmP, callXml, xmlTranP);
+    }
 }
 
 
@@ -912,11 +1381,51 @@ client_xml::start(carriageParm *       const  carriageParmP,
 void
 client_xml::finishAsync(xmlrpc_c::timeout const timeout) {
 
+    this->implP->flushBatch(false);
+
     this->implP->transportP->finishAsync(timeout);
 }
 
 
 
+void
+client_xml::getPollfds(vector<struct xmlrpc_pollfd> * const pollfdsP,
+                       xmlrpc_c::timeout *            const timeoutP) {
+/*----------------------------------------------------------------------------
+   Tell what the client's outstanding asynchronous RPCs are waiting for:
+   file descriptors *pollfdsP to be ready or *timeoutP to pass, whichever
+   comes first.  Wait for that in your own event loop, then call
+   performAsync().  Ask again before each wait.
+-----------------------------------------------------------------------------*/
+    this->implP->transportP->getPollfds(pollfdsP, timeoutP);
+
+    int batchTimeLeft;
+    {
+        Lock::Holder holder(&this->implP->batchLock);
+
+        batchTimeLeft = this->implP->batchTimeLeft();
+    }
+    // RPCs waiting in the batch are waiting for time to pass, too
+    if (batchTimeLeft >= 0 &&
+        (!timeoutP->finite || (unsigned)batchTimeLeft < timeoutP->duration))
+        *timeoutP = xmlrpc_c::timeout(batchTimeLeft);
+}
+
+
+
+void
+client_xml::performAsync() {
+/*----------------------------------------------------------------------------
+   Finish whatever of the client's outstanding asynchronous RPCs can be
+   finished without waiting.
+-----------------------------------------------------------------------------*/
+    this->implP->flushBatch(true);
+
+    this->implP->transportP->performAsync();
+}
+
+
+
 void
 client_xml::setInterrupt(int * const interruptP) {
 
@@ -925,6 +1434,41 @@ client_xml::setInterrupt(int * const interruptP) {
 
 
 
+void
+client_xml::setMulticall(unsigned int const maxBatchSize,
+                         unsigned int const windowMs) {
+/*----------------------------------------------------------------------------
+   Have start() coalesce RPCs into system.multicall requests: hold each RPC
+   for up to 'windowMs' milliseconds so others to the same server can join
+   it, and send them all in one HTTP request.  We send a batch early when it
+   has 'maxBatchSize' RPCs in it, and in any case when you call
+   finishAsync().  Each RPC still finishes with its own result or fault.
+
+   The server must implement system.multicall, or every RPC we batch fails.
+   The carriage parameter you give start() must stay valid until we send
+   the RPC.  Synchronous RPCs (call()) are never batched.
+
+   'maxBatchSize' 0 or 1 means don't coalesce; send each RPC immediately,
+   as it would be without this.
+-----------------------------------------------------------------------------*/
+    Lock::Holder holder(&this->implP->batchLock);
+
+    this->implP->maxBatchSize  = std::max(1u, maxBatchSize);
+    this->implP->batchWindowMs = windowMs;
+}
+
+
+
+multicallStats
+client_xml::getMulticallStats() const {
+
+    Lock::Holder holder(&this->implP->batchLock);
+
+    return this->implP->stats;
+}
+
+
+
 serverAccessor::serverAccessor(clientPtr       const clientP,
                                carriageParmPtr const carriageParmP) :
 
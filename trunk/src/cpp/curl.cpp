@@ -187,6 +187,11 @@ struct clientXmlTransport_curl::constrOpt_impl {
         bool         tcp_keepalive;
         unsigned int tcp_keepidle_sec;
         unsigned int tcp_keepintvl_sec;
+        unsigned int compression_level;
+        size_t       compression_threshold;
+        bool         accept_compressed;
+        bool         no_session_pool;
+        unsigned int session_pool_size;
     } value;
     struct {
         bool network_interface;
@@ -220,6 +225,11 @@ struct clientXmlTransport_curl::constrOpt_impl {
         bool tcp_keepalive;
         bool tcp_keepidle_sec;
         bool tcp_keepintvl_sec;
+        bool compression_level;
+        bool compression_threshold;
+        bool accept_compressed;
+        bool no_session_pool;
+        bool session_pool_size;
     } present;
 };
 
@@ -256,6 +266,11 @@ clientXmlTransport_curl::constrOpt_impl::constrOpt_impl() {
     present.tcp_keepalive     = false;
     present.tcp_keepidle_sec  = false;
     present.tcp_keepintvl_sec = false;
+    present.compression_level = false;
+    present.compression_threshold = false;
+    present.accept_compressed = false;
+    present.no_session_pool   = false;
+    present.session_pool_size = false;
 }
 
 
@@ -299,6 +314,11 @@ DEFINE_OPTION_SETTER(connect_timeout, unsigned int);
 DEFINE_OPTION_SETTER(tcp_keepalive, bool);
 DEFINE_OPTION_SETTER(tcp_keepidle_sec, unsigned int);
 DEFINE_OPTION_SETTER(tcp_keepintvl_sec, unsigned int);
+DEFINE_OPTION_SETTER(compression_level, unsigned int);
+DEFINE_OPTION_SETTER(compression_threshold, size_t);
+DEFINE_OPTION_SETTER(accept_compressed, bool);
+DEFINE_OPTION_SETTER(no_session_pool, bool);
+DEFINE_OPTION_SETTER(session_pool_size, unsigned int);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -391,6 +411,18 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
         opt.value.tcp_keepalive             : false;
     transportParms.tcp_keepidle_sec  = opt.present.tcp_keepidle_sec ?
         opt.value.tcp_keepidle_sec          : 0;
+    transportParms.tcp_keepintvl_sec = opt.present.tcp_keepintvl_sec ?
+        opt.value.tcp_keepintvl_sec         : 0;
+    transportParms.compression_level = opt.present.compression_level ?
+        opt.value.compression_level         : 0;
+    transportParms.compression_threshold = opt.present.compression_threshold ?
+        opt.value.compression_threshold     : 0;
+    transportParms.accept_compressed = opt.present.accept_compressed ?
+        opt.value.accept_compressed         : false;
+    transportParms.no_session_pool   = opt.present.no_session_pool ?
+        opt.value.no_session_pool           : false;
+    transportParms.session_pool_size = opt.present.session_pool_size ?
+        opt.value.session_pool_size         : 0;
 
     this->c_transportOpsP = &xmlrpc_curl_transport_ops;
 
@@ -398,7 +430,7 @@ clientXmlTransport_curl::initialize(constrOpt const& optExt) {
 
     xmlrpc_curl_transport_ops.create(
         &env.env_c, 0, "", "",
-        &transportParms, XMLRPC_CXPSIZE(tcp_keepalive),
+        &transportParms, XMLRPC_CXPSIZE(session_pool_size),
         &this->c_transportP);
 
     if (env.env_c.fault_occurred)
@@ -449,4 +481,29 @@ clientXmlTransport_curl::~clientXmlTransport_curl() {
 }
 
 
+
+#if MUST_BUILD_CURL_CLIENT
+
+xmlrpc_curl_poolstats
+clientXmlTransport_curl::poolStats() const {
+
+    xmlrpc_curl_poolstats stats;
+
+    xmlrpc_curl_transport_get_pool_stats(this->c_transportP, &stats);
+
+    return stats;
+}
+
+#else  // MUST_BUILD_CURL_CLIENT
+
+xmlrpc_curl_poolstats
+clientXmlTransport_curl::poolStats() const {
+
+    throw(error("There is no Curl client XML transport in this XML-RPC client "
+                "library"));
+}
+
+#endif
+
+
 } // namespace
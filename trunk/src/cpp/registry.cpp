@@ -448,6 +448,21 @@ registry::disableIntrospection() {
 
 
 
+void
+registry::freeze() {
+/*----------------------------------------------------------------------------
+   Optimize the registry for method lookup, on the assumption that no one
+   will add methods to it any more.  See xmlrpc_registry_freeze().
+-----------------------------------------------------------------------------*/
+    env_wrap env;
+
+    xmlrpc_registry_freeze(&env.env_c, this->implP->c_registryP);
+
+    throwIfError(env);
+}
+
+
+
 static xmlrpc_server_shutdown_fn shutdownServer;
 
 static void
@@ -198,6 +198,15 @@ struct serverAbyss::constrOpt_impl {
         std::string    logFileName;
         bool           serverOwnsSignals;
         bool           expectSigchld;
+        bool           eventDriven;
+        unsigned int   eventIoThreads;
+        unsigned int   eventWorkers;
+        unsigned int   threadPoolMin;
+        unsigned int   threadPoolMax;
+        unsigned int   threadPoolIdleTimeout;
+        unsigned int   compressionLevel;
+        size_t         compressionThreshold;
+        unsigned int   connBufferSize;
     } value;
     struct {
         bool registryPtr;
@@ -220,6 +229,15 @@ struct serverAbyss::constrOpt_impl {
         bool logFileName;
         bool serverOwnsSignals;
         bool expectSigchld;
+        bool eventDriven;
+        bool eventIoThreads;
+        bool eventWorkers;
+        bool threadPoolMin;
+        bool threadPoolMax;
+        bool threadPoolIdleTimeout;
+        bool compressionLevel;
+        bool compressionThreshold;
+        bool connBufferSize;
     } present;
 };
 
@@ -246,6 +264,15 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     present.sockAddrLen       = false;
     present.serverOwnsSignals = false;
     present.expectSigchld     = false;
+    present.eventDriven       = false;
+    present.eventIoThreads    = false;
+    present.eventWorkers      = false;
+    present.threadPoolMin     = false;
+    present.threadPoolMax     = false;
+    present.threadPoolIdleTimeout = false;
+    present.compressionLevel  = false;
+    present.compressionThreshold = false;
+    present.connBufferSize    = false;
 
     // Set default values
     value.dontAdvertise     = false;
@@ -253,6 +280,14 @@ serverAbyss::constrOpt_impl::constrOpt_impl() {
     value.chunkResponse     = false;
     value.serverOwnsSignals = true;
     value.expectSigchld     = false;
+    value.eventDriven       = false;
+    value.eventIoThreads    = 0;
+    value.eventWorkers      = 0;
+    value.threadPoolMin     = 1;
+    value.threadPoolMax     = 0;
+    value.threadPoolIdleTimeout = 60;
+    value.compressionLevel  = 0;
+    value.compressionThreshold = 0;
 }
 
 
@@ -285,6 +320,15 @@ DEFINE_OPTION_SETTER(sockAddrLen,       socklen_t);
 DEFINE_OPTION_SETTER(logFileName,       string);
 DEFINE_OPTION_SETTER(serverOwnsSignals, bool);
 DEFINE_OPTION_SETTER(expectSigchld,     bool);
+DEFINE_OPTION_SETTER(eventDriven,       bool);
+DEFINE_OPTION_SETTER(eventIoThreads,    unsigned int);
+DEFINE_OPTION_SETTER(eventWorkers,      unsigned int);
+DEFINE_OPTION_SETTER(threadPoolMin,     unsigned int);
+DEFINE_OPTION_SETTER(threadPoolMax,     unsigned int);
+DEFINE_OPTION_SETTER(threadPoolIdleTimeout, unsigned int);
+DEFINE_OPTION_SETTER(compressionLevel,  unsigned int);
+DEFINE_OPTION_SETTER(compressionThreshold, size_t);
+DEFINE_OPTION_SETTER(connBufferSize,    unsigned int);
 
 #undef DEFINE_OPTION_SETTER
 
@@ -645,6 +689,8 @@ setAdditionalServerParms(TServer *                   const  serverP,
         ServerSetMaxConnBacklog(serverP, opt.value.maxConnBacklog);
     if (opt.present.maxRpcMem)
         ServerSetMaxSessionMem(serverP, opt.value.maxRpcMem);
+    if (opt.present.connBufferSize)
+        ServerSetConnBufferSize(serverP, opt.value.connBufferSize);
     if (opt.present.keepaliveTimeout)
         ServerSetKeepaliveTimeout(serverP, opt.value.keepaliveTimeout);
     if (opt.present.keepaliveMaxConn)
@@ -654,6 +700,12 @@ setAdditionalServerParms(TServer *                   const  serverP,
     ServerSetAdvertise(serverP, !opt.value.dontAdvertise);
     if (opt.value.expectSigchld)
         ServerUseSigchld(serverP);
+    ServerSetEventDriven(serverP, opt.value.eventDriven);
+    ServerSetEventThreads(serverP, opt.value.eventIoThreads,
+                          opt.value.eventWorkers);
+    ServerSetThreadPool(serverP, opt.value.threadPoolMin,
+                        opt.value.threadPoolMax,
+                        opt.value.threadPoolIdleTimeout);
 }
 
 
@@ -667,7 +719,9 @@ setHttpReqHandlers(TServer *    const  serverP,
                    bool         const  doHttpAccessControl,
                    string       const& allowOrigin,
                    bool         const  accessCtlExpires,
-                   unsigned int const  accessCtlMaxAge) {
+                   unsigned int const  accessCtlMaxAge,
+                   unsigned int const  compressionLevel,
+                   size_t       const  compressionThreshold) {
 
     env_wrap env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -680,10 +734,12 @@ setHttpReqHandlers(TServer *    const  serverP,
     parms.allow_origin = doHttpAccessControl ? allowOrigin.c_str() : NULL;
     parms.access_ctl_expires = accessCtlExpires;
     parms.access_ctl_max_age = accessCtlMaxAge;
+    parms.compression_level = compressionLevel;
+    parms.compression_threshold = compressionThreshold;
 
     xmlrpc_server_abyss_set_handler3(
         &env.env_c, serverP,
-        &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &parms, XMLRPC_AHPSIZE(compression_threshold));
 
     if (env.env_c.fault_occurred)
         throwf("Failed to register the HTTP handler for XML-RPC "
@@ -723,7 +779,9 @@ createServer(serverAbyss::constrOpt_impl const& opt,
                            opt.present.allowOrigin,
                            opt.value.allowOrigin,
                            opt.present.accessCtlMaxAge,
-                           opt.value.accessCtlMaxAge);
+                           opt.value.accessCtlMaxAge,
+                           opt.value.compressionLevel,
+                           opt.value.compressionThreshold);
 
         if (opt.present.portNumber || opt.present.socketFd ||
             opt.present.sockAddrP)
@@ -362,8 +362,12 @@ xmlrpc_methodListCreate(xmlrpc_env *         const envP,
     if (methodListP == NULL)
         xmlrpc_faultf(envP, "Couldn't allocate method list descriptor");
     else {
-        methodListP->firstMethodP = NULL;
-        methodListP->lastMethodP = NULL;
+        methodListP->firstMethodP  = NULL;
+        methodListP->lastMethodP   = NULL;
+        methodListP->methodCount   = 0;
+        methodListP->hashTable     = NULL;
+        methodListP->hashTableSize = 0;
+        methodListP->frozenP       = NULL;
 
         *methodListPP = methodListP;
     }
@@ -371,6 +375,16 @@ xmlrpc_methodListCreate(xmlrpc_env *         const envP,
 
 
 
+static void
+perfectHashDestroy(xmlrpc_methodPerfectHash * const perfectHashP) {
+
+    free(perfectHashP->seed);
+    free(perfectHashP->slot);
+    free(perfectHashP);
+}
+
+
+
 void
 xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
 
@@ -385,36 +399,155 @@ xmlrpc_methodListDestroy(xmlrpc_methodList * methodListP) {
         free(p);
     }
 
+    if (methodListP->frozenP)
+        perfectHashDestroy(methodListP->frozenP);
+
+    free(methodListP->hashTable);
+
     free(methodListP);
 }
 
 
 
+static uint32_t
+hashMethodName(const char * const methodName) {
+
+    /* This is the 32 bit FNV-1a hash */
+
+    uint32_t hash;
+    const unsigned char * p;
+
+    for (hash = 2166136261u, p = (const unsigned char *)methodName;
+         *p;
+         ++p) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+
+static uint32_t
+mixHash(uint32_t const hash,
+        uint32_t const seed) {
+/*----------------------------------------------------------------------------
+   Derive a new, well scrambled hash from name hash 'hash' and 'seed'.
+   (This is the finalizer of MurmurHash3).
+-----------------------------------------------------------------------------*/
+    uint32_t h;
+
+    h = hash ^ (seed * 0x9e3779b9u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+
+
+static unsigned int
+perfectHashBucket(const xmlrpc_methodPerfectHash * const perfectHashP,
+                  uint32_t                         const nameHash) {
+
+    return mixHash(nameHash, 0) % perfectHashP->bucketCt;
+}
+
+
+
+static unsigned int
+perfectHashSlot(const xmlrpc_methodPerfectHash * const perfectHashP,
+                uint32_t                         const nameHash) {
+
+    uint32_t const seed =
+        perfectHashP->seed[perfectHashBucket(perfectHashP, nameHash)];
+
+    return mixHash(nameHash, seed) % perfectHashP->slotCt;
+}
+
+
+
 void
 xmlrpc_methodListLookupByName(xmlrpc_methodList *  const methodListP,
                               const char *         const methodName,
                               xmlrpc_methodInfo ** const methodPP) {
 
+    uint32_t const nameHash = hashMethodName(methodName);
 
-    /* We do a simple linear lookup along a linked list.
-       If speed is important, we can make this a binary tree instead.
-    */
-
-    xmlrpc_methodNode * p;
     xmlrpc_methodInfo * methodP;
 
-    for (p = methodListP->firstMethodP, methodP = NULL;
-         p && !methodP;
-         p = p->nextP) {
+    if (methodListP->frozenP) {
+        xmlrpc_methodNode * const nodeP =
+            methodListP->frozenP->slot[
+                perfectHashSlot(methodListP->frozenP, nameHash)];
+
+        if (nodeP && nodeP->nameHash == nameHash &&
+            xmlrpc_streq(nodeP->methodName, methodName))
+            methodP = nodeP->methodP;
+        else
+            methodP = NULL;
+    } else if (methodListP->hashTable) {
+        xmlrpc_methodNode * p;
+
+        for (p = methodListP->hashTable[
+                 nameHash & (methodListP->hashTableSize - 1)],
+                 methodP = NULL;
+             p && !methodP;
+             p = p->hashNextP) {
+
+            if (p->nameHash == nameHash &&
+                xmlrpc_streq(p->methodName, methodName))
+                methodP = p->methodP;
+        }
+    } else
+        methodP = NULL;
 
-        if (xmlrpc_streq(p->methodName, methodName))
-            methodP = p->methodP;
-    }
     *methodPP = methodP;
 }
 
 
 
+static void
+growHashTable(xmlrpc_env *        const envP,
+              xmlrpc_methodList * const methodListP) {
+/*----------------------------------------------------------------------------
+   Make the hash index of *methodListP big enough for one more method,
+   keeping it no more than one method per bucket on average.
+-----------------------------------------------------------------------------*/
+    if (methodListP->methodCount + 1 > methodListP->hashTableSize) {
+        unsigned int const newSize =
+            methodListP->hashTableSize == 0 ?
+            64 : methodListP->hashTableSize * 2;
+
+        xmlrpc_methodNode ** newTable;
+
+        newTable = calloc(newSize, sizeof(newTable[0]));
+
+        if (newTable == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate a %u-bucket hash table "
+                          "for the method list", newSize);
+        else {
+            xmlrpc_methodNode * p;
+
+            for (p = methodListP->firstMethodP; p; p = p->nextP) {
+                xmlrpc_methodNode ** const bucketP =
+                    &newTable[p->nameHash & (newSize - 1)];
+
+                p->hashNextP = *bucketP;
+                *bucketP = p;
+            }
+            free(methodListP->hashTable);
+            methodListP->hashTable     = newTable;
+            methodListP->hashTableSize = newSize;
+        }
+    }
+}
+
+
+
 void
 xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                      xmlrpc_methodList * const methodListP,
@@ -431,26 +564,274 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
         xmlrpc_faultf(envP, "Method named '%s' already registered",
                       methodName);
     else {
-        xmlrpc_methodNode * methodNodeP;
+        growHashTable(envP, methodListP);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_methodNode * methodNodeP;
+
+            MALLOCVAR(methodNodeP);
+
+            if (methodNodeP == NULL)
+                xmlrpc_faultf(envP, "Couldn't allocate method node");
+            else {
+                xmlrpc_methodNode ** const bucketP =
+                    &methodListP->hashTable[
+                        hashMethodName(methodName) &
+                        (methodListP->hashTableSize - 1)];
+
+                methodNodeP->methodName = strdup(methodName);
+                methodNodeP->methodP = methodP;
+                methodNodeP->nextP = NULL;
+                methodNodeP->nameHash = hashMethodName(methodName);
+
+                if (!methodListP->firstMethodP)
+                    methodListP->firstMethodP = methodNodeP;
+
+                if (methodListP->lastMethodP)
+                    methodListP->lastMethodP->nextP = methodNodeP;
+
+                methodListP->lastMethodP = methodNodeP;
+
+                methodNodeP->hashNextP = *bucketP;
+                *bucketP = methodNodeP;
+
+                ++methodListP->methodCount;
+
+                /* The perfect hash doesn't know about the new method */
+                if (methodListP->frozenP) {
+                    perfectHashDestroy(methodListP->frozenP);
+                    methodListP->frozenP = NULL;
+                }
+            }
+        }
+    }
+}
 
-        MALLOCVAR(methodNodeP);
 
-        if (methodNodeP == NULL)
-            xmlrpc_faultf(envP, "Couldn't allocate method node");
-        else {
-            methodNodeP->methodName = strdup(methodName);
-            methodNodeP->methodP = methodP;
-            methodNodeP->nextP = NULL;
 
-            if (!methodListP->firstMethodP)
-                methodListP->firstMethodP = methodNodeP;
+/* Maximum number of seeds we try for one bucket before we conclude the
+   table is too crowded and try again with a bigger one.
+*/
+#define MAX_SEED_TRIES 4096
+
+
+
+static void
+placeBucket(xmlrpc_methodPerfectHash * const perfectHashP,
+            xmlrpc_methodNode **       const nodes,
+            unsigned int               const nodeCt,
+            unsigned int               const bucket,
+            bool *                     const successP) {
+/*----------------------------------------------------------------------------
+   Find a displacement seed for bucket 'bucket', whose names are those
+   of the nodes nodes[0 .. nodeCt-1], such that the names all go in
+   distinct slots that are still free.  Put the nodes in those slots and
+   record the seed.
+-----------------------------------------------------------------------------*/
+    uint32_t seed;
+    bool placed;
+
+    for (seed = 1, placed = false; seed <= MAX_SEED_TRIES && !placed; ++seed) {
+        unsigned int i;
+        bool collision;
+
+        for (i = 0, collision = false; i < nodeCt && !collision; ++i) {
+            unsigned int const slot =
+                mixHash(nodes[i]->nameHash, seed) % perfectHashP->slotCt;
+            unsigned int j;
+
+            if (perfectHashP->slot[slot])
+                collision = true;
+            else {
+                for (j = 0; j < i && !collision; ++j) {
+                    if (mixHash(nodes[j]->nameHash, seed) %
+                        perfectHashP->slotCt == slot)
+                        collision = true;
+                }
+            }
+        }
+        if (!collision) {
+            for (i = 0; i < nodeCt; ++i) {
+                unsigned int const slot =
+                    mixHash(nodes[i]->nameHash, seed) % perfectHashP->slotCt;
+
+                perfectHashP->slot[slot] = nodes[i];
+            }
+            perfectHashP->seed[bucket] = seed;
+            placed = true;
+        }
+    }
+    *successP = placed;
+}
+
+
+
+typedef struct {
+    unsigned int bucket;
+    unsigned int nodeCt;
+    xmlrpc_methodNode ** nodes;
+} bucketMembers;
+
+
+
+static int
+cmpBucketSizeDesc(const void * const aP,
+                  const void * const bP) {
+
+    const bucketMembers * const a = aP;
+    const bucketMembers * const b = bP;
+
+    return b->nodeCt < a->nodeCt ? -1 : b->nodeCt > a->nodeCt ? 1 : 0;
+}
+
+
+
+static void
+fillPerfectHash(xmlrpc_env *               const envP,
+                xmlrpc_methodList *        const methodListP,
+                xmlrpc_methodPerfectHash * const perfectHashP,
+                bool *                     const successP) {
+/*----------------------------------------------------------------------------
+   Compute displacement seeds for perfect hash *perfectHashP, whose size is
+   already set, to hold the methods of *methodListP.  Return *successP false
+   if we couldn't find a placement for every bucket.
+
+   We place the fullest buckets first, while most slots are still free.
+-----------------------------------------------------------------------------*/
+    unsigned int const bucketCt = perfectHashP->bucketCt;
+    bucketMembers * buckets;
+    xmlrpc_methodNode ** nodeArray;
+
+    buckets   = calloc(bucketCt, sizeof(buckets[0]));
+    nodeArray = calloc(methodListP->methodCount, sizeof(nodeArray[0]));
+
+    if (buckets == NULL || nodeArray == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate working space for building "
+                      "a perfect hash of %u methods",
+                      methodListP->methodCount);
+    else {
+        xmlrpc_methodNode * p;
+        unsigned int b;
+        unsigned int nextNode;
+        bool success;
 
-            if (methodListP->lastMethodP)
-                methodListP->lastMethodP->nextP = methodNodeP;
+        /* Count the names in each bucket, then give each bucket its
+           stretch of 'nodeArray'.
+        */
+        for (p = methodListP->firstMethodP; p; p = p->nextP)
+            ++buckets[perfectHashBucket(perfectHashP, p->nameHash)].nodeCt;
+
+        for (b = 0, nextNode = 0; b < bucketCt; ++b) {
+            buckets[b].bucket = b;
+            buckets[b].nodes  = &nodeArray[nextNode];
+            nextNode += buckets[b].nodeCt;
+            buckets[b].nodeCt = 0;
+        }
+        for (p = methodListP->firstMethodP; p; p = p->nextP) {
+            bucketMembers * const bucketP =
+                &buckets[perfectHashBucket(perfectHashP, p->nameHash)];
 
-            methodListP->lastMethodP = methodNodeP;
+            bucketP->nodes[bucketP->nodeCt++] = p;
         }
+        qsort(buckets, bucketCt, sizeof(buckets[0]), &cmpBucketSizeDesc);
+
+        for (b = 0, success = true;
+             b < bucketCt && buckets[b].nodeCt > 0 && success;
+             ++b) {
+            placeBucket(perfectHashP, buckets[b].nodes, buckets[b].nodeCt,
+                        buckets[b].bucket, &success);
+        }
+        *successP = success;
     }
+    free(nodeArray);
+    free(buckets);
 }
 
 
+
+static void
+createPerfectHash(xmlrpc_env *                const envP,
+                  xmlrpc_methodList *         const methodListP,
+                  unsigned int                const slotCt,
+                  xmlrpc_methodPerfectHash ** const perfectHashPP) {
+/*----------------------------------------------------------------------------
+   Build a perfect hash with 'slotCt' slots of the methods in *methodListP.
+   Return NULL as *perfectHashPP if we can't find one that size.
+-----------------------------------------------------------------------------*/
+    xmlrpc_methodPerfectHash * perfectHashP;
+
+    MALLOCVAR(perfectHashP);
+
+    if (perfectHashP == NULL)
+        xmlrpc_faultf(envP, "Couldn't allocate perfect hash descriptor");
+    else {
+        perfectHashP->bucketCt = MAX(1, methodListP->methodCount / 4);
+        perfectHashP->slotCt   = slotCt;
+        perfectHashP->seed = calloc(perfectHashP->bucketCt,
+                                    sizeof(perfectHashP->seed[0]));
+        perfectHashP->slot = calloc(perfectHashP->slotCt,
+                                    sizeof(perfectHashP->slot[0]));
+
+        if (perfectHashP->seed == NULL || perfectHashP->slot == NULL)
+            xmlrpc_faultf(envP, "Couldn't allocate a %u-slot perfect hash "
+                          "table", slotCt);
+        else {
+            bool success;
+
+            fillPerfectHash(envP, methodListP, perfectHashP, &success);
+
+            if (!envP->fault_occurred && !success) {
+                perfectHashDestroy(perfectHashP);
+                perfectHashP = NULL;
+            }
+        }
+        if (envP->fault_occurred) {
+            perfectHashDestroy(perfectHashP);
+            perfectHashP = NULL;
+        }
+    }
+    *perfectHashPP = perfectHashP;
+}
+
+
+
+void
+xmlrpc_methodListFreeze(xmlrpc_env *        const envP,
+                        xmlrpc_methodList * const methodListP) {
+/*----------------------------------------------------------------------------
+   Build a perfect hash of the methods in *methodListP and use it for
+   lookups from now on, until someone adds a method.
+
+   We start with a table about 25% bigger than the number of methods and
+   grow it until we find a placement, which normally happens on the first
+   try.  The only thing that defeats it altogether is two method names with
+   the same 32 bit hash; then we fail and leave the list unfrozen.
+-----------------------------------------------------------------------------*/
+    unsigned int const methodCount = methodListP->methodCount;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    if (methodListP->frozenP) {
+        /* Already frozen */
+    } else if (methodCount == 0) {
+        /* Nothing to look up; the regular lookup is as fast as can be */
+    } else {
+        xmlrpc_methodPerfectHash * perfectHashP;
+        unsigned int slotCt;
+
+        for (slotCt = methodCount + methodCount / 4 + 1, perfectHashP = NULL;
+             slotCt <= methodCount * 8 + 8 && !perfectHashP &&
+                 !envP->fault_occurred;
+             slotCt *= 2) {
+
+            createPerfectHash(envP, methodListP, slotCt, &perfectHashP);
+        }
+        if (!envP->fault_occurred) {
+            if (!perfectHashP)
+                xmlrpc_faultf(envP, "Unable to construct a perfect hash of "
+                              "the %u registered method names", methodCount);
+            else
+                methodListP->frozenP = perfectHashP;
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #ifndef METHOD_H_INCLUDED
 #define METHOD_H_INCLUDED
 
+#include "int.h"
 #include "xmlrpc-c/base.h"
 
 struct xmlrpc_signature {
@@ -82,11 +83,45 @@ typedef struct xmlrpc_methodNode {
     struct xmlrpc_methodNode * nextP;
     const char * methodName;
     xmlrpc_methodInfo * methodP;
+    uint32_t nameHash;
+        /* Hash of 'methodName' */
+    struct xmlrpc_methodNode * hashNextP;
+        /* Next node in the same bucket of the method list's hash index */
 } xmlrpc_methodNode;
 
+typedef struct {
+/*----------------------------------------------------------------------------
+   A collision-free ("perfect") hash of a fixed set of method names.
+
+   A name hashes first to one of 'bucketCt' buckets.  Each bucket has a
+   displacement seed, chosen when we build the table so that the names in
+   that bucket, mixed with it, land in slots no other name uses.  So a
+   lookup is two table reads and one string comparison, no matter how many
+   methods there are.
+-----------------------------------------------------------------------------*/
+    unsigned int bucketCt;
+    uint32_t * seed;
+        /* Array of 'bucketCt' displacement seeds */
+    unsigned int slotCt;
+    xmlrpc_methodNode ** slot;
+        /* Array of 'slotCt' nodes; NULL for a slot no name uses */
+} xmlrpc_methodPerfectHash;
+
 typedef struct xmlrpc_methodList {
     xmlrpc_methodNode * firstMethodP;
     xmlrpc_methodNode * lastMethodP;
+        /* The methods, in the order in which they were added */
+    unsigned int methodCount;
+    xmlrpc_methodNode ** hashTable;
+        /* Hash index of the methods: array of 'hashTableSize' bucket chains,
+           linked through 'hashNextP'.  NULL if there are no methods yet.
+        */
+    unsigned int hashTableSize;
+        /* A power of 2 */
+    xmlrpc_methodPerfectHash * frozenP;
+        /* A perfect hash of the methods, for the fastest lookup.  NULL if
+           the list is not frozen.  Adding a method discards this.
+        */
 } xmlrpc_methodList;
 
 void
@@ -120,6 +155,10 @@ xmlrpc_methodListAdd(xmlrpc_env *        const envP,
                      const char *        const methodName,
                      xmlrpc_methodInfo * const methodP);
 
+void
+xmlrpc_methodListFreeze(xmlrpc_env *        const envP,
+                        xmlrpc_methodList * const methodListP);
+
 
 
 #endif
@@ -426,6 +426,185 @@ validateFormatNoRegex(xmlrpc_env * const envP,
 
 
 
+static bool
+isDecDigit(char const c) {
+
+    return c >= '0' && c <= '9';
+}
+
+
+
+static bool
+scanNumber(const char **  const cursorP,
+           unsigned int   const digitCt,
+           unsigned int * const valueP) {
+/*----------------------------------------------------------------------------
+   Scan exactly 'digitCt' decimal digits at *cursorP and return their value
+   as *valueP, advancing *cursorP past them.
+
+   Return false (and don't move *cursorP) if there aren't that many digits
+   there.
+-----------------------------------------------------------------------------*/
+    const char * const p = *cursorP;
+
+    unsigned int accum;
+    unsigned int i;
+    bool valid;
+
+    for (i = 0, accum = 0, valid = true; i < digitCt && valid; ++i) {
+        if (isDecDigit(p[i]))
+            accum = accum * 10 + (p[i] - '0');
+        else
+            valid = false;
+    }
+    if (valid) {
+        *cursorP = p + digitCt;
+        *valueP  = accum;
+    }
+    return valid;
+}
+
+
+
+static void
+skipChar(const char ** const cursorP,
+         char          const c) {
+
+    if (**cursorP == c)
+        ++*cursorP;
+}
+
+
+
+static bool
+isZ(char const c) {
+
+    return c == 'Z' || c == 'z';
+}
+
+
+
+static bool
+scanFractionSuffix(const char *   const suffix,
+                   unsigned int * const uP) {
+/*----------------------------------------------------------------------------
+   Scan what follows the seconds in the first form in iso8601Regex:
+   an optional decimal point, optional digits, and an optional "Z".
+
+   Return the millionths the digits represent as *uP.  Like
+   digitStringMillionths(), we ignore digits past the sixth.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    unsigned int accum;
+    unsigned int digitCt;
+
+    p = suffix;
+
+    skipChar(&p, '.');
+
+    for (accum = 0, digitCt = 0; isDecDigit(*p); ++p, ++digitCt) {
+        if (digitCt < 6)
+            accum = accum * 10 + (*p - '0');
+    }
+    for (; digitCt < 6; ++digitCt)
+        accum *= 10;
+
+    if (isZ(*p))
+        ++p;
+
+    *uP = accum;
+
+    return *p == '\0';
+}
+
+
+
+static bool
+scanTzSuffix(const char * const suffix) {
+/*----------------------------------------------------------------------------
+   Scan what follows the seconds in the second form in iso8601Regex:
+   "Z", "+", or "-", then optionally 2-4 digits, then an optional "Z".
+   We don't use the time zone, so we just validate.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    bool valid;
+
+    p = suffix;
+
+    if (isZ(*p) || *p == '+' || *p == '-') {
+        unsigned int digitCt;
+
+        for (++p, digitCt = 0; isDecDigit(*p); ++p)
+            ++digitCt;
+
+        if (digitCt == 1 || digitCt > 4)
+            valid = false;
+        else {
+            if (isZ(*p))
+                ++p;
+
+            valid = (*p == '\0');
+        }
+    } else
+        valid = false;
+
+    return valid;
+}
+
+
+
+static bool
+scanDatetime(const char *      const datetimeString,
+             xmlrpc_datetime * const dtP) {
+/*----------------------------------------------------------------------------
+   Parse 'datetimeString' if it is one of the forms iso8601Regex describes,
+   without using a regular expression and without allocating memory.
+   Return false, with *dtP undefined, if it isn't.
+
+   This accepts exactly what the regular expressions do, including their
+   case insensitivity, and returns the same result.  It is many times
+   faster, which matters when a response is full of datetimes.
+-----------------------------------------------------------------------------*/
+    const char * p;
+    bool valid;
+
+    p = datetimeString;
+
+    valid = scanNumber(&p, 4, &dtP->Y);
+    if (valid) {
+        skipChar(&p, '-');
+        valid = scanNumber(&p, 2, &dtP->M);
+    }
+    if (valid) {
+        skipChar(&p, '-');
+        valid = scanNumber(&p, 2, &dtP->D);
+    }
+    if (valid) {
+        if (*p == 'T' || *p == 't') {
+            ++p;
+            valid = scanNumber(&p, 2, &dtP->h);
+        } else
+            valid = false;
+    }
+    if (valid) {
+        skipChar(&p, ':');
+        valid = scanNumber(&p, 2, &dtP->m);
+    }
+    if (valid) {
+        skipChar(&p, ':');
+        valid = scanNumber(&p, 2, &dtP->s);
+    }
+    if (valid) {
+        if (!scanFractionSuffix(p, &dtP->u)) {
+            dtP->u = 0;
+            valid = scanTzSuffix(p);
+        }
+    }
+    return valid;
+}
+
+
+
 static void
 validateXmlrpcDatetimeSome(xmlrpc_env *    const envP,
                            xmlrpc_datetime const dt) {
@@ -487,14 +666,19 @@ xmlrpc_parseDatetime(xmlrpc_env *    const envP,
 -----------------------------------------------------------------------------*/
     xmlrpc_datetime dt;
 
+    if (!scanDatetime(datetimeString, &dt)) {
+        /* Not a form we know.  Let the general parser have a look; mostly
+           it's just going to tell the caller what's wrong.
+        */
 #if HAVE_REGEX
-    parseDtRegex(envP, datetimeString, &dt);
+        parseDtRegex(envP, datetimeString, &dt);
 #else
-    /* Note: validation is not as strong without regex */
-    validateFormatNoRegex(envP, datetimeString);
-    if (!envP->fault_occurred)
-        parseDtNoRegex(envP, datetimeString, &dt);
+        /* Note: validation is not as strong without regex */
+        validateFormatNoRegex(envP, datetimeString);
+        if (!envP->fault_occurred)
+            parseDtNoRegex(envP, datetimeString, &dt);
 #endif
+    }
 
     if (!envP->fault_occurred) {
         validateXmlrpcDatetimeSome(envP, dt);
@@ -0,0 +1,1067 @@
+/*=============================================================================
+                                  parse_stream
+===============================================================================
+  This builds the xmlrpc_values of an XML-RPC call, response, or value
+  document straight from the XML parser's events, as the parser goes through
+  the document (see xml_parse_events()).
+
+  The alternative is to have the XML parser build a tree of xml_element
+  objects for the whole document and then walk the tree (xmlrpc_parseValue()).
+  For a large document, that takes a lot more memory and time, because the
+  tree holds another copy of all the data on its way to becoming
+  xmlrpc_values.
+
+  We validate the document the same way the tree walker does.
+
+  For a server's call, we build the xmlrpc_values in an arena (see
+  xmlrpc_mem_pool_get()) that belongs to the one document, so that building
+  them doesn't take a trip to malloc() for every value, and destroying them
+  doesn't take a trip to free() for every value.  The arena goes away when
+  the last of the values does, so one value that lives on keeps the memory
+  of the whole document.  That's fine for the parameters of a call, which
+  normally die with the call, but not for a response or a value the caller
+  may keep as long as it likes, so we build those with malloc().
+=============================================================================*/
+
+#include "xmlrpc_config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bool.h"
+#include "mallocvar.h"
+
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlparser.h"
+#include "parse_value.h"
+
+#include "parse_stream.h"
+
+
+
+typedef enum {
+    ELT_METHODCALL,
+    ELT_METHODRESPONSE,
+    ELT_METHODNAME,
+    ELT_PARAMS,
+    ELT_PARAM,
+    ELT_FAULT,
+    ELT_VALUE,
+    ELT_SCALAR,
+        /* A data type element of a simple value, e.g. <int> */
+    ELT_ARRAY,
+    ELT_DATA,
+    ELT_STRUCT,
+    ELT_MEMBER,
+    ELT_NAME
+} eltType;
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   An XML element the parser is inside of
+-----------------------------------------------------------------------------*/
+    eltType        type;
+    unsigned int   childCt;
+        /* Number of child elements that have started so far */
+    xmlrpc_value * valueP;
+        /* What we have built so far for this element:
+
+             <params>, <data>: the array of the child values
+             <struct>:         the struct
+             <array>:          the array from the <data> child
+             <value>:          the value from the data type child
+             <param>, <fault>, <member>: the value from the <value> child
+
+           NULL if nothing (yet).
+        */
+    xmlrpc_value * keyP;
+        /* <member> only: the value of the <name> child.  NULL if none yet */
+    char           typeName[24];
+        /* ELT_SCALAR only: the element name, e.g. "int".  Every data type
+           element name we understand fits.
+        */
+} frame;
+
+
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   Our parse context.  We pass this to the XML parser as user data for our
+   event handlers.
+-----------------------------------------------------------------------------*/
+    eltType            rootType;
+        /* The type of element the document must be */
+    unsigned int       maxNest;
+        /* How deeply <value> elements may nest */
+    frame *            stack;
+        /* The elements the parser is inside of, outermost first */
+    unsigned int       stackSize;
+        /* Number of frames allocated at 'stack' */
+    unsigned int       depth;
+        /* Number of frames in use at 'stack' */
+    unsigned int       valueDepth;
+        /* Number of <value> elements in the stack */
+    xmlrpc_mem_block * cdataP;
+        /* The character data so far of the innermost element, if it is one
+           whose character data means something.
+        */
+    bool               handlerFailed;
+        /* The fault, if any, came from our handlers (the XML is fine, but
+           it isn't valid XML-RPC).
+        */
+    xmlrpc_mem_pool *  arenaP;
+        /* The arena in which we build the xmlrpc_values; NULL to build
+           them with malloc().  Make it the thread's current arena while the
+           XML parser is running our handlers.
+        */
+
+    /* The results: */
+    const char *       methodName;
+        /* The <methodName> of a <methodCall>.  NULL if none yet */
+    xmlrpc_value *     paramsP;
+        /* The array of <param> values from <params>.  NULL if none yet */
+    xmlrpc_value *     faultP;
+        /* The <fault> value of a <methodResponse>.  NULL if none yet */
+    xmlrpc_value *     valueP;
+        /* The root <value>.  NULL if none yet */
+} parseContext;
+
+
+
+static void
+setParseFault(xmlrpc_env * const envP,
+              const char * const format,
+              ...) {
+
+    va_list args;
+    va_start(args, format);
+    xmlrpc_set_fault_formatted_v(envP, XMLRPC_PARSE_ERROR, format, args);
+    va_end(args);
+}
+
+
+
+static const char *
+eltTypeName(eltType const type) {
+
+    switch (type) {
+    case ELT_METHODCALL:     return "methodCall";
+    case ELT_METHODRESPONSE: return "methodResponse";
+    case ELT_METHODNAME:     return "methodName";
+    case ELT_PARAMS:         return "params";
+    case ELT_PARAM:          return "param";
+    case ELT_FAULT:          return "fault";
+    case ELT_VALUE:          return "value";
+    case ELT_SCALAR:         return "data type";
+    case ELT_ARRAY:          return "array";
+    case ELT_DATA:           return "data";
+    case ELT_STRUCT:         return "struct";
+    case ELT_MEMBER:         return "member";
+    case ELT_NAME:           return "name";
+    }
+    return NULL;  /* Quiet compiler warning */
+}
+
+
+
+static const char *
+frameName(const frame * const frameP) {
+
+    return frameP->type == ELT_SCALAR ?
+        frameP->typeName : eltTypeName(frameP->type);
+}
+
+
+
+static void
+initParseContext(xmlrpc_env *      const envP,
+                 parseContext *    const contextP,
+                 eltType           const rootType,
+                 xmlrpc_mem_pool * const memPoolP,
+                 bool              const inArena) {
+
+    contextP->rootType      = rootType;
+    contextP->maxNest       =
+        (unsigned int)xmlrpc_limit_get(XMLRPC_NESTING_LIMIT_ID);
+    contextP->stack         = NULL;
+    contextP->stackSize     = 0;
+    contextP->depth         = 0;
+    contextP->valueDepth    = 0;
+    contextP->handlerFailed = false;
+    contextP->methodName    = NULL;
+    contextP->paramsP       = NULL;
+    contextP->faultP        = NULL;
+    contextP->valueP        = NULL;
+
+    if (inArena) {
+        /* The arena itself is unbounded, because the values we build in it
+           outlive the parse and *memPoolP.  But while we parse, its growth
+           counts against *memPoolP, so a document can't make us use more
+           memory than the caller allows.
+        */
+        contextP->arenaP = xmlrpc_mem_pool_new(envP, (size_t)-1);
+
+        if (!envP->fault_occurred)
+            xmlrpc_mem_pool_charge_arena(contextP->arenaP, memPoolP);
+    } else
+        contextP->arenaP = NULL;
+
+    if (!envP->fault_occurred) {
+        contextP->cdataP = xmlrpc_mem_block_new_pool(envP, 0, memPoolP);
+
+        if (envP->fault_occurred && contextP->arenaP) {
+            xmlrpc_mem_pool_charge_arena(contextP->arenaP, NULL);
+            xmlrpc_mem_pool_free(contextP->arenaP);
+        }
+    }
+}
+
+
+
+static void
+popFrame(parseContext * const contextP) {
+/*----------------------------------------------------------------------------
+   Discard the innermost frame, and whatever is still in it.
+-----------------------------------------------------------------------------*/
+    frame * const frameP = &contextP->stack[--contextP->depth];
+
+    if (frameP->valueP)
+        xmlrpc_DECREF(frameP->valueP);
+    if (frameP->keyP)
+        xmlrpc_DECREF(frameP->keyP);
+    if (frameP->type == ELT_VALUE)
+        --contextP->valueDepth;
+}
+
+
+
+static void
+termParseContext(parseContext * const contextP) {
+/*----------------------------------------------------------------------------
+   Release everything in *contextP except the results.
+-----------------------------------------------------------------------------*/
+    while (contextP->depth > 0)
+        popFrame(contextP);
+
+    free(contextP->stack);
+
+    XMLRPC_MEMBLOCK_FREE(char, contextP->cdataP);
+
+    if (contextP->arenaP) {
+        /* The arena lives on as long as any of the values in it, but it
+           stops counting against the caller's pool now.
+        */
+        xmlrpc_mem_pool_charge_arena(contextP->arenaP, NULL);
+        xmlrpc_mem_pool_free(contextP->arenaP);
+    }
+}
+
+
+
+static void
+discardResults(parseContext * const contextP) {
+
+    if (contextP->methodName)
+        xmlrpc_strfree(contextP->methodName);
+    if (contextP->paramsP)
+        xmlrpc_DECREF(contextP->paramsP);
+    if (contextP->faultP)
+        xmlrpc_DECREF(contextP->faultP);
+    if (contextP->valueP)
+        xmlrpc_DECREF(contextP->valueP);
+}
+
+
+
+static void
+pushFrame(xmlrpc_env *   const envP,
+          parseContext * const contextP,
+          eltType        const type,
+          const char *   const name) {
+/*----------------------------------------------------------------------------
+   Add a frame for a new innermost element of type 'type', named 'name'.
+-----------------------------------------------------------------------------*/
+    if (type == ELT_VALUE && contextP->valueDepth + 1 > contextP->maxNest)
+        setParseFault(envP, "Nested data structure too deep.");
+    else {
+        if (contextP->depth >= contextP->stackSize) {
+            unsigned int const newSize = MAX(16, contextP->stackSize * 2);
+
+            frame * const newStack =
+                realloc(contextP->stack, newSize * sizeof(frame));
+
+            if (newStack == NULL)
+                xmlrpc_faultf(envP, "Couldn't allocate memory for %u-deep "
+                              "XML element stack", newSize);
+            else {
+                contextP->stack     = newStack;
+                contextP->stackSize = newSize;
+            }
+        }
+        if (!envP->fault_occurred) {
+            frame * const frameP = &contextP->stack[contextP->depth];
+
+            frameP->type    = type;
+            frameP->childCt = 0;
+            frameP->valueP  = NULL;
+            frameP->keyP    = NULL;
+
+            switch (type) {
+            case ELT_PARAMS:
+            case ELT_DATA:
+                frameP->valueP = xmlrpc_array_new(envP);
+                break;
+            case ELT_STRUCT:
+                frameP->valueP = xmlrpc_struct_new(envP);
+                break;
+            case ELT_SCALAR:
+                if (strlen(name) >= sizeof(frameP->typeName))
+                    setParseFault(envP, "Unknown value type -- XML element "
+                                  "is named <%s>", name);
+                else
+                    strcpy(frameP->typeName, name);
+                break;
+            default:
+                break;
+            }
+            if (!envP->fault_occurred) {
+                ++contextP->depth;
+                if (type == ELT_VALUE)
+                    ++contextP->valueDepth;
+            } else {
+                if (frameP->valueP)
+                    xmlrpc_DECREF(frameP->valueP);
+            }
+        }
+    }
+}
+
+
+
+static void
+classifyRoot(xmlrpc_env *   const envP,
+             parseContext * const contextP,
+             const char *   const name,
+             eltType *      const typeP) {
+
+    const char * const rootName = eltTypeName(contextP->rootType);
+
+    if (!xmlrpc_streq(name, rootName))
+        setParseFault(envP, "XML-RPC document should be a <%s> element.  "
+                      "Instead, we have a <%s> element.", rootName, name);
+    else
+        *typeP = contextP->rootType;
+}
+
+
+
+static void
+classifyChild(xmlrpc_env *   const envP,
+              parseContext * const contextP,
+              const frame *  const parentP,
+              const char *   const name,
+              eltType *      const typeP) {
+/*----------------------------------------------------------------------------
+   Determine what kind of element a child named 'name' of the element
+   described by *parentP is.  Fail if it can't be a child of that element.
+
+   *parentP->childCt already counts the child.
+-----------------------------------------------------------------------------*/
+    const char * const parentName = frameName(parentP);
+
+    switch (parentP->type) {
+    case ELT_METHODCALL:
+        if (xmlrpc_streq(name, "methodName") && !contextP->methodName)
+            *typeP = ELT_METHODNAME;
+        else if (xmlrpc_streq(name, "params") && !contextP->paramsP)
+            *typeP = ELT_PARAMS;
+        else
+            setParseFault(envP, "<methodCall> has extraneous <%s> child.  "
+                          "It should have one <methodName> and one "
+                          "<params>.", name);
+        break;
+    case ELT_METHODRESPONSE:
+        if (parentP->childCt > 1)
+            setParseFault(envP, "<methodResponse> has more than one child.  "
+                          "It should have one <params> or <fault>.");
+        else if (xmlrpc_streq(name, "params"))
+            *typeP = ELT_PARAMS;
+        else if (xmlrpc_streq(name, "fault"))
+            *typeP = ELT_FAULT;
+        else
+            setParseFault(envP,
+                          "<methodResponse> must contain <params> or <fault>, "
+                          "but contains <%s>.", name);
+        break;
+    case ELT_PARAMS:
+        if (xmlrpc_streq(name, "param"))
+            *typeP = ELT_PARAM;
+        else
+            setParseFault(envP, "Expected element of type <param>, "
+                          "found <%s>", name);
+        break;
+    case ELT_PARAM:
+    case ELT_FAULT:
+        if (parentP->childCt > 1)
+            setParseFault(envP, "<%s> has more than one child.  "
+                          "Only one <value> makes sense.", parentName);
+        else if (xmlrpc_streq(name, "value"))
+            *typeP = ELT_VALUE;
+        else
+            setParseFault(envP, "<%s> contains a <%s> element.  "
+                          "Only <value> makes sense.", parentName, name);
+        break;
+    case ELT_VALUE:
+        if (parentP->childCt > 1)
+            setParseFault(envP, "<value> has more than one child element.  "
+                          "Only zero or one make sense.");
+        else if (xmlrpc_streq(name, "struct"))
+            *typeP = ELT_STRUCT;
+        else if (xmlrpc_streq(name, "array"))
+            *typeP = ELT_ARRAY;
+        else
+            *typeP = ELT_SCALAR;
+        break;
+    case ELT_ARRAY:
+        if (parentP->childCt > 1)
+            setParseFault(envP, "<array> element has more than one child.  "
+                          "Only one <data> makes sense.");
+        else if (xmlrpc_streq(name, "data"))
+            *typeP = ELT_DATA;
+        else
+            setParseFault(envP, "<array> element has <%s> child.  "
+                          "Only <data> makes sense.", name);
+        break;
+    case ELT_DATA:
+        if (xmlrpc_streq(name, "value"))
+            *typeP = ELT_VALUE;
+        else
+            setParseFault(envP, "<data> element has <%s> child.  "
+                          "Only <value> makes sense.", name);
+        break;
+    case ELT_STRUCT:
+        if (xmlrpc_streq(name, "member"))
+            *typeP = ELT_MEMBER;
+        else
+            setParseFault(envP, "<%s> element found where only <member> "
+                          "makes sense", name);
+        break;
+    case ELT_MEMBER:
+        if (parentP->childCt > 2)
+            setParseFault(envP, "<member> element has more than 2 children.  "
+                          "Only one <name> and one <value> make sense.");
+        else if (xmlrpc_streq(name, "name") && !parentP->keyP)
+            *typeP = ELT_NAME;
+        else if (xmlrpc_streq(name, "value") && !parentP->valueP)
+            *typeP = ELT_VALUE;
+        else
+            setParseFault(envP, "<member> element has extraneous <%s> "
+                          "child.  Only one <name> and one <value> "
+                          "make sense.", name);
+        break;
+    case ELT_METHODNAME:
+    case ELT_NAME:
+    case ELT_SCALAR:
+        setParseFault(envP, "<%s> element has a <%s> child.  "
+                      "It should have no children.", parentName, name);
+        break;
+    }
+}
+
+
+
+static void
+startElement(xmlrpc_env * const envP,
+             void *       const userData,
+             const char * const name) {
+
+    parseContext * const contextP = userData;
+
+    eltType type;
+
+    if (contextP->depth == 0)
+        classifyRoot(envP, contextP, name, &type);
+    else {
+        frame * const parentP = &contextP->stack[contextP->depth-1];
+
+        ++parentP->childCt;
+
+        classifyChild(envP, contextP, parentP, name, &type);
+    }
+    if (!envP->fault_occurred) {
+        pushFrame(envP, contextP, type, name);
+
+        /* Any character data of the parent before this element is
+           meaningless.
+        */
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, contextP->cdataP, 0);
+    }
+    if (envP->fault_occurred)
+        contextP->handlerFailed = true;
+}
+
+
+
+static bool
+wantsCdata(const frame * const frameP) {
+/*----------------------------------------------------------------------------
+   The character data in the element described by *frameP means something.
+-----------------------------------------------------------------------------*/
+    switch (frameP->type) {
+    case ELT_METHODNAME:
+    case ELT_NAME:
+    case ELT_SCALAR:
+        return true;
+    case ELT_VALUE:
+        /* It's the value of an untyped string, unless there's a data type
+           element.
+        */
+        return frameP->childCt == 0;
+    default:
+        return false;
+    }
+}
+
+
+
+static void
+characterData(xmlrpc_env * const envP,
+              void *       const userData,
+              const char * const cdata,
+              size_t       const len) {
+
+    parseContext * const contextP = userData;
+
+    if (contextP->depth > 0 &&
+        wantsCdata(&contextP->stack[contextP->depth-1])) {
+
+        XMLRPC_MEMBLOCK_APPEND(char, envP, contextP->cdataP, cdata, len);
+
+        if (envP->fault_occurred)
+            contextP->handlerFailed = true;
+    }
+}
+
+
+
+static void
+getCdata(xmlrpc_env *   const envP,
+         parseContext * const contextP,
+         const char **  const cdataP,
+         size_t *       const lenP) {
+/*----------------------------------------------------------------------------
+   The character data of the innermost element, NUL-terminated.
+-----------------------------------------------------------------------------*/
+    size_t const len = XMLRPC_MEMBLOCK_SIZE(char, contextP->cdataP);
+
+    XMLRPC_MEMBLOCK_APPEND(char, envP, contextP->cdataP, "\0", 1);
+
+    if (!envP->fault_occurred) {
+        *cdataP = XMLRPC_MEMBLOCK_CONTENTS(char, contextP->cdataP);
+        *lenP   = len;
+    }
+}
+
+
+
+static xmlrpc_value *
+takeValue(frame * const frameP) {
+
+    xmlrpc_value * const retval = frameP->valueP;
+
+    frameP->valueP = NULL;
+
+    return retval;
+}
+
+
+
+static void
+finishFrame(xmlrpc_env *    const envP,
+            parseContext *  const contextP,
+            frame *         const frameP,
+            xmlrpc_value ** const resultPP) {
+/*----------------------------------------------------------------------------
+   Finish the element described by *frameP, which has just ended.
+
+   Return as *resultPP the value the element represents for its parent, or
+   NULL if there isn't one.
+-----------------------------------------------------------------------------*/
+    *resultPP = NULL;  /* initial value */
+
+    switch (frameP->type) {
+    case ELT_METHODCALL:
+        if (!contextP->methodName)
+            setParseFault(envP, "<methodCall> has no <methodName> child");
+        else if (!contextP->paramsP) {
+            /* Workaround for Ruby XML-RPC and old versions of xmlrpc-epi,
+               which send no <params> for no parameters.
+            */
+            contextP->paramsP = xmlrpc_array_new(envP);
+        }
+        break;
+    case ELT_METHODRESPONSE:
+        if (frameP->childCt == 0)
+            setParseFault(envP,
+                          "<methodResponse> has 0 children, should have 1.");
+        break;
+    case ELT_METHODNAME: {
+        const char * cdata;
+        size_t len;
+
+        getCdata(envP, contextP, &cdata, &len);
+
+        if (!envP->fault_occurred) {
+            xmlrpc_validate_utf8(envP, cdata, len);
+
+            if (!envP->fault_occurred) {
+                contextP->methodName = xmlrpc_strdupnull(cdata);
+                if (contextP->methodName == NULL)
+                    xmlrpc_faultf(envP, "Could not allocate memory for "
+                                  "method name");
+            }
+        }
+    } break;
+    case ELT_PARAM:
+    case ELT_FAULT:
+        if (!frameP->valueP)
+            setParseFault(envP, "<%s> element has no <value> child",
+                          frameName(frameP));
+        else
+            *resultPP = takeValue(frameP);
+        break;
+    case ELT_VALUE:
+        if (frameP->childCt == 0) {
+            /* We have no type element, so treat the value as a string. */
+            const char * cdata;
+            size_t len;
+
+            getCdata(envP, contextP, &cdata, &len);
+
+            if (!envP->fault_occurred)
+                *resultPP = xmlrpc_string_new_lp(envP, len, cdata);
+        } else
+            *resultPP = takeValue(frameP);
+        break;
+    case ELT_SCALAR:
+    case ELT_NAME: {
+        const char * cdata;
+        size_t len;
+
+        getCdata(envP, contextP, &cdata, &len);
+
+        if (!envP->fault_occurred) {
+            if (frameP->type == ELT_NAME)
+                *resultPP = xmlrpc_string_new_lp(envP, len, cdata);
+            else
+                xmlrpc_parseSimpleValueCdata(envP, frameP->typeName,
+                                             cdata, len, resultPP);
+        }
+    } break;
+    case ELT_ARRAY:
+        if (frameP->childCt == 0)
+            setParseFault(envP, "<array> element has 0 children.  "
+                          "Only one <data> makes sense.");
+        else
+            *resultPP = takeValue(frameP);
+        break;
+    case ELT_MEMBER:
+        if (!frameP->keyP)
+            setParseFault(envP, "<member> has no <name> child");
+        else if (!frameP->valueP)
+            setParseFault(envP, "<member> has no <value> child");
+        break;
+    case ELT_PARAMS:
+    case ELT_DATA:
+    case ELT_STRUCT:
+        *resultPP = takeValue(frameP);
+        break;
+    }
+}
+
+
+
+static void
+deliverToParent(xmlrpc_env *   const envP,
+                parseContext * const contextP,
+                const frame *  const childP,
+                xmlrpc_value * const valueP) {
+/*----------------------------------------------------------------------------
+   Give the innermost element the value 'valueP' that its child element
+   *childP represents.  If there is no innermost element (*childP was the
+   root), put it in the results.
+
+   'valueP' may be NULL, meaning the child doesn't represent a value.
+
+   We take ownership of the reference 'valueP'.
+-----------------------------------------------------------------------------*/
+    if (contextP->depth == 0) {
+        if (childP->type == ELT_VALUE)
+            contextP->valueP = valueP;
+    } else {
+        frame * const parentP = &contextP->stack[contextP->depth-1];
+
+        switch (parentP->type) {
+        case ELT_METHODCALL:
+        case ELT_METHODRESPONSE:
+            if (childP->type == ELT_PARAMS)
+                contextP->paramsP = valueP;
+            else if (childP->type == ELT_FAULT)
+                contextP->faultP = valueP;
+            break;
+        case ELT_PARAMS:
+        case ELT_DATA:
+            xmlrpc_array_append_item(envP, parentP->valueP, valueP);
+            xmlrpc_DECREF(valueP);
+            break;
+        case ELT_STRUCT:
+            /* The member has the key and value */
+            xmlrpc_struct_set_value_v(envP, parentP->valueP,
+                                      childP->keyP, childP->valueP);
+            break;
+        case ELT_MEMBER:
+            if (childP->type == ELT_NAME)
+                parentP->keyP = valueP;
+            else
+                parentP->valueP = valueP;
+            break;
+        default:
+            parentP->valueP = valueP;
+        }
+    }
+}
+
+
+
+static void
+endElement(xmlrpc_env * const envP,
+           void *       const userData) {
+
+    parseContext * const contextP = userData;
+
+    frame * const frameP = &contextP->stack[contextP->depth-1];
+
+    xmlrpc_value * valueP;
+
+    XMLRPC_ASSERT(contextP->depth > 0);
+
+    finishFrame(envP, contextP, frameP, &valueP);
+
+    if (!envP->fault_occurred) {
+        frame const child = *frameP;
+
+        --contextP->depth;
+        if (child.type == ELT_VALUE)
+            --contextP->valueDepth;
+
+        deliverToParent(envP, contextP, &child, valueP);
+
+        /* The child frame is gone, but its key and value, if any, are still
+           ours.
+        */
+        if (child.keyP)
+            xmlrpc_DECREF(child.keyP);
+        if (child.valueP)
+            xmlrpc_DECREF(child.valueP);
+    }
+    if (envP->fault_occurred)
+        contextP->handlerFailed = true;
+}
+
+
+
+static xml_eventHandlers const handlers = {
+    &startElement,
+    &endElement,
+    &characterData
+};
+
+
+
+static void
+setFaultFromParser(xmlrpc_env *         const envP,
+                   const parseContext * const contextP,
+                   const xmlrpc_env *   const parseEnvP,
+                   const char *         const invalidXmlMsg) {
+/*----------------------------------------------------------------------------
+   Set *envP to describe the failure *parseEnvP of the XML parser.
+
+   'invalidXmlMsg' is what our failure message says if the problem is that
+   the document isn't even XML, as opposed to being XML that isn't valid
+   XML-RPC.
+-----------------------------------------------------------------------------*/
+    if (contextP->handlerFailed)
+        xmlrpc_env_set_fault(envP, parseEnvP->fault_code,
+                             parseEnvP->fault_string);
+    else
+        xmlrpc_env_set_fault_formatted(
+            envP, parseEnvP->fault_code, "%s.  %s",
+            invalidXmlMsg, parseEnvP->fault_string);
+}
+
+
+
+static void
+parseDocument(xmlrpc_env *      const envP,
+              const char *      const xmlData,
+              size_t            const xmlDataLen,
+              xmlrpc_mem_pool * const memPoolP,
+              bool              const inArena,
+              eltType           const rootType,
+              const char *      const invalidXmlMsg,
+              parseContext *    const contextP) {
+/*----------------------------------------------------------------------------
+   Parse the XML-RPC document 'xmlData', whose root element must be of type
+   'rootType'.  Return the results in *contextP.  Build them in an arena of
+   their own iff 'inArena'.
+
+   If we fail, there aren't any results.
+
+   'invalidXmlMsg' is as for setFaultFromParser().
+-----------------------------------------------------------------------------*/
+    initParseContext(envP, contextP, rootType, memPoolP, inArena);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_env env;
+        xmlrpc_mem_pool * oldArenaP;
+
+        xmlrpc_env_init(&env);
+
+        oldArenaP = xmlrpc_mem_pool_set_current(contextP->arenaP);
+
+        xml_parse_events(&env, xmlData, xmlDataLen, memPoolP,
+                         &handlers, contextP);
+
+        xmlrpc_mem_pool_set_current(oldArenaP);
+
+        if (env.fault_occurred) {
+            setFaultFromParser(envP, contextP, &env, invalidXmlMsg);
+
+            discardResults(contextP);
+        }
+        termParseContext(contextP);
+
+        xmlrpc_env_clean(&env);
+    }
+}
+
+
+
+void
+xmlrpc_parseCallStream(xmlrpc_env *      const envP,
+                       const char *      const xmlData,
+                       size_t            const xmlDataLen,
+                       xmlrpc_mem_pool * const memPoolP,
+                       bool              const inArena,
+                       const char **     const methodNameP,
+                       xmlrpc_value **   const paramArrayPP) {
+/*----------------------------------------------------------------------------
+   Parse the XML-RPC call 'xmlData'.  Return the method name and the array
+   of parameters.
+
+   'inArena' means build the parameters in an arena that lives as long as
+   any of them does.  That is for a server, whose parameters die with the
+   call.
+-----------------------------------------------------------------------------*/
+    parseContext context;
+
+    parseDocument(envP, xmlData, xmlDataLen, memPoolP, inArena,
+                  ELT_METHODCALL,
+                  "Call is not valid XML", &context);
+
+    if (!envP->fault_occurred) {
+        XMLRPC_ASSERT(context.methodName && context.paramsP);
+
+        *methodNameP  = context.methodName;
+        *paramArrayPP = context.paramsP;
+    }
+}
+
+
+
+void
+xmlrpc_parseResponseStream(xmlrpc_env *      const envP,
+                           const char *      const xmlData,
+                           size_t            const xmlDataLen,
+                           xmlrpc_mem_pool * const memPoolP,
+                           xmlrpc_value **   const paramArrayPP,
+                           xmlrpc_value **   const faultPP) {
+/*----------------------------------------------------------------------------
+   Parse the XML-RPC response 'xmlData'.
+
+   If it is a <params> response, return the array of parameters as
+   *paramArrayPP and NULL as *faultPP.  If it is a <fault> response, return
+   the fault value as *faultPP and NULL as *paramArrayPP.
+-----------------------------------------------------------------------------*/
+    parseContext context;
+
+    parseDocument(envP, xmlData, xmlDataLen, memPoolP, false,
+                  ELT_METHODRESPONSE,
+                  "Not valid XML", &context);
+
+    if (!envP->fault_occurred) {
+        XMLRPC_ASSERT((context.paramsP == NULL) != (context.faultP == NULL));
+
+        *paramArrayPP = context.paramsP;
+        *faultPP      = context.faultP;
+    }
+}
+
+
+
+void
+xmlrpc_parseValueStream(xmlrpc_env *      const envP,
+                        const char *      const xmlData,
+                        size_t            const xmlDataLen,
+                        xmlrpc_mem_pool * const memPoolP,
+                        xmlrpc_value **   const valuePP) {
+/*----------------------------------------------------------------------------
+   Parse the XML document 'xmlData', which is a single <value> element.
+-----------------------------------------------------------------------------*/
+    parseContext context;
+
+    parseDocument(envP, xmlData, xmlDataLen, memPoolP, false, ELT_VALUE,
+                  "Not valid XML", &context);
+
+    if (!envP->fault_occurred) {
+        XMLRPC_ASSERT(context.valueP);
+
+        *valuePP = context.valueP;
+    }
+}
+
+
+
+struct xmlrpc_callParser {
+    parseContext      context;
+    xml_eventParser * xmlParserP;
+};
+
+
+
+void
+xmlrpc_callParserCreate(xmlrpc_env *         const envP,
+                        xmlrpc_mem_pool *    const memPoolP,
+                        bool                 const inArena,
+                        xmlrpc_callParser ** const parserPP) {
+/*----------------------------------------------------------------------------
+   Create a parser to which to feed a call a piece at a time.  'memPoolP'
+   and 'inArena' are as for xmlrpc_parseCallStream().
+-----------------------------------------------------------------------------*/
+
+    xmlrpc_callParser * parserP;
+
+    MALLOCVAR(parserP);
+
+    if (parserP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for call parser");
+    else {
+        initParseContext(envP, &parserP->context, ELT_METHODCALL, memPoolP,
+                         inArena);
+
+        if (!envP->fault_occurred) {
+            xml_eventParserCreate(envP, memPoolP, &handlers,
+                                  &parserP->context, &parserP->xmlParserP);
+
+            if (envP->fault_occurred)
+                termParseContext(&parserP->context);
+        }
+        if (envP->fault_occurred)
+            free(parserP);
+        else
+            *parserPP = parserP;
+    }
+}
+
+
+
+void
+xmlrpc_callParserDestroy(xmlrpc_callParser * const parserP) {
+
+    xml_eventParserDestroy(parserP->xmlParserP);
+
+    discardResults(&parserP->context);
+
+    termParseContext(&parserP->context);
+
+    free(parserP);
+}
+
+
+
+void
+xmlrpc_callParserFeed(xmlrpc_env *        const envP,
+                      xmlrpc_callParser * const parserP,
+                      const char *        const xmlData,
+                      size_t              const xmlDataLen) {
+/*----------------------------------------------------------------------------
+   Parse the next 'xmlDataLen' bytes of the call.
+
+   Once this fails, don't call it or xmlrpc_callParserFinish() again.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    xmlrpc_mem_pool * oldArenaP;
+
+    xmlrpc_env_init(&env);
+
+    oldArenaP = xmlrpc_mem_pool_set_current(parserP->context.arenaP);
+
+    xml_eventParserFeed(&env, parserP->xmlParserP, xmlData, xmlDataLen,
+                        false);
+
+    xmlrpc_mem_pool_set_current(oldArenaP);
+
+    if (env.fault_occurred)
+        setFaultFromParser(envP, &parserP->context, &env,
+                           "Call is not valid XML");
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+void
+xmlrpc_callParserFinish(xmlrpc_env *        const envP,
+                        xmlrpc_callParser * const parserP,
+                        const char **       const methodNameP,
+                        xmlrpc_value **     const paramArrayPP) {
+/*----------------------------------------------------------------------------
+   Finish parsing the call we have been feeding to *parserP.  Return the
+   method name and the array of parameters, like xmlrpc_parseCallStream().
+-----------------------------------------------------------------------------*/
+    parseContext * const contextP = &parserP->context;
+
+    xmlrpc_env env;
+    xmlrpc_mem_pool * oldArenaP;
+
+    xmlrpc_env_init(&env);
+
+    oldArenaP = xmlrpc_mem_pool_set_current(contextP->arenaP);
+
+    xml_eventParserFeed(&env, parserP->xmlParserP, NULL, 0, true);
+
+    xmlrpc_mem_pool_set_current(oldArenaP);
+
+    if (env.fault_occurred)
+        setFaultFromParser(envP, contextP, &env, "Call is not valid XML");
+    else {
+        XMLRPC_ASSERT(contextP->methodName && contextP->paramsP);
+
+        *methodNameP  = contextP->methodName;
+        *paramArrayPP = contextP->paramsP;
+
+        contextP->methodName = NULL;
+        contextP->paramsP    = NULL;
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
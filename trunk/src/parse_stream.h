@@ -0,0 +1,66 @@
+#ifndef PARSE_STREAM_H_INCLUDED
+#define PARSE_STREAM_H_INCLUDED
+
+#include "bool.h"
+#include "xmlrpc-c/util.h"
+#include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_parseCallStream(xmlrpc_env *      const envP,
+                       const char *      const xmlData,
+                       size_t            const xmlDataLen,
+                       xmlrpc_mem_pool * const memPoolP,
+                       bool              const inArena,
+                       const char **     const methodNameP,
+                       xmlrpc_value **   const paramArrayPP);
+
+void
+xmlrpc_parseResponseStream(xmlrpc_env *      const envP,
+                           const char *      const xmlData,
+                           size_t            const xmlDataLen,
+                           xmlrpc_mem_pool * const memPoolP,
+                           xmlrpc_value **   const paramArrayPP,
+                           xmlrpc_value **   const faultPP);
+
+void
+xmlrpc_parseValueStream(xmlrpc_env *      const envP,
+                        const char *      const xmlData,
+                        size_t            const xmlDataLen,
+                        xmlrpc_mem_pool * const memPoolP,
+                        xmlrpc_value **   const valuePP);
+
+/* If you don't have the whole call at once, you can feed it a piece at a
+   time to an xmlrpc_callParser instead of calling xmlrpc_parseCallStream().
+*/
+
+typedef struct xmlrpc_callParser xmlrpc_callParser;
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_callParserCreate(xmlrpc_env *         const envP,
+                        xmlrpc_mem_pool *    const memPoolP,
+                        bool                 const inArena,
+                        xmlrpc_callParser ** const parserPP);
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_callParserDestroy(xmlrpc_callParser * const parserP);
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_callParserFeed(xmlrpc_env *        const envP,
+                      xmlrpc_callParser * const parserP,
+                      const char *        const xmlData,
+                      size_t              const xmlDataLen);
+
+XMLRPC_LIBINT_EXPORTED
+void
+xmlrpc_callParserFinish(xmlrpc_env *        const envP,
+                        xmlrpc_callParser * const parserP,
+                        const char **       const methodNameP,
+                        xmlrpc_value **     const paramArrayPP);
+
+#endif
@@ -550,16 +550,8 @@ parseBase64(xmlrpc_env *    const envP,
     XMLRPC_ASSERT_PTR_OK(str);
 
     decoded = xmlrpc_base64_decode(envP, str, strLength);
-    if (!envP->fault_occurred) {
-        unsigned char * const bytes =
-            XMLRPC_MEMBLOCK_CONTENTS(unsigned char, decoded);
-        size_t const byteCount =
-            XMLRPC_MEMBLOCK_SIZE(unsigned char, decoded);
-
-        *valuePP = xmlrpc_base64_new(envP, byteCount, bytes);
-        
-        XMLRPC_MEMBLOCK_FREE(unsigned char, decoded);
-    }
+    if (!envP->fault_occurred)
+        *valuePP = xmlrpc_base64_new_block(envP, decoded);
 }
 
 
@@ -602,16 +594,17 @@ parseI8(xmlrpc_env *    const envP,
 
 
 
-static void
-parseSimpleValueCdata(xmlrpc_env *    const envP,
-                      const char *    const elementName,
-                      const char *    const cdata,
-                      size_t          const cdataLength,
-                      xmlrpc_value ** const valuePP) {
+void
+xmlrpc_parseSimpleValueCdata(xmlrpc_env *    const envP,
+                             const char *    const elementName,
+                             const char *    const cdata,
+                             size_t          const cdataLength,
+                             xmlrpc_value ** const valuePP) {
 /*----------------------------------------------------------------------------
    Parse an XML element that is supposedly a data type element such as
    <string>.  Its name is 'elementName', and it has no children, but
-   contains cdata 'cdata', which is 'dataLength' characters long.
+   contains cdata 'cdata', which is 'dataLength' characters long, followed
+   by a NUL.
 -----------------------------------------------------------------------------*/
     /* We need to straighten out the whole character set / encoding thing
        some day.  What is 'cdata', and what should it be?  Does it have
@@ -681,7 +674,8 @@ parseSimpleValue(xmlrpc_env *    const envP,
         const char * const cdata     = xml_element_cdata(elemP);
         size_t       const cdataSize = xml_element_cdata_size(elemP);
 
-        parseSimpleValueCdata(envP, elemName, cdata, cdataSize, valuePP);
+        xmlrpc_parseSimpleValueCdata(envP, elemName, cdata, cdataSize,
+                                     valuePP);
     }
 }
 
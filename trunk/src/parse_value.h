@@ -10,4 +10,11 @@ xmlrpc_parseValue(xmlrpc_env *    const envP,
                   xml_element *   const elemP,
                   xmlrpc_value ** const valuePP);
 
+void
+xmlrpc_parseSimpleValueCdata(xmlrpc_env *    const envP,
+                             const char *    const elementName,
+                             const char *    const cdata,
+                             size_t          const cdataLength,
+                             xmlrpc_value ** const valuePP);
+
 #endif
@@ -24,6 +24,7 @@
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
+#include "xmlrpc_parse.h"
 #include "method.h"
 #include "system_method.h"
 #include "version.h"
@@ -189,6 +190,28 @@ xmlrpc_registry_add_method3(
 
 
 
+void
+xmlrpc_registry_freeze(xmlrpc_env *      const envP,
+                       xmlrpc_registry * const registryP) {
+/*----------------------------------------------------------------------------
+   Optimize registry *registryP for method lookup, on the assumption that
+   no one will add any more methods to it.
+
+   This is for a server that registers all its methods at startup.  Lookup
+   by name is fast anyway, but after this, it costs the same whether there
+   are 10 methods or 10,000.
+
+   If someone does add a method later, that works; the registry just goes
+   back to ordinary lookup until it gets frozen again.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(registryP);
+
+    xmlrpc_methodListFreeze(envP, registryP->methodListP);
+}
+
+
+
 void
 xmlrpc_registry_set_default_method(
     xmlrpc_env *          const envP ATTR_UNUSED,
@@ -385,41 +408,61 @@ serializeFault(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeResult(xmlrpc_env *              const envP,
+                xmlrpc_value *            const resultP,
+                xmlrpc_dialect            const dialect,
+                size_t                    const flushSize,
+                xmlrpc_serializeFlushFn         flush,
+                void *                    const flushArg,
+                xmlrpc_mem_block *        const responseXmlP) {
+
+    if (flush)
+        xmlrpc_serializeResponseStream(envP, responseXmlP, resultP, dialect,
+                                       flushSize, flush, flushArg);
+    else
+        xmlrpc_serialize_response2(envP, responseXmlP, resultP, dialect);
+}
+
+
+
 void
-xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
-                              xmlrpc_registry *   const registryP,
-                              const char *        const callXml,
-                              size_t              const callXmlLen,
-                              void *              const callInfo,
-                              xmlrpc_mem_block ** const responseXmlPP) {
+xmlrpc_processParsedCallStream(xmlrpc_env *              const envP,
+                               xmlrpc_registry *         const registryP,
+                               const xmlrpc_env *        const parseEnvP,
+                               const char *              const methodName,
+                               xmlrpc_value *            const paramArrayP,
+                               void *                    const callInfo,
+                               size_t                    const flushSize,
+                               xmlrpc_serializeFlushFn         flush,
+                               void *                    const flushArg,
+                               xmlrpc_mem_block **       const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Same as xmlrpc_processParsedCall(), except that if 'flush' is non-null,
+   we generate a success response a piece at a time as
+   xmlrpc_serializeResponseStream() does, with 'flush', 'flushSize', and
+   'flushArg' as arguments for that.  *responseXmlPP is then just the part
+   of the response 'flush' didn't take.
 
+   A fault response is always small, so we never flush that.
+-----------------------------------------------------------------------------*/
     xmlrpc_mem_block * responseXmlP;
 
     XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT_PTR_OK(callXml);
-
-    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
 
     /* Allocate our output buffer.
     ** If this fails, we need to die in a special fashion. */
     responseXmlP = XMLRPC_MEMBLOCK_NEW(char, envP, 0);
     if (!envP->fault_occurred) {
-        const char * methodName;
-        xmlrpc_value * paramArrayP;
         xmlrpc_env fault;
-        xmlrpc_env parseEnv;
 
         xmlrpc_env_init(&fault);
-        xmlrpc_env_init(&parseEnv);
-
-        xmlrpc_parse_call(&parseEnv, callXml, callXmlLen,
-                          &methodName, &paramArrayP);
 
-        if (parseEnv.fault_occurred)
+        if (parseEnvP->fault_occurred)
             xmlrpc_env_set_fault_formatted(
                 &fault, XMLRPC_PARSE_ERROR,
                 "Call XML not a proper XML-RPC call.  %s",
-                parseEnv.fault_string);
+                parseEnvP->fault_string);
         else {
             xmlrpc_value * resultP;
 
@@ -427,18 +470,15 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
                                 callInfo, &resultP);
 
             if (!fault.fault_occurred) {
-                xmlrpc_serialize_response2(envP, responseXmlP,
-                                           resultP, registryP->dialect);
+                serializeResult(envP, resultP, registryP->dialect,
+                                flushSize, flush, flushArg, responseXmlP);
 
                 xmlrpc_DECREF(resultP);
             }
-            xmlrpc_strfree(methodName);
-            xmlrpc_DECREF(paramArrayP);
         }
         if (!envP->fault_occurred && fault.fault_occurred)
             serializeFault(envP, fault, responseXmlP);
 
-        xmlrpc_env_clean(&parseEnv);
         xmlrpc_env_clean(&fault);
 
         if (envP->fault_occurred)
@@ -454,6 +494,68 @@ xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
 
 
 
+void
+xmlrpc_processParsedCall(xmlrpc_env *        const envP,
+                         xmlrpc_registry *   const registryP,
+                         const xmlrpc_env *  const parseEnvP,
+                         const char *        const methodName,
+                         xmlrpc_value *      const paramArrayP,
+                         void *              const callInfo,
+                         xmlrpc_mem_block ** const responseXmlPP) {
+/*----------------------------------------------------------------------------
+   Execute the call that we parsed into 'methodName' and 'paramArrayP' and
+   return the XML-RPC response as *responseXmlPP.
+
+   *parseEnvP is the result of parsing the call.  If it indicates failure,
+   there is no 'methodName' or 'paramArrayP' and the response is a fault
+   response saying the call was bad.
+-----------------------------------------------------------------------------*/
+    xmlrpc_processParsedCallStream(envP, registryP, parseEnvP,
+                                   methodName, paramArrayP, callInfo,
+                                   0, NULL, NULL, responseXmlPP);
+}
+
+
+
+void
+xmlrpc_registry_process_call2(xmlrpc_env *        const envP,
+                              xmlrpc_registry *   const registryP,
+                              const char *        const callXml,
+                              size_t              const callXmlLen,
+                              void *              const callInfo,
+                              xmlrpc_mem_block ** const responseXmlPP) {
+
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_env parseEnv;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(callXml);
+
+    xmlrpc_traceXml("XML-RPC CALL", callXml, callXmlLen);
+
+    xmlrpc_env_init(&parseEnv);
+
+    /* The parameters normally die with the call, so we can build them in
+       an arena.  A method that keeps one keeps the memory of the whole call
+       document.
+    */
+    xmlrpc_parse_call2(&parseEnv, callXml, callXmlLen, NULL, true,
+                       &methodName, &paramArrayP);
+
+    xmlrpc_processParsedCall(envP, registryP, &parseEnv,
+                             methodName, paramArrayP, callInfo,
+                             responseXmlPP);
+
+    if (!parseEnv.fault_occurred) {
+        xmlrpc_strfree(methodName);
+        xmlrpc_DECREF(paramArrayP);
+    }
+    xmlrpc_env_clean(&parseEnv);
+}
+
+
+
 xmlrpc_mem_block *
 xmlrpc_registry_process_call(xmlrpc_env *      const envP,
                              xmlrpc_registry * const registryP,
@@ -2,6 +2,7 @@
 #define REGISTRY_H_INCLUDED
 
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/server.h"
 
 void
@@ -12,4 +13,26 @@ xmlrpc_dispatchCall(struct _xmlrpc_env *     const envP,
                     void *                   const callInfoP,
                     struct _xmlrpc_value **  const resultPP);
 
+void
+xmlrpc_processParsedCall(struct _xmlrpc_env *       const envP,
+                         struct xmlrpc_registry *   const registryP,
+                         const struct _xmlrpc_env * const parseEnvP,
+                         const char *               const methodName,
+                         struct _xmlrpc_value *     const paramArrayP,
+                         void *                     const callInfo,
+                         xmlrpc_mem_block **        const responseXmlPP);
+
+void
+xmlrpc_processParsedCallStream(
+    struct _xmlrpc_env *       const envP,
+    struct xmlrpc_registry *   const registryP,
+    const struct _xmlrpc_env * const parseEnvP,
+    const char *               const methodName,
+    struct _xmlrpc_value *     const paramArrayP,
+    void *                     const callInfo,
+    size_t                     const flushSize,
+    xmlrpc_serializeFlushFn          flush,
+    void *                     const flushArg,
+    xmlrpc_mem_block **        const responseXmlPP);
+
 #endif
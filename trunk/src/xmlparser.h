@@ -3,6 +3,7 @@
 #ifndef XMLRPC_XMLPARSER_H_INCLUDED
 #define XMLRPC_XMLPARSER_H_INCLUDED
 
+#include "bool.h"
 #include "xmlrpc-c/util_int.h"
 /*=============================================================================
   Abstract XML Parser Interface
@@ -93,6 +94,83 @@ xml_parse(xmlrpc_env *      const envP,
     */
 
 
+/* Alternatively, you can have the parser tell you about the XML as it goes,
+   without it building any xml_element objects.  You call 'xml_parse_events'
+   with a set of handler functions, and the parser calls them for each
+   element start, element end, and bit of character data, in document order.
+
+   A handler reports a problem by setting a fault in the xmlrpc_env it gets.
+   The parser then calls no more handlers and 'xml_parse_events' fails with
+   that fault.
+*/
+
+typedef void xml_startElementFn(xmlrpc_env * const envP,
+                                void *       const userData,
+                                const char * const name);
+
+typedef void xml_endElementFn(xmlrpc_env * const envP,
+                              void *       const userData);
+
+typedef void xml_characterDataFn(xmlrpc_env * const envP,
+                                 void *       const userData,
+                                 const char * const cdata,
+                                 size_t       const len);
+
+typedef struct {
+    xml_startElementFn *  startElement;
+    xml_endElementFn *    endElement;
+    xml_characterDataFn * characterData;
+} xml_eventHandlers;
+
+void
+xml_parse_events(xmlrpc_env *              const envP,
+                 const char *              const xmlData,
+                 size_t                    const xmlDataLen,
+                 xmlrpc_mem_pool *         const memPoolP,
+                 const xml_eventHandlers * const handlersP,
+                 void *                    const userData);
+    /* Parse the XML text 'xmlData', of length 'xmlDataLen', calling
+       the functions of *handlersP with 'userData' as argument along the way.
+
+       The name and cdata arguments to the handlers are UTF-8 and point to
+       memory owned by the parser, valid only during the call.  Character data
+       may come in several pieces.
+
+       'memPoolP' is as for 'xml_parse'.  But the event parser keeps
+       nothing whose size depends on the document beyond the current piece
+       of it, so it charges nothing to *memPoolP.  What the handlers keep is
+       up to them to charge.
+    */
+
+/* If you don't have the whole XML text at once, you can give it to the
+   parser a piece at a time with an 'xml_eventParser' object instead.  The
+   handlers get called as the pieces arrive.
+*/
+
+typedef struct _xml_eventParser xml_eventParser;
+
+void
+xml_eventParserCreate(xmlrpc_env *              const envP,
+                      xmlrpc_mem_pool *         const memPoolP,
+                      const xml_eventHandlers * const handlersP,
+                      void *                    const userData,
+                      xml_eventParser **        const parserPP);
+
+void
+xml_eventParserDestroy(xml_eventParser * const parserP);
+
+void
+xml_eventParserFeed(xmlrpc_env *      const envP,
+                    xml_eventParser * const parserP,
+                    const char *      const xmlData,
+                    size_t            const xmlDataLen,
+                    bool              const isFinal);
+    /* Parse the next 'xmlDataLen' bytes of the XML text.  'isFinal' means
+       they are the last ones ('xmlDataLen' may be zero).  Fails the same way
+       as 'xml_parse_events'.  Once it has failed, or been called with
+       'isFinal', don't call it again.
+    */
+
 /* Initialize and terminate static global parser state.  This should be done
    once per run of a program, and while the program is just one thread.
 */
@@ -194,9 +194,9 @@ xmlrpc_array_new(xmlrpc_env * const envP) {
     xmlrpc_createXmlrpcValue(envP, &arrayP);
     if (!envP->fault_occurred) {
         arrayP->_type = XMLRPC_TYPE_ARRAY;
-        arrayP->blockP = XMLRPC_MEMBLOCK_NEW(xmlrpc_value *, envP, 0);
+        arrayP->blockP = xmlrpc_valueBlockNew(envP, 0);
         if (envP->fault_occurred)
-            free(arrayP);
+            xmlrpc_freeXmlrpcValue(arrayP);
     }
     return arrayP;
 }
@@ -219,10 +219,10 @@ xmlrpc_array_new_value(xmlrpc_env *   const envP,
         if (!envP->fault_occurred) {
             arrayP->_type = XMLRPC_TYPE_ARRAY;
 
-            arrayP->blockP = XMLRPC_MEMBLOCK_NEW(xmlrpc_value *, envP, 0);
+            arrayP->blockP = xmlrpc_valueBlockNew(envP, 0);
 
             if (envP->fault_occurred)
-                free(arrayP);
+                xmlrpc_freeXmlrpcValue(arrayP);
             else {
                 xmlrpc_value ** const srcValuePList =
                     XMLRPC_MEMBLOCK_CONTENTS(xmlrpc_value *, valueP->blockP);
@@ -242,7 +242,7 @@ xmlrpc_array_new_value(xmlrpc_env *   const envP,
             }
 
             if (envP->fault_occurred)
-                free(arrayP);
+                xmlrpc_freeXmlrpcValue(arrayP);
         }
     }
     return arrayP;
@@ -16,6 +16,7 @@
 #include <errno.h>
 
 #include "bool.h"
+#include "girmath.h"
 #include "mallocvar.h"
 
 #include "xmlrpc-c/base.h"
@@ -285,11 +286,13 @@ getTransportInfo(
     const char **                               const transportNameP,
     struct xportParms *                         const transportParmsP,
     const struct xmlrpc_client_transport_ops ** const transportOpsPP,
+    size_t *                                    const transportOpsSizeP,
     xmlrpc_client_transport **                  const transportPP) {
 
     const char * transportNameParm;
     xmlrpc_client_transport * transportP;
     const struct xmlrpc_client_transport_ops * transportOpsP;
+    size_t transportOpsSize;
 
     if (parmSize < XMLRPC_CPSIZE(transport))
         transportNameParm = NULL;
@@ -306,9 +309,20 @@ getTransportInfo(
     else
         transportOpsP = clientparmsP->transportOpsP;
 
+    if (parmSize < XMLRPC_CPSIZE(transportOps_size))
+        /* Caller predates the members after 'set_interrupt' */
+        transportOpsSize = XMLRPC_XOPSIZE(set_interrupt);
+    else
+        transportOpsSize = clientparmsP->transportOps_size;
+
     if ((transportOpsP && !transportP) || (transportP && ! transportOpsP))
         xmlrpc_faultf(envP, "'transportOpsP' and 'transportP' go together. "
                       "You must specify both or neither");
+    else if (transportOpsP && transportOpsSize < XMLRPC_XOPSIZE(finish_asynch))
+        xmlrpc_faultf(envP, "'transportOps_size' is %u, which is too small "
+                      "for a transport ops structure.  It must be at "
+                      "least %u", (unsigned)transportOpsSize,
+                      (unsigned)XMLRPC_XOPSIZE(finish_asynch));
     else if (transportNameParm && transportP)
         xmlrpc_faultf(envP, "You cannot specify both 'transport' and "
                       "'transportP' transport parameters.");
@@ -319,8 +333,9 @@ getTransportInfo(
     else
         *transportNameP = xmlrpc_client_get_default_transport(envP);
 
-    *transportOpsPP = transportOpsP;
-    *transportPP    = transportP;
+    *transportOpsPP    = transportOpsP;
+    *transportOpsSizeP = transportOpsSize;
+    *transportPP       = transportP;
 
     if (!envP->fault_occurred) {
         getTransportParmsFromClientParms(
@@ -358,11 +373,17 @@ clientCreate(
     xmlrpc_env *                               const envP,
     bool                                       const myTransport,
     const struct xmlrpc_client_transport_ops * const transportOpsP,
+    size_t                                     const transportOpsSize,
     struct xmlrpc_client_transport *           const transportP,
     xmlrpc_dialect                             const dialect,
     xmlrpc_progress_fn *                       const progressFn,
     xmlrpc_client **                           const clientPP) {
-
+/*----------------------------------------------------------------------------
+   'transportOpsSize' is the size of *transportOpsP.  It may be smaller
+   than our struct xmlrpc_client_transport_ops, if the transport was
+   compiled against an older xmlrpc-c/transport.h.  Then the members it
+   doesn't have are NULL in our copy.
+-----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_PTR_OK(transportOpsP);
     XMLRPC_ASSERT_PTR_OK(transportP);
     XMLRPC_ASSERT_PTR_OK(clientPP);
@@ -384,7 +405,9 @@ clientCreate(
                           "client descriptor.");
         else {
             clientP->myTransport  = myTransport;
-            clientP->transportOps = *transportOpsP;
+            memset(&clientP->transportOps, 0, sizeof(clientP->transportOps));
+            memcpy(&clientP->transportOps, transportOpsP,
+                   MIN(transportOpsSize, sizeof(clientP->transportOps)));
             clientP->transportP   = transportP;
             clientP->dialect      = dialect;
             clientP->progressFn   = progressFn;
@@ -423,7 +446,8 @@ createTransportAndClient(
         if (!envP->fault_occurred) {
             bool const myTransportTrue = true;
 
-            clientCreate(envP, myTransportTrue, transportOpsP, transportP,
+            clientCreate(envP, myTransportTrue,
+                         transportOpsP, sizeof(*transportOpsP), transportP,
                          dialect, progressFn, clientPP);
 
             if (envP->fault_occurred)
@@ -457,12 +481,14 @@ xmlrpc_client_create(xmlrpc_env *                      const envP,
         const char * transportName;
         struct xportParms transportparms;
         const struct xmlrpc_client_transport_ops * transportOpsP;
+        size_t transportOpsSize;
         xmlrpc_client_transport * transportP;
         xmlrpc_dialect dialect;
         xmlrpc_progress_fn * progressFn;
 
         getTransportInfo(envP, clientparmsP, parmSize, &transportName,
-                         &transportparms, &transportOpsP, &transportP);
+                         &transportparms, &transportOpsP, &transportOpsSize,
+                         &transportP);
 
         getDialectFromClientParms(clientparmsP, parmSize, &dialect);
 
@@ -480,8 +506,8 @@ xmlrpc_client_create(xmlrpc_env *                      const envP,
             else {
                 bool myTransportFalse = false;
                 clientCreate(envP, myTransportFalse,
-                             transportOpsP, transportP, dialect, progressFn,
-                             clientPP);
+                             transportOpsP, transportOpsSize, transportP,
+                             dialect, progressFn, clientPP);
             }
         }
     }
@@ -936,6 +962,60 @@ xmlrpc_client_event_loop_finish_timeout(xmlrpc_client * const clientP,
 
 
 
+void
+xmlrpc_client_get_pollfds(xmlrpc_env *           const envP,
+                          xmlrpc_client *        const clientP,
+                          struct xmlrpc_pollfd * const pollfds,
+                          unsigned int           const maxCt,
+                          unsigned int *         const pollfdCtP,
+                          int *                  const timeoutMsP) {
+/*----------------------------------------------------------------------------
+   Tell what the client's outstanding asynchronous RPCs are waiting for:
+   the file descriptors in pollfds[], and the time *timeoutMsP milliseconds
+   from now, whichever comes first.  -1 means no time limit.
+
+   We return at most 'maxCt' file descriptors, but return as *pollfdCtP how
+   many there are, so if that is more than 'maxCt', Caller didn't get them
+   all.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(clientP);
+    XMLRPC_ASSERT_PTR_OK(pollfdCtP);
+    XMLRPC_ASSERT_PTR_OK(timeoutMsP);
+
+    if (!clientP->transportOps.get_pollfds)
+        xmlrpc_faultf(envP, "The client's transport can't tell what file "
+                      "descriptors to wait for.  You must use "
+                      "xmlrpc_client_event_loop_finish() instead.");
+    else
+        clientP->transportOps.get_pollfds(envP, clientP->transportP,
+                                          pollfds, maxCt,
+                                          pollfdCtP, timeoutMsP);
+}
+
+
+
+void
+xmlrpc_client_event_loop_perform(xmlrpc_env *    const envP,
+                                 xmlrpc_client * const clientP) {
+/*----------------------------------------------------------------------------
+   Do whatever work for the client's outstanding asynchronous RPCs is ready
+   to be done now, and finish the RPCs that are thereby complete (i.e.
+   call their response handlers).  Don't wait for anything.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT_PTR_OK(clientP);
+
+    if (!clientP->transportOps.perform_asynch)
+        xmlrpc_faultf(envP, "The client's transport can't be driven by "
+                      "an external event loop.  You must use "
+                      "xmlrpc_client_event_loop_finish() instead.");
+    else
+        clientP->transportOps.perform_asynch(envP, clientP->transportP);
+}
+
+
+
 /* Microsoft Visual C in debug mode produces code that complains about
    passing an undefined value of 'resultP' to xmlrpc_parse_response2().
    It's a bogus complaint, because this function knows in those cases
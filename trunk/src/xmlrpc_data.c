@@ -23,11 +23,13 @@
   xmlrpc_value is designed to enable cheap copies by sharing pointers and
   maintaining reference counts.  Multiple threads can use an xmlrpc_value
   simultaneously because there is locking around the reference count
-  manipulation (but only since Xmlrpc-c 1.33).  But there is no copy on
-  write, so the scheme depends upon the user not modifying an xmlrpc_value
-  after building it, and not copying it while building it.  Another reason
-  to observe this sequence is that there is no locking around modifications,
-  so a reader could see a half-updated xmlrpc_value.
+  manipulation (but only since Xmlrpc-c 1.33).  Where the compiler provides
+  atomic operations, that "locking" is just atomic update of the reference
+  count; elsewhere, it is a mutex in each xmlrpc_value.  But there is no
+  copy on write, so the scheme depends upon the user not modifying an
+  xmlrpc_value after building it, and not copying it while building it.
+  Another reason to observe this sequence is that there is no locking
+  around modifications, so a reader could see a half-updated xmlrpc_value.
 
   We could enforce a prohibition against modifying an xmlrpc_value that has
   references other than the one by the party doing the modifying, but we
@@ -101,14 +103,16 @@ destroyValue(xmlrpc_value * const valueP) {
         XMLRPC_ASSERT(false); /* There are no other possible values */
     }
 
+#if !HAVE_ATOMIC_REFCOUNT
     valueP->lockP->destroy(valueP->lockP);
+#endif
 
     /* Next, we mark this value as invalid, to help catch refcount errors.
     */
     valueP->_type = XMLRPC_TYPE_DEAD;
 
     /* Finally, we destroy the value itself. */
-    free(valueP);
+    xmlrpc_freeXmlrpcValue(valueP);
 }
 
 
@@ -125,6 +129,14 @@ xmlrpc_INCREF (xmlrpc_value * const valueP) {
 
     XMLRPC_ASSERT_VALUE_OK(valueP);
 
+#if HAVE_ATOMIC_REFCOUNT
+    XMLRPC_ASSERT(valueP->refcount > 0);
+
+    /* The caller holds a reference, so the value can't die under us, and
+       nothing needs to be ordered against the increment.
+    */
+    __atomic_add_fetch(&valueP->refcount, 1, __ATOMIC_RELAXED);
+#else
     valueP->lockP->acquire(valueP->lockP);
 
     XMLRPC_ASSERT(valueP->refcount > 0);
@@ -132,6 +144,7 @@ xmlrpc_INCREF (xmlrpc_value * const valueP) {
     ++valueP->refcount;
 
     valueP->lockP->release(valueP->lockP);
+#endif
 }
 
 
@@ -143,6 +156,15 @@ xmlrpc_DECREF (xmlrpc_value * const valueP) {
 
     XMLRPC_ASSERT_VALUE_OK(valueP);
 
+#if HAVE_ATOMIC_REFCOUNT
+    XMLRPC_ASSERT(valueP->refcount > 0);
+    XMLRPC_ASSERT(valueP->_type != XMLRPC_TYPE_DEAD);
+
+    /* Release/acquire ordering makes every other thread's use of the value
+       happen before the thread that drops the last reference destroys it.
+    */
+    died = (__atomic_sub_fetch(&valueP->refcount, 1, __ATOMIC_ACQ_REL) == 0);
+#else
     valueP->lockP->acquire(valueP->lockP);
 
     XMLRPC_ASSERT(valueP->refcount > 0);
@@ -153,6 +175,7 @@ xmlrpc_DECREF (xmlrpc_value * const valueP) {
     died = (valueP->refcount == 0);
 
     valueP->lockP->release(valueP->lockP);
+#endif
 
     if (died)
         destroyValue(valueP);
@@ -367,12 +390,29 @@ xmlrpc_createXmlrpcValue(xmlrpc_env *    const envP,
 
    Set the reference count to 1.
 -----------------------------------------------------------------------------*/
+    xmlrpc_mem_pool * const arenaP = xmlrpc_mem_pool_current();
+
     xmlrpc_value * valP;
 
-    MALLOCVAR(valP);
+    if (arenaP) {
+        xmlrpc_env env;
+        xmlrpc_env_init(&env);
+        valP = xmlrpc_mem_pool_get(&env, arenaP, sizeof(*valP));
+        if (env.fault_occurred)
+            valP = NULL;
+        else
+            xmlrpc_mem_pool_ref(arenaP);
+        xmlrpc_env_clean(&env);
+    } else
+        MALLOCVAR(valP);
+
     if (!valP)
         xmlrpc_faultf(envP, "Could not allocate memory for xmlrpc_value");
     else {
+        valP->arenaP = arenaP;
+#if HAVE_ATOMIC_REFCOUNT
+        valP->refcount = 1;
+#else
         valP->lockP = xmlrpc_lock_create();
 
         if (!valP->lockP)
@@ -382,15 +422,49 @@ xmlrpc_createXmlrpcValue(xmlrpc_env *    const envP,
             valP->refcount = 1;
 
         if (envP->fault_occurred) {
-            free(valP);
+            xmlrpc_freeXmlrpcValue(valP);
             valP = NULL;
         }
+#endif
     }
     *valPP = valP;
 }
 
 
 
+void
+xmlrpc_freeXmlrpcValue(xmlrpc_value * const valP) {
+/*----------------------------------------------------------------------------
+   Release the memory of xmlrpc_value *valP, which xmlrpc_createXmlrpcValue()
+   allocated.  Whatever the value contains must already be gone.
+-----------------------------------------------------------------------------*/
+    if (valP->arenaP)
+        xmlrpc_mem_pool_free(valP->arenaP);
+    else
+        free(valP);
+}
+
+
+
+xmlrpc_mem_block *
+xmlrpc_valueBlockNew(xmlrpc_env * const envP,
+                     size_t       const size) {
+/*----------------------------------------------------------------------------
+   Create a memory block of size 'size' to hold the contents of an
+   xmlrpc_value.
+
+   If the thread has a current arena (e.g. we are parsing an XML-RPC
+   message), the block goes in it, like the xmlrpc_value itself.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_pool * const arenaP = xmlrpc_mem_pool_current();
+
+    return arenaP ?
+        xmlrpc_mem_block_new_arena(envP, size, arenaP) :
+        xmlrpc_mem_block_new(envP, size);
+}
+
+
+
 xmlrpc_value *
 xmlrpc_value_new(xmlrpc_env *   const envP,
                  xmlrpc_value * const sourceValP) {
@@ -592,14 +666,39 @@ xmlrpc_base64_new(xmlrpc_env *          const envP,
     if (!envP->fault_occurred) {
         valP->_type = XMLRPC_TYPE_BASE64;
 
-        valP->blockP = xmlrpc_mem_block_new(envP, length);
+        valP->blockP = xmlrpc_valueBlockNew(envP, length);
         if (!envP->fault_occurred) {
             char * const contents =
                 xmlrpc_mem_block_contents(valP->blockP);
             memcpy(contents, value, length);
         }
         if (envP->fault_occurred)
-            free(valP);
+            xmlrpc_freeXmlrpcValue(valP);
+    }
+    return valP;
+}
+
+
+
+xmlrpc_value *
+xmlrpc_base64_new_block(xmlrpc_env *       const envP,
+                        xmlrpc_mem_block * const blockP) {
+/*----------------------------------------------------------------------------
+   Create a base64 xmlrpc_value whose bytes are the contents of *blockP.
+
+   The value takes over *blockP, even if we fail.  This saves copying the
+   bytes when Caller made them just for the value, as the XML-RPC parser
+   does.
+-----------------------------------------------------------------------------*/
+    xmlrpc_value * valP;
+
+    xmlrpc_createXmlrpcValue(envP, &valP);
+
+    if (envP->fault_occurred)
+        xmlrpc_mem_block_free(blockP);
+    else {
+        valP->_type  = XMLRPC_TYPE_BASE64;
+        valP->blockP = blockP;
     }
     return valP;
 }
@@ -9,6 +9,7 @@
 #include <xmlparse.h> /* Expat */
 
 #include "bool.h"
+#include "mallocvar.h"
 
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
@@ -520,6 +521,182 @@ xml_parse(xmlrpc_env *      const envP,
 }
 
 
+
+/*=============================================================================
+  Event-driven parsing
+
+  This is the implementation of xml_eventParser and xml_parse_events():
+  the Expat handlers just pass the events on to the user's handlers.
+=============================================================================*/
+
+struct _xml_eventParser {
+/*----------------------------------------------------------------------------
+   An event-driven parse.  We pass this around as expat user data.
+-----------------------------------------------------------------------------*/
+    XML_Parser                parser;
+    xmlrpc_env                env;
+        /* Failure of a user handler.  Once this indicates failure, we don't
+           call any more user handlers.
+        */
+    const xml_eventHandlers * handlersP;
+    void *                    userData;
+};
+
+
+
+static void
+startElementEvent(void *      const userData,
+                  XML_Char *  const name,
+                  XML_Char ** const atts ATTR_UNUSED) {
+
+    xml_eventParser * const parserP = userData;
+
+    XMLRPC_ASSERT(name != NULL);
+
+    if (!parserP->env.fault_occurred)
+        parserP->handlersP->startElement(&parserP->env, parserP->userData,
+                                         name);
+}
+
+
+
+static void
+endElementEvent(void *     const userData,
+                XML_Char * const name ATTR_UNUSED) {
+
+    xml_eventParser * const parserP = userData;
+
+    if (!parserP->env.fault_occurred)
+        parserP->handlersP->endElement(&parserP->env, parserP->userData);
+}
+
+
+
+static void
+characterDataEvent(void *     const userData,
+                   XML_Char * const s,
+                   int        const len) {
+
+    xml_eventParser * const parserP = userData;
+
+    XMLRPC_ASSERT(s != NULL);
+    XMLRPC_ASSERT(len >= 0);
+
+    if (!parserP->env.fault_occurred)
+        parserP->handlersP->characterData(&parserP->env, parserP->userData,
+                                          s, len);
+}
+
+
+
+void
+xml_eventParserCreate(xmlrpc_env *              const envP,
+                      xmlrpc_mem_pool *         const memPoolP ATTR_UNUSED,
+                      const xml_eventHandlers * const handlersP,
+                      void *                    const userData,
+                      xml_eventParser **        const parserPP) {
+/*----------------------------------------------------------------------------
+  This is an implementation of the interface declared in xmlparser.h.  This
+  implementation uses Xmlrpc-c's private fork of Expat.
+-----------------------------------------------------------------------------*/
+    xml_eventParser * parserP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    MALLOCVAR(parserP);
+
+    if (parserP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for XML parser");
+    else {
+        parserP->parser = xmlrpc_XML_ParserCreate(NULL);
+
+        if (parserP->parser == NULL)
+            xmlrpc_faultf(envP, "Could not create expat parser");
+        else {
+            xmlrpc_env_init(&parserP->env);
+            parserP->handlersP = handlersP;
+            parserP->userData  = userData;
+
+            xmlrpc_XML_SetUserData(parserP->parser, parserP);
+            xmlrpc_XML_SetElementHandler(
+                parserP->parser,
+                (XML_StartElementHandler) startElementEvent,
+                (XML_EndElementHandler) endElementEvent);
+            xmlrpc_XML_SetCharacterDataHandler(
+                parserP->parser,
+                (XML_CharacterDataHandler) characterDataEvent);
+        }
+        if (envP->fault_occurred)
+            free(parserP);
+        else
+            *parserPP = parserP;
+    }
+}
+
+
+
+void
+xml_eventParserDestroy(xml_eventParser * const parserP) {
+
+    xmlrpc_env_clean(&parserP->env);
+    xmlrpc_XML_ParserFree(parserP->parser);
+
+    free(parserP);
+}
+
+
+
+void
+xml_eventParserFeed(xmlrpc_env *      const envP,
+                    xml_eventParser * const parserP,
+                    const char *      const xmlData,
+                    size_t            const xmlDataLen,
+                    bool              const isFinal) {
+
+    bool ok;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(xmlData != NULL || xmlDataLen == 0);
+
+    ok = xmlrpc_XML_Parse(parserP->parser, xmlData, xmlDataLen, isFinal);
+
+    if (parserP->env.fault_occurred)
+        xmlrpc_env_set_fault(envP, parserP->env.fault_code,
+                             parserP->env.fault_string);
+    else if (!ok)
+        xmlrpc_env_set_fault(
+            envP, XMLRPC_PARSE_ERROR,
+            xmlrpc_XML_GetErrorString(parserP->parser));
+}
+
+
+
+void
+xml_parse_events(xmlrpc_env *              const envP,
+                 const char *              const xmlData,
+                 size_t                    const xmlDataLen,
+                 xmlrpc_mem_pool *         const memPoolP,
+                 const xml_eventHandlers * const handlersP,
+                 void *                    const userData) {
+/*----------------------------------------------------------------------------
+  This is an implementation of the interface declared in xmlparser.h.  This
+  implementation uses Xmlrpc-c's private fork of Expat.
+-----------------------------------------------------------------------------*/
+    xml_eventParser * parserP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(xmlData != NULL);
+
+    xml_eventParserCreate(envP, memPoolP, handlersP, userData, &parserP);
+
+    if (!envP->fault_occurred) {
+        xml_eventParserFeed(envP, parserP, xmlData, xmlDataLen, true);
+
+        xml_eventParserDestroy(parserP);
+    }
+}
+
+
 /* Copyright (C) 2001 by First Peer, Inc. All rights reserved.
 **
 ** Redistribution and use in source and binary forms, with or without
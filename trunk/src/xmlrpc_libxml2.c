@@ -517,3 +517,212 @@ xml_parse(xmlrpc_env *      const envP,
 
 
 
+/*=========================================================================
+**  Event-driven parsing
+**=========================================================================
+**  This is the implementation of xml_eventParser and xml_parse_events():
+**  the LibXML handlers just pass the events on to the user's handlers.
+*/
+
+struct _xml_eventParser {
+    xmlParserCtxt *           parserP;
+    xmlrpc_env                env;
+        /* Failure of a user handler.  Once this indicates failure, we don't
+           call any more user handlers.
+        */
+    const xml_eventHandlers * handlersP;
+    void *                    userData;
+};
+
+
+
+static void
+startElementEvent(void *           const userData,
+                  const xmlChar *  const name,
+                  const xmlChar ** const attrs ATTR_UNUSED) {
+
+    xml_eventParser * const eventParserP = userData;
+
+    assert(name != NULL);
+
+    if (!eventParserP->env.fault_occurred)
+        eventParserP->handlersP->startElement(
+            &eventParserP->env, eventParserP->userData, (const char *)name);
+}
+
+
+
+static void
+endElementEvent(void *          const userData,
+                const xmlChar * const name ATTR_UNUSED) {
+
+    xml_eventParser * const eventParserP = userData;
+
+    if (!eventParserP->env.fault_occurred)
+        eventParserP->handlersP->endElement(
+            &eventParserP->env, eventParserP->userData);
+}
+
+
+
+static void
+characterDataEvent(void *          const userData,
+                   const xmlChar * const s,
+                   int             const len) {
+
+    xml_eventParser * const eventParserP = userData;
+
+    assert(s != NULL);
+
+    if (!eventParserP->env.fault_occurred)
+        eventParserP->handlersP->characterData(
+            &eventParserP->env, eventParserP->userData, (const char *)s, len);
+}
+
+
+
+static xmlSAXHandler const eventSaxHandler = {
+    NULL,      /* internalSubset */
+    NULL,      /* isStandalone */
+    NULL,      /* hasInternalSubset */
+    NULL,      /* hasExternalSubset */
+    NULL,      /* resolveEntity */
+    NULL,      /* getEntity */
+    NULL,      /* entityDecl */
+    NULL,      /* notationDecl */
+    NULL,      /* attributeDecl */
+    NULL,      /* elementDecl */
+    NULL,      /* unparsedEntityDecl */
+    NULL,      /* setDocumentLocator */
+    NULL,      /* startDocument */
+    NULL,      /* endDocument */
+    startElementEvent,   /* startElement */
+    endElementEvent,     /* endElement */
+    NULL,      /* reference */
+    characterDataEvent,  /* characters */
+    NULL,      /* ignorableWhitespace */
+    NULL,      /* processingInstruction */
+    NULL,      /* comment */
+    NULL,      /* warning */
+    NULL,      /* error */
+    NULL,      /* fatalError */
+    NULL,      /* getParameterEntity */
+    NULL,      /* cdataBlock */
+    NULL,      /* externalSubset */
+    1          /* initialized */
+
+    ,NULL,     /* _private */
+    NULL,      /* startElementNs */
+    NULL,      /* endElementNs */
+    NULL       /* serror */
+};
+
+
+
+void
+xml_eventParserCreate(xmlrpc_env *              const envP,
+                      xmlrpc_mem_pool *         const memPoolP ATTR_UNUSED,
+                      const xml_eventHandlers * const handlersP,
+                      void *                    const userData,
+                      xml_eventParser **        const eventParserPP) {
+/*----------------------------------------------------------------------------
+  This is an implementation of the interface declared in xmlparser.h.  This
+  implementation uses Libxml2.
+-----------------------------------------------------------------------------*/
+    xml_eventParser * eventParserP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+
+    MALLOCVAR(eventParserP);
+
+    if (eventParserP == NULL)
+        xmlrpc_faultf(envP, "Could not allocate memory for XML parser");
+    else {
+        eventParserP->parserP =
+            xmlCreatePushParserCtxt((xmlSAXHandler *)&eventSaxHandler,
+                                    eventParserP, NULL, 0, NULL);
+
+        if (!eventParserP->parserP)
+            xmlrpc_faultf(envP, "Failed to create libxml2 parser.");
+        else {
+            removeDocSizeLimit(eventParserP->parserP);
+
+            xmlrpc_env_init(&eventParserP->env);
+            eventParserP->handlersP = handlersP;
+            eventParserP->userData  = userData;
+        }
+        if (envP->fault_occurred)
+            free(eventParserP);
+        else
+            *eventParserPP = eventParserP;
+    }
+}
+
+
+
+void
+xml_eventParserDestroy(xml_eventParser * const eventParserP) {
+
+    xmlrpc_env_clean(&eventParserP->env);
+
+    if (eventParserP->parserP->myDoc)
+        xmlFreeDoc(eventParserP->parserP->myDoc);
+    xmlFreeParserCtxt(eventParserP->parserP);
+
+    free(eventParserP);
+}
+
+
+
+void
+xml_eventParserFeed(xmlrpc_env *      const envP,
+                    xml_eventParser * const eventParserP,
+                    const char *      const xmlData,
+                    size_t            const xmlDataLen,
+                    bool              const isFinal) {
+
+    int rc;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    assert(xmlData != NULL || xmlDataLen == 0);
+
+    rc = xmlParseChunk(eventParserP->parserP, xmlData, xmlDataLen, isFinal);
+
+    if (eventParserP->env.fault_occurred)
+        xmlrpc_env_set_fault(envP, eventParserP->env.fault_code,
+                             eventParserP->env.fault_string);
+    else if (rc != 0)
+        xmlrpc_env_set_fault(envP, XMLRPC_PARSE_ERROR,
+                             "XML parsing failed");
+}
+
+
+
+void
+xml_parse_events(xmlrpc_env *              const envP,
+                 const char *              const xmlData,
+                 size_t                    const xmlDataLen,
+                 xmlrpc_mem_pool *         const memPoolP,
+                 const xml_eventHandlers * const handlersP,
+                 void *                    const userData) {
+/*----------------------------------------------------------------------------
+  This is an implementation of the interface declared in xmlparser.h.  This
+  implementation uses Libxml2.
+-----------------------------------------------------------------------------*/
+    xml_eventParser * eventParserP;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    assert(xmlData != NULL);
+
+    xml_eventParserCreate(envP, memPoolP, handlersP, userData,
+                          &eventParserP);
+
+    if (!envP->fault_occurred) {
+        xml_eventParserFeed(envP, eventParserP, xmlData, xmlDataLen, true);
+
+        xml_eventParserDestroy(eventParserP);
+    }
+}
+
+
+
@@ -18,8 +18,7 @@
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
 #include "xmlrpc-c/util.h"
-#include "xmlparser.h"
-#include "parse_value.h"
+#include "parse_stream.h"
 
 #include "xmlrpc_parse.h"
 
@@ -32,8 +31,8 @@
    We also try *very* hard to handle malicious data gracefully, and without
    leaking memory.
 
-   The CHECK_NAME and CHECK_CHILD_COUNT macros examine an XML element, and
-   invoke XMLRPC_FAIL if something looks wrong.
+   The structure of the document gets validated as it gets parsed; see
+   parse_stream.c.
 */
 
 static void
@@ -49,242 +48,12 @@ setParseFault(xmlrpc_env * const envP,
 
 
 
-static void
-validateName(xmlrpc_env *        const envP,
-             const xml_element * const elemP,
-             const char *        const name) {
-
-    if (!xmlrpc_streq(name, xml_element_name(elemP)))
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR,
-            "Expected element of type <%s>, found <%s>",
-            name, xml_element_name(elemP));
-}
-
-
-
-static void
-validateChildCount(xmlrpc_env *        const envP,
-                   const xml_element * const elemP,
-                   unsigned int        const requiredCount) {
-
-    if (xml_element_children_size(elemP) != requiredCount)
-        xmlrpc_env_set_fault_formatted(
-            envP, XMLRPC_PARSE_ERROR,
-            "Expected <%s> to have %u children, found %u",
-            xml_element_name(elemP), requiredCount,
-            (unsigned)xml_element_children_size(elemP));
-}
-
-
-
-static xml_element *
-getChildByName (xmlrpc_env *  const envP,
-                xml_element * const parentP,
-                const char *  const name) {
-
-    size_t const childCount = xml_element_children_size(parentP);
-    xml_element ** const childrenP = xml_element_children(parentP);
-
-    unsigned int i;
-
-    for (i = 0; i < childCount; ++i) {
-        if (xmlrpc_streq(xml_element_name(childrenP[i]), name))
-            return childrenP[i];
-    }
-
-    setParseFault(envP, "Expected <%s> to have child <%s>",
-                  xml_element_name(parentP), name);
-    return NULL;
-}
-
-
-
-static xmlrpc_value *
-convertParams(xmlrpc_env *        const envP,
-              const xml_element * const elemP) {
-/*----------------------------------------------------------------------------
-   Convert an XML element representing a list of parameters (i.e.  a <params>
-   element) to an xmlrpc_value of type array.  Note that an xmlrpc_value is
-   normally represented in XML by a <value> element, not a <params> element.
-   We use type xmlrpc_value to represent the parameter list just for
-   convenience.
------------------------------------------------------------------------------*/
-    xmlrpc_value * arrayP;
-    xmlrpc_value * itemP;
-
-    XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT(elemP != NULL);
-
-    /* Allocate an array to hold our parameters. */
-    arrayP = xmlrpc_array_new(envP);
-    if (!envP->fault_occurred) {
-        /* We're responsible for checking our own element name. */
-        validateName(envP, elemP, "params");
-
-        if (!envP->fault_occurred) {
-            /* Iterate over our children. */
-            unsigned int const size = xml_element_children_size(elemP);
-            xml_element ** const paramPList = xml_element_children(elemP);
-
-            unsigned int i;
-
-            for (i = 0; i < size; ++i) {
-                xml_element * const paramP = paramPList[i];
-                unsigned int const maxNest = (unsigned int)
-                    xmlrpc_limit_get(XMLRPC_NESTING_LIMIT_ID);
-
-                validateName(envP, paramP, "param");
-                if (!envP->fault_occurred) {
-                    validateChildCount(envP, paramP, 1);
-                    if (!envP->fault_occurred) {
-                        xml_element * const valueEltP =
-                            xml_element_children(paramP)[0];
-
-                        validateName(envP, valueEltP, "value");
-
-                        if (!envP->fault_occurred) {
-                            xmlrpc_parseValue(envP, maxNest, valueEltP,
-                                              &itemP);
-                            if (!envP->fault_occurred) {
-                                xmlrpc_array_append_item(envP, arrayP, itemP);
-                                xmlrpc_DECREF(itemP);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        if (envP->fault_occurred)
-            xmlrpc_DECREF(arrayP);
-    }
-    return arrayP;
-}
-
-
-
-static void
-parseCallXml(xmlrpc_env *      const envP,
-             const char *      const xmlData,
-             size_t            const xmlDataLen,
-             xmlrpc_mem_pool * const memPoolP,
-             xml_element **    const callElemPP) {
-/*----------------------------------------------------------------------------
-   Parse the XML of an XML-RPC call.
------------------------------------------------------------------------------*/
-    xml_element * callElemP;
-    xmlrpc_env env;
-
-    xmlrpc_env_init(&env);
-    xml_parse(&env, xmlData, xmlDataLen, memPoolP, &callElemP);
-    if (env.fault_occurred)
-        xmlrpc_env_set_fault_formatted(
-            envP, env.fault_code, "Call is not valid XML.  %s",
-            env.fault_string);
-    else {
-        if (!xmlrpc_streq(xml_element_name(callElemP), "methodCall"))
-            setParseFault(envP,
-                          "XML-RPC call should be a <methodCall> element.  "
-                          "Instead, we have a <%s> element.",
-                          xml_element_name(callElemP));
-
-        if (envP->fault_occurred)
-            xml_element_free(callElemP);
-    }
-    *callElemPP = callElemP;
-
-    xmlrpc_env_clean(&env);
-}
-
-
-
-static void
-parseMethodNameElement(xmlrpc_env *  const envP,
-                       xml_element * const nameElemP,
-                       const char ** const methodNameP) {
-
-    XMLRPC_ASSERT(xmlrpc_streq(xml_element_name(nameElemP), "methodName"));
-
-    if (xml_element_children_size(nameElemP) > 0)
-        setParseFault(envP, "A <methodName> element should not have "
-                      "children.  This one has %u of them.",
-                      xml_element_children_size(nameElemP));
-    else {
-        const char * const cdata = xml_element_cdata(nameElemP);
-
-        xmlrpc_validate_utf8(envP, cdata, strlen(cdata));
-
-        if (!envP->fault_occurred) {
-            *methodNameP = strdup(cdata);
-            if (*methodNameP == NULL)
-                xmlrpc_faultf(envP,
-                              "Could not allocate memory for method name");
-        }
-    }
-}
-
-
-
-static void
-parseCallChildren(xmlrpc_env *      const envP,
-                  xml_element *     const callElemP,
-                  const char **     const methodNameP,
-                  xmlrpc_value **   const paramArrayPP ) {
-/*----------------------------------------------------------------------------
-  Parse the children of a <methodCall> XML element *callElemP.  They should
-  be <methodName> and <params>.
------------------------------------------------------------------------------*/
-    size_t const callChildCount = xml_element_children_size(callElemP);
-
-    xml_element * nameElemP;
-
-    XMLRPC_ASSERT(xmlrpc_streq(xml_element_name(callElemP), "methodCall"));
-
-    nameElemP = getChildByName(envP, callElemP, "methodName");
-
-    if (!envP->fault_occurred) {
-        parseMethodNameElement(envP, nameElemP, methodNameP);
-
-        if (!envP->fault_occurred) {
-            /* Convert our parameters. */
-            if (callChildCount > 1) {
-                xml_element * paramsElemP;
-
-                paramsElemP = getChildByName(envP, callElemP, "params");
-
-                if (!envP->fault_occurred)
-                    *paramArrayPP = convertParams(envP, paramsElemP);
-            } else {
-                /* Workaround for Ruby XML-RPC and old versions of
-                   xmlrpc-epi.  Future improvement: Instead of looking
-                   at child count, we should just check for existence
-                   of <params>.
-                */
-                *paramArrayPP = xmlrpc_array_new(envP);
-            }
-            if (!envP->fault_occurred) {
-                if (callChildCount > 2)
-                    setParseFault(envP, "<methodCall> has extraneous "
-                                  "children, other than <methodName> and "
-                                  "<params>.  Total child count = %u",
-                                  callChildCount);
-
-                if (envP->fault_occurred)
-                    xmlrpc_DECREF(*paramArrayPP);
-            }
-            if (envP->fault_occurred)
-                xmlrpc_strfree(*methodNameP);
-        }
-    }
-}
-
-
-
 void
 xmlrpc_parse_call2(xmlrpc_env *      const envP,
                    const char *      const xmlData,
                    size_t            const xmlDataLen,
                    xmlrpc_mem_pool * const memPoolP,
+                   bool              const inArena,
                    const char **     const methodNameP,
                    xmlrpc_value **   const paramArrayPP) {
 /*----------------------------------------------------------------------------
@@ -292,6 +61,9 @@ xmlrpc_parse_call2(xmlrpc_env *      const envP,
   Return as *methodNameP the name of the method identified in the call
   and as *paramArrayPP the parameter list as an XML-RPC array.
   Caller must free() and xmlrpc_DECREF() these, respectively).
+
+  'inArena' is as for xmlrpc_parseCallStream(): true only if the parameters
+  won't outlive the call.
 -----------------------------------------------------------------------------*/
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(xmlData != NULL);
@@ -307,15 +79,10 @@ xmlrpc_parse_call2(xmlrpc_env *      const envP,
             envP, XMLRPC_LIMIT_EXCEEDED_ERROR,
             "XML-RPC request too large.  Max allowed is %u bytes",
             (unsigned)xmlrpc_limit_get(XMLRPC_XML_SIZE_LIMIT_ID));
-    else {
-        xml_element * callElemP;
-        parseCallXml(envP, xmlData, xmlDataLen, memPoolP, &callElemP);
-        if (!envP->fault_occurred) {
-            parseCallChildren(envP, callElemP, methodNameP, paramArrayPP);
+    else
+        xmlrpc_parseCallStream(envP, xmlData, xmlDataLen, memPoolP, inArena,
+                               methodNameP, paramArrayPP);
 
-            xml_element_free(callElemP);
-        }
-    }
     if (envP->fault_occurred) {
         /* Should not be necessary, but for backward compatibility: */
         *methodNameP  = NULL;
@@ -332,12 +99,11 @@ xmlrpc_parse_call(xmlrpc_env *    const envP,
                   const char **   const methodNameP,
                   xmlrpc_value ** const paramArrayPP) {
 
-    xmlrpc_parse_call2(envP, xmlData, xmlDataLen, NULL,
+    xmlrpc_parse_call2(envP, xmlData, xmlDataLen, NULL, false,
                        methodNameP, paramArrayPP);
 }
 
 
-
 static void
 interpretFaultCode(xmlrpc_env *   const envP,
                    xmlrpc_value * const faultCodeVP,
@@ -419,140 +185,32 @@ interpretFaultValue(xmlrpc_env *   const envP,
 
 
 static void
-parseFaultElement(xmlrpc_env *        const envP,
-                  const xml_element * const faultElement,
-                  int *               const faultCodeP,
-                  const char **       const faultStringP) {
-
-    unsigned int const maxRecursion = (unsigned int)
-        xmlrpc_limit_get(XMLRPC_NESTING_LIMIT_ID);
-
-    XMLRPC_ASSERT(xmlrpc_streq(xml_element_name(faultElement), "fault"));
-
-    if (xml_element_children_size(faultElement) != 1)
-        setParseFault(envP, "<fault> element should have 1 child, "
-                      "but it has %u.",
-                      xml_element_children_size(faultElement));
-    else {
-        xml_element * const faultValueP =
-            xml_element_children(faultElement)[0];
-        const char * const elemName = xml_element_name(faultValueP);
-
-        if (!xmlrpc_streq(elemName, "value"))
-            setParseFault(envP,
-                          "<fault> contains a <%s> element.  "
-                          "Only <value> makes sense.",
-                          elemName);
-        else {
-            xmlrpc_value * faultVP;
-
-            xmlrpc_parseValue(envP, maxRecursion, faultValueP, &faultVP);
-
-            if (!envP->fault_occurred) {
-                interpretFaultValue(envP, faultVP, faultCodeP, faultStringP);
-
-                xmlrpc_DECREF(faultVP);
-            }
-        }
-    }
-}
-
-
-
-static void
-parseParamsElement(xmlrpc_env *        const envP,
-                   const xml_element * const paramsElementP,
-                   xmlrpc_value **     const resultPP) {
-
-    xmlrpc_value * paramsVP;
-    xmlrpc_env env;
-
-    xmlrpc_env_init(&env);
-
-    XMLRPC_ASSERT(xmlrpc_streq(xml_element_name(paramsElementP), "params"));
-
-    paramsVP = convertParams(envP, paramsElementP);
-
-    if (!envP->fault_occurred) {
-        int arraySize;
-        xmlrpc_env sizeEnv;
-
-        XMLRPC_ASSERT_ARRAY_OK(paramsVP);
-
-        xmlrpc_env_init(&sizeEnv);
-
-        arraySize = xmlrpc_array_size(&sizeEnv, paramsVP);
-        /* Since it's a valid array, as asserted above, can't fail */
-        XMLRPC_ASSERT(!sizeEnv.fault_occurred);
-
-        if (arraySize != 1)
-            setParseFault(envP, "Contains %d items.  It should have 1.",
-                          arraySize);
-        else {
-            xmlrpc_array_read_item(envP, paramsVP, 0, resultPP);
-        }
-        xmlrpc_DECREF(paramsVP);
-        xmlrpc_env_clean(&sizeEnv);
-    }
-    if (env.fault_occurred)
-        xmlrpc_env_set_fault_formatted(
-            envP, env.fault_code,
-            "Invalid <params> element.  %s", env.fault_string);
-
-    xmlrpc_env_clean(&env);
-}
-
-
-
-static void
-parseMethodResponseElt(xmlrpc_env *        const envP,
-                       const xml_element * const methodResponseEltP,
-                       xmlrpc_value **     const resultPP,
-                       int *               const faultCodeP,
-                       const char **       const faultStringP) {
-
-    XMLRPC_ASSERT(xmlrpc_streq(xml_element_name(methodResponseEltP),
-                               "methodResponse"));
-
-    if (xml_element_children_size(methodResponseEltP) == 1) {
-        xml_element * const child =
-            xml_element_children(methodResponseEltP)[0];
-
-        if (xmlrpc_streq(xml_element_name(child), "params")) {
-            /* It's a successful response */
-            parseParamsElement(envP, child, resultPP);
-            *faultStringP = NULL;
-        } else if (xmlrpc_streq(xml_element_name(child), "fault")) {
-            /* It's a failure response */
-            parseFaultElement(envP, child, faultCodeP, faultStringP);
-        } else
-            setParseFault(envP,
-                          "<methodResponse> must contain <params> or <fault>, "
-                          "but contains <%s>.", xml_element_name(child));
-    } else
-        setParseFault(envP,
-                      "<methodResponse> has %u children, should have 1.",
-                      xml_element_children_size(methodResponseEltP));
-}
-
+interpretParams(xmlrpc_env *    const envP,
+                xmlrpc_value *  const paramsVP,
+                xmlrpc_value ** const resultPP) {
+/*----------------------------------------------------------------------------
+   Get the result of an RPC from the array 'paramsVP' of the values in the
+   <params> element of a response.
+-----------------------------------------------------------------------------*/
+    int arraySize;
+    xmlrpc_env sizeEnv;
 
+    XMLRPC_ASSERT_ARRAY_OK(paramsVP);
 
-static void
-parseResponseXml(xmlrpc_env *      const envP,
-                 const char *      const xmlData,
-                 size_t            const xmlDataLen,
-                 xmlrpc_mem_pool * const memPoolP,
-                 xml_element **    const responseEltPP) {
+    xmlrpc_env_init(&sizeEnv);
 
-    xmlrpc_env env;
-    xmlrpc_env_init(&env);
+    arraySize = xmlrpc_array_size(&sizeEnv, paramsVP);
+    /* Since it's a valid array, as asserted above, can't fail */
+    XMLRPC_ASSERT(!sizeEnv.fault_occurred);
 
-    xml_parse(&env, xmlData, xmlDataLen, memPoolP, responseEltPP);
+    if (arraySize != 1)
+        setParseFault(envP, "Invalid <params> element.  "
+                      "Contains %d items.  It should have 1.",
+                      arraySize);
+    else
+        xmlrpc_array_read_item(envP, paramsVP, 0, resultPP);
 
-    if (env.fault_occurred)
-        setParseFault(envP, "Not valid XML.  %s", env.fault_string);
-
-    xmlrpc_env_clean(&env);
+    xmlrpc_env_clean(&sizeEnv);
 }
 
 
@@ -594,21 +252,25 @@ xmlrpc_parse_response3(xmlrpc_env *      const envP,
             (unsigned)xmlrpc_limit_get(XMLRPC_XML_SIZE_LIMIT_ID),
             (unsigned)xmlDataLen);
     else {
-        xml_element * responseEltP;
-        parseResponseXml(envP, xmlData, xmlDataLen, memPoolP, &responseEltP);
+        xmlrpc_value * paramsVP;
+        xmlrpc_value * faultVP;
+
+        xmlrpc_parseResponseStream(envP, xmlData, xmlDataLen, memPoolP,
+                                   &paramsVP, &faultVP);
 
         if (!envP->fault_occurred) {
-            if (xmlrpc_streq(xml_element_name(responseEltP),
-                             "methodResponse")) {
-                parseMethodResponseElt(envP, responseEltP,
-                                       resultPP, faultCodeP, faultStringP);
-            } else
-                setParseFault(envP, "XML-RPC response must consist of a "
-                              "<methodResponse> element.  "
-                              "This has a <%s> instead.",
-                              xml_element_name(responseEltP));
-
-            xml_element_free(responseEltP);
+            if (paramsVP) {
+                /* It's a successful response */
+                interpretParams(envP, paramsVP, resultPP);
+                *faultStringP = NULL;
+
+                xmlrpc_DECREF(paramsVP);
+            } else {
+                /* It's a failure response */
+                interpretFaultValue(envP, faultVP, faultCodeP, faultStringP);
+
+                xmlrpc_DECREF(faultVP);
+            }
         }
     }
 }
@@ -676,10 +338,6 @@ xmlrpc_parse_value_xml2(xmlrpc_env *      const envP,
    length 'xmlDataLen' characters), which must consist of a single <value>
    element.  Return that xmlrpc_value.
 
-   We call convert_array() and convert_struct(), which may ultimately
-   call us recursively.  Don't recurse any more than 'maxRecursion'
-   times.
-
    This isn't generally useful in XML-RPC programs, because such programs
    parse a whole XML-RPC call or response document, and never see the XML text
    of just a <value> element.  But a program may do some weird form of XML-RPC
@@ -688,31 +346,10 @@ xmlrpc_parse_value_xml2(xmlrpc_env *      const envP,
    inverse of xmlrpc_serialize_value2(), which generates XML text from an
    xmlrpc_value.
 -----------------------------------------------------------------------------*/
-    xmlrpc_env env;
-
-    xml_element * valueEltP;
-
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(xmlData != NULL);
 
-    xmlrpc_env_init(&env);
-
-    xml_parse(&env, xmlData, xmlDataLen, memPoolP, &valueEltP);
-
-    if (env.fault_occurred) {
-        setParseFault(envP, "Not valid XML.  %s", env.fault_string);
-    } else {
-        if (xmlrpc_streq(xml_element_name(valueEltP), "value")) {
-            unsigned int const maxRecursion = (unsigned int)
-                xmlrpc_limit_get(XMLRPC_NESTING_LIMIT_ID);
-            xmlrpc_parseValue(envP, maxRecursion, valueEltP, valuePP);
-        } else
-            setParseFault(envP, "XML-RPC value XML document must consist of "
-                          "a <value> element.  This has a <%s> instead.",
-                          xml_element_name(valueEltP));
-        xml_element_free(valueEltP);
-    }
-    xmlrpc_env_clean(&env);
+    xmlrpc_parseValueStream(envP, xmlData, xmlDataLen, memPoolP, valuePP);
 }
 
 
@@ -13,13 +13,17 @@
   which is an internal concept we don't feel like making external right now.
 =============================================================================*/
 
+#include "bool.h"
 #include "xmlrpc-c/util_int.h"
+#include "xmlrpc-c/base_int.h"
 
+XMLRPC_LIBINT_EXPORTED
 void 
 xmlrpc_parse_call2(xmlrpc_env *      const envP,
                    const char *      const xmlData,
                    size_t            const xmlDataLen,
                    xmlrpc_mem_pool * const memPoolP,
+                   bool              const inArena,
                    const char **     const methodNameP,
                    xmlrpc_value **   const paramArrayPP);
 
@@ -18,11 +18,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
+#if HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include "int.h"
+#include "girmath.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/base_int.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/base64_int.h"
 #include "double.h"
 
 #define CRLF "\015\012"
@@ -30,6 +35,27 @@
 #define APACHE_URL "http://ws.apache.org/xmlrpc/namespaces/extensions"
 #define XMLNS_APACHE "xmlns:ex=\"" APACHE_URL "\""
 
+#define BASE64_LINE_BIN 57
+    /* Bytes of binary data per line of base64, as
+       xmlrpc_base64EncodeAppend() breaks it up
+    */
+
+typedef struct {
+/*----------------------------------------------------------------------------
+   Where the XML we generate goes.
+-----------------------------------------------------------------------------*/
+    xmlrpc_mem_block *        blockP;
+        /* The XML accumulates here */
+    xmlrpc_serializeFlushFn * flush;
+        /* Function to call to take the XML out of *blockP when it gets to
+           'flushSize' bytes.  NULL means never; all the XML stays in
+           *blockP.
+        */
+    size_t                    flushSize;
+    void *                    flushArg;
+        /* Argument for 'flush' */
+} outSink;
+
 
 static void
 addString(xmlrpc_env *       const envP,
@@ -85,6 +111,25 @@ formatOut(xmlrpc_env *       const envP,
 
 
 
+static void
+maybeFlush(xmlrpc_env * const envP,
+           outSink *    const sinkP) {
+/*----------------------------------------------------------------------------
+   Flush the sink *sinkP if it has as much XML in it as it is supposed to
+   hold.
+
+   We get called only at points where the XML so far is a reasonable thing
+   to send, not e.g. halfway through an element name, but that's just
+   politeness; the XML is all the same to the receiver no matter how it is
+   divided.
+-----------------------------------------------------------------------------*/
+    if (sinkP->flush &&
+        XMLRPC_MEMBLOCK_SIZE(char, sinkP->blockP) >= sinkP->flushSize)
+        sinkP->flush(envP, sinkP->flushArg, sinkP->blockP);
+}
+
+
+
 static void
 assertValidUtf8(const char * const str ATTR_UNUSED,
                 size_t       const len ATTR_UNUSED) {
@@ -109,47 +154,153 @@ assertValidUtf8(const char * const str ATTR_UNUSED,
 
 
 
+/* The kernel of XML escaping is finding the next character that needs
+   escaping.  Most strings have long runs of characters that don't, and we
+   copy those runs wholesale.  Where the CPU has vector instructions, we use
+   them to look at 16 or 32 characters at a time.
+*/
+
+typedef size_t CleanRunFn(const char * const chars,
+                          size_t       const len);
+
+
+
+static bool
+needsEscape(char const c) {
+
+    return c == '<' || c == '>' || c == '&' || c == '\r';
+}
+
+
+
+static size_t
+cleanRunScalar(const char * const chars,
+               size_t       const len) {
+/*----------------------------------------------------------------------------
+   The number of characters at the start of chars[] that don't need escaping.
+-----------------------------------------------------------------------------*/
+    size_t i;
+
+    for (i = 0; i < len && !needsEscape(chars[i]); ++i);
+
+    return i;
+}
+
+
+
+#if HAVE_X86_SIMD
+
 static size_t
-escapedSize(const char * const chars,
-            size_t       const len) {
+cleanRunSse2(const char * const chars,
+             size_t       const len) {
+/*----------------------------------------------------------------------------
+   Same as cleanRunScalar(), but 16 characters at a time.
+-----------------------------------------------------------------------------*/
+    __m128i const lt = _mm_set1_epi8('<');
+    __m128i const gt = _mm_set1_epi8('>');
+    __m128i const amp = _mm_set1_epi8('&');
+    __m128i const cr = _mm_set1_epi8('\r');
 
-    size_t size;
     size_t i;
 
-    size = 0;
-    for (i = 0; i < len; ++i) {
-        if (chars[i] == '<')
-            size += 4; /* &lt; */
-        else if (chars[i] == '>')
-            size += 4; /* &gt; */
-        else if (chars[i] == '&')
-            size += 5; /* &amp; */
-        else if (chars[i] == '\r')
-            size += 6; /* &#x0d; */
-        else
-            size += 1;
+    for (i = 0; i + 16 <= len; i += 16) {
+        __m128i const v = _mm_loadu_si128((const __m128i *)&chars[i]);
+        __m128i const hits =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt),
+                                      _mm_cmpeq_epi8(v, gt)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, amp),
+                                      _mm_cmpeq_epi8(v, cr)));
+        unsigned int const mask = (unsigned int)_mm_movemask_epi8(hits);
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + cleanRunScalar(&chars[i], len - i);
+}
+
+
+
+__attribute__((target("avx2")))
+static size_t
+cleanRunAvx2(const char * const chars,
+             size_t       const len) {
+/*----------------------------------------------------------------------------
+   Same as cleanRunScalar(), but 32 characters at a time.
+-----------------------------------------------------------------------------*/
+    __m256i const lt = _mm256_set1_epi8('<');
+    __m256i const gt = _mm256_set1_epi8('>');
+    __m256i const amp = _mm256_set1_epi8('&');
+    __m256i const cr = _mm256_set1_epi8('\r');
+
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i const v = _mm256_loadu_si256((const __m256i *)&chars[i]);
+        __m256i const hits =
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt),
+                                            _mm256_cmpeq_epi8(v, gt)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, amp),
+                                            _mm256_cmpeq_epi8(v, cr)));
+        unsigned int const mask = (unsigned int)_mm256_movemask_epi8(hits);
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + cleanRunSse2(&chars[i], len - i);
+}
+
+#endif
+
+
+
+static CleanRunFn *
+cleanRunFn(void) {
+/*----------------------------------------------------------------------------
+   The best cleanRun function for the CPU we are running on.
+-----------------------------------------------------------------------------*/
+#if HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+        return &cleanRunAvx2;
+    else
+        return &cleanRunSse2;
+#else
+    return &cleanRunScalar;
+#endif
+}
+
+
+
+static const char *
+entityFor(char     const c,
+          size_t * const lenP) {
+/*----------------------------------------------------------------------------
+   The XML reference that stands for character 'c', which is one that
+   needsEscape() says needs escaping.
+-----------------------------------------------------------------------------*/
+    switch (c) {
+    case '<':  *lenP = 4; return "&lt;";
+    case '>':  *lenP = 4; return "&gt;";
+    case '&':  *lenP = 5; return "&amp;";
+    default:   *lenP = 6; return "&#x0d;";  /* CR */
     }
-    return size;
 }
 
 
 
 static void
-escapeForXml(xmlrpc_env *        const envP,
-             const char *        const chars,
-             size_t              const len,
-             xmlrpc_mem_block ** const outputPP) {
+appendEscaped(xmlrpc_env *       const envP,
+              xmlrpc_mem_block * const outputP,
+              const char *       const chars,
+              size_t             const len) {
 /*----------------------------------------------------------------------------
-   Escape & and < in a UTF-8 string so as to make it suitable for the
-   content of an XML element.  I.e. turn them into entity references
-   &amp; and &lt;.
+   Append the UTF-8 string chars[] of length 'len' to *outputP, escaped so as
+   to make it suitable for the content of an XML element.
 
-   Also change > to &gt;, even though not required for XML, for
+   We escape & and < by turning them into entity references &amp; and
+   &lt;.  We also change > to &gt;, even though not required for XML, for
    symmetry.
 
-   &lt; etc. are known in XML as "entity references."
-
-   Also Escape CR as &#x0d; .  While raw CR _is_ allowed in the content
+   We also escape CR as &#x0d; .  While raw CR _is_ allowed in the content
    of an XML element, it has a special meaning -- it means line ending.
    Our input uses LF for for line endings.  Since it also means line ending
    in XML, we just pass it through to our output like it were a regular
@@ -157,59 +308,84 @@ escapeForXml(xmlrpc_env *        const envP,
 
    &#x0d; is known in XML as a "character reference."
 
-   We assume chars[] is is ASCII.  That isn't right -- we should
-   handle all valid UTF-8.  Someday, we must do something more complex
-   and copy over multibyte characters verbatim.  (The code here could
-   erroneously find that e.g. the 2nd byte of a UTF-8 character is a
-   CR).
+   Note that in UTF-8, any byte that has high bit of zero is a character all
+   by itself (every byte of a multi-byte UTF-8 character has the high bit
+   set).  Also, the Unicode code points < 128 are identical to the ASCII
+   ones.  So we can look for the characters to escape a byte at a time and
+   copy everything else, including multibyte characters, verbatim.
+
+   We write straight into *outputP, in one pass over chars[].  We reserve
+   room for the output as if nothing needs escaping, and grow it, with some
+   room to spare, when we find something that does.  If we fail, *outputP is
+   as it was.
 -----------------------------------------------------------------------------*/
-    xmlrpc_mem_block * outputP;
-    size_t outputSize;
+    CleanRunFn * const cleanRun = cleanRunFn();
+    size_t const startSize = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+
+    size_t outLen;
+        /* Number of characters of output so far */
+    size_t reserved;
+        /* Number of characters of output for which *outputP has room */
+    size_t i;
+        /* Number of characters of input we've done so far */
 
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(chars != NULL);
 
     assertValidUtf8(chars, len);
 
-    /* Note that in UTF-8, any byte that has high bit of zero is a
-       character all by itself (every byte of a multi-byte UTF-8 character
-       has the high bit set).  Also, the Unicode code points < 128 are
-       identical to the ASCII ones.
-    */
-
-    outputSize = escapedSize(chars, len);
-
-    outputP = XMLRPC_MEMBLOCK_NEW(char, envP, outputSize);
-    if (!envP->fault_occurred) {
-        char * p;
-        size_t i;
-        p = XMLRPC_MEMBLOCK_CONTENTS(char, outputP); /* Start at beginning */
-
-        for (i = 0; i < len; i++) {
-            if (chars[i] == '<') {
-                memcpy(p, "&lt;", 4);
-                p += 4;
-            } else if (chars[i] == '>') {
-                memcpy(p, "&gt;", 4);
-                p += 4;
-            } else if (chars[i] == '&') {
-                memcpy(p, "&amp;", 5);
-                p += 5;
-            } else if (chars[i] == '\r') {
-                memcpy(p, "&#x0d;", 6);
-                p += 6;
-            } else {
-                /* Either a plain character or a LF line delimiter */
-                *p = chars[i];
-                p += 1;
-            }
+    reserved = len;
+    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, startSize + reserved);
+
+    for (i = 0, outLen = 0; i < len && !envP->fault_occurred; ) {
+        size_t const runLen = cleanRun(&chars[i], len - i);
+        size_t const windowEnd = MIN(len, i + runLen + 16);
+
+        char * dst = XMLRPC_MEMBLOCK_CONTENTS(char, outputP) + startSize;
+
+        memcpy(&dst[outLen], &chars[i], runLen);
+        outLen += runLen;
+        i      += runLen;
+
+        /* Now we're at a character that needs escaping, or the end.  Where
+           there's one such character, there are often more close by, so we
+           go a character at a time for a while rather than go back to
+           cleanRun() for every few characters.
+        */
+        while (i < windowEnd && !envP->fault_occurred) {
+            if (needsEscape(chars[i])) {
+                size_t entityLen;
+                const char * const entity = entityFor(chars[i], &entityLen);
+
+                /* The entity replaces 1 character; the rest of the input
+                   might not need escaping.
+                */
+                size_t const needed = outLen + entityLen + (len - i - 1);
+
+                if (needed > reserved) {
+                    /* Where there's one, there are likely more */
+                    reserved = needed + MAX(len / 8, 64);
+                    XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP,
+                                           startSize + reserved);
+                    dst = XMLRPC_MEMBLOCK_CONTENTS(char, outputP) + startSize;
+                }
+                if (!envP->fault_occurred) {
+                    memcpy(&dst[outLen], entity, entityLen);
+                    outLen += entityLen;
+                    ++i;
+                }
+            } else
+                dst[outLen++] = chars[i++];
         }
-        *outputPP = outputP;
-        assert(p == XMLRPC_MEMBLOCK_CONTENTS(char, outputP) + outputSize);
-
-        if (envP->fault_occurred)
-            XMLRPC_MEMBLOCK_FREE(char, outputP);
     }
+    if (envP->fault_occurred) {
+        xmlrpc_env env;
+        xmlrpc_env_init(&env);
+        /* Shrinking a block always succeeds */
+        XMLRPC_MEMBLOCK_RESIZE(char, &env, outputP, startSize);
+        xmlrpc_env_clean(&env);
+    } else
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, startSize + outLen);
 }
 
 
@@ -232,52 +408,105 @@ serializeUtf8MemBlock(xmlrpc_env *       const envP,
    unfortunate way in which Xmlrpc-c defines its string type means Caller
    is actually supposed to generate non-XML output sometimes.
 -----------------------------------------------------------------------------*/
-    xmlrpc_mem_block * escapedP;
-
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(outputP != NULL);
     XMLRPC_ASSERT(inputP != NULL);
 
-    escapeForXml(envP,
-                 XMLRPC_MEMBLOCK_CONTENTS(const char, inputP),
-                 XMLRPC_MEMBLOCK_SIZE(const char, inputP) - 1,
-                    /* -1 is for the terminating NUL */
-                 &escapedP);
-    if (!envP->fault_occurred) {
-        const char * const contents =
-            XMLRPC_MEMBLOCK_CONTENTS(const char, escapedP);
-        size_t const size = XMLRPC_MEMBLOCK_SIZE(char, escapedP);
+    appendEscaped(envP, outputP,
+                  XMLRPC_MEMBLOCK_CONTENTS(const char, inputP),
+                  XMLRPC_MEMBLOCK_SIZE(const char, inputP) - 1);
+                      /* -1 is for the terminating NUL */
+}
+
+
+
+static size_t
+sinkRoom(outSink * const sinkP) {
+/*----------------------------------------------------------------------------
+   How much more XML sink *sinkP wants before it gets flushed.  For a sink
+   that never gets flushed, that's unlimited.
+-----------------------------------------------------------------------------*/
+    size_t const size = XMLRPC_MEMBLOCK_SIZE(char, sinkP->blockP);
+
+    if (!sinkP->flush)
+        return (size_t)-1;
+    else
+        return size < sinkP->flushSize ? sinkP->flushSize - size : 0;
+}
+
+
 
-        XMLRPC_MEMBLOCK_APPEND(char, envP, outputP, contents, size);
+static void
+serializeStringContent(xmlrpc_env *       const envP,
+                       outSink *          const sinkP,
+                       xmlrpc_mem_block * const inputP) {
+/*----------------------------------------------------------------------------
+   Same as serializeUtf8MemBlock(), but to sink *sinkP, which gets a long
+   string a piece at a time, so the sink never has to hold much more than
+   its flush size.
+
+   We don't split a multibyte UTF-8 character between pieces.
+-----------------------------------------------------------------------------*/
+    const char * const chars = XMLRPC_MEMBLOCK_CONTENTS(const char, inputP);
+    size_t const len = XMLRPC_MEMBLOCK_SIZE(const char, inputP) - 1;
+        /* -1 is for the terminating NUL */
+
+    size_t done;
+
+    for (done = 0; done < len && !envP->fault_occurred; ) {
+        size_t pieceLen;
+
+        pieceLen = MIN(MAX(sinkRoom(sinkP), 4), len - done);
+            /* 4 is the longest a UTF-8 character can be */
 
-        XMLRPC_MEMBLOCK_FREE(const char, escapedP);
+        while (pieceLen > 1 && done + pieceLen < len &&
+               ((unsigned char)chars[done + pieceLen] & 0xc0) == 0x80)
+            --pieceLen;
+
+        appendEscaped(envP, sinkP->blockP, &chars[done], pieceLen);
+
+        if (!envP->fault_occurred) {
+            done += pieceLen;
+
+            maybeFlush(envP, sinkP);
+        }
     }
 }
 
 
 
 static void
-xmlrpc_serialize_base64_data(xmlrpc_env *       const envP,
-                             xmlrpc_mem_block * const output,
-                             unsigned char *    const data,
-                             size_t             const len) {
+xmlrpc_serialize_base64_data(xmlrpc_env *          const envP,
+                             outSink *             const sinkP,
+                             const unsigned char * const data,
+                             size_t                const len) {
 /*----------------------------------------------------------------------------
    Encode the 'len' bytes at 'data' in base64 ASCII and append the result to
-   'output'.
+   sink *sinkP.
+
+   We encode whole lines at a time, so the pieces make the same text as
+   encoding it all at once would.
 -----------------------------------------------------------------------------*/
-    xmlrpc_mem_block * encoded;
+    size_t done;
 
-    encoded = xmlrpc_base64_encode(envP, data, len);
-    if (!envP->fault_occurred) {
-        unsigned char * const contents =
-            XMLRPC_MEMBLOCK_CONTENTS(unsigned char, encoded);
-        size_t const size =
-            XMLRPC_MEMBLOCK_SIZE(unsigned char, encoded);
+    done = 0;
 
-        XMLRPC_MEMBLOCK_APPEND(char, envP, output, contents, size);
+    do {
+        size_t const room = sinkRoom(sinkP);
+        size_t const pieceMax =
+            room == (size_t)-1 ? len : MAX(room / 78, 1) * BASE64_LINE_BIN;
+                /* 78 is the length of a line of base64, with CRLF */
+        size_t const pieceLen = MIN(pieceMax, len - done);
 
-        XMLRPC_MEMBLOCK_FREE(char, encoded);
-    }
+        xmlrpc_base64EncodeAppend(envP, sinkP->blockP,
+                                  &data[done], pieceLen, true);
+
+        if (!envP->fault_occurred) {
+            done += pieceLen;
+
+            maybeFlush(envP, sinkP);
+        }
+    } while (done < len && !envP->fault_occurred);
 }
 
 
@@ -322,13 +551,23 @@ serializeDatetime(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeValue(xmlrpc_env *   const envP,
+               outSink *      const sinkP,
+               xmlrpc_value * const valueP,
+               xmlrpc_dialect const dialect);
+
+
+
 static void
 serializeStructMember(xmlrpc_env *       const envP,
-                      xmlrpc_mem_block * const outputP,
+                      outSink *          const sinkP,
                       xmlrpc_value *     const memberKeyP,
                       xmlrpc_value *     const memberValueP,
                       xmlrpc_dialect     const dialect) {
 
+    xmlrpc_mem_block * const outputP = sinkP->blockP;
+
     addString(envP, outputP, "<member><name>");
 
     if (!envP->fault_occurred) {
@@ -338,7 +577,7 @@ serializeStructMember(xmlrpc_env *       const envP,
             addString(envP, outputP, "</name>"CRLF);
 
             if (!envP->fault_occurred) {
-                xmlrpc_serialize_value2(envP, outputP, memberValueP, dialect);
+                serializeValue(envP, sinkP, memberValueP, dialect);
 
                 if (!envP->fault_occurred) {
                     addString(envP, outputP, "</member>"CRLF);
@@ -352,13 +591,15 @@ serializeStructMember(xmlrpc_env *       const envP,
 
 static void
 serializeStruct(xmlrpc_env *       const envP,
-                xmlrpc_mem_block * const outputP,
+                outSink *          const sinkP,
                 xmlrpc_value *     const structP,
                 xmlrpc_dialect     const dialect) {
 /*----------------------------------------------------------------------------
-   Add to *outputP the content of a <value> element to represent
+   Add to sink *sinkP the content of a <value> element to represent
    the structure value *valueP.  I.e. "<struct> ... </struct>".
 -----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * const outputP = sinkP->blockP;
+
     addString(envP, outputP, "<struct>"CRLF);
     if (!envP->fault_occurred) {
         unsigned int const size = xmlrpc_struct_size(envP, structP);
@@ -371,8 +612,10 @@ serializeStruct(xmlrpc_env *       const envP,
                 xmlrpc_struct_get_key_and_value(envP, structP, i,
                                                 &memberKeyP, &memberValueP);
                 if (!envP->fault_occurred) {
-                    serializeStructMember(envP, outputP,
+                    serializeStructMember(envP, sinkP,
                                           memberKeyP, memberValueP, dialect);
+                    if (!envP->fault_occurred)
+                        maybeFlush(envP, sinkP);
                 }
             }
             if (!envP->fault_occurred)
@@ -385,13 +628,15 @@ serializeStruct(xmlrpc_env *       const envP,
 
 static void
 serializeArray(xmlrpc_env *       const envP,
-               xmlrpc_mem_block * const outputP,
+               outSink *          const sinkP,
                xmlrpc_value *     const valueP,
                xmlrpc_dialect     const dialect) {
 /*----------------------------------------------------------------------------
-   Add to *outputP the content of a <value> element to represent
+   Add to sink *sinkP the content of a <value> element to represent
    the array value *valueP.  I.e. "<array> ... </array>".
 -----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * const outputP = sinkP->blockP;
+
     int const size = xmlrpc_array_size(envP, valueP);
 
     if (!envP->fault_occurred) {
@@ -403,9 +648,11 @@ serializeArray(xmlrpc_env *       const envP,
                 xmlrpc_value * const itemP =
                     xmlrpc_array_get_item(envP, valueP, i);
                 if (!envP->fault_occurred) {
-                    xmlrpc_serialize_value2(envP, outputP, itemP, dialect);
+                    serializeValue(envP, sinkP, itemP, dialect);
                     if (!envP->fault_occurred)
                         addString(envP, outputP, CRLF);
+                    if (!envP->fault_occurred)
+                        maybeFlush(envP, sinkP);
                 }
             }
         }
@@ -418,13 +665,15 @@ serializeArray(xmlrpc_env *       const envP,
 
 static void
 formatValueContent(xmlrpc_env *       const envP,
-                   xmlrpc_mem_block * const outputP,
+                   outSink *          const sinkP,
                    xmlrpc_value *     const valueP,
                    xmlrpc_dialect     const dialect) {
 /*----------------------------------------------------------------------------
-   Add to *outputP the content of a <value> element to represent
+   Add to sink *sinkP the content of a <value> element to represent
    value *valueP.  E.g. "<int>42</int>"
 -----------------------------------------------------------------------------*/
+    xmlrpc_mem_block * const outputP = sinkP->blockP;
+
     XMLRPC_ASSERT_ENV_OK(envP);
 
     switch (valueP->_type) {
@@ -465,7 +714,7 @@ formatValueContent(xmlrpc_env *       const envP,
     case XMLRPC_TYPE_STRING:
         addString(envP, outputP, "<string>");
         if (!envP->fault_occurred) {
-            serializeUtf8MemBlock(envP, outputP, valueP->blockP);
+            serializeStringContent(envP, sinkP, valueP->blockP);
             if (!envP->fault_occurred)
                 addString(envP, outputP, "</string>");
         }
@@ -478,18 +727,18 @@ formatValueContent(xmlrpc_env *       const envP,
             XMLRPC_MEMBLOCK_SIZE(unsigned char, valueP->blockP);
         addString(envP, outputP, "<base64>"CRLF);
         if (!envP->fault_occurred) {
-            xmlrpc_serialize_base64_data(envP, outputP, contents, size);
+            xmlrpc_serialize_base64_data(envP, sinkP, contents, size);
             if (!envP->fault_occurred)
                 addString(envP, outputP, "</base64>");
         }
     } break;
 
     case XMLRPC_TYPE_ARRAY:
-        serializeArray(envP, outputP, valueP, dialect);
+        serializeArray(envP, sinkP, valueP, dialect);
         break;
 
     case XMLRPC_TYPE_STRUCT:
-        serializeStruct(envP, outputP, valueP, dialect);
+        serializeStruct(envP, sinkP, valueP, dialect);
         break;
 
     case XMLRPC_TYPE_C_PTR:
@@ -513,6 +762,44 @@ formatValueContent(xmlrpc_env *       const envP,
 
 
 
+static void
+serializeValue(xmlrpc_env *   const envP,
+               outSink *      const sinkP,
+               xmlrpc_value * const valueP,
+               xmlrpc_dialect const dialect) {
+/*----------------------------------------------------------------------------
+   Generate the XML to represent XML-RPC value 'valueP' in XML-RPC.
+
+   Add it to sink *sinkP.
+-----------------------------------------------------------------------------*/
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    addString(envP, sinkP->blockP, "<value>");
+
+    if (!envP->fault_occurred) {
+        formatValueContent(envP, sinkP, valueP, dialect);
+
+        if (!envP->fault_occurred)
+            addString(envP, sinkP->blockP, "</value>");
+    }
+}
+
+
+
+static void
+initSink(outSink *          const sinkP,
+         xmlrpc_mem_block * const outputP) {
+/*----------------------------------------------------------------------------
+   Make *sinkP a sink that just accumulates XML in *outputP.
+-----------------------------------------------------------------------------*/
+    sinkP->blockP    = outputP;
+    sinkP->flush     = NULL;
+    sinkP->flushSize = 0;
+    sinkP->flushArg  = NULL;
+}
+
+
+
 void
 xmlrpc_serialize_value2(xmlrpc_env *       const envP,
                         xmlrpc_mem_block * const outputP,
@@ -523,18 +810,15 @@ xmlrpc_serialize_value2(xmlrpc_env *       const envP,
 
    Add it to *outputP.
 -----------------------------------------------------------------------------*/
+    outSink sink;
+
     XMLRPC_ASSERT_ENV_OK(envP);
     XMLRPC_ASSERT(outputP != NULL);
     XMLRPC_ASSERT_VALUE_OK(valueP);
 
-    addString(envP, outputP, "<value>");
+    initSink(&sink, outputP);
 
-    if (!envP->fault_occurred) {
-        formatValueContent(envP, outputP, valueP, dialect);
-
-        if (!envP->fault_occurred)
-            addString(envP, outputP, "</value>");
-    }
+    serializeValue(envP, &sink, valueP, dialect);
 }
 
 
@@ -633,23 +917,15 @@ xmlrpc_serialize_call2(xmlrpc_env *       const envP,
             dialect == xmlrpc_dialect_apache ? " " XMLNS_APACHE : "";
         formatOut(envP, outputP, "<methodCall%s>"CRLF"<methodName>", xmlns);
         if (!envP->fault_occurred) {
-            xmlrpc_mem_block * encodedP;
-            escapeForXml(envP, methodName, strlen(methodName), &encodedP);
+            appendEscaped(envP, outputP, methodName, strlen(methodName));
             if (!envP->fault_occurred) {
-                const char * const contents =
-                    XMLRPC_MEMBLOCK_CONTENTS(char, encodedP);
-                size_t const size = XMLRPC_MEMBLOCK_SIZE(char, encodedP);
-                XMLRPC_MEMBLOCK_APPEND(char, envP, outputP, contents, size);
+                addString(envP, outputP, "</methodName>"CRLF);
                 if (!envP->fault_occurred) {
-                    addString(envP, outputP, "</methodName>"CRLF);
-                    if (!envP->fault_occurred) {
-                        xmlrpc_serialize_params2(envP, outputP, paramArrayP,
-                                                 dialect);
-                        if (!envP->fault_occurred)
-                            addString(envP, outputP, "</methodCall>"CRLF);
-                    }
+                    xmlrpc_serialize_params2(envP, outputP, paramArrayP,
+                                             dialect);
+                    if (!envP->fault_occurred)
+                        addString(envP, outputP, "</methodCall>"CRLF);
                 }
-                XMLRPC_MEMBLOCK_FREE(char, encodedP);
             }
         }
     }
@@ -669,21 +945,13 @@ xmlrpc_serialize_call(xmlrpc_env *       const envP,
 
 
 
-void
-xmlrpc_serialize_response2(xmlrpc_env *       const envP,
-                           xmlrpc_mem_block * const outputP,
-                           xmlrpc_value *     const valueP,
-                           xmlrpc_dialect     const dialect) {
-/*----------------------------------------------------------------------------
-  Serialize a result response to an XML-RPC call.
-
-  The result is 'valueP'.
+static void
+serializeResponse(xmlrpc_env *   const envP,
+                  outSink *      const sinkP,
+                  xmlrpc_value * const valueP,
+                  xmlrpc_dialect const dialect) {
 
-  Add the response XML to *outputP.
------------------------------------------------------------------------------*/
-    XMLRPC_ASSERT_ENV_OK(envP);
-    XMLRPC_ASSERT(outputP != NULL);
-    XMLRPC_ASSERT_VALUE_OK(valueP);
+    xmlrpc_mem_block * const outputP = sinkP->blockP;
 
     addString(envP, outputP, XML_PROLOGUE);
     if (!envP->fault_occurred) {
@@ -692,7 +960,7 @@ xmlrpc_serialize_response2(xmlrpc_env *       const envP,
         formatOut(envP, outputP,
                   "<methodResponse%s>"CRLF"<params>"CRLF"<param>", xmlns);
         if (!envP->fault_occurred) {
-            xmlrpc_serialize_value2(envP, outputP, valueP, dialect);
+            serializeValue(envP, sinkP, valueP, dialect);
             if (!envP->fault_occurred) {
                 addString(envP, outputP,
                           "</param>"CRLF"</params>"CRLF
@@ -704,6 +972,70 @@ xmlrpc_serialize_response2(xmlrpc_env *       const envP,
 
 
 
+void
+xmlrpc_serialize_response2(xmlrpc_env *       const envP,
+                           xmlrpc_mem_block * const outputP,
+                           xmlrpc_value *     const valueP,
+                           xmlrpc_dialect     const dialect) {
+/*----------------------------------------------------------------------------
+  Serialize a result response to an XML-RPC call.
+
+  The result is 'valueP'.
+
+  Add the response XML to *outputP.
+-----------------------------------------------------------------------------*/
+    outSink sink;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+
+    initSink(&sink, outputP);
+
+    serializeResponse(envP, &sink, valueP, dialect);
+}
+
+
+
+void
+xmlrpc_serializeResponseStream(xmlrpc_env *              const envP,
+                               xmlrpc_mem_block *        const outputP,
+                               xmlrpc_value *            const valueP,
+                               xmlrpc_dialect            const dialect,
+                               size_t                    const flushSize,
+                               xmlrpc_serializeFlushFn         flush,
+                               void *                    const flushArg) {
+/*----------------------------------------------------------------------------
+  Same as xmlrpc_serialize_response2(), except that whenever *outputP gets
+  to 'flushSize' bytes or so, we call 'flush' (with argument 'flushArg') to
+  take the XML out of it.  That's how Caller can send out a big response as
+  we generate it instead of having to hold the whole thing.
+
+  'flush' normally sends the contents of *outputP somewhere and empties it,
+  but may leave it as is, in which case we just keep adding to it.  Either
+  way, what is in *outputP when we return is the rest of the response.
+
+  *outputP may exceed 'flushSize' by the size of the largest thing we don't
+  split up: a scalar other than a string or base64, or a struct member
+  name.
+-----------------------------------------------------------------------------*/
+    outSink sink;
+
+    XMLRPC_ASSERT_ENV_OK(envP);
+    XMLRPC_ASSERT(outputP != NULL);
+    XMLRPC_ASSERT_VALUE_OK(valueP);
+    XMLRPC_ASSERT(flush != NULL);
+
+    sink.blockP    = outputP;
+    sink.flush     = flush;
+    sink.flushSize = flushSize;
+    sink.flushArg  = flushArg;
+
+    serializeResponse(envP, &sink, valueP, dialect);
+}
+
+
+
 void
 xmlrpc_serialize_response(xmlrpc_env *       const envP,
                           xmlrpc_mem_block * const outputP,
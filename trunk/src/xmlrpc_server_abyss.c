@@ -208,6 +208,30 @@ interpretHttpAccessControl(
 
 
 
+static void
+interpretCompression(
+    const xmlrpc_server_abyss_handler_parms * const parmsP,
+    unsigned int                              const parmSize,
+    unsigned int *                            const levelP,
+    size_t *                                  const thresholdP) {
+
+    /* zlib has no level above 9 */
+
+    if (parmSize >= XMLRPC_AHPSIZE(compression_level))
+        *levelP = parmsP->compression_level > 9 ?
+            9 : parmsP->compression_level;
+    else
+        *levelP = 0;
+
+    if (parmSize >= XMLRPC_AHPSIZE(compression_threshold) &&
+        parmsP->compression_threshold > 0)
+        *thresholdP = parmsP->compression_threshold;
+    else
+        *thresholdP = 1024;
+}
+
+
+
 void
 xmlrpc_server_abyss_set_handler3(
     xmlrpc_env *                              const envP,
@@ -234,6 +258,16 @@ xmlrpc_server_abyss_set_handler3(
             xmlrpc_faultf(envP, "Parameter too short to contain the required "
                           "'xml_processor_arg' member");
     }
+    if (!envP->fault_occurred) {
+        /* If the processor is just our own front end to a method registry,
+           the handler can use the registry directly, which lets it parse
+           the call as it arrives.
+        */
+        if (uriHandlerXmlrpcP->xmlProcessor == &processXmlrpcCall)
+            uriHandlerXmlrpcP->registryP = uriHandlerXmlrpcP->xmlProcessorArg;
+        else
+            uriHandlerXmlrpcP->registryP = NULL;
+    }
     if (!envP->fault_occurred) {
         if (parmSize >= XMLRPC_AHPSIZE(xml_processor_max_stack))
             xmlProcessorMaxStackSize = parmsP->xml_processor_max_stack;
@@ -253,6 +287,10 @@ xmlrpc_server_abyss_set_handler3(
         else
             uriHandlerXmlrpcP->chunkResponse = false;
 
+        interpretCompression(parmsP, parmSize,
+                             &uriHandlerXmlrpcP->compressionLevel,
+                             &uriHandlerXmlrpcP->compressionThreshold);
+
         interpretHttpAccessControl(parmsP, parmSize,
                                    &uriHandlerXmlrpcP->accessControl);
 
@@ -333,7 +371,9 @@ setHandlersRegistry(TServer *         const srvP,
                     bool              const chunkResponse,
                     const char *      const allowOrigin,
                     bool              const expires,
-                    unsigned int      const maxAge) {
+                    unsigned int      const maxAge,
+                    unsigned int      const compressionLevel,
+                    size_t            const compressionThreshold) {
 
     xmlrpc_env env;
     xmlrpc_server_abyss_handler_parms parms;
@@ -348,9 +388,11 @@ setHandlersRegistry(TServer *         const srvP,
     parms.allow_origin = allowOrigin;
     parms.access_ctl_expires = expires;
     parms.access_ctl_max_age = maxAge;
+    parms.compression_level = compressionLevel;
+    parms.compression_threshold = compressionThreshold;
 
     xmlrpc_server_abyss_set_handler3(
-        &env, srvP, &parms, XMLRPC_AHPSIZE(access_ctl_max_age));
+        &env, srvP, &parms, XMLRPC_AHPSIZE(compression_threshold));
 
     if (env.fault_occurred)
         abort();
@@ -367,7 +409,8 @@ xmlrpc_server_abyss_set_handlers2(TServer *         const srvP,
                                   const char *      const uriPath,
                                   xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, uriPath, registryP, false, NULL, false, 0,
+                        0, 0);
 }
 
 
@@ -376,7 +419,8 @@ void
 xmlrpc_server_abyss_set_handlers(TServer *         const srvP,
                                  xmlrpc_registry * const registryP) {
 
-    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0);
+    setHandlersRegistry(srvP, "/RPC2", registryP, false, NULL, false, 0,
+                        0, 0);
 }
 
 
@@ -413,6 +457,17 @@ setAdditionalServerParms(const xmlrpc_server_abyss_parms * const parmsP,
         if (parmsP->max_rpc_mem != 0)
             ServerSetMaxSessionMem(serverP, parmsP->max_rpc_mem);
     }
+    if (parmSize >= XMLRPC_APSIZE(conn_buffer_size))
+        ServerSetConnBufferSize(serverP, parmsP->conn_buffer_size);
+    if (parmSize >= XMLRPC_APSIZE(event_driven))
+        ServerSetEventDriven(serverP, parmsP->event_driven);
+    if (parmSize >= XMLRPC_APSIZE(event_workers))
+        ServerSetEventThreads(serverP, parmsP->event_io_threads,
+                              parmsP->event_workers);
+    if (parmSize >= XMLRPC_APSIZE(thread_pool_idle_timeout))
+        ServerSetThreadPool(serverP, parmsP->thread_pool_min,
+                            parmsP->thread_pool_max,
+                            parmsP->thread_pool_idle_timeout);
 }
 
 
@@ -756,6 +811,28 @@ maxAgeParm(const xmlrpc_server_abyss_parms * const parmsP,
 
 
 
+static unsigned int
+compressionLevelParm(const xmlrpc_server_abyss_parms * const parmsP,
+                     unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(compression_level) ?
+        parmsP->compression_level : 0;
+}
+
+
+
+static size_t
+compressionThresholdParm(const xmlrpc_server_abyss_parms * const parmsP,
+                         unsigned int                      const parmSize) {
+
+    return
+        parmSize >= XMLRPC_APSIZE(compression_threshold) ?
+        parmsP->compression_threshold : 0;
+}
+
+
+
 static void
 createServer(xmlrpc_env *                      const envP,
              const xmlrpc_server_abyss_parms * const parmsP,
@@ -775,7 +852,9 @@ createServer(xmlrpc_env *                      const envP,
                             chunkResponseParm(parmsP, parmSize),
                             allowOriginParm(parmsP, parmSize),
                             expiresParm(parmsP, parmSize),
-                            maxAgeParm(parmsP, parmSize));
+                            maxAgeParm(parmsP, parmSize),
+                            compressionLevelParm(parmsP, parmSize),
+                            compressionThresholdParm(parmsP, parmSize));
 
         ServerInit2(abyssServerP, &error);
 
@@ -1127,7 +1206,7 @@ oldHighLevelAbyssRun(xmlrpc_env *                      const envP,
         assert(parmSize >= XMLRPC_APSIZE(registryP));
 
         setHandlersRegistry(&server, "/RPC2", parmsP->registryP, false, NULL,
-                            false, 0);
+                            false, 0, 0, 0);
 
         ServerInit(&server);
 
@@ -1251,7 +1330,7 @@ xmlrpc_server_abyss_init_registry(void) {
     xmlrpc_env_clean(&env);
 
     setHandlersRegistry(&globalSrv, "/RPC2", builtin_registryP, false, NULL,
-                        false, 0);
+                        false, 0, 0, 0);
 }
 
 
@@ -659,7 +659,7 @@ copyLines(xmlrpc_env *        const envP,
 
     xmlrpc_mem_block * dstP;
 
-    dstP = XMLRPC_MEMBLOCK_NEW(char, envP, srcLen + 1);
+    dstP = xmlrpc_valueBlockNew(envP, srcLen + 1);
 
     if (!envP->fault_occurred) {
         const char * const srcEnd = &src[srcLen];
@@ -723,7 +723,7 @@ copySimple(xmlrpc_env *        const envP,
 -----------------------------------------------------------------------------*/
     xmlrpc_mem_block * dstP;
 
-    dstP = XMLRPC_MEMBLOCK_NEW(char, envP, srcLen + 1);
+    dstP = xmlrpc_valueBlockNew(envP, srcLen + 1);
 
     if (!envP->fault_occurred) {
         char * const contents = XMLRPC_MEMBLOCK_CONTENTS(char, dstP);
@@ -765,7 +765,7 @@ stringNew(xmlrpc_env *     const envP,
                 copySimple(envP, value, length, &valP->blockP);
 
             if (envP->fault_occurred)
-                free(valP);
+                xmlrpc_freeXmlrpcValue(valP);
             else
                 *valPP = valP;
         }
@@ -12,6 +12,12 @@
 
 #define KEY_ERROR_BUFFER_SZ (32)
 
+#define STRUCT_INDEX_MIN_MBRS (16)
+    /* A struct with fewer members than this has no hash index; we find a
+       member by linear search of the member hashes, which is at least as
+       fast for a handful of members and costs no extra memory.
+    */
+
 
 
 static uint32_t
@@ -35,6 +41,106 @@ hashStructKey(const char * const key,
 
 
 
+static uint32_t
+indexSlot(uint32_t     const keyHash,
+          unsigned int const log2Size) {
+/*----------------------------------------------------------------------------
+   The home slot for a key with hash 'keyHash' in a 2^log2Size-slot index.
+
+   The Bernstein hash puts most of a key's last characters into its low bits
+   and little of the rest, so we mix it (Fibonacci hashing) and take the high
+   bits.
+-----------------------------------------------------------------------------*/
+    return (uint32_t)(keyHash * 2654435769u) >> (32 - log2Size);
+}
+
+
+
+static void
+indexInsert(uint32_t *   const index,
+            unsigned int const log2Size,
+            uint32_t     const keyHash,
+            size_t       const mbrIndex) {
+
+    uint32_t const mask = (1u << log2Size) - 1;
+
+    uint32_t slot;
+
+    for (slot = indexSlot(keyHash, log2Size);
+         index[slot] != 0;
+         slot = (slot + 1) & mask);
+
+    index[slot] = mbrIndex + 1;
+}
+
+
+
+static void
+buildIndex(xmlrpc_value * const structP) {
+/*----------------------------------------------------------------------------
+   Replace the hash index of struct *structP (if any) with a new one, sized
+   so it is at most half full.
+
+   If we can't get the memory, we leave the struct with no index.  That's OK;
+   findMember() just falls back to a linear search.
+-----------------------------------------------------------------------------*/
+    _struct_member * const members =
+        XMLRPC_MEMBLOCK_CONTENTS(_struct_member, structP->blockP);
+    size_t const size =
+        XMLRPC_MEMBLOCK_SIZE(_struct_member, structP->blockP);
+
+    unsigned int log2Size;
+    uint32_t * index;
+
+    for (log2Size = 1; ((size_t)1 << log2Size) < size * 2; ++log2Size);
+
+    free(structP->_value.strct.index);
+
+    if (log2Size > 31)
+        index = NULL;
+    else
+        index = calloc((size_t)1 << log2Size, sizeof(index[0]));
+
+    if (index) {
+        size_t i;
+
+        for (i = 0; i < size; ++i)
+            indexInsert(index, log2Size, members[i].keyHash, i);
+    }
+    structP->_value.strct.index         = index;
+    structP->_value.strct.indexLog2Size = log2Size;
+}
+
+
+
+static void
+indexNewMember(xmlrpc_value * const structP) {
+/*----------------------------------------------------------------------------
+   Update the hash index of struct *structP for the member just added to the
+   end of the member list.  Create the index if the struct has just become
+   large enough to warrant one.
+-----------------------------------------------------------------------------*/
+    size_t const size =
+        XMLRPC_MEMBLOCK_SIZE(_struct_member, structP->blockP);
+
+    if (structP->_value.strct.index) {
+        unsigned int const log2Size = structP->_value.strct.indexLog2Size;
+
+        if (size * 2 > ((size_t)1 << log2Size))
+            buildIndex(structP);
+        else {
+            _struct_member * const members =
+                XMLRPC_MEMBLOCK_CONTENTS(_struct_member, structP->blockP);
+
+            indexInsert(structP->_value.strct.index, log2Size,
+                        members[size-1].keyHash, size-1);
+        }
+    } else if (size >= STRUCT_INDEX_MIN_MBRS)
+        buildIndex(structP);
+}
+
+
+
 static void
 changeMemberValue(xmlrpc_value * const structP,
                   unsigned int   const mbrIndex,
@@ -82,6 +188,8 @@ addNewMember(xmlrpc_env *   const envP,
     if (!envP->fault_occurred) {
         xmlrpc_INCREF(keyvalP);
         xmlrpc_INCREF(valueP);
+
+        indexNewMember(structP);
     }
 }
 
@@ -105,6 +213,8 @@ xmlrpc_destroyStruct(xmlrpc_value * const structP) {
         xmlrpc_DECREF(members[i].value);
     }
     XMLRPC_MEMBLOCK_FREE(_struct_member, structP->blockP);
+
+    free(structP->_value.strct.index);
 }
 
 
@@ -117,7 +227,9 @@ xmlrpc_destroyStruct(xmlrpc_value * const structP) {
 **
 **  We store the individual members in an array of _struct_member. This
 **  contains a key, a hash code, and a value. We look up keys by doing
-**  a linear search of the hash codes.
+**  a linear search of the hash codes or, once the struct is large, through
+**  an open-addressing hash index of the array.  The array order is the
+**  order in which members were added, and the index does not change that.
 */
 
 xmlrpc_value *
@@ -130,11 +242,12 @@ xmlrpc_struct_new(xmlrpc_env * const envP) {
     xmlrpc_createXmlrpcValue(envP, &valP);
     if (!envP->fault_occurred) {
         valP->_type = XMLRPC_TYPE_STRUCT;
+        valP->_value.strct.index = NULL;
 
-        valP->blockP = XMLRPC_MEMBLOCK_NEW(_struct_member, envP, 0);
+        valP->blockP = xmlrpc_valueBlockNew(envP, 0);
 
         if (envP->fault_occurred)
-            free(valP);
+            xmlrpc_freeXmlrpcValue(valP);
     }
     return valP;
 }
@@ -156,11 +269,12 @@ xmlrpc_struct_new_value(xmlrpc_env *   const envP,
         xmlrpc_createXmlrpcValue(envP, &structP);
         if (!envP->fault_occurred) {
             structP->_type = XMLRPC_TYPE_STRUCT;
+            structP->_value.strct.index = NULL;
 
-            structP->blockP = XMLRPC_MEMBLOCK_NEW(_struct_member, envP, 0);
+            structP->blockP = xmlrpc_valueBlockNew(envP, 0);
 
             if (envP->fault_occurred)
-                free(structP);
+                xmlrpc_freeXmlrpcValue(structP);
             else {
                 _struct_member * const srcMemberList =
                     XMLRPC_MEMBLOCK_CONTENTS(_struct_member, valueP->blockP);
@@ -192,7 +306,7 @@ xmlrpc_struct_new_value(xmlrpc_env *   const envP,
             }
 
             if (envP->fault_occurred)
-                free(structP);
+                xmlrpc_freeXmlrpcValue(structP);
         }
     }
     return structP;
@@ -235,6 +349,30 @@ xmlrpc_struct_size(xmlrpc_env *   const envP,
 
 
 
+static bool
+memberHasKey(const _struct_member * const memberP,
+             uint32_t               const keyHash,
+             const char *           const key,
+             size_t                 const keyLen) {
+
+    bool retval;
+
+    if (memberP->keyHash != keyHash)
+        retval = false;
+    else {
+        xmlrpc_value * const keyvalP = memberP->key;
+        const char * const keystr =
+            XMLRPC_MEMBLOCK_CONTENTS(char, keyvalP->blockP);
+        size_t const keystrSize =
+            XMLRPC_MEMBLOCK_SIZE(char, keyvalP->blockP)-1;
+
+        retval = (keystrSize == keyLen && memcmp(key, keystr, keyLen) == 0);
+    }
+    return retval;
+}
+
+
+
 static void
 findMember(xmlrpc_value * const structP, 
            const char *   const key, 
@@ -256,18 +394,32 @@ findMember(xmlrpc_value * const structP,
     searchHash = hashStructKey(key, keyLen);
     size = XMLRPC_MEMBLOCK_SIZE(_struct_member, structP->blockP);
     contents = XMLRPC_MEMBLOCK_CONTENTS(_struct_member, structP->blockP);
-    for (i = 0, found = false; i < size && !found; ++i) {
-        if (contents[i].keyHash == searchHash) {
-            xmlrpc_value * const keyvalP = contents[i].key;
-            const char * const keystr =
-                XMLRPC_MEMBLOCK_CONTENTS(char, keyvalP->blockP);
-            size_t const keystrSize =
-                XMLRPC_MEMBLOCK_SIZE(char, keyvalP->blockP)-1;
-            if (keystrSize == keyLen && memcmp(key, keystr, keyLen) == 0) {
+
+    if (structP->_value.strct.index) {
+        uint32_t * const index = structP->_value.strct.index;
+        unsigned int const log2Size = structP->_value.strct.indexLog2Size;
+        uint32_t const mask = (1u << log2Size) - 1;
+
+        uint32_t slot;
+
+        for (slot = indexSlot(searchHash, log2Size), found = false;
+             index[slot] != 0 && !found;
+             slot = (slot + 1) & mask) {
+
+            i = index[slot] - 1;
+
+            if (memberHasKey(&contents[i], searchHash, key, keyLen)) {
                 found = true;
                 foundIndex = i;
             }
-        }   
+        }
+    } else {
+        for (i = 0, found = false; i < size && !found; ++i) {
+            if (memberHasKey(&contents[i], searchHash, key, keyLen)) {
+                found = true;
+                foundIndex = i;
+            }
+        }
     }
     if (found) {
         assert((size_t)(int)foundIndex == foundIndex);
@@ -1,28 +1,52 @@
-/* None of the tests in here rely on a client existing, or even a network
-   connection.  We should figure out how to create a test client and do
-   such tests.
+/* Most of the tests in here don't rely on a client existing, or even a
+   network connection.  The loopback tests run a server in a thread and
+   talk to it over a TCP connection on the loopback interface.
 */
 #define WIN32_LEAN_AND_MEAN  /* required by xmlrpc-c/abyss.h */
 
 #include "unistdx.h"
 #include <stdio.h>
+#include <stdlib.h>
 #ifndef _WIN32
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <strings.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
 #endif
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 
 #include "xmlrpc_config.h"
+#if HAVE_ABYSS_OPENSSL
+#include <openssl/ssl.h>
+#endif
 
 #include "int.h"
+#include "girmath.h"
+#include "bool.h"
 #include "casprintf.h"
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/abyss.h"
+#if HAVE_ABYSS_OPENSSL
+#include "xmlrpc-c/abyss_openssl.h"
+#endif
 
 #include "testtool.h"
 
+#ifndef _WIN32
+/* Abyss internal interfaces */
+#include "channel.h"
+#include "conn.h"
+#include "file.h"
+#include "server.h"
+#endif
+
 #include "abyss.h"
 
 
@@ -369,7 +393,18 @@ testServerCreate(void) {
         ServerSetTimeout(&server, 75);
         ServerSetAdvertise(&server, 1);
         ServerSetAdvertise(&server, 0);
-
+        ServerSetThreadPool(&server, 2, 8, 30);
+        ServerSetConnBufferSize(&server, 65536);
+
+        {
+            TServerThreadPoolStats stats;
+
+            /* There's no pool until ServerRun() */
+            ServerGetThreadPoolStats(&server, &stats);
+            TEST(stats.threadCt == 0);
+            TEST(stats.queueDepth == 0);
+            TEST(stats.connectionCt == 0);
+        }
         ServerInit(&server);
 
         ServerFree(&server);
@@ -379,32 +414,1691 @@ testServerCreate(void) {
 }
 
 
+#ifndef _WIN32
+
+/* The loopback tests below run a real server in a thread of this program
+   and talk HTTP to it over a TCP connection.
+*/
+
+struct loopbackServer {
+    TServer       server;
+    TChanSwitch * chanSwitchP;
+    uint16_t      portNumber;
+    pthread_t     thread;
+};
+
+
+
+static void *
+loopbackServerRun(void * const arg) {
+
+    struct loopbackServer * const lsP = arg;
+
+    ServerRun(&lsP->server);
+
+    return NULL;
+}
+
+
+
+static int
+loopbackListenFd(uint16_t * const portNumberP) {
+/*----------------------------------------------------------------------------
+   A socket bound to a free port of the loopback interface, for a channel
+   switch.  Return the port number as *portNumberP.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in sockAddr;
+    socklen_t sockAddrLen;
+    int fd;
+    int rc;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockAddr.sin_port = 0;  /* Any free port */
+
+    rc = bind(fd, (struct sockaddr *)&sockAddr, sizeof(sockAddr));
+    TEST(rc == 0);
+
+    sockAddrLen = sizeof(sockAddr);
+    rc = getsockname(fd, (struct sockaddr *)&sockAddr, &sockAddrLen);
+    TEST(rc == 0);
+    *portNumberP = ntohs(sockAddr.sin_port);
+
+    return fd;
+}
 
-void
-test_abyss(void) {
 
+
+static void
+loopbackServerCreate(struct loopbackServer * const lsP) {
+/*----------------------------------------------------------------------------
+   Create a server listening on a free port of the loopback interface.
+   Caller configures it, then starts it with loopbackServerStart().
+-----------------------------------------------------------------------------*/
     const char * error;
 
-    printf("Running Abyss server tests...\n");
-    
-    AbyssInit(&error);
+    chanSwitchCreateFd(loopbackListenFd(&lsP->portNumber),
+                       &lsP->chanSwitchP, &error);
     TEST_NULL_STRING(error);
 
-    ChanSwitchInit(&error);
+    ServerCreateSwitch(&lsP->server, lsP->chanSwitchP, &error);
     TEST_NULL_STRING(error);
+}
 
-    ChannelInit(&error);
-    TEST_NULL_STRING(error);
 
-    testChanSwitch();
 
-    testChannel();
+static void
+loopbackServerStart(struct loopbackServer * const lsP) {
 
-    testOsSocket();
+    int rc;
 
-    testSocket();
+    ServerInit(&lsP->server);
 
-    testServerCreate();
+    rc = pthread_create(&lsP->thread, NULL, &loopbackServerRun, lsP);
+    TEST(rc == 0);
+}
+
+
+
+static void
+loopbackServerDestroy(struct loopbackServer * const lsP) {
+
+    ServerTerminate(&lsP->server);
+
+    pthread_join(lsP->thread, NULL);
+
+    ServerFree(&lsP->server);
+
+    ChanSwitchDestroy(lsP->chanSwitchP);
+}
+
+
+
+static int
+loopbackConnect(struct loopbackServer * const lsP) {
+
+    struct sockaddr_in sockAddr;
+    int fd;
+    int rc;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(fd >= 0);
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockAddr.sin_port = htons(lsP->portNumber);
+
+    rc = connect(fd, (struct sockaddr *)&sockAddr, sizeof(sockAddr));
+    TEST(rc == 0);
+
+    return fd;
+}
+
+
+
+static void
+sendString(int          const fd,
+           const char * const string) {
+
+    ssize_t rc;
+
+    rc = write(fd, string, strlen(string));
+    TEST(rc == (ssize_t)strlen(string));
+}
+
+
+
+static size_t
+readWithTimeout(int    const fd,
+                char * const buffer,
+                size_t const size,
+                int    const timeoutMs) {
+/*----------------------------------------------------------------------------
+   Read what is available from 'fd', waiting up to 'timeoutMs' milliseconds
+   for something to arrive.  Return the number of bytes read; zero means the
+   peer closed the connection or nothing arrived.
+-----------------------------------------------------------------------------*/
+    struct pollfd pollFd;
+    ssize_t rc;
+
+    pollFd.fd     = fd;
+    pollFd.events = POLLIN;
+
+    if (poll(&pollFd, 1, timeoutMs) != 1)
+        return 0;
+
+    rc = read(fd, buffer, size);
+
+    return rc > 0 ? (size_t)rc : 0;
+}
+
+
+
+static void
+readResponse(int    const fd,
+             char * const buffer,
+             size_t const size) {
+/*----------------------------------------------------------------------------
+   Read one HTTP response with a Content-Length body from 'fd' into
+   'buffer', as a NUL-terminated string.  Don't read past its end, so that
+   the connection can carry another request.
+-----------------------------------------------------------------------------*/
+    size_t len;
+    size_t fullLen;
+
+    len = 0;
+    fullLen = 0;
+
+    while (len < size - 1 && (fullLen == 0 || len < fullLen)) {
+        size_t const wanted = fullLen ? fullLen - len : 1;
+        size_t const got =
+            readWithTimeout(fd, &buffer[len], MIN(wanted, size - 1 - len),
+                            5000);
+        if (got == 0)
+            break;
+
+        len += got;
+        buffer[len] = '\0';
+
+        if (fullLen == 0) {
+            const char * const headerEnd = strstr(buffer, "\r\n\r\n");
+            if (headerEnd) {
+                const char * p;
+                unsigned int contentLength;
+
+                contentLength = 0;
+                for (p = buffer; p < headerEnd; ++p) {
+                    if (strncasecmp(p, "\r\nContent-Length:", 17) == 0)
+                        sscanf(&p[17], "%u", &contentLength);
+                }
+
+                fullLen = headerEnd - buffer + 4 + contentLength;
+            }
+        }
+    }
+    buffer[len] = '\0';
+}
+
+
+
+static size_t
+readToEof(int    const fd,
+          char * const buffer,
+          size_t const size) {
+/*----------------------------------------------------------------------------
+   Read from 'fd' into 'buffer', as a NUL-terminated string, until the peer
+   closes the connection.  Return how much we read.  Give up if the peer
+   goes quiet for 5 seconds.
+-----------------------------------------------------------------------------*/
+    size_t len;
+    bool eof;
+
+    for (len = 0, eof = false; len < size - 1 && !eof; ) {
+        size_t const got =
+            readWithTimeout(fd, &buffer[len], size - 1 - len, 5000);
+
+        if (got == 0)
+            eof = true;
+        else
+            len += got;
+    }
+    buffer[len] = '\0';
+
+    return len;
+}
+
+
+
+static abyss_bool
+helloHandler(TSession * const sessionP) {
+
+    const char * const body = "hello";
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentType(sessionP, "text/plain");
+    ResponseContentLength(sessionP, strlen(body));
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, body, strlen(body));
+    ResponseWriteEnd(sessionP);
+
+    return true;
+}
+
+
+
+static abyss_bool
+abortingHandler(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Start a chunked response, then fail in the middle of it.
+-----------------------------------------------------------------------------*/
+    const char * const body = "partial";
+
+    ResponseStatus(sessionP, 200);
+    ResponseContentType(sessionP, "text/plain");
+    ResponseChunked(sessionP);
+    ResponseWriteStart(sessionP);
+    ResponseWriteBody(sessionP, body, strlen(body));
+    ResponseAbort(sessionP);
+
+    return true;
+}
+
+
+
+static void
+testResponseAbort(void) {
+/*----------------------------------------------------------------------------
+   A handler that aborts a chunked response it has started: the client must
+   get the part that was sent, but no terminating chunk, and the connection
+   must close even though the client asked for keepalive.
+-----------------------------------------------------------------------------*/
+    struct loopbackServer ls;
+    char response[1024];
+    int fd;
+
+    loopbackServerCreate(&ls);
+
+    ServerSetKeepaliveTimeout(&ls.server, 5);
+    ServerSetTimeout(&ls.server, 5);
+    ServerDefaultHandler(&ls.server, &abortingHandler);
+
+    loopbackServerStart(&ls);
+
+    fd = loopbackConnect(&ls);
+
+    sendString(fd,
+               "GET /abort HTTP/1.1\r\n"
+               "Host: localhost\r\n"
+               "\r\n");
+
+    readToEof(fd, response, sizeof(response));
+
+    TEST(strncmp(response, "HTTP/1.1 200", 12) == 0);
+    TEST(strstr(response, "partial") != NULL);
+    TEST(strstr(response, "\r\n0\r\n") == NULL);
+
+    close(fd);
+
+    loopbackServerDestroy(&ls);
+}
+
+
+
+static uint32_t
+checksum(const char * const data,
+         size_t       const len) {
+
+    uint32_t sum;
+    size_t i;
+
+    for (i = 0, sum = 0; i < len; ++i)
+        sum = sum * 31 + (unsigned char)data[i];
+
+    return sum;
+}
+
+
+
+static abyss_bool
+bodySumHandler(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Read the request body, whose size is given by Content-Length, with
+   SessionReadBody() and respond with its checksum.  Respond 400 if we can't
+   read it.
+-----------------------------------------------------------------------------*/
+    const char * const contentLength =
+        RequestHeaderValue(sessionP, "content-length");
+    size_t const len = contentLength ? (size_t)atol(contentLength) : 0;
+
+    char * body;
+    const char * error;
+
+    body = malloc(len + 1);
+    TEST(body != NULL);
+
+    SessionReadBody(sessionP, body, len, &error);
+
+    if (error) {
+        ResponseStatus(sessionP, 400);
+        ResponseError2(sessionP, error);
+        strfree(error);
+    } else {
+        char reply[32];
+
+        sprintf(reply, "%u", checksum(body, len));
+
+        ResponseStatus(sessionP, 200);
+        ResponseContentType(sessionP, "text/plain");
+        ResponseContentLength(sessionP, strlen(reply));
+        ResponseWriteStart(sessionP);
+        ResponseWriteBody(sessionP, reply, strlen(reply));
+        ResponseWriteEnd(sessionP);
+    }
+    free(body);
+
+    return true;
+}
+
+
+
+static void
+startBodySumServer(struct loopbackServer * const lsP) {
+
+    loopbackServerCreate(lsP);
+
+    /* A small buffer, so most of a body doesn't fit in it */
+    ServerSetConnBufferSize(&lsP->server, 1024);
+    ServerSetKeepaliveTimeout(&lsP->server, 5);
+    ServerSetTimeout(&lsP->server, 5);
+    ServerDefaultHandler(&lsP->server, &bodySumHandler);
+
+    loopbackServerStart(lsP);
+}
+
+
+
+static const char *
+bodySumRequestHeader(size_t       const contentLength,
+                     const char * const extraField) {
+
+    const char * header;
+
+    casprintf(&header,
+              "POST /sum HTTP/1.1\r\n"
+              "Host: localhost\r\n"
+              "Content-Length: %lu\r\n"
+              "%s"
+              "\r\n",
+              (unsigned long)contentLength, extraField);
+
+    return header;
+}
+
+
+
+static bool
+responseHasChecksum(const char * const response,
+                    const char * const body,
+                    size_t       const len) {
+
+    const char * const bodyStart = strstr(response, "\r\n\r\n");
+
+    char expected[32];
+
+    sprintf(expected, "%u", checksum(body, len));
+
+    return
+        strncmp(response, "HTTP/1.1 200", 12) == 0 &&
+        bodyStart && strcmp(bodyStart + 4, expected) == 0;
+}
+
+
+
+static void
+testReadBodySplit(void) {
+/*----------------------------------------------------------------------------
+   A body that arrives with the header, so the first part of it is in the
+   connection buffer and SessionReadBody() has to read the rest straight
+   from the connection.
+-----------------------------------------------------------------------------*/
+    size_t const bodyLen = 20000;
+
+    struct loopbackServer ls;
+    char response[1024];
+    char body[20000];
+    const char * header;
+    char * request;
+    size_t i;
+    int fd;
+
+    for (i = 0; i < bodyLen; ++i)
+        body[i] = 'a' + i % 26;
+
+    header = bodySumRequestHeader(bodyLen, "");
+
+    request = malloc(strlen(header) + bodyLen + 1);
+    TEST(request != NULL);
+    strcpy(request, header);
+    memcpy(&request[strlen(header)], body, bodyLen);
+    request[strlen(header) + bodyLen] = '\0';
+
+    startBodySumServer(&ls);
+
+    fd = loopbackConnect(&ls);
+
+    sendString(fd, request);
+
+    readResponse(fd, response, sizeof(response));
+    TEST(responseHasChecksum(response, body, bodyLen));
+
+    close(fd);
+
+    loopbackServerDestroy(&ls);
+
+    free(request);
+    strfree(header);
+}
+
+
+
+static void
+testReadBodyContinue(void) {
+/*----------------------------------------------------------------------------
+   A client that waits for "100 Continue" before it sends the body.
+-----------------------------------------------------------------------------*/
+    size_t const bodyLen = 5000;
+
+    struct loopbackServer ls;
+    char response[1024];
+    char body[5000 + 1];
+    const char * header;
+    size_t i;
+    size_t len;
+    int fd;
+
+    for (i = 0; i < bodyLen; ++i)
+        body[i] = 'A' + i % 26;
+    body[bodyLen] = '\0';
+
+    header = bodySumRequestHeader(bodyLen, "Expect: 100-continue\r\n");
+
+    startBodySumServer(&ls);
+
+    fd = loopbackConnect(&ls);
+
+    sendString(fd, header);
+
+    /* The server must tell us to go ahead before we send the body */
+    len = readWithTimeout(fd, response, sizeof(response) - 1, 5000);
+    response[len] = '\0';
+    TEST(strncmp(response, "HTTP/1.1 100", 12) == 0);
+    TEST(strstr(response, "\r\n\r\n") != NULL);
+
+    sendString(fd, body);
+
+    readResponse(fd, response, sizeof(response));
+    TEST(responseHasChecksum(response, body, bodyLen));
+
+    close(fd);
+
+    loopbackServerDestroy(&ls);
+
+    strfree(header);
+}
+
+
+
+static void
+testReadBodyShort(void) {
+/*----------------------------------------------------------------------------
+   A client that sends less body than its Content-Length says and then
+   closes its end.  SessionReadBody() must fail rather than wait forever or
+   return a short body.
+-----------------------------------------------------------------------------*/
+    struct loopbackServer ls;
+    char response[1024];
+    char body[5000 + 1];
+    const char * header;
+    int fd;
+
+    memset(body, 'x', 5000);
+    body[5000] = '\0';
+
+    header = bodySumRequestHeader(20000, "");
+
+    startBodySumServer(&ls);
+
+    fd = loopbackConnect(&ls);
+
+    sendString(fd, header);
+    sendString(fd, body);
+    shutdown(fd, SHUT_WR);
+
+    readResponse(fd, response, sizeof(response));
+    TEST(strncmp(response, "HTTP/1.1 400", 12) == 0);
+
+    close(fd);
+
+    loopbackServerDestroy(&ls);
+
+    strfree(header);
+}
+
+
+
+static void
+testConnBufferSize(void) {
+
+    TServer server;
+    abyss_bool success;
+
+    success = ServerCreateNoAccept(&server, NULL, NULL, NULL);
+    TEST(success);
+
+    ServerSetConnBufferSize(&server, 10);
+    TEST(server.srvP->connBufferSize == 1024 + 1);
+
+    ServerSetConnBufferSize(&server, 65536);
+    TEST(server.srvP->connBufferSize == 65536 + 1);
+
+    /* Doesn't wrap around to a tiny buffer */
+    ServerSetConnBufferSize(&server, 0xFFFFFFFF);
+    TEST(server.srvP->connBufferSize > 65536);
+
+    ServerFree(&server);
+}
+
+
+
+/* A recording channel is a channel that just collects what Abyss writes to
+   it, so a test can look at it.  Its sendFile method either works (by
+   reading the file) or fails without sending anything, as sendfile() does
+   on a file it can't handle.
+*/
+
+struct recordingChannel {
+    char         data[64 * 1024];
+    size_t       len;
+    bool         sendFileWorks;
+    unsigned int sendFileCt;
+};
+
+
+
+static void
+recChannelDestroy(TChannel * const channelP ATTR_UNUSED) {
+
+}
+
+
+
+static void
+recChannelWrite(TChannel *            const channelP,
+                const unsigned char * const buffer,
+                uint32_t              const len,
+                TChanWriteExpect      const expectation ATTR_UNUSED,
+                bool *                const failedP) {
+
+    struct recordingChannel * const recP = channelP->implP;
+
+    if (recP->len + len > sizeof(recP->data))
+        *failedP = true;
+    else {
+        memcpy(&recP->data[recP->len], buffer, len);
+        recP->len += len;
+        *failedP = false;
+    }
+}
+
+
+
+static void
+recChannelSendFile(TChannel * const channelP,
+                   int        const fileFd,
+                   uint64_t   const offset,
+                   uint32_t   const len,
+                   uint32_t * const bytesSentP,
+                   bool *     const failedP) {
+
+    struct recordingChannel * const recP = channelP->implP;
+
+    ++recP->sendFileCt;
+
+    if (!recP->sendFileWorks || recP->len + len > sizeof(recP->data)) {
+        *bytesSentP = 0;
+        *failedP    = true;
+    } else {
+        ssize_t const rc =
+            pread(fileFd, &recP->data[recP->len], len, (off_t)offset);
+
+        *bytesSentP = rc > 0 ? (uint32_t)rc : 0;
+        *failedP    = rc < 0;
+        recP->len  += *bytesSentP;
+    }
+}
+
+
+
+static void
+createConnOnRecordingChannel(TServer *                 const serverP,
+                             struct recordingChannel * const recP,
+                             TChannel **               const channelPP,
+                             TConn **                  const connPP) {
+
+    struct TChannelVtbl vtbl;
+    const char * error;
+
+    memset(&vtbl, 0, sizeof(vtbl));
+    vtbl.destroy  = &recChannelDestroy;
+    vtbl.write    = &recChannelWrite;
+    vtbl.sendFile = &recChannelSendFile;
+
+    recP->len        = 0;
+    recP->sendFileCt = 0;
+
+    ChannelCreate(&vtbl, recP, channelPP);
+    TEST(*channelPP != NULL);
+
+    ConnCreate(connPP, serverP, *channelPP, NULL, NULL, 0, NULL,
+               ABYSS_FOREGROUND, NULL, false, &error);
+    TEST_NULL_STRING(error);
+}
+
+
+
+static void
+makeTestFile(char *   const fileName,
+             char *   const contents,
+             uint32_t const size) {
+/*----------------------------------------------------------------------------
+   Create a temporary file of 'size' bytes.  Return its name as 'fileName'
+   and what is in it as 'contents'.
+-----------------------------------------------------------------------------*/
+    uint32_t i;
+    int fd;
+
+    for (i = 0; i < size; ++i)
+        contents[i] = 'a' + i % 26;
+
+    strcpy(fileName, "/tmp/xmlrpc_test_abyss_XXXXXX");
+    fd = mkstemp(fileName);
+    TEST(fd >= 0);
+    TEST(write(fd, contents, size) == (ssize_t)size);
+    close(fd);
+}
+
+
+
+static void
+testConnWriteFromFile(bool     const sendFileWorks,
+                      uint32_t const rate) {
+/*----------------------------------------------------------------------------
+   Send a 25,000-byte file through a connection whose channel's sendFile
+   works or fails per 'sendFileWorks', at 'rate' bytes per second (0 = no
+   limit).
+-----------------------------------------------------------------------------*/
+    uint32_t const fileSize = 25000;
+
+    TServer server;
+    struct recordingChannel rec;
+    TChannel * channelP;
+    TConn * connP;
+    char fileName[64];
+    char contents[25000];
+    char buffer[4096];
+    TFile * fileP;
+    struct timeval start, end;
+    double elapsed;
+    bool success;
+
+    makeTestFile(fileName, contents, fileSize);
+
+    success = ServerCreateNoAccept(&server, NULL, NULL, NULL);
+    TEST(success);
+
+    rec.sendFileWorks = sendFileWorks;
+
+    createConnOnRecordingChannel(&server, &rec, &channelP, &connP);
+
+    success = FileOpen(&fileP, fileName, O_RDONLY);
+    TEST(success);
+
+    gettimeofday(&start, NULL);
+
+    success = ConnWriteFromFile(connP, fileP, 0, fileSize - 1,
+                                buffer, sizeof(buffer), rate);
+
+    gettimeofday(&end, NULL);
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1e6;
+
+    TEST(success);
+    TEST(rec.len == fileSize);
+    TEST(memcmp(rec.data, contents, fileSize) == 0);
+
+    /* When sendFile fails before sending anything, we try it once and then
+       copy the file through the buffer instead.
+    */
+    if (sendFileWorks)
+        TEST(rec.sendFileCt >= 1);
+    else
+        TEST(rec.sendFileCt == 1);
+
+    if (rate > 0) {
+        /* One second's worth goes out at once; the rest at 'rate' */
+        double const expected = (double)(fileSize - rate) / rate;
+
+        TEST(elapsed > expected * 0.8);
+        TEST(elapsed < expected + 3);
+    } else
+        TEST(elapsed < 3);
+
+    FileClose(fileP);
+    ConnWaitAndRelease(connP);
+    ChannelDestroy(channelP);
+    ServerFree(&server);
+    unlink(fileName);
+}
+
+
+
+static void
+testConnWriteFromFileAll(void) {
+
+    testConnWriteFromFile(true,  0);
+    testConnWriteFromFile(false, 0);
+    testConnWriteFromFile(true,  10000);
+    testConnWriteFromFile(false, 10000);
+}
+
+
+
+/* The scatter-gather write tests write more pieces than a channel passes
+   to the OS in one call, some of them empty and some bigger than a TLS
+   record, to a peer that reads slowly, so that the writes stop partway
+   through a piece.
+*/
+
+#define WRITEV_PIECE_CT 200
+
+
+
+static size_t
+makeWritevPieces(unsigned char * const data,
+                 TChannelIoVec * const iov) {
+/*----------------------------------------------------------------------------
+   Divide data[] into WRITEV_PIECE_CT pieces, described by iov[], and fill
+   it with a pattern that shows if any of it arrives out of place.  Return
+   the total size of the pieces.
+
+   data[] must have room for WRITEV_PIECE_CT * 4000 bytes.
+-----------------------------------------------------------------------------*/
+    size_t total;
+    unsigned int i;
+
+    for (i = 0, total = 0; i < WRITEV_PIECE_CT; ++i) {
+        uint32_t const len =
+            i == 101 ? 3 * 16384 + 5 :
+            i == 150 ? 16384 :
+            i % 5 == 0 || i == WRITEV_PIECE_CT - 1 ? 0 :
+            (i * 7919) % 2000 + 1;
+
+        iov[i].buffer = &data[total];
+        iov[i].len    = len;
+
+        total += len;
+    }
+    for (i = 0; i < total; ++i)
+        data[i] = (unsigned char)(i + i / 251);
+
+    return total;
+}
+
+
+
+struct slowReader {
+/*----------------------------------------------------------------------------
+   A thread that reads a socket to end of stream, a little at a time, and
+   signals the writer thread each time, so that the writer keeps finding
+   the socket full and keeps having its writes cut short.
+-----------------------------------------------------------------------------*/
+    int       fd;
+    pthread_t writerThread;
+    char *    buffer;
+    size_t    size;
+    size_t    len;
+        /* How much the thread read */
+    pthread_t thread;
+};
+
+
+
+static void *
+slowReaderRun(void * const arg) {
+
+    struct slowReader * const readerP = arg;
+
+    bool eof;
+
+    for (readerP->len = 0, eof = false; !eof; ) {
+        size_t const got =
+            readWithTimeout(readerP->fd, &readerP->buffer[readerP->len],
+                            MIN(256, readerP->size - readerP->len), 5000);
+
+        if (got == 0)
+            eof = true;
+        else {
+            readerP->len += got;
+            pthread_kill(readerP->writerThread, SIGUSR1);
+            poll(NULL, 0, 1);
+        }
+    }
+    return NULL;
+}
+
+
+
+static void
+ignoreSignal(int const signalClass ATTR_UNUSED) {
+
+}
+
+
+
+static void
+testChannelWritev(void) {
+/*----------------------------------------------------------------------------
+   A blocking sendmsg() returns when a signal arrives after it has sent part
+   of what we gave it.  (If it hasn't sent anything yet, SA_RESTART makes it
+   carry on waiting.)  So the slow reader's signals make the channel pick up
+   partway through a piece over and over.
+-----------------------------------------------------------------------------*/
+    int const sendBufferSize = 4096;
+
+    unsigned char * data;
+    TChannelIoVec iov[WRITEV_PIECE_CT];
+    size_t total;
+    int fds[2];
+    struct sigaction sigAction, oldSigAction;
+    struct slowReader reader;
+    TChannel * channelP;
+    const char * error;
+    bool failed;
+    int rc;
+
+    data = malloc(WRITEV_PIECE_CT * 4000);
+    TEST(data != NULL);
+    total = makeWritevPieces(data, iov);
+
+    rc = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    TEST(rc == 0);
+    rc = setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF,
+                    &sendBufferSize, sizeof(sendBufferSize));
+    TEST(rc == 0);
+
+    memset(&sigAction, 0, sizeof(sigAction));
+    sigAction.sa_handler = &ignoreSignal;
+    sigAction.sa_flags   = SA_RESTART;
+    sigemptyset(&sigAction.sa_mask);
+    rc = sigaction(SIGUSR1, &sigAction, &oldSigAction);
+    TEST(rc == 0);
+
+    reader.fd           = fds[1];
+    reader.writerThread = pthread_self();
+    reader.size         = total + 2;
+    reader.buffer       = malloc(reader.size);
+    TEST(reader.buffer != NULL);
+    rc = pthread_create(&reader.thread, NULL, &slowReaderRun, &reader);
+    TEST(rc == 0);
+
+    channelCreateFd(fds[0], &channelP, &error);
+    TEST_NULL_STRING(error);
+
+    ChannelWritev(channelP, iov, WRITEV_PIECE_CT, CHAN_EXPECT_NOTHING,
+                  &failed);
+    TEST(!failed);
+
+    /* Nothing at all to write is not a failure */
+    ChannelWritev(channelP, iov, 1, CHAN_EXPECT_NOTHING, &failed);
+    TEST(!failed);
+
+    ChannelDestroy(channelP);
+    shutdown(fds[0], SHUT_WR);
+
+    pthread_join(reader.thread, NULL);
+
+    sigaction(SIGUSR1, &oldSigAction, NULL);
+
+    TEST(reader.len == total);
+    TEST(memcmp(reader.buffer, data, total) == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    free(reader.buffer);
+    free(data);
+}
+
+
+
+static void
+testEventDrivenLoopback(void) {
+/*----------------------------------------------------------------------------
+   Serve a keepalive client with the event-driven engine: two requests on
+   one connection, then the connection sits idle until the server closes
+   it for the keepalive timeout.
+-----------------------------------------------------------------------------*/
+    const char * const request =
+        "GET /hello HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "\r\n";
+
+    struct loopbackServer ls;
+    char response[1024];
+    int fd;
+    time_t idleStart;
+
+    loopbackServerCreate(&ls);
+
+    ServerSetEventDriven(&ls.server, true);
+    ServerSetEventThreads(&ls.server, 1, 2);
+    ServerSetKeepaliveTimeout(&ls.server, 1);
+    ServerSetKeepaliveMaxConn(&ls.server, 10);
+    ServerSetTimeout(&ls.server, 5);
+    ServerDefaultHandler(&ls.server, &helloHandler);
+
+    loopbackServerStart(&ls);
+
+    fd = loopbackConnect(&ls);
+
+    sendString(fd, request);
+    readResponse(fd, response, sizeof(response));
+    TEST(strncmp(response, "HTTP/1.1 200", 12) == 0);
+    TEST(strstr(response, "\r\n\r\nhello") != NULL);
+
+    /* The same connection carries a second request */
+    sendString(fd, request);
+    readResponse(fd, response, sizeof(response));
+    TEST(strncmp(response, "HTTP/1.1 200", 12) == 0);
+    TEST(strstr(response, "\r\n\r\nhello") != NULL);
+
+    /* Now idle: the server closes it after the keepalive timeout */
+    idleStart = time(NULL);
+    TEST(readWithTimeout(fd, response, sizeof(response), 10000) == 0);
+    TEST(time(NULL) - idleStart < 5);
+
+    close(fd);
+
+    loopbackServerDestroy(&ls);
+}
+
+
+
+static abyss_bool
+slowHelloHandler(TSession * const sessionP) {
+/*----------------------------------------------------------------------------
+   Like helloHandler, but take half a second about it if the URI is /slow.
+-----------------------------------------------------------------------------*/
+    const TRequestInfo * requestInfoP;
+
+    SessionGetRequestInfo(sessionP, &requestInfoP);
+
+    if (strcmp(requestInfoP->uri, "/slow") == 0)
+        poll(NULL, 0, 500);
+
+    return helloHandler(sessionP);
+}
+
+
+
+static void
+testMaxConnWakeup(void) {
+/*----------------------------------------------------------------------------
+   With the server at its connection limit, a new connection must get
+   served as soon as the one in progress finishes, not when the accept
+   loop next looks on its own (every 2 seconds).
+-----------------------------------------------------------------------------*/
+    struct loopbackServer ls;
+    char response[1024];
+    int slowFd, fd;
+    struct timeval start, end;
+    double elapsed;
+
+    loopbackServerCreate(&ls);
+
+    ServerSetMaxConn(&ls.server, 1);
+    ServerSetKeepaliveTimeout(&ls.server, 5);
+    ServerSetTimeout(&ls.server, 5);
+    ServerDefaultHandler(&ls.server, &slowHelloHandler);
+
+    loopbackServerStart(&ls);
+
+    slowFd = loopbackConnect(&ls);
+    sendString(slowFd,
+               "GET /slow HTTP/1.0\r\n"
+               "\r\n");
+
+    /* Give the server time to start on the slow request */
+    poll(NULL, 0, 100);
+
+    gettimeofday(&start, NULL);
+
+    fd = loopbackConnect(&ls);
+    sendString(fd,
+               "GET /hello HTTP/1.0\r\n"
+               "\r\n");
+
+    readResponse(fd, response, sizeof(response));
+
+    gettimeofday(&end, NULL);
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1e6;
+
+    TEST(strncmp(response, "HTTP/1.1 200", 12) == 0);
+    TEST(strstr(response, "\r\n\r\nhello") != NULL);
+
+    /* The slow request has 0.4 s to go; the accept loop wakes when it is
+       done.
+    */
+    TEST(elapsed < 1.5);
+
+    readResponse(slowFd, response, sizeof(response));
+    TEST(strstr(response, "\r\n\r\nhello") != NULL);
+
+    close(fd);
+    close(slowFd);
+
+    loopbackServerDestroy(&ls);
+}
+
+#endif
+
+
+
+#if HAVE_ABYSS_OPENSSL
+
+static void
+makeTcpConnection(int * const serverFdP,
+                  int * const clientFdP) {
+/*----------------------------------------------------------------------------
+   Make a TCP connection to ourselves over the loopback interface.
+-----------------------------------------------------------------------------*/
+    struct sockaddr_in sockAddr;
+    socklen_t sockAddrLen;
+    int listenFd;
+    int rc;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(listenFd >= 0);
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockAddr.sin_port = 0;  /* Any free port */
+
+    rc = bind(listenFd, (struct sockaddr *)&sockAddr, sizeof(sockAddr));
+    TEST(rc == 0);
+    rc = listen(listenFd, 1);
+    TEST(rc == 0);
+
+    sockAddrLen = sizeof(sockAddr);
+    rc = getsockname(listenFd, (struct sockaddr *)&sockAddr, &sockAddrLen);
+    TEST(rc == 0);
+
+    *clientFdP = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(*clientFdP >= 0);
+    rc = connect(*clientFdP, (struct sockaddr *)&sockAddr, sockAddrLen);
+    TEST(rc == 0);
+
+    *serverFdP = accept(listenFd, NULL, NULL);
+    TEST(*serverFdP >= 0);
+
+    close(listenFd);
+}
+
+
+
+static void
+useNewCertificate(SSL_CTX * const sslCtxP) {
+/*----------------------------------------------------------------------------
+   Give *sslCtxP a new self-signed certificate and its key, so that it can
+   serve TLS connections.
+-----------------------------------------------------------------------------*/
+    EVP_PKEY_CTX * keyCtxP;
+    EVP_PKEY * keyP;
+    X509 * certP;
+    X509_NAME * nameP;
+    int rc;
+
+    keyCtxP = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    TEST(keyCtxP != NULL);
+    rc = EVP_PKEY_keygen_init(keyCtxP);
+    TEST(rc == 1);
+    rc = EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtxP,
+                                                NID_X9_62_prime256v1);
+    TEST(rc == 1);
+    keyP = NULL;
+    rc = EVP_PKEY_keygen(keyCtxP, &keyP);
+    TEST(rc == 1);
+    EVP_PKEY_CTX_free(keyCtxP);
+
+    certP = X509_new();
+    TEST(certP != NULL);
+    X509_set_version(certP, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certP), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certP), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certP), 3600);
+    X509_set_pubkey(certP, keyP);
+
+    nameP = X509_get_subject_name(certP);
+    X509_NAME_add_entry_by_txt(nameP, "CN", MBSTRING_ASC,
+                               (const unsigned char *)"localhost",
+                               -1, -1, 0);
+    X509_set_issuer_name(certP, nameP);
+
+    rc = X509_sign(certP, keyP, EVP_sha256());
+    TEST(rc > 0);
+
+    rc = SSL_CTX_use_certificate(sslCtxP, certP);
+    TEST(rc == 1);
+    rc = SSL_CTX_use_PrivateKey(sslCtxP, keyP);
+    TEST(rc == 1);
+
+    X509_free(certP);
+    EVP_PKEY_free(keyP);
+}
+
+
+
+struct sslReader {
+/*----------------------------------------------------------------------------
+   A thread that connects as a TLS client and reads to end of stream, after
+   a pause that lets the server fill the socket.  It counts the application
+   data records it receives.
+-----------------------------------------------------------------------------*/
+    SSL_CTX *     sslCtxP;
+    int           fd;
+    char *        buffer;
+    size_t        size;
+    size_t        len;
+        /* How much the thread read */
+    unsigned int  recordCt;
+    pthread_t     thread;
+};
+
+
+
+static void
+countAppDataRecord(int          const writeP,
+                   int          const version ATTR_UNUSED,
+                   int          const contentType,
+                   const void * const buf,
+                   size_t       const len,
+                   SSL *        const sslP ATTR_UNUSED,
+                   void *       const arg) {
+
+    struct sslReader * const readerP = arg;
+
+    if (!writeP && contentType == SSL3_RT_HEADER && len > 0 &&
+        ((const unsigned char *)buf)[0] == SSL3_RT_APPLICATION_DATA)
+        ++readerP->recordCt;
+}
+
+
+
+static void *
+sslReaderRun(void * const arg) {
+
+    struct sslReader * const readerP = arg;
+
+    SSL * sslP;
+    int rc;
+
+    sslP = SSL_new(readerP->sslCtxP);
+    TEST(sslP != NULL);
+    SSL_set_fd(sslP, readerP->fd);
+    SSL_set_msg_callback(sslP, &countAppDataRecord);
+    SSL_set_msg_callback_arg(sslP, readerP);
+
+    rc = SSL_connect(sslP);
+    TEST(rc == 1);
+
+    poll(NULL, 0, 100);
+
+    for (readerP->len = 0, rc = 1; rc > 0 && readerP->len < readerP->size; ) {
+        rc = SSL_read(sslP, &readerP->buffer[readerP->len],
+                      readerP->size - readerP->len);
+        if (rc > 0)
+            readerP->len += rc;
+    }
+    SSL_free(sslP);
+
+    return NULL;
+}
+
+
+
+static void
+testOpenSslChannelWritev(void) {
+/*----------------------------------------------------------------------------
+   The OpenSSL channel packs the pieces into full TLS records.
+
+   The client is limited to TLS 1.2 so that everything it receives after the
+   handshake in an application data record is ours: TLS 1.3 hides the
+   handshake in such records too.
+-----------------------------------------------------------------------------*/
+    int const sendBufferSize = 4096;
+    size_t const recordSize = 16384;
+
+    SSL_CTX * serverCtxP;
+    SSL_CTX * clientCtxP;
+    SSL * sslP;
+    unsigned char * data;
+    TChannelIoVec iov[WRITEV_PIECE_CT];
+    size_t total;
+    int serverFd, clientFd;
+    struct sslReader reader;
+    TChannel * channelP;
+    struct abyss_openSsl_chaninfo * channelInfoP;
+    const char * error;
+    bool failed;
+    int rc;
+
+    serverCtxP = SSL_CTX_new(TLS_server_method());
+    TEST(serverCtxP != NULL);
+    useNewCertificate(serverCtxP);
+
+    clientCtxP = SSL_CTX_new(TLS_client_method());
+    TEST(clientCtxP != NULL);
+    SSL_CTX_set_max_proto_version(clientCtxP, TLS1_2_VERSION);
+
+    data = malloc(WRITEV_PIECE_CT * 4000);
+    TEST(data != NULL);
+    total = makeWritevPieces(data, iov);
+
+    makeTcpConnection(&serverFd, &clientFd);
+    rc = setsockopt(serverFd, SOL_SOCKET, SO_SNDBUF,
+                    &sendBufferSize, sizeof(sendBufferSize));
+    TEST(rc == 0);
+
+    reader.sslCtxP  = clientCtxP;
+    reader.fd       = clientFd;
+    reader.size     = total + 1;
+    reader.buffer   = malloc(reader.size);
+    reader.recordCt = 0;
+    TEST(reader.buffer != NULL);
+    rc = pthread_create(&reader.thread, NULL, &sslReaderRun, &reader);
+    TEST(rc == 0);
+
+    sslP = SSL_new(serverCtxP);
+    TEST(sslP != NULL);
+    SSL_set_fd(sslP, serverFd);
+    rc = SSL_accept(sslP);
+    TEST(rc == 1);
+
+    ChannelOpenSslCreateSsl(sslP, &channelP, &channelInfoP, &error);
+    TEST_NULL_STRING(error);
+
+    ChannelWritev(channelP, iov, WRITEV_PIECE_CT, CHAN_EXPECT_NOTHING,
+                  &failed);
+    TEST(!failed);
+
+    ChannelDestroy(channelP);
+    free(channelInfoP);
+
+    SSL_shutdown(sslP);
+    shutdown(serverFd, SHUT_WR);
+
+    pthread_join(reader.thread, NULL);
+
+    TEST(reader.len == total);
+    TEST(memcmp(reader.buffer, data, total) == 0);
+
+    /* Every record but the last is full */
+    TEST(reader.recordCt == (total + recordSize - 1) / recordSize);
+
+    SSL_free(sslP);
+    close(serverFd);
+    close(clientFd);
+    free(reader.buffer);
+    free(data);
+    SSL_CTX_free(clientCtxP);
+    SSL_CTX_free(serverCtxP);
+}
+
+
+
+static void
+sslLoopbackServerCreate(struct loopbackServer * const lsP,
+                        SSL_CTX *               const sslCtxP) {
+/*----------------------------------------------------------------------------
+   Like loopbackServerCreate(), but with an OpenSSL channel switch.
+-----------------------------------------------------------------------------*/
+    const char * error;
+
+    ChanSwitchOpenSslCreateFd(loopbackListenFd(&lsP->portNumber), sslCtxP,
+                              &lsP->chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+
+    ServerCreateSwitch(&lsP->server, lsP->chanSwitchP, &error);
+    TEST_NULL_STRING(error);
+}
+
+
+
+static void
+sslGetHello(struct loopbackServer * const lsP,
+            SSL_CTX *               const sslCtxP,
+            SSL_SESSION *           const sessionP,
+            SSL_SESSION **          const newSessionPP,
+            bool *                  const reusedP) {
+/*----------------------------------------------------------------------------
+   GET /hello from the server over a new TLS connection, offering to resume
+   session *sessionP if 'sessionP' is non-null.
+
+   Return as *newSessionPP the session to offer next time and as *reusedP
+   whether this connection resumed one.
+-----------------------------------------------------------------------------*/
+    const char * const request = "GET /hello HTTP/1.0\r\n\r\n";
+    struct timeval const readTimeout = {5, 0};
+
+    int const fd = loopbackConnect(lsP);
+
+    SSL * sslP;
+    char response[1024];
+    size_t len;
+    int rc;
+
+    /* So a server that doesn't answer fails the test instead of hanging it */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &readTimeout, sizeof(readTimeout));
+
+    sslP = SSL_new(sslCtxP);
+    TEST(sslP != NULL);
+    SSL_set_fd(sslP, fd);
+    if (sessionP)
+        SSL_set_session(sslP, sessionP);
+
+    rc = SSL_connect(sslP);
+    TEST(rc == 1);
+
+    rc = SSL_write(sslP, request, strlen(request));
+    TEST(rc == (int)strlen(request));
+
+    /* Reading also takes in any session ticket the server sends after the
+       handshake.
+    */
+    for (len = 0, rc = 1; rc > 0 && len < sizeof(response) - 1; ) {
+        rc = SSL_read(sslP, &response[len], sizeof(response) - 1 - len);
+        if (rc > 0)
+            len += rc;
+    }
+    response[len] = '\0';
+    TEST(strstr(response, "\r\n\r\nhello") != NULL);
+
+    *reusedP      = SSL_session_reused(sslP);
+    *newSessionPP = SSL_get1_session(sslP);
+
+    /* OpenSSL marks the session not resumable if we don't close properly */
+    SSL_shutdown(sslP);
+    SSL_free(sslP);
+    close(fd);
+}
+
+
+
+static void
+testOpenSslResume(unsigned int const cacheSize,
+                  unsigned int const ticketKeyLifetime,
+                  int          const maxProtoVersion) {
+/*----------------------------------------------------------------------------
+   A client that offers the session of its first connection on its second
+   resumes it, so the switch does one full handshake and one resumption.
+-----------------------------------------------------------------------------*/
+    SSL_CTX * serverCtxP;
+    SSL_CTX * clientCtxP;
+    struct loopbackServer ls;
+    struct abyss_openSsl_sessionparms parms;
+    struct abyss_openSsl_handshakestats stats;
+    SSL_SESSION * session1P;
+    SSL_SESSION * session2P;
+    bool reused;
+    const char * error;
+
+    serverCtxP = SSL_CTX_new(TLS_server_method());
+    TEST(serverCtxP != NULL);
+    useNewCertificate(serverCtxP);
+
+    clientCtxP = SSL_CTX_new(TLS_client_method());
+    TEST(clientCtxP != NULL);
+    SSL_CTX_set_max_proto_version(clientCtxP, maxProtoVersion);
+
+    sslLoopbackServerCreate(&ls, serverCtxP);
+
+    parms.cacheSize         = cacheSize;
+    parms.timeout           = 0;
+    parms.ticketKeyLifetime = ticketKeyLifetime;
+    ChanSwitchOpenSslSetSessionParms(ls.chanSwitchP, &parms, &error);
+    TEST_NULL_STRING(error);
+
+    ServerDefaultHandler(&ls.server, &helloHandler);
+
+    loopbackServerStart(&ls);
+
+    sslGetHello(&ls, clientCtxP, NULL, &session1P, &reused);
+    TEST(!reused);
+    TEST(session1P != NULL);
+
+    sslGetHello(&ls, clientCtxP, session1P, &session2P, &reused);
+    TEST(reused);
+
+    ChanSwitchOpenSslGetHandshakeStats(ls.chanSwitchP, &stats);
+    TEST(stats.fullCt    == 1);
+    TEST(stats.resumedCt == 1);
+    TEST(stats.failedCt  == 0);
+
+    loopbackServerDestroy(&ls);
+
+    SSL_SESSION_free(session2P);
+    SSL_SESSION_free(session1P);
+    SSL_CTX_free(clientCtxP);
+    SSL_CTX_free(serverCtxP);
+}
+
+
+
+static void
+testOpenSslResumeAll(void) {
+
+    /* From the session cache only */
+    testOpenSslResume(100, 0,    TLS1_2_VERSION);
+    testOpenSslResume(100, 0,    0);
+
+    /* From a session ticket only */
+    testOpenSslResume(0,   3600, TLS1_2_VERSION);
+    testOpenSslResume(0,   3600, 0);
+}
+
+
+
+/* The start of a TLS handshake record that claims 512 bytes.  A client
+   that sends this and then nothing more is stuck in the middle of the
+   handshake.
+*/
+static unsigned char const partialRecord[] = {
+    0x16, 0x03, 0x01, 0x02, 0x00, 0x01
+};
+
+
+
+static void
+testOpenSslSlowClientChannel(void) {
+/*----------------------------------------------------------------------------
+   A client that sends part of a TLS record and then nothing more must not
+   hold the server thread past the server's timeout.
+-----------------------------------------------------------------------------*/
+    SSL_CTX * sslCtxP;
+    SSL * sslP;
+    int serverFd, clientFd;
+    TChannel * channelP;
+    struct abyss_openSsl_chaninfo * channelInfoP;
+    TServer server;
+    abyss_bool success;
+    const char * error;
+    time_t start;
+    ssize_t rc;
+
+    sslCtxP = SSL_CTX_new(TLS_server_method());
+    TEST(sslCtxP != NULL);
+
+    makeTcpConnection(&serverFd, &clientFd);
+
+    rc = write(clientFd, partialRecord, sizeof(partialRecord));
+    TEST(rc == sizeof(partialRecord));
+
+    sslP = SSL_new(sslCtxP);
+    TEST(sslP != NULL);
+    SSL_set_fd(sslP, serverFd);
+    SSL_set_accept_state(sslP);
+
+    ChannelOpenSslCreateSsl(sslP, &channelP, &channelInfoP, &error);
+    TEST_NULL_STRING(error);
+
+    success = ServerCreateNoAccept(&server, NULL, NULL, NULL);
+    TEST(success);
+    ServerSetTimeout(&server, 1);
+    ServerSetKeepaliveTimeout(&server, 1);
+
+    start = time(NULL);
+
+    ServerRunChannel(&server, channelP, channelInfoP, &error);
+
+    TEST_NULL_STRING(error);
+    TEST(time(NULL) - start < 5);
+
+    ServerFree(&server);
+
+    ChannelDestroy(channelP);
+    free(channelInfoP);
+    SSL_free(sslP);
+    SSL_CTX_free(sslCtxP);
+    close(serverFd);
+    close(clientFd);
+}
+
+
+
+static void
+testOpenSslSlowClientSwitch(void) {
+/*----------------------------------------------------------------------------
+   While a client that accepted through an OpenSSL channel switch is stuck
+   in the middle of the TLS handshake, the switch accepts and serves
+   another client, and the server drops the stuck one after its timeout.
+-----------------------------------------------------------------------------*/
+    SSL_CTX * serverCtxP;
+    SSL_CTX * clientCtxP;
+    struct loopbackServer ls;
+    struct abyss_openSsl_handshakestats stats;
+    SSL_SESSION * sessionP;
+    bool reused;
+    char buffer[64];
+    int slowFd;
+    time_t start;
+    ssize_t rc;
+
+    serverCtxP = SSL_CTX_new(TLS_server_method());
+    TEST(serverCtxP != NULL);
+    useNewCertificate(serverCtxP);
+
+    clientCtxP = SSL_CTX_new(TLS_client_method());
+    TEST(clientCtxP != NULL);
+
+    sslLoopbackServerCreate(&ls, serverCtxP);
+    ServerSetTimeout(&ls.server, 2);
+    ServerSetKeepaliveTimeout(&ls.server, 2);
+    ServerDefaultHandler(&ls.server, &helloHandler);
+
+    loopbackServerStart(&ls);
+
+    slowFd = loopbackConnect(&ls);
+    rc = write(slowFd, partialRecord, sizeof(partialRecord));
+    TEST(rc == sizeof(partialRecord));
+
+    start = time(NULL);
+
+    /* This fails if the switch is still waiting for the slow client */
+    sslGetHello(&ls, clientCtxP, NULL, &sessionP, &reused);
+    TEST(time(NULL) - start < 2);
+
+    /* The server closes the stuck connection */
+    TEST(readWithTimeout(slowFd, buffer, sizeof(buffer), 10000) == 0);
+    TEST(time(NULL) - start < 5);
+
+    ChanSwitchOpenSslGetHandshakeStats(ls.chanSwitchP, &stats);
+    TEST(stats.fullCt   == 1);
+    TEST(stats.failedCt == 1);
+
+    close(slowFd);
+
+    loopbackServerDestroy(&ls);
+
+    SSL_SESSION_free(sessionP);
+    SSL_CTX_free(clientCtxP);
+    SSL_CTX_free(serverCtxP);
+}
+
+
+
+static void
+testOpenSslSlowClient(void) {
+
+    testOpenSslSlowClientChannel();
+
+    testOpenSslSlowClientSwitch();
+}
+
+#endif
+
+
+
+void
+test_abyss(void) {
+
+    const char * error;
+
+    printf("Running Abyss server tests...\n");
+    
+    AbyssInit(&error);
+    TEST_NULL_STRING(error);
+
+    ChanSwitchInit(&error);
+    TEST_NULL_STRING(error);
+
+    ChannelInit(&error);
+    TEST_NULL_STRING(error);
+
+    testChanSwitch();
+
+    testChannel();
+
+    testOsSocket();
+
+    testSocket();
+
+    testServerCreate();
+
+#ifndef _WIN32
+    testEventDrivenLoopback();
+
+    testMaxConnWakeup();
+
+    testResponseAbort();
+
+    testConnWriteFromFileAll();
+
+    testChannelWritev();
+
+    testReadBodySplit();
+
+    testReadBodyContinue();
+
+    testReadBodyShort();
+
+    testConnBufferSize();
+#endif
+
+#if HAVE_ABYSS_OPENSSL
+    testOpenSslSlowClient();
+
+    testOpenSslChannelWritev();
+
+    testOpenSslResumeAll();
+#endif
 
     ChannelTerm();
     ChanSwitchTerm();
@@ -2,6 +2,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <strings.h>
+#include <pthread.h>
+#endif
 
 #include "xmlrpc_config.h"
 #include "transport_config.h"
@@ -11,6 +20,7 @@
 #include "xmlrpc-c/transport.h"
 
 #include "bool.h"
+#include "casprintf.h"
 #include "testtool.h"
 #include "client.h"
 
@@ -149,12 +159,73 @@ testCreateCurlParms(void) {
     TEST_NO_FAULT(&env);
     xmlrpc_client_destroy(clientP);
 
+    curlTransportParms1.compression_level     = 6;
+    curlTransportParms1.compression_threshold = 512;
+    curlTransportParms1.accept_compressed     = 1;
+
+    clientParms1.transportparm_size = XMLRPC_CXPSIZE(accept_compressed);
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms1, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_client_destroy(clientP);
+
+    curlTransportParms1.no_session_pool   = 0;
+    curlTransportParms1.session_pool_size = 4;
+
+    clientParms1.transportparm_size = XMLRPC_CXPSIZE(session_pool_size);
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms1, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_client_destroy(clientP);
+
+    curlTransportParms1.no_session_pool = 1;
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms1, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_client_destroy(clientP);
+
+    curlTransportParms1.compression_level = 10;
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms1, XMLRPC_CPSIZE(transportparm_size),
+                         &clientP);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);  /* No such zlib level */
+
     xmlrpc_env_clean(&env);
 #endif  /* MUST_BUILD_CURL_CLIENT */
 }
 
 
 
+#if MUST_BUILD_CURL_CLIENT
+
+static void
+getPollfdsNotCalled(xmlrpc_env *                     const envP ATTR_UNUSED,
+                    struct xmlrpc_client_transport * const xportP ATTR_UNUSED,
+                    struct xmlrpc_pollfd *           const fds ATTR_UNUSED,
+                    unsigned int                     const maxCt ATTR_UNUSED,
+                    unsigned int *                   const ctP ATTR_UNUSED,
+                    int *                            const msP ATTR_UNUSED) {
+
+    TEST(false);
+}
+
+
+
+static void
+performAsynchNotCalled(xmlrpc_env *                     const envP ATTR_UNUSED,
+                       struct xmlrpc_client_transport * const xportP
+                       ATTR_UNUSED) {
+
+    TEST(false);
+}
+
+#endif
+
+
+
 static void
 testCreateSeparateXport(void) {
 
@@ -173,6 +244,15 @@ testCreateSeparateXport(void) {
 
     TEST_NO_FAULT(&env);
 
+    {
+        struct xmlrpc_curl_poolstats poolStats;
+
+        xmlrpc_curl_transport_get_pool_stats(transportP, &poolStats);
+        TEST(poolStats.hits == 0);
+        TEST(poolStats.misses == 0);
+        TEST(poolStats.discards == 0);
+    }
+
     clientParms1.transport          = NULL;
     clientParms1.transportparmsP    = NULL;
     clientParms1.transportparm_size = 0;
@@ -227,6 +307,73 @@ testCreateSeparateXport(void) {
 
     xmlrpc_client_destroy(clientP);
 
+    {
+        /* A transport compiled before 'get_pollfds' existed: its ops
+           structure ends at 'set_interrupt', so whatever follows it in
+           memory must not be taken for the newer members.
+        */
+        struct xmlrpc_client_transport_ops oldOps;
+        struct xmlrpc_pollfd pollfds[1];
+        unsigned int pollfdCt;
+        int timeoutMs;
+
+        oldOps = xmlrpc_curl_transport_ops;
+        oldOps.get_pollfds    = &getPollfdsNotCalled;
+        oldOps.perform_asynch = &performAsynchNotCalled;
+
+        clientParms1.transportOpsP = &oldOps;
+
+        xmlrpc_client_create(&env, 0, "", "",
+                             &clientParms1, XMLRPC_CPSIZE(transportP),
+                             &clientP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_client_get_pollfds(&env, clientP, pollfds, 1,
+                                  &pollfdCt, &timeoutMs);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+        xmlrpc_client_event_loop_perform(&env, clientP);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+        xmlrpc_client_destroy(clientP);
+
+        clientParms1.dialect           = xmlrpc_dialect_i8;
+        clientParms1.progressFn        = NULL;
+        clientParms1.transportOps_size = XMLRPC_XOPSIZE(set_interrupt);
+
+        xmlrpc_client_create(&env, 0, "", "",
+                             &clientParms1, XMLRPC_CPSIZE(transportOps_size),
+                             &clientP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_client_get_pollfds(&env, clientP, pollfds, 1,
+                                  &pollfdCt, &timeoutMs);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+        xmlrpc_client_destroy(clientP);
+
+        clientParms1.transportOps_size = 1;
+
+        xmlrpc_client_create(&env, 0, "", "",
+                             &clientParms1, XMLRPC_CPSIZE(transportOps_size),
+                             &clientP);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+            /* Too small to be an ops structure */
+
+        clientParms1.transportOpsP     = &xmlrpc_curl_transport_ops;
+        clientParms1.transportOps_size = XMLRPC_XOPSIZE(perform_asynch);
+
+        xmlrpc_client_create(&env, 0, "", "",
+                             &clientParms1, XMLRPC_CPSIZE(transportOps_size),
+                             &clientP);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_client_get_pollfds(&env, clientP, pollfds, 1,
+                                  &pollfdCt, &timeoutMs);
+        TEST_NO_FAULT(&env);
+
+        xmlrpc_client_destroy(clientP);
+    }
+
     xmlrpc_curl_transport_ops.destroy(transportP);
 
     xmlrpc_env_clean(&env);
@@ -358,6 +505,384 @@ testSynchCall(void) {
 }
 
 
+#if MUST_BUILD_CURL_CLIENT && !defined(_WIN32)
+
+#define CONCURRENT_CALL_CT 4
+
+struct rendezvousServer {
+/*----------------------------------------------------------------------------
+   A minimal HTTP server, in a thread of its own, that answers no RPC until
+   CONCURRENT_CALL_CT of them are waiting for an answer at once, each on its
+   own connection.  It gives up waiting after a few seconds and then answers
+   the ones it has.
+-----------------------------------------------------------------------------*/
+    int listenFd;
+    uint16_t portNumber;
+    pthread_t thread;
+    unsigned int waitingCt;
+        /* The most RPCs that were waiting for an answer at once */
+};
+
+
+
+static bool
+readHttpRequest(int const fd) {
+/*----------------------------------------------------------------------------
+   Read and discard one HTTP request, with a body of the size its
+   Content-Length header says, from 'fd'.  Return false if the connection
+   fails or goes quiet first.
+-----------------------------------------------------------------------------*/
+    char buffer[4096];
+    size_t len;
+    const char * bodyStart;
+    bool failed;
+
+    for (len = 0, bodyStart = NULL, failed = false; !bodyStart && !failed;) {
+        struct pollfd pollfd;
+        ssize_t rc;
+
+        pollfd.fd     = fd;
+        pollfd.events = POLLIN;
+
+        if (len >= sizeof(buffer) - 1 || poll(&pollfd, 1, 5000) != 1)
+            failed = true;
+        else {
+            rc = read(fd, &buffer[len], sizeof(buffer) - 1 - len);
+            if (rc <= 0)
+                failed = true;
+            else {
+                len += rc;
+                buffer[len] = '\0';
+                bodyStart = strstr(buffer, "\r\n\r\n");
+            }
+        }
+    }
+    if (!failed) {
+        size_t const headerLen = bodyStart + 4 - buffer;
+        size_t contentLen;
+        size_t bodyLenRead;
+        const char * p;
+
+        for (p = buffer, contentLen = 0; p < bodyStart; ++p) {
+            if (strncasecmp(p, "\r\nContent-Length:", 17) == 0)
+                contentLen = atoi(p + 17);
+        }
+
+        for (bodyLenRead = len - headerLen;
+             bodyLenRead < contentLen && !failed;) {
+            ssize_t const rc = read(fd, buffer, sizeof(buffer));
+            if (rc <= 0)
+                failed = true;
+            else
+                bodyLenRead += rc;
+        }
+    }
+    return !failed;
+}
+
+
+
+static void *
+rendezvousServerThread(void * const arg) {
+
+    struct rendezvousServer * const serverP = arg;
+
+    const char * const body =
+        "<?xml version=\"1.0\"?>\r\n"
+        "<methodResponse><params><param>"
+        "<value><i4>7</i4></value>"
+        "</param></params></methodResponse>\r\n";
+
+    int connFd[CONCURRENT_CALL_CT];
+    bool timedOut;
+    unsigned int i;
+
+    for (serverP->waitingCt = 0, timedOut = false;
+         serverP->waitingCt < CONCURRENT_CALL_CT && !timedOut;) {
+        struct pollfd pollfd;
+
+        pollfd.fd     = serverP->listenFd;
+        pollfd.events = POLLIN;
+
+        if (poll(&pollfd, 1, 5000) != 1)
+            timedOut = true;
+        else {
+            int const fd = accept(serverP->listenFd, NULL, NULL);
+
+            if (fd >= 0) {
+                if (readHttpRequest(fd))
+                    connFd[serverP->waitingCt++] = fd;
+                else
+                    close(fd);
+            }
+        }
+    }
+    for (i = 0; i < serverP->waitingCt; ++i) {
+        char header[200];
+        ssize_t rc;
+
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/xml\r\n"
+                 "Content-Length: %u\r\n"
+                 "Connection: close\r\n"
+                 "\r\n", (unsigned)strlen(body));
+        rc = write(connFd[i], header, strlen(header));
+        if (rc >= 0)
+            rc = write(connFd[i], body, strlen(body));
+        close(connFd[i]);
+    }
+    close(serverP->listenFd);
+
+    return NULL;
+}
+
+
+
+static void
+rendezvousServerStart(struct rendezvousServer * const serverP) {
+
+    struct sockaddr_in sockAddr;
+    socklen_t sockAddrLen;
+    int rc;
+
+    serverP->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST(serverP->listenFd >= 0);
+
+    memset(&sockAddr, 0, sizeof(sockAddr));
+    sockAddr.sin_family      = AF_INET;
+    sockAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sockAddr.sin_port        = 0;
+
+    rc = bind(serverP->listenFd, (struct sockaddr *)&sockAddr,
+              sizeof(sockAddr));
+    TEST(rc == 0);
+
+    rc = listen(serverP->listenFd, CONCURRENT_CALL_CT);
+    TEST(rc == 0);
+
+    sockAddrLen = sizeof(sockAddr);
+    rc = getsockname(serverP->listenFd, (struct sockaddr *)&sockAddr,
+                     &sockAddrLen);
+    TEST(rc == 0);
+    serverP->portNumber = ntohs(sockAddr.sin_port);
+
+    rc = pthread_create(&serverP->thread, NULL, &rendezvousServerThread,
+                        serverP);
+    TEST(rc == 0);
+}
+
+
+
+struct concurrentCaller {
+    pthread_t thread;
+    xmlrpc_client * clientP;
+    const char * serverUrl;
+    xmlrpc_env env;
+    xmlrpc_int32 result;
+};
+
+
+
+static void *
+concurrentCallerThread(void * const arg) {
+
+    struct concurrentCaller * const callerP = arg;
+
+    xmlrpc_value * resultP;
+
+    xmlrpc_client_call2f(&callerP->env, callerP->clientP, callerP->serverUrl,
+                         "test", &resultP, "()");
+
+    if (!callerP->env.fault_occurred) {
+        xmlrpc_read_int(&callerP->env, resultP, &callerP->result);
+        xmlrpc_DECREF(resultP);
+    }
+    return NULL;
+}
+
+#endif
+
+
+
+static void
+testSynchCallConcurrent(void) {
+/*----------------------------------------------------------------------------
+   Test that threads sharing a client can have synchronous RPCs in progress
+   at the same time.  The server answers none of them until all of them
+   have arrived, so if the client made them one at a time, all but the
+   first would fail.
+-----------------------------------------------------------------------------*/
+#if MUST_BUILD_CURL_CLIENT && !defined(_WIN32)
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    struct xmlrpc_clientparms clientParms;
+    struct rendezvousServer server;
+    struct concurrentCaller caller[CONCURRENT_CALL_CT];
+    const char * serverUrl;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    clientParms.transport = "curl";
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms, XMLRPC_CPSIZE(transport), &clientP);
+    TEST_NO_FAULT(&env);
+
+    rendezvousServerStart(&server);
+
+    casprintf(&serverUrl, "http://127.0.0.1:%u/RPC2",
+              (unsigned)server.portNumber);
+
+    for (i = 0; i < CONCURRENT_CALL_CT; ++i) {
+        int rc;
+
+        caller[i].clientP   = clientP;
+        caller[i].serverUrl = serverUrl;
+        caller[i].result    = 0;
+        xmlrpc_env_init(&caller[i].env);
+
+        rc = pthread_create(&caller[i].thread, NULL, &concurrentCallerThread,
+                            &caller[i]);
+        TEST(rc == 0);
+    }
+    for (i = 0; i < CONCURRENT_CALL_CT; ++i) {
+        pthread_join(caller[i].thread, NULL);
+        TEST_NO_FAULT(&caller[i].env);
+        TEST(caller[i].result == 7);
+        xmlrpc_env_clean(&caller[i].env);
+    }
+    pthread_join(server.thread, NULL);
+
+    TEST(server.waitingCt == CONCURRENT_CALL_CT);
+
+    strfree(serverUrl);
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+#endif
+}
+
+
+
+
+#if MUST_BUILD_CURL_CLIENT
+
+#define MAX_POLLFDS 16
+
+static void
+handleNoSuchServer(const char *   const serverUrl ATTR_UNUSED,
+                   const char *   const methodName ATTR_UNUSED,
+                   xmlrpc_value * const paramArrayP ATTR_UNUSED,
+                   void *         const userHandle,
+                   xmlrpc_env *   const faultP,
+                   xmlrpc_value * const resultP ATTR_UNUSED) {
+
+    int * const doneP = userHandle;
+
+    TEST(faultP->fault_occurred);
+
+    *doneP = 1;
+}
+
+#endif
+
+
+
+static void
+testExternalEventLoop(void) {
+
+#if MUST_BUILD_CURL_CLIENT
+    xmlrpc_env env;
+    xmlrpc_client * clientP;
+    struct xmlrpc_clientparms clientParms;
+    struct xmlrpc_pollfd pollfds[MAX_POLLFDS];
+    unsigned int pollfdCt;
+    int timeoutMs;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_client_setup_global_const(&env);
+    TEST_NO_FAULT(&env);
+
+    clientParms.transport = "curl";
+
+    xmlrpc_client_create(&env, 0, "testprog", "1.0",
+                         &clientParms, XMLRPC_CPSIZE(transport), &clientP);
+    TEST_NO_FAULT(&env);
+
+    /* No RPCs, so nothing to wait for */
+    xmlrpc_client_get_pollfds(&env, clientP, pollfds, MAX_POLLFDS,
+                              &pollfdCt, &timeoutMs);
+    TEST_NO_FAULT(&env);
+    TEST(pollfdCt <= MAX_POLLFDS);
+    TEST(timeoutMs == -1);
+
+    xmlrpc_client_event_loop_perform(&env, clientP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_client_get_pollfds(&env, clientP, pollfds, 0,
+                              &pollfdCt, &timeoutMs);
+    TEST_NO_FAULT(&env);
+
+#ifndef _WIN32
+    {
+        int done;
+        unsigned int i;
+
+        done = 0;
+
+        xmlrpc_client_start_rpcf(&env, clientP, "http://localhost:1/RPC2",
+                                 "nosuchmethod", &handleNoSuchServer, &done,
+                                 "()");
+        TEST_NO_FAULT(&env);
+
+        /* Drive the RPC to completion (a connection failure) ourselves */
+        for (i = 0; i < 1000 && !done; ++i) {
+            struct pollfd sysPollfds[MAX_POLLFDS];
+            unsigned int j;
+
+            xmlrpc_client_get_pollfds(&env, clientP, pollfds, MAX_POLLFDS,
+                                      &pollfdCt, &timeoutMs);
+            TEST_NO_FAULT(&env);
+            TEST(pollfdCt <= MAX_POLLFDS);
+
+            for (j = 0; j < pollfdCt; ++j) {
+                sysPollfds[j].fd = pollfds[j].fd;
+                sysPollfds[j].events =
+                    (pollfds[j].events & XMLRPC_POLL_IN  ? POLLIN  : 0) |
+                    (pollfds[j].events & XMLRPC_POLL_OUT ? POLLOUT : 0);
+            }
+            poll(sysPollfds, pollfdCt, timeoutMs < 0 ? 100 : timeoutMs);
+
+            xmlrpc_client_event_loop_perform(&env, clientP);
+            TEST_NO_FAULT(&env);
+        }
+        TEST(done);
+
+        xmlrpc_client_get_pollfds(&env, clientP, pollfds, MAX_POLLFDS,
+                                  &pollfdCt, &timeoutMs);
+        TEST_NO_FAULT(&env);
+        TEST(timeoutMs == -1);
+    }
+#endif
+
+    xmlrpc_client_destroy(clientP);
+
+    xmlrpc_client_teardown_global_const();
+
+    xmlrpc_env_clean(&env);
+#endif  /* MUST_BUILD_CURL_CLIENT */
+}
+
+
 
 static void
 testInitCleanup(void) {
@@ -513,6 +1038,8 @@ test_client(void) {
     printf("\n");
     testServerInfo();
     testSynchCall();
+    testSynchCallConcurrent();
+    testExternalEventLoop();
 
     printf("\n");
     printf("Client tests done.\n");
@@ -328,6 +328,15 @@ public:
                                     .logFileName("/tmp/logfile")
                                     .serverOwnsSignals(false)
                                     .expectSigchld(true)
+                                    .eventDriven(true)
+                                    .eventIoThreads(2)
+                                    .eventWorkers(8)
+                                    .threadPoolMin(2)
+                                    .threadPoolMax(8)
+                                    .threadPoolIdleTimeout(30)
+                                    .compressionLevel(6)
+                                    .compressionThreshold(512)
+                                    .connBufferSize(65536)
                 );
     
         }
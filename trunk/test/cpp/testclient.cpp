@@ -15,6 +15,7 @@
 #include <time.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include "xmlrpc-c/girerr.hpp"
 using girerr::error;
@@ -163,6 +164,106 @@ public:
         TEST(rpcSampleAdd1P->isSuccessful());
         value_int const result2(rpcSampleAdd2P->getResult());
         TEST(static_cast<int>(result2) == 20);
+
+        // Nothing is ever outstanding, so there is nothing to wait for
+        vector<struct xmlrpc_pollfd> pollfds;
+        timeout pollTimeout(50);
+        clientDirect.getPollfds(&pollfds, &pollTimeout);
+        TEST(pollfds.size() == 0);
+        TEST(!pollTimeout.finite);
+        clientDirect.performAsync();
+    }
+};
+
+
+
+class clientMulticallTestSuite : public testSuite {
+/*----------------------------------------------------------------------------
+   The object of this class tests a client coalescing RPCs into
+   system.multicall RPCs.  We use a clientXmlTransport_direct object;
+   see clientDirectTestSuite.
+-----------------------------------------------------------------------------*/
+public:
+    virtual string suiteName() {
+        return "clientMulticallTestSuite";
+    }
+    virtual void runtests(unsigned int const) {
+
+        registry myRegistry;
+
+        myRegistry.addMethod("sample.add", methodPtr(new sampleAddMethod));
+
+        carriageParm_direct carriageParmDirect(&myRegistry);
+        carriageParm_direct carriageParmDirect2(&myRegistry);
+        clientXmlTransport_direct transportDirect;
+        client_xml clientDirect(&transportDirect);
+
+        clientDirect.setMulticall(3, 60000);
+
+        vector<rpcPtr> rpcs;
+
+        for (int i = 0; i < 5; ++i) {
+            paramList params;
+            params.add(value_int(i));
+            params.add(value_int(100));
+            rpcs.push_back(rpcPtr("sample.add", params));
+        }
+        paramList paramListBad;
+        paramListBad.add(value_int(1));
+        rpcPtr const rpcBadP("sample.add", paramListBad);
+        rpcPtr const rpcNoSuchP("nosuchmethod", paramList());
+
+        rpcs[0]->start(&clientDirect, &carriageParmDirect);
+        rpcs[1]->start(&clientDirect, &carriageParmDirect);
+        TEST(!rpcs[0]->isFinished());
+        TEST(!rpcs[1]->isFinished());
+
+        // This fills the batch, so it goes
+        rpcBadP->start(&clientDirect, &carriageParmDirect);
+        TEST(rpcs[0]->isFinished());
+        TEST(rpcs[1]->isFinished());
+        TEST(rpcBadP->isFinished());
+        TEST(!rpcBadP->isSuccessful());
+        rpcBadP->getFault();  // An XML-RPC fault, not a failure to execute
+
+        rpcs[2]->start(&clientDirect, &carriageParmDirect);
+        rpcNoSuchP->start(&clientDirect, &carriageParmDirect);
+
+        // A different carriage parameter ends the batch
+        rpcs[3]->start(&clientDirect, &carriageParmDirect2);
+        TEST(rpcs[2]->isFinished());
+        TEST(rpcNoSuchP->isFinished());
+        TEST(!rpcNoSuchP->isSuccessful());
+        TEST(rpcNoSuchP->getFault().getCode() == fault::CODE_NO_SUCH_METHOD);
+        TEST(!rpcs[3]->isFinished());
+
+        // The batch waits for more RPCs until its time is up
+        vector<struct xmlrpc_pollfd> pollfds;
+        timeout pollTimeout;
+        clientDirect.getPollfds(&pollfds, &pollTimeout);
+        TEST(pollTimeout.finite);
+        TEST(pollTimeout.duration <= 60000);
+        clientDirect.performAsync();
+        TEST(!rpcs[3]->isFinished());
+
+        clientDirect.finishAsync(timeout());
+        TEST(rpcs[3]->isFinished());
+
+        // With a zero window, every RPC goes by itself as it starts
+        clientDirect.setMulticall(3, 0);
+        rpcs[4]->start(&clientDirect, &carriageParmDirect);
+        TEST(rpcs[4]->isFinished());
+
+        for (int i = 0; i < 5; ++i) {
+            TEST(rpcs[i]->isSuccessful());
+            TEST(static_cast<int>(value_int(rpcs[i]->getResult())) ==
+                 i + 100);
+        }
+        multicallStats const stats(clientDirect.getMulticallStats());
+        TEST(stats.batchCt == 2);
+        TEST(stats.batchedRpcCt == 5);
+        TEST(stats.singleRpcCt == 2);
+        TEST(stats.maxBatchSize == 3);
     }
 };
 
@@ -310,6 +411,8 @@ public:
 
         clientDirectAsyncTestSuite().run(indentation+1);
 
+        clientMulticallTestSuite().run(indentation+1);
+
         clientDerivedRpcTestSuite().run(indentation+1);
     }
 };
@@ -362,12 +465,22 @@ public:
             .tcp_keepalive(true)
             .tcp_keepidle_sec(5)
             .tcp_keepintvl_sec(4)
+            .compression_level(6)
+            .compression_threshold(512)
+            .accept_compressed(true)
+            .no_session_pool(false)
+            .session_pool_size(4)
             );
 
         clientXmlTransport_curl transport5(
             clientXmlTransport_curl::constrOpt()
             .no_ssl_verifypeer(false));
 
+        xmlrpc_curl_poolstats const poolStats(transport5.poolStats());
+        TEST(poolStats.hits == 0);
+        TEST(poolStats.misses == 0);
+        TEST(poolStats.discards == 0);
+
         clientXmlTransport_curl transport6(
             clientXmlTransport_curl::constrOpt());
 
@@ -680,6 +793,33 @@ public:
         TEST(rpc2P->isFinished());
         TEST(!rpc2P->isSuccessful());
 
+        rpcPtr rpc4P("blowme", paramList0);
+        // This RPC fails to execute because the server doesn't exist.
+        // We drive it to completion with our own poll() loop.
+        rpc4P->start(&client0, &carriageParmCurl);
+
+        for (unsigned int i = 0; i < 1000 && !rpc4P->isFinished(); ++i) {
+            vector<struct xmlrpc_pollfd> pollfds;
+            timeout pollTimeout;
+
+            client0.getPollfds(&pollfds, &pollTimeout);
+
+            vector<struct pollfd> sysPollfds(pollfds.size() + 1);
+
+            for (unsigned int j = 0; j < pollfds.size(); ++j) {
+                sysPollfds[j].fd = pollfds[j].fd;
+                sysPollfds[j].events =
+                    (pollfds[j].events & XMLRPC_POLL_IN  ? POLLIN  : 0) |
+                    (pollfds[j].events & XMLRPC_POLL_OUT ? POLLOUT : 0);
+            }
+            poll(&sysPollfds[0], pollfds.size(),
+                 pollTimeout.finite ? pollTimeout.duration : 100);
+
+            client0.performAsync();
+        }
+        TEST(rpc4P->isFinished());
+        TEST(!rpc4P->isSuccessful());
+
         clientCurlIntTestSuite().run(indentation+1);
 #else
         // This fails because there is no Curl transport in the library.
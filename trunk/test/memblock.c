@@ -156,6 +156,69 @@ testMemPool(void) {
 
 
 
+static void
+testMemPoolChargeArena(void) {
+
+    xmlrpc_env env;
+
+    xmlrpc_mem_pool * poolP;
+    xmlrpc_mem_pool * arenaP;
+    void * p;
+
+    xmlrpc_env_init(&env);
+
+    poolP = xmlrpc_mem_pool_new(&env, 100*1000);
+    TEST_NO_FAULT(&env);
+
+    arenaP = xmlrpc_mem_pool_new(&env, (size_t)-1);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_mem_pool_charge_arena(arenaP, poolP);
+
+    p = xmlrpc_mem_pool_get(&env, arenaP, 1000);
+    TEST_NO_FAULT(&env);
+    TEST(p != NULL);
+
+    /* The arena would grow past the limit of the pool it charges */
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        p = xmlrpc_mem_pool_get(&env2, arenaP, 200*1000);
+        TEST_FAULT(&env2, XMLRPC_LIMIT_EXCEEDED_ERROR);
+        TEST(p == NULL);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* The arena's growth counts against the pool */
+    {
+        xmlrpc_env env2;
+        xmlrpc_env_init(&env2);
+        xmlrpc_mem_pool_alloc(&env2, poolP, 100*1000);
+        TEST_FAULT(&env2, XMLRPC_LIMIT_EXCEEDED_ERROR);
+        xmlrpc_env_clean(&env2);
+    }
+
+    /* Once we stop charging, the pool gets it all back, and the arena can
+       grow without bound.
+    */
+    xmlrpc_mem_pool_charge_arena(arenaP, NULL);
+
+    xmlrpc_mem_pool_alloc(&env, poolP, 100*1000);
+    TEST_NO_FAULT(&env);
+    xmlrpc_mem_pool_release(poolP, 100*1000);
+
+    p = xmlrpc_mem_pool_get(&env, arenaP, 200*1000);
+    TEST_NO_FAULT(&env);
+    TEST(p != NULL);
+
+    xmlrpc_mem_pool_free(arenaP);
+    xmlrpc_mem_pool_free(poolP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 testMemBlockPool(void) {
 
@@ -228,6 +291,8 @@ test_memBlock() {
 
     testMemPool();
 
+    testMemPoolChargeArena();
+
     testMemBlockPool();
 
     printf("\n");
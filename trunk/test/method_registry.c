@@ -431,6 +431,117 @@ test_disable_introspection(void) {
 
 
 
+static xmlrpc_value *
+test_serverInfoNumber(xmlrpc_env *   const envP,
+                      xmlrpc_value * const paramArrayP ATTR_UNUSED,
+                      void *         const serverInfo,
+                      void *         const callInfo ATTR_UNUSED) {
+
+    return xmlrpc_int_new(envP, (xmlrpc_int)(unsigned long)serverInfo);
+}
+
+
+
+static void
+testFrozenCall(xmlrpc_registry * const registryP,
+               unsigned int      const methodNum) {
+
+    xmlrpc_env env;
+    char methodName[32];
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    xmlrpc_int result;
+
+    xmlrpc_env_init(&env);
+
+    sprintf(methodName, "test.method%u", methodNum);
+
+    argArrayP = xmlrpc_array_new(&env);
+    doRpc(&env, registryP, methodName, argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_read_int(&env, resultP, &result);
+    TEST_NO_FAULT(&env);
+    TEST(result == (xmlrpc_int)methodNum);
+    xmlrpc_DECREF(resultP);
+    xmlrpc_DECREF(argArrayP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_freeze(void) {
+
+    unsigned int const methodCt = 900;
+
+    xmlrpc_env env;
+    xmlrpc_registry * registryP;
+    xmlrpc_value * argArrayP;
+    xmlrpc_value * resultP;
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    printf("  Running freeze tests.");
+
+    registryP = xmlrpc_registry_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCt; ++i) {
+        char methodName[32];
+        sprintf(methodName, "test.method%u", i);
+        xmlrpc_registry_add_method2(&env, registryP, methodName,
+                                    test_serverInfoNumber, NULL, NULL,
+                                    (void*)(unsigned long)i);
+        TEST_NO_FAULT(&env);
+    }
+    xmlrpc_registry_add_method2(&env, registryP, "test.method0",
+                                test_serverInfoNumber, NULL, NULL, NULL);
+    TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+
+    xmlrpc_registry_freeze(&env, registryP);
+    TEST_NO_FAULT(&env);
+
+    /* Freezing twice is harmless */
+    xmlrpc_registry_freeze(&env, registryP);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < methodCt; ++i)
+        testFrozenCall(registryP, i);
+
+    argArrayP = xmlrpc_array_new(&env);
+    doRpc(&env, registryP, "test.method900", argArrayP, NULL, &resultP);
+    TEST_FAULT(&env, XMLRPC_NO_SUCH_METHOD_ERROR);
+
+    xmlrpc_DECREF(argArrayP);
+    argArrayP = xmlrpc_build_value(&env, "(s)", "test.method1");
+    doRpc(&env, registryP, "system.methodExist", argArrayP, NULL, &resultP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(resultP);
+
+    /* Adding a method to a frozen registry works */
+    xmlrpc_registry_add_method2(&env, registryP, "test.method900",
+                                test_serverInfoNumber, NULL, NULL,
+                                (void*)(unsigned long)900);
+    TEST_NO_FAULT(&env);
+    testFrozenCall(registryP, 900);
+    testFrozenCall(registryP, 17);
+
+    xmlrpc_registry_freeze(&env, registryP);
+    TEST_NO_FAULT(&env);
+    testFrozenCall(registryP, 900);
+
+    xmlrpc_DECREF(argArrayP);
+    xmlrpc_registry_free(registryP);
+
+    xmlrpc_env_clean(&env);
+
+    printf("\n");
+}
+
+
+
 static const char * const expectedMethodName[] = {
 /*----------------------------------------------------------------------------
    The list we expect back from system.listMethods.
@@ -1115,6 +1226,8 @@ test_method_registry(void) {
 
     test_disable_introspection();
 
+    test_freeze();
+
     test_apache_dialect();
     
     /* Test cleanup code (w/memprof). */
@@ -3,9 +3,13 @@
 
 #include "xmlrpc_config.h"
 
+#include "girmath.h"
 #include "girstring.h"
 #include "casprintf.h"
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
+#include "xmlrpc_parse.h"
+#include "parse_stream.h"
 
 #include "testtool.h"
 #include "xml_data.h"
@@ -174,6 +178,107 @@ char const xmldata[] =
 
 
 
+static void
+testParseDatetimeForm(const char * const dtString,
+                      unsigned int const Y,
+                      unsigned int const M,
+                      unsigned int const D,
+                      unsigned int const h,
+                      unsigned int const m,
+                      unsigned int const s,
+                      unsigned int const u) {
+
+    xmlrpc_env env;
+    const char * xml;
+    xmlrpc_value * valueP;
+    xmlrpc_datetime dt;
+
+    xmlrpc_env_init(&env);
+
+    casprintf(&xml, "<value><dateTime.iso8601>%s</dateTime.iso8601>"
+              "</value>", dtString);
+
+    xmlrpc_parse_value_xml(&env, xml, strlen(xml), &valueP);
+    TEST_NO_FAULT(&env);
+
+    xmlrpc_read_datetime(&env, valueP, &dt);
+    TEST_NO_FAULT(&env);
+
+    TEST(dt.Y == Y);
+    TEST(dt.M == M);
+    TEST(dt.D == D);
+    TEST(dt.h == h);
+    TEST(dt.m == m);
+    TEST(dt.s == s);
+    TEST(dt.u == u);
+
+    xmlrpc_DECREF(valueP);
+    strfree(xml);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testParseDatetimeBad(const char * const dtString) {
+
+    xmlrpc_env env;
+    const char * xml;
+    xmlrpc_value * valueP;
+
+    xmlrpc_env_init(&env);
+
+    casprintf(&xml, "<value><dateTime.iso8601>%s</dateTime.iso8601>"
+              "</value>", dtString);
+
+    xmlrpc_parse_value_xml(&env, xml, strlen(xml), &valueP);
+    TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+    strfree(xml);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testParseDatetime(void) {
+/*----------------------------------------------------------------------------
+   Test the various forms of <dateTime.iso8601> we recognize, and some we
+   don't.
+-----------------------------------------------------------------------------*/
+    testParseDatetimeForm("19980717T14:08:55", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("1998-07-17T14:08:55", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T140855", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("1998-0717t1408:55", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T14:08:55.", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T14:08:55.5", 1998, 7, 17, 14, 8, 55,
+                          500000);
+    testParseDatetimeForm("19980717T14:08:55.1234567", 1998, 7, 17, 14, 8, 55,
+                          123456);
+    testParseDatetimeForm("19980717T14:08:55.12z", 1998, 7, 17, 14, 8, 55,
+                          120000);
+    testParseDatetimeForm("19980717T14:08:5512", 1998, 7, 17, 14, 8, 55,
+                          120000);
+    testParseDatetimeForm("19980717T14:08:55+05", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T14:08:55-0530", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T14:08:55-", 1998, 7, 17, 14, 8, 55, 0);
+    testParseDatetimeForm("19980717T14:08:55Z05Z", 1998, 7, 17, 14, 8, 55, 0);
+
+    testParseDatetimeBad("");
+    testParseDatetimeBad("1998071714:08:55");
+    testParseDatetimeBad("19980717T14:08");
+    testParseDatetimeBad("1998--0717T14:08:55");
+    testParseDatetimeBad("19980717T14:08:55+5");
+    testParseDatetimeBad("19980717T14:08:55+05300");
+    testParseDatetimeBad("19980717T14:08:55.5+05");
+    testParseDatetimeBad("19980717T14:08:55ZZZ");
+    testParseDatetimeBad("19980717T14:08:55 ");
+    testParseDatetimeBad("19981317T14:08:55");
+    testParseDatetimeBad("19980717T24:08:55");
+}
+
+
+
 static void
 validateParseResponseResult(xmlrpc_value * const valueP) {
 
@@ -492,6 +597,350 @@ testParseXmlCall(void) {
 
 
 
+/* A call with every kind of value, and text that has entity references,
+   a character reference and a CDATA section in it, so that a split can
+   fall inside any of those.
+*/
+static const char * const pushCall =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+    "<methodCall>\r\n"
+    "<methodName>sample.push&amp;pull</methodName>\r\n"
+    "<params>\r\n"
+    "<param><value><i4>-12345</i4></value></param>\r\n"
+    "<param><value><boolean>1</boolean></value></param>\r\n"
+    "<param><value><double>3.25</double></value></param>\r\n"
+    "<param><value><string>a &lt;b&gt; &#233; <![CDATA[<c>]]></string>"
+    "</value></param>\r\n"
+    "<param><value>untyped</value></param>\r\n"
+    "<param><value><dateTime.iso8601>20261017T12:34:56</dateTime.iso8601>"
+    "</value></param>\r\n"
+    "<param><value><base64>YmFzZTY0IGRhdGE=</base64></value></param>\r\n"
+    "<param><value><array><data>\r\n"
+    "<value><int>1</int></value>\r\n"
+    "<value><struct>\r\n"
+    "<member><name>x</name><value><string>y</string></value></member>\r\n"
+    "<member><name>empty</name><value><array><data></data></array>"
+    "</value></member>\r\n"
+    "</struct></value>\r\n"
+    "</data></array></value></param>\r\n"
+    "</params>\r\n"
+    "</methodCall>\r\n";
+
+
+
+static void
+parseCallInPieces(xmlrpc_env *    const envP,
+                  const char *    const xml,
+                  const size_t *  const cuts,
+                  unsigned int    const cutCt,
+                  bool            const inArena,
+                  const char **   const methodNameP,
+                  xmlrpc_value ** const paramArrayPP) {
+/*----------------------------------------------------------------------------
+   Parse the call 'xml' with an xmlrpc_callParser, feeding it the pieces
+   between the offsets cuts[0], cuts[1], ... (ascending).
+-----------------------------------------------------------------------------*/
+    size_t const xmlLen = strlen(xml);
+
+    xmlrpc_callParser * parserP;
+    size_t pos;
+    unsigned int i;
+
+    xmlrpc_callParserCreate(envP, NULL, inArena, &parserP);
+    TEST_NO_FAULT(envP);
+
+    for (i = 0, pos = 0; i <= cutCt && !envP->fault_occurred; ++i) {
+        size_t const end = i < cutCt ? cuts[i] : xmlLen;
+
+        xmlrpc_callParserFeed(envP, parserP, &xml[pos], end - pos);
+
+        pos = end;
+    }
+    if (!envP->fault_occurred)
+        xmlrpc_callParserFinish(envP, parserP, methodNameP, paramArrayPP);
+
+    xmlrpc_callParserDestroy(parserP);
+}
+
+
+
+static void
+testPushParseSame(const char *   const xml,
+                  const size_t * const cuts,
+                  unsigned int   const cutCt,
+                  bool           const inArena,
+                  const char *   const expMethodName,
+                  const char *   const expParams,
+                  size_t         const expParamsLen) {
+/*----------------------------------------------------------------------------
+   Parse 'xml' in pieces and check that we get method name 'expMethodName'
+   and a parameter array that serializes as 'expParams'.
+-----------------------------------------------------------------------------*/
+    xmlrpc_env env;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_mem_block * serializedP;
+
+    xmlrpc_env_init(&env);
+
+    parseCallInPieces(&env, xml, cuts, cutCt, inArena,
+                      &methodName, &paramArrayP);
+    TEST_NO_FAULT(&env);
+
+    TEST(streq(methodName, expMethodName));
+
+    serializedP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, serializedP, paramArrayP);
+    TEST_NO_FAULT(&env);
+
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, serializedP) == expParamsLen);
+    TEST(memcmp(XMLRPC_MEMBLOCK_CONTENTS(char, serializedP), expParams,
+                expParamsLen) == 0);
+
+    XMLRPC_MEMBLOCK_FREE(char, serializedP);
+    xmlrpc_DECREF(paramArrayP);
+    strfree(methodName);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testPushParseGood(bool const inArena) {
+/*----------------------------------------------------------------------------
+   However the call is split, the push parser must get the same result as
+   xmlrpc_parseCallStream() does with the whole thing.
+-----------------------------------------------------------------------------*/
+    size_t const xmlLen = strlen(pushCall);
+
+    xmlrpc_env env;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_mem_block * expParamsP;
+    const char * expParams;
+    size_t expParamsLen;
+    size_t * cuts;
+    unsigned int cutCt;
+    unsigned int seed;
+    size_t i;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_parseCallStream(&env, pushCall, xmlLen, NULL, false,
+                           &methodName, &paramArrayP);
+    TEST_NO_FAULT(&env);
+    TEST(streq(methodName, "sample.push&pull"));
+    TEST(xmlrpc_array_size(&env, paramArrayP) == 8);
+
+    expParamsP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, expParamsP, paramArrayP);
+    TEST_NO_FAULT(&env);
+    expParams    = XMLRPC_MEMBLOCK_CONTENTS(char, expParamsP);
+    expParamsLen = XMLRPC_MEMBLOCK_SIZE(char, expParamsP);
+
+    cuts = malloc(xmlLen * sizeof(cuts[0]));
+    TEST(cuts != NULL);
+
+    /* All in one piece */
+    testPushParseSame(pushCall, cuts, 0, inArena, methodName,
+                      expParams, expParamsLen);
+
+    /* One byte at a time */
+    for (i = 1; i < xmlLen; ++i)
+        cuts[i-1] = i;
+    testPushParseSame(pushCall, cuts, xmlLen - 1, inArena, methodName,
+                      expParams, expParamsLen);
+
+    /* Two pieces, split at every possible place, including an empty
+       piece at either end
+    */
+    for (i = 0; i <= xmlLen; ++i) {
+        cuts[0] = i;
+        testPushParseSame(pushCall, cuts, 1, inArena, methodName,
+                          expParams, expParamsLen);
+    }
+
+    /* Pieces of pseudo-random sizes from 0 to 31 */
+    for (seed = 1; seed <= 50; ++seed) {
+        unsigned int randNum;
+        size_t pos;
+
+        for (cutCt = 0, pos = 0, randNum = seed; pos < xmlLen; ++cutCt) {
+            randNum = randNum * 1103515245 + 12345;
+            pos = MIN(xmlLen, pos + (randNum >> 16) % 32);
+            cuts[cutCt] = pos;
+        }
+        testPushParseSame(pushCall, cuts, cutCt, inArena, methodName,
+                          expParams, expParamsLen);
+    }
+    free(cuts);
+    XMLRPC_MEMBLOCK_FREE(char, expParamsP);
+    xmlrpc_DECREF(paramArrayP);
+    strfree(methodName);
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testPushParseBadInPieces(const char * const xml) {
+/*----------------------------------------------------------------------------
+   Feed the bad call 'xml' to the push parser one byte at a time, then in
+   two pieces split at every place, and check that it fails.
+-----------------------------------------------------------------------------*/
+    size_t const xmlLen = strlen(xml);
+
+    size_t * cuts;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    size_t i;
+
+    cuts = malloc(xmlLen * sizeof(cuts[0]));
+    TEST(cuts != NULL);
+
+    for (i = 1; i < xmlLen; ++i)
+        cuts[i-1] = i;
+
+    {
+        xmlrpc_env env;
+        xmlrpc_env_init(&env);
+        parseCallInPieces(&env, xml, cuts, xmlLen - 1, true,
+                          &methodName, &paramArrayP);
+        TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+        xmlrpc_env_clean(&env);
+    }
+    for (i = 0; i <= xmlLen; ++i) {
+        xmlrpc_env env;
+        xmlrpc_env_init(&env);
+        cuts[0] = i;
+        parseCallInPieces(&env, xml, cuts, 1, true,
+                          &methodName, &paramArrayP);
+        TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+        xmlrpc_env_clean(&env);
+    }
+    free(cuts);
+}
+
+
+
+static void
+testPushParseBad(void) {
+
+    const char ** badCallP;
+
+    /* Not well-formed XML: the method name is never closed */
+    testPushParseBadInPieces(
+        "<?xml version=\"1.0\"?>\r\n"
+        "<methodCall><methodName>m</params>"
+        "<params><param><value><i4>1</i4></value></param></params>"
+        "</methodCall>\r\n");
+
+    /* Well-formed XML, but not a valid XML-RPC value */
+    testPushParseBadInPieces(
+        "<?xml version=\"1.0\"?>\r\n"
+        "<methodCall><methodName>m</methodName>"
+        "<params><param><value><i4>one</i4></value></param></params>"
+        "</methodCall>\r\n");
+
+    /* Truncated: a fault only when we say it's finished */
+    testPushParseBadInPieces(
+        "<?xml version=\"1.0\"?>\r\n"
+        "<methodCall><methodName>m</methodName>"
+        "<params><param><value><i4>1</i4></value></param>");
+
+    for (badCallP = bad_calls; *badCallP; ++badCallP)
+        testPushParseBadInPieces(*badCallP);
+}
+
+
+
+static void
+testPushParseDestroy(void) {
+/*----------------------------------------------------------------------------
+   Destroying a push parser without finishing the parse must release
+   everything, whether it was in the middle of the call or had seen all of
+   it.
+-----------------------------------------------------------------------------*/
+    size_t const xmlLen = strlen(pushCall);
+
+    xmlrpc_env env;
+    xmlrpc_callParser * parserP;
+
+    xmlrpc_env_init(&env);
+
+    /* Never fed */
+    xmlrpc_callParserCreate(&env, NULL, true, &parserP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_callParserDestroy(parserP);
+
+    /* Stopped in the middle of the parameters */
+    xmlrpc_callParserCreate(&env, NULL, true, &parserP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_callParserFeed(&env, parserP, pushCall, xmlLen / 2);
+    TEST_NO_FAULT(&env);
+    xmlrpc_callParserDestroy(parserP);
+
+    /* Fed the whole call */
+    xmlrpc_callParserCreate(&env, NULL, true, &parserP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_callParserFeed(&env, parserP, pushCall, xmlLen);
+    TEST_NO_FAULT(&env);
+    xmlrpc_callParserDestroy(parserP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testParseArenaScope(void) {
+/*----------------------------------------------------------------------------
+   Only a server's call gets built in an arena.  A value that its caller may
+   keep as long as it likes must not hold the memory of its whole document.
+-----------------------------------------------------------------------------*/
+    const char * const xmlInt7 = "<value><int>7</int></value>";
+
+    xmlrpc_env env;
+    const char * methodName;
+    xmlrpc_value * paramArrayP;
+    xmlrpc_value * valueP;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_parse_call(&env, serialized_call, strlen(serialized_call),
+                      &methodName, &paramArrayP);
+    TEST_NO_FAULT(&env);
+    TEST(paramArrayP->arenaP == NULL);
+    xmlrpc_DECREF(paramArrayP);
+    strfree(methodName);
+
+    valueP = xmlrpc_parse_response(&env, good_response_xml,
+                                   strlen(good_response_xml));
+    TEST_NO_FAULT(&env);
+    TEST(valueP->arenaP == NULL);
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_parse_value_xml(&env, xmlInt7, strlen(xmlInt7), &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP->arenaP == NULL);
+    xmlrpc_DECREF(valueP);
+
+    xmlrpc_parse_call2(&env, serialized_call, strlen(serialized_call), NULL,
+                       true, &methodName, &paramArrayP);
+    TEST_NO_FAULT(&env);
+#if HAVE_THREAD_LOCAL && HAVE_ATOMIC_REFCOUNT
+    TEST(paramArrayP->arenaP != NULL);
+#else
+    TEST(paramArrayP->arenaP == NULL);
+#endif
+    xmlrpc_DECREF(paramArrayP);
+    strfree(methodName);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 testParseXmlValue(void) {
 
@@ -530,10 +979,16 @@ test_parse_xml(void) {
     printf("Running XML parsing tests.\n");
     testParseNumberValue();
     testParseMiscSimpleValue();
+    testParseDatetime();
     testParseGoodResponse();
     testParseFaultResponse();
     testParseBadResponse();
     testParseXmlCall();
+    testPushParseGood(false);
+    testPushParseGood(true);
+    testPushParseBad();
+    testPushParseDestroy();
+    testParseArenaScope();
     testParseXmlValue();
     printf("\n");
     printf("XML parsing tests done.\n");
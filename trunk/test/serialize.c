@@ -5,6 +5,7 @@
 #include "xmlrpc_config.h"
 
 #include "xmlrpc-c/base.h"
+#include "xmlrpc-c/base_int.h"
 
 #include "testtool.h"
 #include "xml_data.h"
@@ -298,6 +299,155 @@ test_serialize_apache(void) {
 
 
 
+struct flushCollector {
+    xmlrpc_mem_block * collectedP;
+    unsigned int       flushCount;
+    size_t             maxFlushSize;
+    bool               keep;
+        /* Leave the XML in the serializer's buffer instead of taking it */
+};
+
+
+
+static xmlrpc_serializeFlushFn collectFlush;
+
+static void
+collectFlush(xmlrpc_env *       const envP,
+             void *             const arg,
+             xmlrpc_mem_block * const outputP) {
+
+    struct flushCollector * const collectorP = arg;
+    size_t const size = XMLRPC_MEMBLOCK_SIZE(char, outputP);
+
+    ++collectorP->flushCount;
+
+    if (!collectorP->keep) {
+        if (size > collectorP->maxFlushSize)
+            collectorP->maxFlushSize = size;
+
+        XMLRPC_MEMBLOCK_APPEND(char, envP, collectorP->collectedP,
+                               XMLRPC_MEMBLOCK_CONTENTS(char, outputP), size);
+        XMLRPC_MEMBLOCK_RESIZE(char, envP, outputP, 0);
+    }
+}
+
+
+
+static void
+testStreamFlushSize(xmlrpc_value *     const valueP,
+                    xmlrpc_mem_block * const referenceP,
+                    size_t             const flushSize,
+                    bool               const keep) {
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * outputP;
+    struct flushCollector collector;
+
+    xmlrpc_env_init(&env);
+
+    collector.collectedP   = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    collector.flushCount   = 0;
+    collector.maxFlushSize = 0;
+    collector.keep         = keep;
+    outputP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+
+    xmlrpc_serializeResponseStream(&env, outputP, valueP, xmlrpc_dialect_i8,
+                                   flushSize, &collectFlush, &collector);
+    TEST_NO_FAULT(&env);
+
+    TEST(collector.flushCount > 1);
+    if (keep)
+        TEST(XMLRPC_MEMBLOCK_SIZE(char, collector.collectedP) == 0);
+    else
+        /* A flush can go over by one struct member, or by a piece of
+           string that grew as much as 6 times in escaping (CR becomes
+           &#x0d;).
+        */
+        TEST(collector.maxFlushSize < 7 * flushSize + 200);
+
+    XMLRPC_MEMBLOCK_APPEND(char, &env, collector.collectedP,
+                           XMLRPC_MEMBLOCK_CONTENTS(char, outputP),
+                           XMLRPC_MEMBLOCK_SIZE(char, outputP));
+    TEST_NO_FAULT(&env);
+
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, collector.collectedP) ==
+         XMLRPC_MEMBLOCK_SIZE(char, referenceP));
+    TEST(memcmp(XMLRPC_MEMBLOCK_CONTENTS(char, collector.collectedP),
+                XMLRPC_MEMBLOCK_CONTENTS(char, referenceP),
+                XMLRPC_MEMBLOCK_SIZE(char, referenceP)) == 0);
+
+    XMLRPC_MEMBLOCK_FREE(char, outputP);
+    XMLRPC_MEMBLOCK_FREE(char, collector.collectedP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+test_serialize_stream(void) {
+
+    /* Serialize a big methodResponse a piece at a time and make sure the
+       pieces add up to the same thing as serializing it all at once.
+    */
+    xmlrpc_env env;
+    xmlrpc_value * arrayP;
+    xmlrpc_value * v;
+    xmlrpc_mem_block * referenceP;
+    char longString[5000];
+    unsigned char binary[3000];
+    unsigned int i;
+
+    xmlrpc_env_init(&env);
+
+    /* A string with 2-byte UTF-8 characters (\xc3\xa9 is e-acute) and
+       characters that need escaping, which a piece boundary must not split
+    */
+    for (i = 0; i + 3 < sizeof(longString); i += 3) {
+        longString[i]   = '\xc3';
+        longString[i+1] = '\xa9';
+        longString[i+2] = i % 2 ? '&' : 'x';
+    }
+    longString[i] = '\0';
+
+    for (i = 0; i < sizeof(binary); ++i)
+        binary[i] = (unsigned char)i;
+
+    arrayP = xmlrpc_array_new(&env);
+    for (i = 0; i < 200; ++i) {
+        v = xmlrpc_build_value(&env, "{s:i,s:s}",
+                               "index", (xmlrpc_int32)i, "name", "item");
+        xmlrpc_array_append_item(&env, arrayP, v);
+        xmlrpc_DECREF(v);
+    }
+    v = xmlrpc_string_new(&env, longString);
+    xmlrpc_array_append_item(&env, arrayP, v);
+    xmlrpc_DECREF(v);
+    v = xmlrpc_base64_new(&env, sizeof(binary), binary);
+    xmlrpc_array_append_item(&env, arrayP, v);
+    xmlrpc_DECREF(v);
+    v = xmlrpc_base64_new(&env, 0, binary);
+    xmlrpc_array_append_item(&env, arrayP, v);
+    xmlrpc_DECREF(v);
+    TEST_NO_FAULT(&env);
+
+    referenceP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_response(&env, referenceP, arrayP);
+    TEST_NO_FAULT(&env);
+
+    testStreamFlushSize(arrayP, referenceP, 1, false);
+    testStreamFlushSize(arrayP, referenceP, 100, false);
+    testStreamFlushSize(arrayP, referenceP, 1000, false);
+    testStreamFlushSize(arrayP, referenceP, 100, true);
+
+    XMLRPC_MEMBLOCK_FREE(char, referenceP);
+    xmlrpc_DECREF(arrayP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 void 
 test_serialize(void) {
 
@@ -310,6 +460,7 @@ test_serialize(void) {
     test_serialize_methodCall();
     test_serialize_fault();
     test_serialize_apache();
+    test_serialize_stream();
 
     printf("\n");
     printf("Serialize tests done.\n");
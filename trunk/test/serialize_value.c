@@ -166,6 +166,58 @@ testOneDouble(double const value) {
 
 
 
+static void
+test_serialize_string_escape(void) {
+
+    /* Test escaping of characters throughout a long string, so that they
+       fall in various places with respect to however many characters the
+       serializer looks at at once.
+    */
+
+    char const specials[] = "<>&\r";
+    char const * const entities[] = {"&lt;", "&gt;", "&amp;", "&#x0d;"};
+
+    xmlrpc_env env;
+    xmlrpc_value * v;
+    xmlrpc_mem_block * xmlP;         /* Serialized result */
+    char str[200];
+    char expected[sizeof("<value><string></string></value>") + 6 * 200];
+    unsigned int i;
+    unsigned int j;
+
+    xmlrpc_env_init(&env);
+
+    strcpy(expected, "<value><string>");
+    for (i = 0, j = strlen(expected); i < sizeof(str); ++i) {
+        if (i % 7 == 0 || i % 31 == 0) {
+            unsigned int const k = (i / 7) % 4;
+            str[i] = specials[k];
+            strcpy(&expected[j], entities[k]);
+            j += strlen(entities[k]);
+        } else {
+            str[i] = 'a' + i % 26;
+            expected[j++] = str[i];
+        }
+    }
+    strcpy(&expected[j], "</string></value>");
+
+    v = xmlrpc_string_new_lp_cr(&env, sizeof(str), str);
+    TEST_NO_FAULT(&env);
+
+    xmlP = XMLRPC_MEMBLOCK_NEW(char, &env, 0);
+    xmlrpc_serialize_value(&env, xmlP, v);
+    TEST_NO_FAULT(&env);
+    TEST(XMLRPC_MEMBLOCK_SIZE(char, xmlP) == strlen(expected));
+    TEST(memeq(XMLRPC_MEMBLOCK_CONTENTS(char, xmlP), expected,
+               XMLRPC_MEMBLOCK_SIZE(char, xmlP)));
+    XMLRPC_MEMBLOCK_FREE(char, xmlP);
+    xmlrpc_DECREF(v);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 test_serialize_double(void) {
 
@@ -232,6 +284,8 @@ test_serialize_value(void) {
 
     test_serialize_string();
 
+    test_serialize_string_escape();
+
     test_serialize_double();
 
     test_serialize_struct();
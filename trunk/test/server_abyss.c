@@ -59,6 +59,15 @@ testSetHandlers(TServer * const abyssServerP) {
         &env, abyssServerP, &parms, XMLRPC_AHPSIZE(allow_origin));
     TEST_NO_FAULT(&env);
 
+    parms.uri_path = "/RPC7";
+    parms.access_ctl_expires = false;
+    parms.access_ctl_max_age = 0;
+    parms.compression_level = 6;
+    parms.compression_threshold = 0;
+    xmlrpc_server_abyss_set_handler3(
+        &env, abyssServerP, &parms, XMLRPC_AHPSIZE(compression_threshold));
+    TEST_NO_FAULT(&env);
+
     xmlrpc_server_abyss_set_handler2(abyssServerP, "/RPC5",
                                      &myXmlProcessor, NULL, 512, true);
 
@@ -107,6 +116,15 @@ testServerParms(void) {
     parms.sockaddr_p = &sockaddr;
     parms.sockaddrlen = sizeof(sockaddr);
     parms.log_file_name = "/tmp/xmlrpc_logfile";
+    parms.event_driven = true;
+    parms.event_io_threads = 2;
+    parms.event_workers = 8;
+    parms.thread_pool_min = 2;
+    parms.thread_pool_max = 8;
+    parms.thread_pool_idle_timeout = 30;
+    parms.compression_level = 6;
+    parms.compression_threshold = 512;
+    parms.conn_buffer_size = 65536;
 
     if (parms.config_file_name) {}  // Defeat set-but-unused compiler warning
 };
@@ -265,6 +283,8 @@ test_server_abyss(void) {
     ServerSetKeepaliveMaxConn(&abyssServer, 10);
     ServerSetTimeout(&abyssServer, 0);
     ServerSetAdvertise(&abyssServer, false);
+    ServerSetEventDriven(&abyssServer, true);
+    ServerSetEventThreads(&abyssServer, 2, 8);
 
     ServerFree(&abyssServer);
 
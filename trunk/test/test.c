@@ -18,6 +18,7 @@
 #include "xmlrpc-c/base.h"
 #include "xmlrpc-c/server.h"
 #include "xmlrpc-c/string_int.h"
+#include "xmlrpc-c/compress_int.h"
 
 #include "bool.h"
 #include "testtool.h"
@@ -199,6 +200,48 @@ testBase64Conversion(void) {
         xmlrpc_mem_block_free(output);
     }
 
+    /* Round trips of binary data of every length up to several lines, so
+       as to end at every place with respect to a line and to however much
+       data the codec handles at once.
+    */
+    {
+        unsigned char bin_data[300];
+        unsigned int len;
+
+        for (len = 0; len < sizeof(bin_data); ++len)
+            bin_data[len] = (unsigned char)(len * 97 + 13);
+
+        for (len = 0; len <= sizeof(bin_data); ++len) {
+            unsigned int withNewlines;
+
+            for (withNewlines = 0; withNewlines < 2; ++withNewlines) {
+                xmlrpc_mem_block * encoded;
+                xmlrpc_mem_block * decoded;
+
+                encoded = withNewlines ?
+                    xmlrpc_base64_encode(&env, bin_data, len) :
+                    xmlrpc_base64_encode_without_newlines(&env,
+                                                          bin_data, len);
+                TEST_NO_FAULT(&env);
+                TEST(xmlrpc_mem_block_size(encoded) ==
+                     (len + 2) / 3 * 4 +
+                     (withNewlines ? 2 * (len == 0 ? 1 : (len + 56) / 57) :
+                      0));
+
+                decoded = xmlrpc_base64_decode(
+                    &env, xmlrpc_mem_block_contents(encoded),
+                    xmlrpc_mem_block_size(encoded));
+                TEST_NO_FAULT(&env);
+                TEST(xmlrpc_mem_block_size(decoded) == len);
+                TEST(memcmp(xmlrpc_mem_block_contents(decoded), bin_data,
+                            len) == 0);
+
+                xmlrpc_mem_block_free(decoded);
+                xmlrpc_mem_block_free(encoded);
+            }
+        }
+    }
+
     /* Now for something broken... */
     {
         xmlrpc_env env2;
@@ -225,6 +268,165 @@ testBase64Conversion(void) {
 
 
 
+static void
+decompressInPieces(xmlrpc_env *         const envP,
+                   xmlrpc_contentCoding const coding,
+                   const char *         const data,
+                   size_t               const len,
+                   size_t               const pieceSize,
+                   size_t               const maxSize,
+                   xmlrpc_mem_block **  const outputPP) {
+
+    xmlrpc_zstream * zsP;
+
+    xmlrpc_zstreamCreateInflate(envP, coding, maxSize, &zsP);
+
+    if (!envP->fault_occurred) {
+        xmlrpc_mem_block * const outputP = xmlrpc_mem_block_new(envP, 0);
+
+        size_t done;
+
+        for (done = 0; done < len && !envP->fault_occurred; ) {
+            size_t const thisLen =
+                len - done < pieceSize ? len - done : pieceSize;
+
+            xmlrpc_zstreamFeed(envP, zsP, &data[done], thisLen, outputP);
+
+            done += thisLen;
+        }
+        if (!envP->fault_occurred)
+            xmlrpc_zstreamFinish(envP, zsP, outputP);
+
+        if (envP->fault_occurred)
+            xmlrpc_mem_block_free(outputP);
+        else
+            *outputPP = outputP;
+
+        xmlrpc_zstreamDestroy(zsP);
+    }
+}
+
+
+
+static void
+testCompressionRoundTrip(xmlrpc_contentCoding const coding,
+                         const char *         const data,
+                         size_t               const len) {
+
+    xmlrpc_env env;
+    xmlrpc_mem_block * compressedP;
+    const char * compressed;
+    size_t compressedLen;
+    size_t pieceSize;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_compress(&env, coding, 6, data, len, &compressedP);
+    TEST_NO_FAULT(&env);
+
+    compressed    = xmlrpc_mem_block_contents(compressedP);
+    compressedLen = xmlrpc_mem_block_size(compressedP);
+
+    TEST(compressedLen < len / 10);
+
+    if (coding == XMLRPC_CODING_GZIP)
+        TEST((unsigned char)compressed[0] == 0x1f &&
+             (unsigned char)compressed[1] == 0x8b);
+
+    for (pieceSize = 1; pieceSize <= compressedLen; pieceSize *= 7) {
+        xmlrpc_mem_block * outputP;
+
+        decompressInPieces(&env, coding, compressed, compressedLen,
+                           pieceSize, len, &outputP);
+        TEST_NO_FAULT(&env);
+        TEST(xmlrpc_mem_block_size(outputP) == len);
+        TEST(memcmp(xmlrpc_mem_block_contents(outputP), data, len) == 0);
+        xmlrpc_mem_block_free(outputP);
+    }
+    {
+        xmlrpc_mem_block * outputP;
+
+        /* Decompresses to more than we allow */
+        decompressInPieces(&env, coding, compressed, compressedLen,
+                           compressedLen, len - 1, &outputP);
+        TEST_FAULT(&env, XMLRPC_LIMIT_EXCEEDED_ERROR);
+
+        /* Truncated */
+        decompressInPieces(&env, coding, compressed, compressedLen - 1,
+                           compressedLen, len, &outputP);
+        TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+    }
+    {
+        xmlrpc_mem_block * outputP;
+        char * corrupt = malloc(compressedLen + 1);
+
+        /* Garbage after the end */
+        memcpy(corrupt, compressed, compressedLen);
+        corrupt[compressedLen] = 'x';
+        decompressInPieces(&env, coding, corrupt, compressedLen + 1,
+                           compressedLen + 1, len, &outputP);
+        TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+        /* Not compressed data at all */
+        decompressInPieces(&env, coding, data, len, len, len, &outputP);
+        TEST_FAULT(&env, XMLRPC_PARSE_ERROR);
+
+        free(corrupt);
+    }
+    xmlrpc_mem_block_free(compressedP);
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
+static void
+testCompression(void) {
+
+    xmlrpc_env env;
+    bool recognized;
+    xmlrpc_contentCoding coding;
+
+    xmlrpc_env_init(&env);
+
+    xmlrpc_contentCodingFromName("gzip", &recognized, &coding);
+    TEST(recognized && coding == XMLRPC_CODING_GZIP);
+    xmlrpc_contentCodingFromName("X-Gzip", &recognized, &coding);
+    TEST(recognized && coding == XMLRPC_CODING_GZIP);
+    xmlrpc_contentCodingFromName("deflate", &recognized, &coding);
+    TEST(recognized && coding == XMLRPC_CODING_DEFLATE);
+    xmlrpc_contentCodingFromName("identity", &recognized, &coding);
+    TEST(recognized && coding == XMLRPC_CODING_IDENTITY);
+    xmlrpc_contentCodingFromName("br", &recognized, &coding);
+    TEST(!recognized);
+
+    TEST(xmlrpc_streq(xmlrpc_contentCodingName(XMLRPC_CODING_GZIP), "gzip"));
+
+    if (xmlrpc_compressionAvailable()) {
+        size_t const len = 100000;
+        char * const data = malloc(len);
+        size_t i;
+
+        TEST(data != NULL);
+
+        for (i = 0; i < len; ++i)
+            data[i] = "<value><i4>17</i4></value>\n"[i % 27];
+
+        testCompressionRoundTrip(XMLRPC_CODING_GZIP, data, len);
+        testCompressionRoundTrip(XMLRPC_CODING_DEFLATE, data, len);
+
+        free(data);
+    } else {
+        xmlrpc_mem_block * outputP;
+
+        xmlrpc_compress(&env, XMLRPC_CODING_GZIP, 6, "x", 1, &outputP);
+        TEST_FAULT(&env, XMLRPC_INTERNAL_ERROR);
+    }
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 testBoundsChecks(void) {
 
@@ -668,6 +870,7 @@ main(int     argc,
         printf("\n");
         test_memBlock();
         testBase64Conversion();
+        testCompression();
         printf("\n");
         test_value();
         testBoundsChecks();
@@ -1926,6 +1926,98 @@ testStructDuplicate(xmlrpc_value * structP) {
 
 
 
+static void
+testStructLarge(void) {
+/*----------------------------------------------------------------------------
+   Exercise a struct big enough that it has a hash index.
+-----------------------------------------------------------------------------*/
+    unsigned int const mbrCt = 1000;
+
+    xmlrpc_env env;
+    xmlrpc_value * sP;
+    xmlrpc_value * valueP;
+    unsigned int i;
+    int present;
+
+    xmlrpc_env_init(&env);
+
+    sP = xmlrpc_struct_new(&env);
+    TEST_NO_FAULT(&env);
+
+    for (i = 0; i < mbrCt; ++i) {
+        char key[32];
+        xmlrpc_value * const iP = xmlrpc_int_new(&env, i);
+        TEST_NO_FAULT(&env);
+        sprintf(key, "member%u", i);
+        xmlrpc_struct_set_value(&env, sP, key, iP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(iP);
+    }
+    TEST(xmlrpc_struct_size(&env, sP) == (int)mbrCt);
+
+    /* Replacing a member's value must not add a member */
+    valueP = xmlrpc_int_new(&env, -1);
+    TEST_NO_FAULT(&env);
+    xmlrpc_struct_set_value(&env, sP, "member500", valueP);
+    TEST_NO_FAULT(&env);
+    xmlrpc_DECREF(valueP);
+    TEST(xmlrpc_struct_size(&env, sP) == (int)mbrCt);
+
+    for (i = 0; i < mbrCt; ++i) {
+        char key[32];
+        xmlrpc_value * keyP;
+        xmlrpc_int value;
+        const char * keyStr;
+
+        sprintf(key, "member%u", i);
+
+        /* Lookup by key */
+        xmlrpc_struct_read_value(&env, sP, key, &valueP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_int(&env, valueP, &value);
+        TEST_NO_FAULT(&env);
+        TEST(value == (i == 500 ? -1 : (xmlrpc_int)i));
+        xmlrpc_DECREF(valueP);
+
+        /* Members are still in the order we added them */
+        xmlrpc_struct_read_member(&env, sP, i, &keyP, &valueP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_string(&env, keyP, &keyStr);
+        TEST_NO_FAULT(&env);
+        TEST(streq(keyStr, key));
+        strfree(keyStr);
+        xmlrpc_DECREF(keyP);
+        xmlrpc_DECREF(valueP);
+    }
+
+    present = xmlrpc_struct_has_key(&env, sP, "member1000");
+    TEST_NO_FAULT(&env);
+    TEST(!present);
+
+    xmlrpc_struct_find_value(&env, sP, "", &valueP);
+    TEST_NO_FAULT(&env);
+    TEST(valueP == NULL);
+
+    /* A copy gets its own index */
+    {
+        xmlrpc_value * const copyP = xmlrpc_value_new(&env, sP);
+        xmlrpc_int value;
+        TEST_NO_FAULT(&env);
+        xmlrpc_DECREF(sP);
+        xmlrpc_struct_read_value(&env, copyP, "member999", &valueP);
+        TEST_NO_FAULT(&env);
+        xmlrpc_read_int(&env, valueP, &value);
+        TEST_NO_FAULT(&env);
+        TEST(value == 999);
+        xmlrpc_DECREF(valueP);
+        xmlrpc_DECREF(copyP);
+    }
+
+    xmlrpc_env_clean(&env);
+}
+
+
+
 static void
 test_struct(void) {
 
@@ -2055,6 +2147,8 @@ test_struct(void) {
     /* Test cleanup code (w/memprof). */
     xmlrpc_DECREF(s);
 
+    testStructLarge();
+
     xmlrpc_DECREF(i1);
     xmlrpc_DECREF(i2);
     xmlrpc_DECREF(i3);